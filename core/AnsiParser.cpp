@@ -0,0 +1,328 @@
+#include "AnsiParser.h"
+
+#include <array>
+
+namespace MTerm {
+
+namespace {
+
+enum Action : uint8_t {
+  ActNone,
+  ActPrint,
+  ActExecute,
+  ActCollect,
+  ActParam,
+  ActEscDispatch,
+  ActCsiDispatch,
+  ActPut,
+};
+
+constexpr uint8_t Pack(Action action, uint8_t state) {
+  return static_cast<uint8_t>((action << 4) | state);
+}
+
+// Transition table indexed by [state][byte]. Each entry packs the action in
+// the high nibble and the next state in the low nibble. Entry/exit actions
+// (clear, OSC start/end, DCS hook/unhook) are handled in Transition().
+struct TransitionTable {
+  std::array<std::array<uint8_t, 256>, AnsiParser::NumStates> entries{};
+
+  constexpr void Set(uint8_t state,
+                     int from,
+                     int to,
+                     Action action,
+                     uint8_t next) {
+    for (int i = from; i <= to; i++) {
+      entries[state][i] = Pack(action, next);
+    }
+  }
+};
+
+constexpr TransitionTable BuildTable() {
+  using S = AnsiParser;
+  TransitionTable t;
+  for (uint8_t s = 0; s < AnsiParser::NumStates; s++) {
+    t.Set(s, 0x00, 0xFF, ActNone, s);
+  }
+
+  // Ground
+  t.Set(S::Ground, 0x00, 0x1F, ActExecute, S::Ground);
+  t.Set(S::Ground, 0x20, 0x7E, ActPrint, S::Ground);
+  t.Set(S::Ground, 0x80, 0xFF, ActPrint, S::Ground);
+
+  // Escape
+  t.Set(S::Escape, 0x00, 0x1F, ActExecute, S::Escape);
+  t.Set(S::Escape, 0x20, 0x2F, ActCollect, S::EscapeIntermediate);
+  t.Set(S::Escape, 0x30, 0x7E, ActEscDispatch, S::Ground);
+  t.Set(S::Escape, 0x5B, 0x5B, ActNone, S::CsiEntry);        // [
+  t.Set(S::Escape, 0x5D, 0x5D, ActNone, S::OscString);       // ]
+  t.Set(S::Escape, 0x50, 0x50, ActNone, S::DcsEntry);        // P
+  t.Set(S::Escape, 0x58, 0x58, ActNone, S::SosPmApcString);  // X
+  t.Set(S::Escape, 0x5E, 0x5F, ActNone, S::SosPmApcString);  // ^ _
+
+  t.Set(S::EscapeIntermediate, 0x00, 0x1F, ActExecute, S::EscapeIntermediate);
+  t.Set(S::EscapeIntermediate, 0x20, 0x2F, ActCollect, S::EscapeIntermediate);
+  t.Set(S::EscapeIntermediate, 0x30, 0x7E, ActEscDispatch, S::Ground);
+
+  // CSI
+  t.Set(S::CsiEntry, 0x00, 0x1F, ActExecute, S::CsiEntry);
+  t.Set(S::CsiEntry, 0x20, 0x2F, ActCollect, S::CsiIntermediate);
+  t.Set(S::CsiEntry, 0x30, 0x3B, ActParam, S::CsiParam);
+  t.Set(S::CsiEntry, 0x3C, 0x3F, ActCollect, S::CsiParam);
+  t.Set(S::CsiEntry, 0x40, 0x7E, ActCsiDispatch, S::Ground);
+
+  t.Set(S::CsiParam, 0x00, 0x1F, ActExecute, S::CsiParam);
+  t.Set(S::CsiParam, 0x20, 0x2F, ActCollect, S::CsiIntermediate);
+  t.Set(S::CsiParam, 0x30, 0x3B, ActParam, S::CsiParam);
+  t.Set(S::CsiParam, 0x3C, 0x3F, ActNone, S::CsiIgnore);
+  t.Set(S::CsiParam, 0x40, 0x7E, ActCsiDispatch, S::Ground);
+
+  t.Set(S::CsiIntermediate, 0x00, 0x1F, ActExecute, S::CsiIntermediate);
+  t.Set(S::CsiIntermediate, 0x20, 0x2F, ActCollect, S::CsiIntermediate);
+  t.Set(S::CsiIntermediate, 0x30, 0x3F, ActNone, S::CsiIgnore);
+  t.Set(S::CsiIntermediate, 0x40, 0x7E, ActCsiDispatch, S::Ground);
+
+  t.Set(S::CsiIgnore, 0x00, 0x1F, ActExecute, S::CsiIgnore);
+  t.Set(S::CsiIgnore, 0x40, 0x7E, ActNone, S::Ground);
+
+  // Non-ASCII bytes interrupt a sequence header and are printed as text
+  for (uint8_t s : {S::Escape, S::EscapeIntermediate, S::CsiEntry, S::CsiParam,
+                    S::CsiIntermediate, S::CsiIgnore}) {
+    t.Set(s, 0x80, 0xFF, ActPrint, S::Ground);
+  }
+
+  // DCS
+  t.Set(S::DcsEntry, 0x20, 0x2F, ActCollect, S::DcsIntermediate);
+  t.Set(S::DcsEntry, 0x30, 0x3B, ActParam, S::DcsParam);
+  t.Set(S::DcsEntry, 0x3C, 0x3F, ActCollect, S::DcsParam);
+  t.Set(S::DcsEntry, 0x40, 0x7E, ActNone, S::DcsPassthrough);
+
+  t.Set(S::DcsParam, 0x20, 0x2F, ActCollect, S::DcsIntermediate);
+  t.Set(S::DcsParam, 0x30, 0x3B, ActParam, S::DcsParam);
+  t.Set(S::DcsParam, 0x3C, 0x3F, ActNone, S::DcsIgnore);
+  t.Set(S::DcsParam, 0x40, 0x7E, ActNone, S::DcsPassthrough);
+
+  t.Set(S::DcsIntermediate, 0x20, 0x2F, ActCollect, S::DcsIntermediate);
+  t.Set(S::DcsIntermediate, 0x30, 0x3F, ActNone, S::DcsIgnore);
+  t.Set(S::DcsIntermediate, 0x40, 0x7E, ActNone, S::DcsPassthrough);
+
+  t.Set(S::DcsPassthrough, 0x00, 0x7E, ActPut, S::DcsPassthrough);
+  t.Set(S::DcsPassthrough, 0x80, 0xFF, ActPut, S::DcsPassthrough);
+
+  // OSC, terminated by BEL or ST
+  t.Set(S::OscString, 0x20, 0xFF, ActPut, S::OscString);
+  t.Set(S::OscString, 0x07, 0x07, ActNone, S::Ground);
+
+  // Transitions valid from any state
+  for (uint8_t s = 0; s < AnsiParser::NumStates; s++) {
+    t.Set(s, 0x18, 0x18, ActExecute, S::Ground);  // CAN
+    t.Set(s, 0x1A, 0x1A, ActExecute, S::Ground);  // SUB
+    t.Set(s, 0x1B, 0x1B, ActNone, S::Escape);     // ESC
+  }
+  return t;
+}
+
+constexpr TransitionTable kTable = BuildTable();
+
+}  // namespace
+
+AnsiParser::AnsiParser() {
+  Clear();
+}
+
+void AnsiParser::Feed(const char* data, size_t size) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  size_t i = 0;
+  while (i < size) {
+    uint8_t entry = kTable.entries[m_state][bytes[i]];
+    Action action = static_cast<Action>(entry >> 4);
+    State next = static_cast<State>(entry & 0x0F);
+
+    if (action == ActPrint) {
+      // Take the whole printable run at once
+      size_t end = i + 1;
+      end += Utils::FindControlByte(data + end, size - end);
+      Transition(next);
+      Print(data + i, end - i);
+      i = end;
+      continue;
+    }
+
+    if (m_decoder.GetPendingSize() > 0) {
+      FlushPrint();
+    }
+
+    bool is_anywhere =
+        bytes[i] == 0x18 || bytes[i] == 0x1A || bytes[i] == 0x1B;
+    if (next != m_state || is_anywhere) {
+      Transition(next);
+    }
+
+    switch (action) {
+      case ActExecute:
+        Execute(data[i]);
+        break;
+      case ActCollect:
+        Collect(data[i]);
+        break;
+      case ActParam:
+        Param(data[i]);
+        break;
+      case ActEscDispatch:
+        Dispatch(ParserActionType::EscDispatch, data[i]);
+        break;
+      case ActCsiDispatch:
+        Dispatch(ParserActionType::CsiDispatch, data[i]);
+        break;
+      case ActPut:
+        if (m_string.size() < PARSER_MAX_STRING_LENGTH) {
+          m_string.push_back(data[i]);
+        }
+        break;
+      default:
+        break;
+    }
+    if (m_state == DcsPassthrough && m_dcsFinal == 0) {
+      // Hook: the byte which entered passthrough is the DCS final byte
+      m_dcsFinal = data[i];
+    }
+    i++;
+  }
+}
+
+const std::vector<ParserAction>& AnsiParser::GetActions() const {
+  return m_actions;
+}
+
+const std::string& AnsiParser::GetData() const {
+  return m_data;
+}
+
+const std::vector<int>& AnsiParser::GetParams() const {
+  return m_paramStore;
+}
+
+void AnsiParser::ClearActions() {
+  m_actions.clear();
+  m_data.clear();
+  m_paramStore.clear();
+}
+
+void AnsiParser::Reset() {
+  ClearActions();
+  Clear();
+  m_string.clear();
+  m_decoder.Reset();
+  m_state = Ground;
+}
+
+void AnsiParser::Transition(State next) {
+  // Exit actions
+  if (m_state == OscString) {
+    DispatchString(ParserActionType::OscDispatch);
+  } else if (m_state == DcsPassthrough) {
+    DispatchString(ParserActionType::DcsDispatch);
+  }
+  // Entry actions
+  if (next == Escape || next == CsiEntry || next == DcsEntry) {
+    Clear();
+  } else if (next == OscString) {
+    m_string.clear();
+  } else if (next == DcsPassthrough) {
+    m_string.clear();
+    m_dcsFinal = 0;
+  }
+  m_state = next;
+}
+
+void AnsiParser::Collect(char c) {
+  if (c >= 0x3C && c <= 0x3F) {
+    m_privateMarker = c;
+  } else if (m_numIntermediates < PARSER_MAX_INTERMEDIATES) {
+    m_intermediates[m_numIntermediates++] = c;
+  }
+}
+
+void AnsiParser::Param(char c) {
+  if (m_numParams == 0) {
+    m_params[0] = 0;
+    m_numParams = 1;
+  }
+  if (c == ';' || c == ':') {
+    if (m_numParams < PARSER_MAX_PARAMS) {
+      m_params[m_numParams++] = 0;
+    }
+    return;
+  }
+  int& value = m_params[m_numParams - 1];
+  if (value < 100000) {
+    value = value * 10 + (c - '0');
+  }
+}
+
+void AnsiParser::Clear() {
+  m_numParams = 0;
+  m_numIntermediates = 0;
+  m_privateMarker = 0;
+}
+
+void AnsiParser::Print(const char* data, size_t size) {
+  size_t offset = m_data.size();
+  m_decoder.Decode(data, size, m_data);
+  AddPrintAction(offset);
+}
+
+void AnsiParser::FlushPrint() {
+  size_t offset = m_data.size();
+  m_decoder.Flush(m_data);
+  AddPrintAction(offset);
+}
+
+void AnsiParser::AddPrintAction(size_t offset) {
+  size_t size = m_data.size() - offset;
+  if (size == 0) {
+    return;
+  }
+  if (!m_actions.empty() && m_actions.back().type == ParserActionType::Print) {
+    m_actions.back().data_length += static_cast<uint32_t>(size);
+  } else {
+    ParserAction action{};
+    action.type = ParserActionType::Print;
+    action.data_offset = static_cast<uint32_t>(offset);
+    action.data_length = static_cast<uint32_t>(size);
+    m_actions.push_back(action);
+  }
+}
+
+void AnsiParser::Execute(char c) {
+  ParserAction action{};
+  action.type = ParserActionType::Execute;
+  action.final_byte = c;
+  m_actions.push_back(action);
+}
+
+void AnsiParser::Dispatch(ParserActionType type, char final_byte) {
+  ParserAction action{};
+  action.type = type;
+  action.final_byte = final_byte;
+  action.private_marker = m_privateMarker;
+  action.num_intermediates = m_numIntermediates;
+  for (int i = 0; i < m_numIntermediates; i++) {
+    action.intermediates[i] = m_intermediates[i];
+  }
+  action.params_offset = static_cast<uint32_t>(m_paramStore.size());
+  action.num_params = static_cast<uint32_t>(m_numParams);
+  m_paramStore.insert(m_paramStore.end(), m_params, m_params + m_numParams);
+  m_actions.push_back(action);
+}
+
+void AnsiParser::DispatchString(ParserActionType type) {
+  Dispatch(type, type == ParserActionType::DcsDispatch ? m_dcsFinal : 0);
+  ParserAction& action = m_actions.back();
+  action.data_offset = static_cast<uint32_t>(m_data.size());
+  action.data_length = static_cast<uint32_t>(m_string.size());
+  m_data.append(m_string);
+  m_string.clear();
+}
+
+}  // namespace MTerm
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+
+namespace MTerm {
+
+constexpr int PARSER_MAX_PARAMS = 32;
+constexpr int PARSER_MAX_INTERMEDIATES = 2;
+constexpr size_t PARSER_MAX_STRING_LENGTH = 4096;
+
+enum class ParserActionType : uint8_t {
+  Print,        // Run of printable UTF-8 text
+  Execute,      // C0 control code
+  CsiDispatch,  // ESC [ ... final
+  EscDispatch,  // ESC ... final
+  OscDispatch,  // ESC ] ... BEL / ST
+  DcsDispatch,  // ESC P ... ST
+};
+
+struct ParserAction {
+  ParserActionType type;
+  char final_byte;      // Final byte, or the control code for Execute
+  char private_marker;  // One of '<', '=', '>', '?' or 0
+  char intermediates[PARSER_MAX_INTERMEDIATES];
+  int num_intermediates;
+  uint32_t data_offset;  // Print / OSC / DCS payload in GetData()
+  uint32_t data_length;
+  uint32_t params_offset;  // CSI / DCS parameters in GetParams()
+  uint32_t num_params;
+};
+
+// Table-driven VT500-style escape sequence parser. Bytes are fed in arbitrary
+// chunks; the parser keeps its state between calls and records coarse actions
+// (whole print runs, complete sequences) until ClearActions() is called.
+// A UTF-8 sequence split between two chunks is completed by the next Feed().
+class AnsiParser {
+ public:
+  enum State : uint8_t {
+    Ground,
+    Escape,
+    EscapeIntermediate,
+    CsiEntry,
+    CsiParam,
+    CsiIntermediate,
+    CsiIgnore,
+    DcsEntry,
+    DcsParam,
+    DcsIntermediate,
+    DcsPassthrough,
+    DcsIgnore,
+    OscString,
+    SosPmApcString,
+    NumStates
+  };
+
+  AnsiParser();
+
+  void Feed(const char* data, size_t size);
+
+  const std::vector<ParserAction>& GetActions() const;
+
+  const std::string& GetData() const;
+
+  const std::vector<int>& GetParams() const;
+
+  void ClearActions();
+
+  void Reset();
+
+ private:
+  void Transition(State next);
+
+  void Collect(char c);
+
+  void Param(char c);
+
+  void Clear();
+
+  void Print(const char* data, size_t size);
+
+  void FlushPrint();
+
+  void AddPrintAction(size_t offset);
+
+  void Execute(char c);
+
+  void Dispatch(ParserActionType type, char final_byte);
+
+  void DispatchString(ParserActionType type);
+
+  State m_state = Ground;
+
+  int m_params[PARSER_MAX_PARAMS];
+  int m_numParams = 0;
+  char m_intermediates[PARSER_MAX_INTERMEDIATES];
+  int m_numIntermediates = 0;
+  char m_privateMarker = 0;
+  char m_dcsFinal = 0;
+  std::string m_string;  // Pending OSC / DCS payload
+  Utf8StreamDecoder m_decoder;
+
+  std::vector<ParserAction> m_actions;
+  std::string m_data;
+  std::vector<int> m_paramStore;
+};
+
+}  // namespace MTerm
@@ -0,0 +1,38 @@
+#include "AttributeTable.h"
+
+namespace MTerm {
+
+size_t AttributeTable::Hash::operator()(
+    const TextAttributes& attributes) const {
+  uint64_t hash = static_cast<uint32_t>(attributes.color);
+  hash = hash * 0x9E3779B97F4A7C15ull ^
+         static_cast<uint32_t>(attributes.underline_color);
+  hash = hash * 0x9E3779B97F4A7C15ull ^
+         static_cast<uint32_t>(attributes.background_color);
+  hash = hash * 0x9E3779B97F4A7C15ull ^ attributes.flags;
+  return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+uint32_t AttributeTable::Intern(const TextAttributes& attributes) {
+  auto [it, inserted] = m_ids.try_emplace(
+      attributes, static_cast<uint32_t>(m_attributes.size()));
+  if (inserted) {
+    m_attributes.push_back(attributes);
+  }
+  return it->second;
+}
+
+const TextAttributes& AttributeTable::Get(uint32_t id) const {
+  return m_attributes[id];
+}
+
+size_t AttributeTable::GetSize() const {
+  return m_attributes.size();
+}
+
+void AttributeTable::Clear() {
+  m_attributes.clear();
+  m_ids.clear();
+}
+
+}  // namespace MTerm
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace MTerm {
+
+// Colors are 0xRRGGBB, COLOR_DEFAULT, or a palette index tagged with
+// COLOR_PALETTE_FLAG that the renderer resolves with the current palette.
+constexpr int COLOR_DEFAULT = -1;
+constexpr int COLOR_PALETTE_FLAG = 0x1000000;
+constexpr int PALETTE_SIZE = 256;
+
+enum AttributeFlags : uint32_t {
+  ATTR_BOLD = 1 << 0,
+  ATTR_ITALIC = 1 << 1,
+  ATTR_INVERSE = 1 << 2,
+};
+
+struct TextAttributes {
+  int color;
+  int underline_color;
+  int background_color;
+  uint32_t flags;
+
+  bool operator==(const TextAttributes& other) const = default;
+};
+
+// Interns distinct attribute combinations so that text runs only store a
+// 32-bit id. Ids are dense and stay valid until Clear().
+class AttributeTable {
+ public:
+  uint32_t Intern(const TextAttributes& attributes);
+
+  const TextAttributes& Get(uint32_t id) const;
+
+  size_t GetSize() const;
+
+  void Clear();
+
+ private:
+  struct Hash {
+    size_t operator()(const TextAttributes& attributes) const;
+  };
+
+  std::vector<TextAttributes> m_attributes;
+  std::unordered_map<TextAttributes, uint32_t, Hash> m_ids;
+};
+
+}  // namespace MTerm
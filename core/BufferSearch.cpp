@@ -0,0 +1,446 @@
+#include "BufferSearch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "Utils.h"
+
+namespace MTerm {
+
+namespace {
+
+// What starting on lines away from the previous ones costs, in lines: cold
+// lines are decompressed a block at a time
+constexpr size_t kSeekLines = COLD_BLOCK_LINES / 2;
+
+// Columns [first, second) of one line
+using Range = std::pair<int, int>;
+
+// Lines copied by one Update(), in the order they are searched
+struct Batch {
+  uint64_t trimmed;  // Matches on lines before it are evicted
+  uint64_t end;      // and on lines from it on are removed
+  std::vector<uint64_t> lines;
+  std::vector<size_t> offsets;  // Into text, one more than lines
+  std::vector<char32_t> text;
+};
+
+}  // namespace
+
+class BufferSearch::Impl {
+ public:
+  Impl(const ColoredTextBuffer& buffer,
+       const std::string& pattern,
+       SearchMode mode,
+       bool ignore_case)
+      : m_buffer(buffer), m_mode(mode), m_ignoreCase(ignore_case) {
+    if (pattern.empty()) {
+      throw std::runtime_error("Empty search pattern");
+    }
+    Utils::Utf8ToUtf32(pattern.data(), pattern.size(), m_needle);
+    if (mode == SearchMode::Regex) {
+      std::wstring wide;
+      std::vector<int> columns;
+      Utils::Utf32ToWChar(m_needle.data(), m_needle.size(), wide, columns);
+      auto flags = std::regex_constants::ECMAScript;
+      if (ignore_case) {
+        flags |= std::regex_constants::icase;
+      }
+      try {
+        m_regex.assign(wide, flags);
+      } catch (const std::regex_error& e) {
+        throw std::runtime_error(std::string("Invalid search pattern: ") +
+                                 e.what());
+      }
+    } else if (ignore_case) {
+      for (char32_t& c : m_needle) {
+        c = Utils::FoldCase(c);
+      }
+    }
+    m_seen = m_tailBegin = buffer.GetTrimmedLineCount();
+    m_thread = std::thread(&Impl::SearchThread, this);
+  }
+
+  ~Impl() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_work.notify_one();
+    m_thread.join();
+  }
+
+  size_t Update(size_t max_lines) {
+    size_t count = m_buffer.GetLineCount();
+    uint64_t trimmed = m_buffer.GetTrimmedLineCount();
+    uint64_t end = trimmed + count;
+    Batch batch;
+    batch.trimmed = trimmed;
+    batch.end = end;
+    batch.offsets.push_back(0);
+
+    // Forget evicted and removed lines
+    m_seen = std::clamp(m_seen, trimmed, end);
+    while (!m_backfill.empty() && m_backfill.front().second <= trimmed) {
+      m_remaining -= m_backfill.front().second - m_backfill.front().first;
+      m_backfill.pop_front();
+    }
+    if (!m_backfill.empty() && m_backfill.front().first < trimmed) {
+      m_remaining -= trimmed - m_backfill.front().first;
+      m_backfill.front().first = trimmed;
+    }
+    while (!m_backfill.empty() && m_backfill.back().first >= end) {
+      m_remaining -= m_backfill.back().second - m_backfill.back().first;
+      m_backfill.pop_back();
+    }
+    if (!m_backfill.empty() && m_backfill.back().second > end) {
+      m_remaining -= m_backfill.back().second - end;
+      m_backfill.back().second = end;
+    }
+
+    // Lines added faster than SEARCH_TAIL_LINES per call are searched with
+    // the scrollback
+    uint64_t tail_begin = end - std::min(count, SEARCH_TAIL_LINES);
+    if (m_seen < tail_begin) {
+      AddBackfill(m_seen, tail_begin);
+    }
+    m_versions.clear();
+    for (uint64_t line = tail_begin; line < end; line++) {
+      uint64_t version = m_buffer.GetLineVersion(line - trimmed);
+      uint64_t old_version = 0;
+      if (line >= m_tailBegin && line < m_seen &&
+          line - m_tailBegin < m_oldVersions.size()) {
+        old_version = m_oldVersions[line - m_tailBegin];
+      }
+      if (version != old_version) {
+        CopyLine(batch, line, trimmed);
+      }
+      m_versions.push_back(version);
+    }
+    std::swap(m_versions, m_oldVersions);
+    m_tailBegin = tail_begin;
+    m_seen = end;
+
+    // Scrollback, newest first, unless the search thread is behind
+    bool behind;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      behind = m_queuedLines > max_lines;
+    }
+    size_t budget = behind ? 0 : max_lines;
+    uint64_t previous = 0;
+    while (budget > 0 && !m_backfill.empty()) {
+      auto& range = m_backfill.back();
+      budget -= std::min(budget, range.second == previous ? 1 : kSeekLines);
+      previous = --range.second;
+      CopyLine(batch, previous, trimmed);
+      m_remaining--;
+      if (range.first == range.second) {
+        m_backfill.pop_back();
+      }
+    }
+
+    size_t copied = batch.lines.size();
+    if (copied == 0 && trimmed == m_queuedTrimmed && end >= m_queuedEnd) {
+      return 0;  // Nothing for the search thread
+    }
+    m_queuedTrimmed = trimmed;
+    m_queuedEnd = end;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queuedLines += copied;
+      m_queue.push_back(std::move(batch));
+    }
+    m_work.notify_one();
+    return copied;
+  }
+
+  std::vector<SearchMatch> TakeNewMatches() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::exchange(m_newMatches, {});
+  }
+
+  std::vector<SearchMatch> GetMatches(uint64_t begin, uint64_t end) {
+    std::vector<SearchMatch> matches;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_matches.lower_bound(begin);
+         it != m_matches.end() && it->first < end; ++it) {
+      for (const Range& range : it->second) {
+        matches.push_back({it->first, range.first, range.second});
+      }
+    }
+    return matches;
+  }
+
+  bool FindNext(uint64_t line,
+                int column,
+                bool backward,
+                SearchMatch& match) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (backward) {
+      auto it = m_matches.upper_bound(line);
+      while (it != m_matches.begin()) {
+        --it;
+        const std::vector<Range>& ranges = it->second;
+        for (auto range = ranges.rbegin(); range != ranges.rend(); ++range) {
+          if (it->first < line || range->first < column) {
+            match = {it->first, range->first, range->second};
+            return true;
+          }
+        }
+      }
+    } else {
+      for (auto it = m_matches.lower_bound(line); it != m_matches.end();
+           ++it) {
+        for (const Range& range : it->second) {
+          if (it->first > line || range.first > column) {
+            match = {it->first, range.first, range.second};
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  size_t GetMatchCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_matchCount;
+  }
+
+  SearchStats GetStats() {
+    SearchStats stats = {};
+    stats.lines_remaining = m_remaining.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.lines_searched = m_linesSearched;
+    stats.lines_queued = m_queuedLines;
+    stats.matches = m_matchCount;
+    stats.done = stats.lines_remaining == 0 && m_queue.empty() && !m_busy;
+    return stats;
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_queue.empty() && !m_busy; });
+  }
+
+ private:
+  // Queues lines [begin, end) of scrollback, only the candidates when the
+  // buffer has an index
+  void AddBackfill(uint64_t begin, uint64_t end) {
+    const TrigramIndex* index = m_buffer.GetSearchIndex();
+    m_candidates.clear();
+    if (m_mode != SearchMode::Literal || !index ||
+        !index->FindCandidates(m_needle.data(), m_needle.size(), begin, end,
+                               m_candidates)) {
+      m_candidates.emplace_back(begin, end);
+    }
+    // Searching a short gap costs less than seeking past it
+    for (const auto& range : m_candidates) {
+      if (!m_backfill.empty() &&
+          m_backfill.back().second + kSeekLines >= range.first) {
+        m_remaining += range.second - m_backfill.back().second;
+        m_backfill.back().second = range.second;
+      } else {
+        m_backfill.push_back(range);
+        m_remaining += range.second - range.first;
+      }
+    }
+  }
+
+  void CopyLine(Batch& batch, uint64_t line, uint64_t trimmed) {
+    const ColoredLine& source =
+        m_buffer.GetLine(static_cast<size_t>(line - trimmed));
+    batch.lines.push_back(line);
+    batch.text.insert(batch.text.end(), source.text.begin(),
+                      source.text.end());
+    batch.offsets.push_back(batch.text.size());
+  }
+
+  void SearchThread() {
+    std::vector<Range> found;
+    std::vector<size_t> found_ends;  // Per line of the batch
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_work.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+      if (m_stopping) {
+        break;
+      }
+      Batch batch = std::move(m_queue.front());
+      m_queue.pop_front();
+      m_busy = true;
+      lock.unlock();
+
+      found.clear();
+      found_ends.clear();
+      for (size_t i = 0; i < batch.lines.size(); i++) {
+        SearchLine(batch.text.data() + batch.offsets[i],
+                   batch.offsets[i + 1] - batch.offsets[i], found);
+        found_ends.push_back(found.size());
+      }
+
+      lock.lock();
+      EraseMatches(m_matches.begin(), m_matches.lower_bound(batch.trimmed));
+      EraseMatches(m_matches.lower_bound(batch.end), m_matches.end());
+      size_t next = 0;
+      for (size_t i = 0; i < batch.lines.size(); i++) {
+        uint64_t line = batch.lines[i];
+        auto it = m_matches.find(line);
+        if (it != m_matches.end()) {
+          EraseMatches(it, std::next(it));
+        }
+        if (found_ends[i] > next) {
+          std::vector<Range>& ranges = m_matches[line];
+          ranges.assign(found.begin() + next, found.begin() + found_ends[i]);
+          for (const Range& range : ranges) {
+            m_newMatches.push_back({line, range.first, range.second});
+          }
+          m_matchCount += ranges.size();
+          next = found_ends[i];
+        }
+      }
+      m_linesSearched += batch.lines.size();
+      m_queuedLines -= batch.lines.size();
+      m_busy = false;
+      if (m_queue.empty()) {
+        m_idle.notify_all();
+      }
+    }
+  }
+
+  // Lock held
+  void EraseMatches(std::map<uint64_t, std::vector<Range>>::iterator first,
+                    std::map<uint64_t, std::vector<Range>>::iterator last) {
+    for (auto it = first; it != last; ++it) {
+      m_matchCount -= it->second.size();
+    }
+    m_matches.erase(first, last);
+  }
+
+  void SearchLine(const char32_t* text,
+                  size_t length,
+                  std::vector<Range>& found) {
+    if (m_mode == SearchMode::Regex) {
+      Utils::Utf32ToWChar(text, length, m_wide, m_columns);
+      try {
+        for (auto it = std::wsregex_iterator(m_wide.begin(), m_wide.end(),
+                                             m_regex);
+             it != std::wsregex_iterator(); ++it) {
+          if (it->length() > 0) {
+            size_t start = static_cast<size_t>(it->position());
+            found.emplace_back(m_columns[start],
+                               m_columns[start + it->length()]);
+          }
+        }
+      } catch (const std::regex_error&) {
+        // Too complex for this line, e.g. backtracking on a long one
+      }
+      return;
+    }
+    if (m_ignoreCase) {
+      m_folded.resize(length);
+      for (size_t i = 0; i < length; i++) {
+        m_folded[i] = Utils::FoldCase(text[i]);
+      }
+      text = m_folded.data();
+    }
+    size_t needle_length = m_needle.size();
+    size_t pos = 0;
+    while (pos + needle_length <= length) {
+      pos += Utils::FindUtf32(text + pos, length - pos, m_needle.data(),
+                              needle_length);
+      if (pos >= length) {
+        break;
+      }
+      found.emplace_back(static_cast<int>(pos),
+                         static_cast<int>(pos + needle_length));
+      pos += needle_length;
+    }
+  }
+
+  const ColoredTextBuffer& m_buffer;
+  const SearchMode m_mode;
+  const bool m_ignoreCase;
+  std::vector<char32_t> m_needle;  // Folded when ignoring case
+  std::wregex m_regex;
+
+  // Update() state, owned by the thread editing the buffer
+  uint64_t m_seen;       // Lines before it were copied at least once
+  uint64_t m_tailBegin;  // First line of m_oldVersions
+  std::vector<uint64_t> m_oldVersions;
+  std::vector<uint64_t> m_versions;
+  std::deque<std::pair<uint64_t, uint64_t>> m_backfill;  // Oldest first
+  std::vector<std::pair<uint64_t, uint64_t>> m_candidates;
+  uint64_t m_queuedTrimmed = 0;  // Line range of the last batch
+  uint64_t m_queuedEnd = 0;
+  std::atomic<uint64_t> m_remaining{0};  // Lines in m_backfill
+
+  // Search thread scratch
+  std::vector<char32_t> m_folded;
+  std::wstring m_wide;
+  std::vector<int> m_columns;
+
+  std::mutex m_mutex;
+  std::condition_variable m_work;
+  std::condition_variable m_idle;
+  std::deque<Batch> m_queue;
+  size_t m_queuedLines = 0;
+  bool m_busy = false;
+  bool m_stopping = false;
+  std::map<uint64_t, std::vector<Range>> m_matches;
+  size_t m_matchCount = 0;
+  uint64_t m_linesSearched = 0;
+  std::vector<SearchMatch> m_newMatches;
+
+  std::thread m_thread;
+};
+
+BufferSearch::BufferSearch(const ColoredTextBuffer& buffer,
+                           const std::string& pattern,
+                           SearchMode mode,
+                           bool ignore_case)
+    : m_impl(std::make_unique<Impl>(buffer, pattern, mode, ignore_case)) {}
+
+BufferSearch::~BufferSearch() = default;
+
+size_t BufferSearch::Update(size_t max_lines) {
+  return m_impl->Update(max_lines);
+}
+
+std::vector<SearchMatch> BufferSearch::TakeNewMatches() {
+  return m_impl->TakeNewMatches();
+}
+
+std::vector<SearchMatch> BufferSearch::GetMatches(uint64_t begin,
+                                                  uint64_t end) const {
+  return m_impl->GetMatches(begin, end);
+}
+
+bool BufferSearch::FindNext(uint64_t line,
+                            int column,
+                            bool backward,
+                            SearchMatch& match) const {
+  return m_impl->FindNext(line, column, backward, match);
+}
+
+size_t BufferSearch::GetMatchCount() const {
+  return m_impl->GetMatchCount();
+}
+
+SearchStats BufferSearch::GetStats() const {
+  return m_impl->GetStats();
+}
+
+void BufferSearch::Wait() const {
+  m_impl->Wait();
+}
+
+}  // namespace MTerm
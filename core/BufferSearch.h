@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ColoredTextBuffer.h"
+
+namespace MTerm {
+
+constexpr size_t DEFAULT_SEARCH_SLICE = 2048;
+
+// Bottom lines whose versions are checked by every Update(), the screen
+// and what a program may still redraw above it
+constexpr size_t SEARCH_TAIL_LINES = 1024;
+
+enum class SearchMode { Literal, Regex };
+
+// Columns [start, end) of a line. Lines are absolute: a buffer index plus
+// the buffer's GetTrimmedLineCount(), so they stay valid while old lines
+// are evicted.
+struct SearchMatch {
+  uint64_t line;
+  int start;
+  int end;
+};
+
+struct SearchStats {
+  uint64_t lines_searched;   // Including lines searched again after edits
+  uint64_t lines_queued;     // Copied, waiting for the search thread
+  uint64_t lines_remaining;  // Scrollback not copied yet
+  uint64_t matches;
+  bool done;  // Every line is searched, until new output arrives
+};
+
+// Searches a ColoredTextBuffer on a background thread. The buffer is not
+// thread-safe, so the thread that edits it (or holds its lock) calls
+// Update(), which copies a bounded slice of lines for the search thread:
+// first lines added or changed at the bottom since the previous call, then
+// the scrollback from the newest line up. Matches are reported as the
+// search thread finds them and replaced when a line is searched again.
+// Lines that leave the last SEARCH_TAIL_LINES are not checked for edits.
+// When the buffer keeps a search index, only the scrollback lines that the
+// index gives as candidates for a literal pattern are copied.
+// Literal patterns are matched with Utils::FindUtf32, regular expressions
+// (ECMAScript) with std::wregex. Matches do not overlap. Throws
+// std::runtime_error for an empty or invalid pattern.
+class BufferSearch {
+ public:
+  BufferSearch(const ColoredTextBuffer& buffer,
+               const std::string& pattern,
+               SearchMode mode = SearchMode::Literal,
+               bool ignore_case = false);
+  ~BufferSearch();
+
+  BufferSearch(const BufferSearch&) = delete;
+  BufferSearch& operator=(const BufferSearch&) = delete;
+
+  // Copies up to max_lines of scrollback, fewer when they are scattered,
+  // plus the changed bottom lines, and returns the number of lines copied.
+  // Scrollback is not copied while the search thread is behind.
+  size_t Update(size_t max_lines = DEFAULT_SEARCH_SLICE);
+
+  // Matches found since the previous call, in the order they were found
+  std::vector<SearchMatch> TakeNewMatches();
+
+  // Current matches on lines [begin, end), in order
+  std::vector<SearchMatch> GetMatches(uint64_t begin, uint64_t end) const;
+
+  // The first match starting after (line, column), or the last one
+  // starting before it when backward is set. Returns false if there is
+  // none.
+  bool FindNext(uint64_t line,
+                int column,
+                bool backward,
+                SearchMatch& match) const;
+
+  size_t GetMatchCount() const;
+
+  SearchStats GetStats() const;
+
+  // Waits until the search thread has searched every copied line
+  void Wait() const;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> m_impl;
+};
+
+}  // namespace MTerm
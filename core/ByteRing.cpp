@@ -0,0 +1,103 @@
+#include "ByteRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace MTerm {
+
+static size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+ByteRing::ByteRing(size_t capacity)
+    : m_capacity(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 1))),
+      m_mask(m_capacity - 1) {
+  m_data = std::make_unique<char[]>(m_capacity);
+}
+
+char* ByteRing::GetWriteRegion(size_t* size) {
+  size_t write_pos = m_writePos.load(std::memory_order_relaxed);
+  size_t read_pos = m_readPos.load(std::memory_order_acquire);
+  size_t offset = write_pos & m_mask;
+  size_t free_size = m_capacity - (write_pos - read_pos);
+  *size = std::min(free_size, m_capacity - offset);
+  return m_data.get() + offset;
+}
+
+void ByteRing::CommitWrite(size_t size) {
+  size_t write_pos = m_writePos.load(std::memory_order_relaxed) + size;
+  m_writePos.store(write_pos, std::memory_order_release);
+
+  size_t used = write_pos - m_readPos.load(std::memory_order_relaxed);
+  if (used > m_peakSize.load(std::memory_order_relaxed)) {
+    m_peakSize.store(used, std::memory_order_relaxed);
+  }
+}
+
+size_t ByteRing::Write(const char* data, size_t size) {
+  size_t written = 0;
+  while (written < size) {
+    size_t region_size;
+    char* region = GetWriteRegion(&region_size);
+    if (region_size == 0) {
+      break;
+    }
+    size_t count = std::min(region_size, size - written);
+    memcpy(region, data + written, count);
+    CommitWrite(count);
+    written += count;
+  }
+  return written;
+}
+
+const char* ByteRing::GetReadRegion(size_t* size) {
+  size_t read_pos = m_readPos.load(std::memory_order_relaxed);
+  size_t write_pos = m_writePos.load(std::memory_order_acquire);
+  size_t offset = read_pos & m_mask;
+  *size = std::min(write_pos - read_pos, m_capacity - offset);
+  return m_data.get() + offset;
+}
+
+void ByteRing::CommitRead(size_t size) {
+  m_readPos.store(m_readPos.load(std::memory_order_relaxed) + size,
+                  std::memory_order_release);
+}
+
+size_t ByteRing::Peek(char* data, size_t size) {
+  size_t read_pos = m_readPos.load(std::memory_order_relaxed);
+  size_t write_pos = m_writePos.load(std::memory_order_acquire);
+  size = std::min(size, write_pos - read_pos);
+
+  size_t offset = read_pos & m_mask;
+  size_t first = std::min(size, m_capacity - offset);
+  memcpy(data, m_data.get() + offset, first);
+  memcpy(data + first, m_data.get(), size - first);
+  return size;
+}
+
+size_t ByteRing::GetCapacity() const {
+  return m_capacity;
+}
+
+size_t ByteRing::GetSize() const {
+  size_t read_pos = m_readPos.load(std::memory_order_acquire);
+  return m_writePos.load(std::memory_order_acquire) - read_pos;
+}
+
+size_t ByteRing::GetFreeSize() const {
+  return m_capacity - GetSize();
+}
+
+size_t ByteRing::GetPeakSize() const {
+  return m_peakSize.load(std::memory_order_relaxed);
+}
+
+uint64_t ByteRing::GetTotalWritten() const {
+  return m_writePos.load(std::memory_order_relaxed);
+}
+
+}  // namespace MTerm
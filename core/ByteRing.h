@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace MTerm {
+
+// Fixed-size lock-free byte ring for exactly one producer thread and one
+// consumer thread. Positions grow monotonically and are masked on access, so
+// the capacity is rounded up to a power of two.
+class ByteRing {
+ public:
+  explicit ByteRing(size_t capacity);
+
+  // Producer: contiguous free space at the write position. Bytes stored there
+  // become visible to the consumer after CommitWrite().
+  char* GetWriteRegion(size_t* size);
+
+  void CommitWrite(size_t size);
+
+  // Producer: copies as much of data as fits and returns the number of bytes
+  // written.
+  size_t Write(const char* data, size_t size);
+
+  // Consumer: contiguous readable bytes at the read position. They stay valid
+  // until CommitRead().
+  const char* GetReadRegion(size_t* size);
+
+  void CommitRead(size_t size);
+
+  // Consumer: copies up to size readable bytes without committing them.
+  size_t Peek(char* data, size_t size);
+
+  size_t GetCapacity() const;
+
+  size_t GetSize() const;
+
+  size_t GetFreeSize() const;
+
+  // Highest occupancy seen by the producer
+  size_t GetPeakSize() const;
+
+  uint64_t GetTotalWritten() const;
+
+ private:
+  std::unique_ptr<char[]> m_data;
+  size_t m_capacity;
+  size_t m_mask;
+
+  alignas(64) std::atomic<size_t> m_writePos{0};
+  std::atomic<size_t> m_peakSize{0};
+  alignas(64) std::atomic<size_t> m_readPos{0};
+};
+
+}  // namespace MTerm
@@ -0,0 +1,328 @@
+#include "ColdLineStore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include "ColoredTextBuffer.h"
+#include "Compression.h"
+#include "Utils.h"
+
+namespace MTerm {
+
+namespace {
+
+void WriteVarint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void WriteInt(std::string& out, int value) {
+  char bytes[sizeof(value)];
+  memcpy(bytes, &value, sizeof(value));
+  out.append(bytes, sizeof(value));
+}
+
+class Reader {
+ public:
+  explicit Reader(const std::string& data)
+      : m_pos(data.data()), m_end(data.data() + data.size()) {}
+
+  uint64_t ReadVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t byte = static_cast<uint8_t>(*Take(1));
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    throw std::runtime_error("Corrupt scrollback block");
+  }
+
+  int ReadInt() {
+    int value;
+    memcpy(&value, Take(sizeof(value)), sizeof(value));
+    return value;
+  }
+
+  const char* Take(size_t size) {
+    if (static_cast<size_t>(m_end - m_pos) < size) {
+      throw std::runtime_error("Corrupt scrollback block");
+    }
+    const char* data = m_pos;
+    m_pos += size;
+    return data;
+  }
+
+ private:
+  const char* m_pos;
+  const char* m_end;
+};
+
+size_t GetMemorySize(const ColoredLine& line) {
+  return line.text.size() * sizeof(char32_t) +
+         line.fragments.size() * sizeof(LineFragment);
+}
+
+}  // namespace
+
+ColdLineStore::ColdLineStore() {}
+
+ColdLineStore::~ColdLineStore() {}
+
+size_t ColdLineStore::GetLineCount() const {
+  return m_blocks.size() * COLD_BLOCK_LINES - m_skippedLines;
+}
+
+void ColdLineStore::PushBlock(const ColoredLine* const* lines,
+                              const AttributeTable& attributes) {
+  m_blocks.emplace_back();
+  Store(m_blocks.back(), lines, attributes);
+  SpillBlocks();
+}
+
+void ColdLineStore::Store(Block& block,
+                          const ColoredLine* const* lines,
+                          const AttributeTable& attributes) {
+  bool spilled = block.spilled;
+  Unspill(block);
+  m_uncompressedBytes -= block.memory_size;
+  m_compressedBytes -= block.compressed_size;
+
+  std::string utf8;
+  m_serialized.clear();
+  block.memory_size = 0;
+  uint64_t version = 0;
+  for (size_t i = 0; i < COLD_BLOCK_LINES; i++) {
+    const ColoredLine& line = *lines[i];
+    block.memory_size += GetMemorySize(line);
+
+    utf8.clear();
+    Utils::Utf32ToUtf8(line.text.data(), line.text.size(), utf8);
+    // Neighbouring lines have close versions, zigzag-encoded deltas stay short
+    uint64_t delta = line.version - version;
+    WriteVarint(m_serialized, (delta << 1) ^ (0 - (delta >> 63)));
+    version = line.version;
+    WriteVarint(m_serialized, utf8.size());
+    m_serialized += utf8;
+
+    WriteVarint(m_serialized, line.fragments.size());
+    for (const LineFragment& fragment : line.fragments) {
+      const TextAttributes& value = attributes.Get(fragment.attr);
+      WriteVarint(m_serialized, static_cast<uint32_t>(fragment.pos));
+      WriteInt(m_serialized, value.color);
+      WriteInt(m_serialized, value.underline_color);
+      WriteInt(m_serialized, value.background_color);
+      WriteVarint(m_serialized, value.flags);
+    }
+  }
+  block.serialized_size = m_serialized.size();
+  Compression::Compress(m_serialized.data(), m_serialized.size(), block.data);
+  block.data.shrink_to_fit();
+  block.compressed_size = block.data.size();
+
+  m_uncompressedBytes += block.memory_size;
+  m_compressedBytes += block.compressed_size;
+  if (spilled) {
+    // Keep the spilled blocks a prefix of the store
+    Spill(block);
+  }
+}
+
+void ColdLineStore::SpillBlocks() {
+  while (m_memoryBudget > 0 && m_spilledBlocks < m_blocks.size() &&
+         m_compressedBytes - m_spilledBytes > m_memoryBudget) {
+    if (!m_spill) {
+      m_spill = std::make_unique<SpillFile>();
+    }
+    try {
+      Spill(m_blocks[m_spilledBlocks]);
+    } catch (const std::runtime_error&) {
+      // No usable temp directory: keep the scrollback in memory
+      m_memoryBudget = 0;
+      return;
+    }
+    m_spilledBlocks++;
+  }
+}
+
+void ColdLineStore::Spill(Block& block) {
+  block.spill_offset = m_spill->Append(std::move(block.data));
+  block.data = std::string();
+  block.spilled = true;
+  m_spilledBytes += block.compressed_size;
+}
+
+void ColdLineStore::Unspill(Block& block) {
+  if (!block.spilled) {
+    return;
+  }
+  m_spill->Discard(block.spill_offset, block.compressed_size);
+  m_spilledBytes -= block.compressed_size;
+  block.spilled = false;
+}
+
+ColdLineStore::CachedBlock& ColdLineStore::Load(uint64_t id,
+                                                AttributeTable& attributes) {
+  auto it = std::find_if(m_cache.begin(), m_cache.end(),
+                         [id](const CachedBlock& cached) {
+                           return cached.id == id;
+                         });
+  if (it != m_cache.end()) {
+    m_cacheHits++;
+    std::rotate(m_cache.begin(), it, it + 1);
+    return m_cache.front();
+  }
+  m_cacheMisses++;
+
+  if (m_cache.size() == COLD_CACHE_BLOCKS) {
+    WriteBack(m_cache.back(), attributes);
+    m_cache.pop_back();
+  }
+
+  const Block& block = m_blocks[id - m_firstBlockId];
+  const std::string* data = &block.data;
+  if (block.spilled) {
+    m_spill->Read(block.spill_offset, block.compressed_size, m_spillBuffer);
+    data = &m_spillBuffer;
+  }
+  Compression::Decompress(data->data(), data->size(), block.serialized_size,
+                          m_serialized);
+
+  CachedBlock cached{id, false, std::vector<ColoredLine>(COLD_BLOCK_LINES)};
+  Reader reader(m_serialized);
+  uint64_t version = 0;
+  for (ColoredLine& line : cached.lines) {
+    uint64_t delta = reader.ReadVarint();
+    version += (delta >> 1) ^ (0 - (delta & 1));
+    line.version = version;
+    size_t text_size = static_cast<size_t>(reader.ReadVarint());
+    Utils::Utf8ToUtf32(reader.Take(text_size), text_size, line.text);
+
+    line.fragments.resize(static_cast<size_t>(reader.ReadVarint()));
+    for (LineFragment& fragment : line.fragments) {
+      fragment.pos = static_cast<int>(reader.ReadVarint());
+      TextAttributes value;
+      value.color = reader.ReadInt();
+      value.underline_color = reader.ReadInt();
+      value.background_color = reader.ReadInt();
+      value.flags = static_cast<uint32_t>(reader.ReadVarint());
+      fragment.attr = attributes.Intern(value);
+    }
+  }
+  m_cache.insert(m_cache.begin(), std::move(cached));
+  return m_cache.front();
+}
+
+void ColdLineStore::WriteBack(CachedBlock& cached,
+                              const AttributeTable& attributes) {
+  if (!cached.dirty) {
+    return;
+  }
+  const ColoredLine* lines[COLD_BLOCK_LINES];
+  for (size_t i = 0; i < COLD_BLOCK_LINES; i++) {
+    lines[i] = &cached.lines[i];
+  }
+  Store(m_blocks[cached.id - m_firstBlockId], lines, attributes);
+  cached.dirty = false;
+}
+
+void ColdLineStore::DropCached(uint64_t id) {
+  m_cache.erase(std::remove_if(m_cache.begin(), m_cache.end(),
+                               [id](const CachedBlock& cached) {
+                                 return cached.id == id;
+                               }),
+                m_cache.end());
+}
+
+ColoredLine& ColdLineStore::GetLine(size_t index,
+                                    AttributeTable& attributes,
+                                    bool modify) {
+  size_t position = index + m_skippedLines;
+  CachedBlock& cached =
+      Load(m_firstBlockId + position / COLD_BLOCK_LINES, attributes);
+  cached.dirty |= modify;
+  return cached.lines[position % COLD_BLOCK_LINES];
+}
+
+void ColdLineStore::PopFrontLine() {
+  if (m_blocks.empty()) {
+    return;
+  }
+  if (++m_skippedLines < COLD_BLOCK_LINES) {
+    return;
+  }
+  DropCached(m_firstBlockId);
+  Block& block = m_blocks.front();
+  if (block.spilled) {
+    Unspill(block);
+    m_spilledBlocks--;
+  }
+  m_uncompressedBytes -= block.memory_size;
+  m_compressedBytes -= block.compressed_size;
+  m_blocks.pop_front();
+  m_firstBlockId++;
+  m_skippedLines = 0;
+}
+
+void ColdLineStore::PopBackBlock(std::vector<ColoredLine>& lines,
+                                 AttributeTable& attributes) {
+  if (m_blocks.empty()) {
+    return;
+  }
+  uint64_t id = m_firstBlockId + m_blocks.size() - 1;
+  CachedBlock& cached = Load(id, attributes);
+  size_t first = m_blocks.size() == 1 ? m_skippedLines : 0;
+  std::move(cached.lines.begin() + first, cached.lines.end(),
+            std::back_inserter(lines));
+  DropCached(id);
+
+  Block& block = m_blocks.back();
+  if (block.spilled) {
+    Unspill(block);
+    m_spilledBlocks--;
+  }
+  m_uncompressedBytes -= block.memory_size;
+  m_compressedBytes -= block.compressed_size;
+  m_blocks.pop_back();
+  if (m_blocks.empty()) {
+    m_skippedLines = 0;
+  }
+}
+
+void ColdLineStore::ForEachCachedLine(
+    const std::function<void(ColoredLine&)>& fn) {
+  for (CachedBlock& cached : m_cache) {
+    for (ColoredLine& line : cached.lines) {
+      fn(line);
+    }
+  }
+}
+
+void ColdLineStore::FillStats(ScrollbackStats& stats) const {
+  stats.cold_lines = GetLineCount();
+  stats.cold_blocks = m_blocks.size();
+  stats.uncompressed_bytes = m_uncompressedBytes;
+  stats.compressed_bytes = m_compressedBytes;
+  stats.spilled_blocks = m_spilledBlocks;
+  stats.spilled_bytes = m_spilledBytes;
+  stats.spill_file_bytes = m_spill ? m_spill->GetSize() : 0;
+  stats.cache_hits = m_cacheHits;
+  stats.cache_misses = m_cacheMisses;
+}
+
+size_t ColdLineStore::GetMemoryBudget() const {
+  return m_memoryBudget;
+}
+
+void ColdLineStore::SetMemoryBudget(size_t budget) {
+  m_memoryBudget = budget;
+  SpillBlocks();
+}
+
+}  // namespace MTerm
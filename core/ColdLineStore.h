@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AttributeTable.h"
+#include "SpillFile.h"
+
+struct ColoredLine;
+
+namespace MTerm {
+
+constexpr size_t COLD_BLOCK_LINES = 128;
+constexpr size_t COLD_CACHE_BLOCKS = 8;
+
+struct ScrollbackStats {
+  size_t hot_lines;
+  size_t cold_lines;
+  size_t cold_blocks;
+  size_t uncompressed_bytes;  // In-memory size of the cold lines
+  size_t compressed_bytes;
+  size_t spilled_blocks;
+  size_t spilled_bytes;  // Part of compressed_bytes that lives on disk
+  uint64_t spill_file_bytes;
+  uint64_t cache_hits;
+  uint64_t cache_misses;
+};
+
+// Oldest scrollback lines, compressed in blocks of COLD_BLOCK_LINES. Lines are
+// serialized with UTF-8 text and attribute values (not ids), so blocks do not
+// depend on the state of the attribute table. Recently used blocks are kept
+// decompressed in a small LRU; edits to them are written back on eviction.
+// With a memory budget set, the oldest compressed blocks beyond it are moved
+// to a SpillFile; the block index keeps their offsets, so finding any line
+// is still a single lookup.
+class ColdLineStore {
+ public:
+  ColdLineStore();
+  ~ColdLineStore();
+
+  size_t GetLineCount() const;
+
+  // Compresses COLD_BLOCK_LINES lines into a new newest block
+  void PushBlock(const ColoredLine* const* lines,
+                 const AttributeTable& attributes);
+
+  // The reference stays valid until the next call on the store. modify marks
+  // the block for recompression.
+  ColoredLine& GetLine(size_t index, AttributeTable& attributes, bool modify);
+
+  // Drops the oldest line
+  void PopFrontLine();
+
+  // Removes the newest block and appends its lines to lines
+  void PopBackBlock(std::vector<ColoredLine>& lines,
+                    AttributeTable& attributes);
+
+  // Visits decompressed lines, whose attribute ids refer to the table
+  void ForEachCachedLine(const std::function<void(ColoredLine&)>& fn);
+
+  void FillStats(ScrollbackStats& stats) const;
+
+  // Compressed bytes kept in memory before blocks go to disk, 0 - no limit.
+  // Blocks that are already on disk stay there.
+  size_t GetMemoryBudget() const;
+
+  void SetMemoryBudget(size_t budget);
+
+ private:
+  struct Block {
+    std::string data;  // Empty once spilled
+    size_t compressed_size = 0;
+    size_t serialized_size = 0;
+    size_t memory_size = 0;
+    uint64_t spill_offset = 0;
+    bool spilled = false;
+  };
+
+  struct CachedBlock {
+    uint64_t id;
+    bool dirty;
+    std::vector<ColoredLine> lines;
+  };
+
+  void Store(Block& block,
+             const ColoredLine* const* lines,
+             const AttributeTable& attributes);
+
+  CachedBlock& Load(uint64_t id, AttributeTable& attributes);
+
+  void WriteBack(CachedBlock& cached, const AttributeTable& attributes);
+
+  void DropCached(uint64_t id);
+
+  void SpillBlocks();
+
+  void Spill(Block& block);
+
+  void Unspill(Block& block);
+
+  std::deque<Block> m_blocks;
+  uint64_t m_firstBlockId = 0;
+  size_t m_skippedLines = 0;  // Trimmed lines at the start of the first block
+  std::vector<CachedBlock> m_cache;  // Most recently used first
+  std::string m_serialized;
+  size_t m_uncompressedBytes = 0;
+  size_t m_compressedBytes = 0;
+  std::unique_ptr<SpillFile> m_spill;
+  std::string m_spillBuffer;
+  size_t m_memoryBudget = 0;
+  size_t m_spilledBlocks = 0;  // Always the oldest blocks
+  size_t m_spilledBytes = 0;
+  uint64_t m_cacheHits = 0;
+  uint64_t m_cacheMisses = 0;
+};
+
+}  // namespace MTerm
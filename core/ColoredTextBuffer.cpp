@@ -1,71 +1,369 @@
 #include "ColoredTextBuffer.h"
 
 #include <algorithm>
+#include <atomic>
 
+#include "Instrumentation.h"
 #include "Utils.h"
 
 namespace MTerm {
 
-ColoredTextBuffer::ColoredTextBuffer() {}
+namespace {
+
+std::atomic<uint64_t> g_lineVersion{0};
+
+uint64_t NextLineVersion() {
+  return g_lineVersion.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+}  // namespace
+
+ColoredTextBuffer::ColoredTextBuffer(size_t max_lines)
+    : m_maxLines(max_lines) {}
 
 void ColoredTextBuffer::AddLine() {
-  m_lines.emplace_back();
+  ScopedProbe probe(Probe::BufferAddLine);
+  AppendLine();
+  FreezeLines();
+  if (m_index) {
+    IndexLines();
+  }
+}
+
+void ColoredTextBuffer::AppendLine() {
+  if (m_maxLines != 0 && GetLineCount() >= m_maxLines) {
+    TrimOldestLine();
+  }
+  if (m_count == m_lines.size()) {
+    Linearize();
+    m_lines.emplace_back();
+  }
+  // Reuse the slot together with its allocations
+  ColoredLine& line = HotLine(m_count++);
+  line.text.clear();
+  line.fragments.clear();
+  line.version = NextLineVersion();
+  Damage(GetLineCount() - 1, GetLineCount());
+}
+
+void ColoredTextBuffer::TrimOldestLine() {
+  if (m_cold.GetLineCount() > 0) {
+    m_cold.PopFrontLine();
+  } else if (m_count > 0) {
+    m_first = (m_first + 1) % m_lines.size();
+    m_count--;
+  } else {
+    return;
+  }
+  m_trimmedLines++;
+  if (m_index) {
+    m_index->Trim(m_trimmedLines);
+  }
+}
+
+void ColoredTextBuffer::FreezeLines() {
+  if (m_hotLines == 0) {
+    return;
+  }
+  while (m_count >= m_hotLines + COLD_BLOCK_LINES) {
+    const ColoredLine* lines[COLD_BLOCK_LINES];
+    for (size_t i = 0; i < COLD_BLOCK_LINES; i++) {
+      lines[i] = &HotLine(i);
+    }
+    m_cold.PushBlock(lines, m_attributes);
+    m_first = (m_first + COLD_BLOCK_LINES) % m_lines.size();
+    m_count -= COLD_BLOCK_LINES;
+  }
+}
+
+void ColoredTextBuffer::ThawLines(size_t line_index) {
+  std::vector<ColoredLine> lines;
+  while (m_cold.GetLineCount() > line_index) {
+    lines.clear();
+    m_cold.PopBackBlock(lines, m_attributes);
+    for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
+      PushFrontHotLine(std::move(*it));
+    }
+  }
+}
+
+void ColoredTextBuffer::PushFrontHotLine(ColoredLine&& line) {
+  if (m_count == m_lines.size()) {
+    // Grow geometrically so that thawing many blocks stays linear
+    Linearize();
+    m_lines.resize(m_lines.size() + std::max<size_t>(m_lines.size(), 16));
+  }
+  m_first = (m_first + m_lines.size() - 1) % m_lines.size();
+  m_lines[m_first] = std::move(line);
+  m_count++;
+}
+
+ColoredLine& ColoredTextBuffer::HotLine(size_t hot_index) {
+  size_t slot = m_first + hot_index;
+  if (slot >= m_lines.size()) {
+    slot -= m_lines.size();
+  }
+  return m_lines[slot];
 }
 
-std::deque<ColoredLine>& ColoredTextBuffer::GetLines() {
-  return m_lines;
+ColoredLine& ColoredTextBuffer::GetLine(size_t line_index) {
+  size_t cold_count = m_cold.GetLineCount();
+  ColoredLine& line = line_index < cold_count
+                          ? m_cold.GetLine(line_index, m_attributes, true)
+                          : HotLine(line_index - cold_count);
+  line.version = NextLineVersion();
+  Damage(line_index, line_index + 1);
+  if (m_index) {
+    m_index->MarkDirty(m_trimmedLines + line_index);
+  }
+  return line;
+}
+
+const ColoredLine& ColoredTextBuffer::GetLine(size_t line_index) const {
+  size_t cold_count = m_cold.GetLineCount();
+  if (line_index < cold_count) {
+    return m_cold.GetLine(line_index, m_attributes, false);
+  }
+  size_t slot = m_first + line_index - cold_count;
+  if (slot >= m_lines.size()) {
+    slot -= m_lines.size();
+  }
+  return m_lines[slot];
 }
 
 size_t ColoredTextBuffer::GetLineCount() const {
-  return m_lines.size();
+  return m_cold.GetLineCount() + m_count;
+}
+
+uint64_t ColoredTextBuffer::GetLineVersion(size_t line_index) const {
+  if (line_index >= GetLineCount()) {
+    return 0;  // Invalid line index
+  }
+  return GetLine(line_index).version;
+}
+
+LineDamage ColoredTextBuffer::TakeDamage() {
+  LineDamage damage{0, 0};
+  if (m_damageEnd > m_trimmedLines) {
+    damage.begin =
+        static_cast<size_t>(std::max(m_damageBegin, m_trimmedLines) -
+                            m_trimmedLines);
+    damage.end = static_cast<size_t>(m_damageEnd - m_trimmedLines);
+  }
+  m_damageBegin = m_damageEnd = 0;
+  return damage;
+}
+
+void ColoredTextBuffer::Damage(size_t begin, size_t end) {
+  uint64_t first = m_trimmedLines + begin;
+  uint64_t last = m_trimmedLines + end;
+  if (m_damageBegin == m_damageEnd) {
+    m_damageBegin = first;
+    m_damageEnd = last;
+  } else {
+    m_damageBegin = std::min(m_damageBegin, first);
+    m_damageEnd = std::max(m_damageEnd, last);
+  }
+}
+
+size_t ColoredTextBuffer::GetMaxLines() const {
+  return m_maxLines;
+}
+
+void ColoredTextBuffer::SetMaxLines(size_t max_lines) {
+  m_maxLines = max_lines;
+  if (max_lines == 0) {
+    return;
+  }
+  while (GetLineCount() > max_lines) {
+    TrimOldestLine();
+  }
+  if (m_lines.size() > max_lines) {
+    Linearize();
+    m_lines.resize(max_lines);
+  }
+}
+
+size_t ColoredTextBuffer::GetHotLineCount() const {
+  return m_hotLines;
+}
+
+void ColoredTextBuffer::SetHotLineCount(size_t hot_lines) {
+  m_hotLines = hot_lines;
+  if (hot_lines == 0) {
+    ThawLines(0);
+  } else {
+    FreezeLines();
+  }
+}
+
+ScrollbackStats ColoredTextBuffer::GetScrollbackStats() const {
+  ScrollbackStats stats{};
+  m_cold.FillStats(stats);
+  stats.hot_lines = m_count;
+  return stats;
+}
+
+size_t ColoredTextBuffer::GetSpillBudget() const {
+  return m_cold.GetMemoryBudget();
+}
+
+void ColoredTextBuffer::SetSpillBudget(size_t budget) {
+  m_cold.SetMemoryBudget(budget);
+}
+
+uint64_t ColoredTextBuffer::GetTrimmedLineCount() const {
+  return m_trimmedLines;
+}
+
+size_t ColoredTextBuffer::GetSearchIndexBudget() const {
+  return m_index ? m_index->GetBudget() : 0;
+}
+
+void ColoredTextBuffer::SetSearchIndexBudget(size_t budget) {
+  if (budget == 0) {
+    m_index.reset();
+    return;
+  }
+  if (m_index) {
+    m_index->SetBudget(budget);
+    return;
+  }
+  // Indexing the existing scrollback would stall the caller
+  m_index = std::make_unique<TrigramIndex>(budget);
+  m_index->Reset(GetIndexLimit());
+}
+
+const TrigramIndex* ColoredTextBuffer::GetSearchIndex() const {
+  return m_index.get();
+}
+
+uint64_t ColoredTextBuffer::GetIndexLimit() const {
+  size_t count = GetLineCount();
+  return m_trimmedLines + count - std::min(count, INDEX_LAG_LINES);
+}
+
+void ColoredTextBuffer::IndexLines() {
+  if (m_index->GetEnd() < m_trimmedLines) {
+    m_index->Reset(m_trimmedLines);
+  }
+  const ColoredTextBuffer& self = *this;
+  uint64_t limit = GetIndexLimit();
+  for (uint64_t line = m_index->GetEnd(); line < limit; line++) {
+    const ColoredLine& indexed =
+        self.GetLine(static_cast<size_t>(line - m_trimmedLines));
+    m_index->AddLine(indexed.text.data(), indexed.text.size());
+  }
+}
+
+void ColoredTextBuffer::MaybeResetIndex(size_t line_index) {
+  // Lines before stay indexed no longer, they are searched without index
+  if (m_index && m_trimmedLines + line_index < m_index->GetEnd()) {
+    m_index->Reset(GetIndexLimit());
+  }
 }
 
 void ColoredTextBuffer::InsertLines(size_t index, size_t count) {
-  if (index > m_lines.size() || count == 0) {
+  ScopedProbe probe(Probe::BufferInsertLines, count);
+  size_t line_count = GetLineCount();
+  if (index > line_count || count == 0) {
     return;  // Invalid index or count
   }
-  m_lines.insert(m_lines.begin() + index, count, ColoredLine());
+  MaybeResetIndex(index);
+  ThawLines(index);
+  size_t overflow = 0;
+  if (m_maxLines != 0 && line_count + count > m_maxLines) {
+    overflow = line_count + count - m_maxLines;
+  }
+  if (overflow > index) {
+    // Some of the new lines would be evicted right away
+    m_trimmedLines += overflow - index;
+    count -= overflow - index;
+  }
+  uint64_t trimmed = m_trimmedLines;
+  for (size_t i = 0; i < count; i++) {
+    AppendLine();
+  }
+  // Lines evicted from the top move the insertion point up
+  index -= static_cast<size_t>(m_trimmedLines - trimmed);
+  RotateLines(index - m_cold.GetLineCount(), m_count - count, m_count);
+  Damage(index, GetLineCount());
+  FreezeLines();
 }
 
 void ColoredTextBuffer::RemoveLines(size_t start_index, size_t end_index) {
-  if (start_index >= m_lines.size() || end_index <= start_index ||
-      end_index > m_lines.size()) {
+  ScopedProbe probe(Probe::BufferRemoveLines,
+                    end_index > start_index ? end_index - start_index : 0);
+  size_t line_count = GetLineCount();
+  if (start_index >= line_count || end_index <= start_index ||
+      end_index > line_count) {
     return;  // Invalid range
   }
-  auto it_start = m_lines.begin() + start_index;
-  auto it_end = m_lines.begin() + end_index;
-  m_lines.erase(it_start, it_end);
+  MaybeResetIndex(start_index);
+  ThawLines(start_index);
+  size_t cold_count = m_cold.GetLineCount();
+  // Removed lines stay behind the last line and are reused by AddLine()
+  RotateLines(start_index - cold_count, end_index - cold_count, m_count);
+  m_count -= end_index - start_index;
+  Damage(start_index, line_count);
+  FreezeLines();
+}
+
+void ColoredTextBuffer::RotateLines(size_t first, size_t middle, size_t last) {
+  if (first == middle || middle == last) {
+    return;
+  }
+  ReverseLines(first, middle);
+  ReverseLines(middle, last);
+  ReverseLines(first, last);
+}
+
+void ColoredTextBuffer::ReverseLines(size_t first, size_t last) {
+  while (first + 1 < last) {
+    std::swap(HotLine(first++), HotLine(--last));
+  }
+}
+
+void ColoredTextBuffer::Linearize() {
+  if (m_first != 0) {
+    std::rotate(m_lines.begin(), m_lines.begin() + m_first, m_lines.end());
+    m_first = 0;
+  }
 }
 
 void ColoredTextBuffer::ResizeLines(size_t start_index,
                                     size_t end_index,
                                     size_t new_size) {
-  if (start_index >= m_lines.size() || end_index < start_index ||
-      new_size == 0) {
+  ScopedProbe probe(Probe::BufferResizeLines,
+                    end_index >= start_index ? end_index - start_index + 1 : 0);
+  size_t line_count = GetLineCount();
+  if (start_index >= line_count || end_index < start_index || new_size == 0) {
     return;  // Invalid range or new size
   }
-  end_index = std::min(end_index, m_lines.size() - 1);
+  end_index = std::min(end_index, line_count - 1);
   for (size_t i = start_index; i <= end_index; i++) {
-    m_lines[i].text.resize(new_size, U' ');
+    GetLine(i).text.resize(new_size, U' ');
   }
 }
 
 void ColoredTextBuffer::WriteToLine(size_t line_index,
                                     const char32_t* text,
                                     int length) {
-  if (line_index >= m_lines.size() || length <= 0 || !text)
+  ScopedProbe probe(Probe::BufferSetText, std::max(length, 0));
+  if (line_index >= GetLineCount() || length <= 0 || !text)
     return;
-  auto& line = m_lines[line_index];
+  auto& line = GetLine(line_index);
   line.text.insert(line.text.end(), text, text + length);
 }
 
 void ColoredTextBuffer::EraseInLine(size_t line_index,
                                     int start_pos,
                                     int end_pos) {
-  if (line_index >= m_lines.size() || start_pos < 0 || end_pos < start_pos) {
+  ScopedProbe probe(Probe::BufferEraseInLine);
+  if (line_index >= GetLineCount() || start_pos < 0 || end_pos < start_pos) {
     return;
   }
-  auto& line = m_lines[line_index];
+  auto& line = GetLine(line_index);
   if (start_pos >= static_cast<int>(line.text.size())) {
     return;  // Start position is out of bounds
   }
@@ -101,19 +399,19 @@ void ColoredTextBuffer::EraseInLine(size_t line_index,
 }
 
 int ColoredTextBuffer::GetLineLength(size_t line_index) const {
-  if (line_index >= m_lines.size()) {
+  if (line_index >= GetLineCount()) {
     return -1;  // Invalid line index
   }
-  return static_cast<int>(m_lines[line_index].text.size());
+  return static_cast<int>(GetLine(line_index).text.size());
 }
 
 std::string ColoredTextBuffer::GetLineText(size_t line_index,
                                            int start_pos,
                                            int end_pos) const {
-  if (line_index >= m_lines.size()) {
+  if (line_index >= GetLineCount()) {
     return std::string();  // Invalid line index
   }
-  const auto& line = m_lines[line_index];
+  const auto& line = GetLine(line_index);
   if (line.text.size() == 0) {
     return std::string();
   }
@@ -128,36 +426,35 @@ std::string ColoredTextBuffer::GetLineText(size_t line_index,
     return std::string();  // Invalid range
   }
 
-  std::vector<char> utf8;
+  std::string utf8;
   Utils::Utf32ToUtf8(line.text.data() + start_pos, end_pos - start_pos + 1,
                      utf8);
-  return std::string(utf8.begin(), utf8.end());
+  return utf8;
 }
 
 void ColoredTextBuffer::SetText(size_t line_index,
                                 int offset,
                                 const char32_t* content,
                                 int length) {
-  if (line_index >= m_lines.size() || offset < 0 || length <= 0 || !content) {
+  ScopedProbe probe(Probe::BufferSetText, std::max(length, 0));
+  if (line_index >= GetLineCount() || offset < 0 || length <= 0 || !content) {
     return;
   }
-  auto& line = m_lines[line_index];
+  auto& line = GetLine(line_index);
   size_t required = static_cast<size_t>(offset + length);
   if (line.text.size() < required) {
     line.text.resize(required, U' ');
   }
-  for (int i = 0; i < length; ++i) {
-    line.text[offset + i] = content[i];
-  }
+  std::copy_n(content, length, line.text.begin() + offset);
 }
 
 void ColoredTextBuffer::SetSpaces(size_t line_index,
                                   int start_pos,
                                   int end_pos) {
-  if (line_index >= m_lines.size() || start_pos < 0 || end_pos < start_pos) {
+  if (line_index >= GetLineCount() || start_pos < 0 || end_pos < start_pos) {
     return;
   }
-  auto& line = m_lines[line_index];
+  auto& line = GetLine(line_index);
   int line_last_pos = static_cast<int>(line.text.size() - 1);
   if (end_pos > line_last_pos) {
     line.text.resize(end_pos + 1, U' ');
@@ -198,10 +495,7 @@ void ColoredTextBuffer::MaybeAddFragment(LineFragment* fragments,
     fragments[size++] = fragment;
     return;
   }
-  LineFragment& back_fragment = fragments[size - 1];
-  if (fragment.color != back_fragment.color ||
-      fragment.underline_color != back_fragment.underline_color ||
-      fragment.background_color != back_fragment.background_color) {
+  if (fragment.attr != fragments[size - 1].attr) {
     fragments[size++] = fragment;
   }
 }
@@ -211,11 +505,53 @@ void ColoredTextBuffer::SetColor(size_t line_index,
                                  int end_pos,
                                  int color,
                                  int underline_color,
-                                 int background_color) {
-  if (line_index >= m_lines.size() || start_pos < 0)
+                                 int background_color,
+                                 uint32_t flags) {
+  ScopedProbe probe(Probe::BufferSetColor);
+  if (line_index >= GetLineCount() || start_pos < 0)
+    return;
+
+  if (m_attributes.GetSize() >= m_attributeCompactionSize) {
+    CompactAttributes();
+  }
+  uint32_t attr = m_attributes.Intern(
+      {color, underline_color, background_color, flags});
+  SetAttributes(line_index, start_pos, end_pos, attr);
+}
+
+const TextAttributes& ColoredTextBuffer::GetAttributes(uint32_t attr) const {
+  return m_attributes.Get(attr);
+}
+
+size_t ColoredTextBuffer::GetAttributeCount() const {
+  return m_attributes.GetSize();
+}
+
+void ColoredTextBuffer::CompactAttributes() {
+  AttributeTable compacted;
+  auto remap = [&](ColoredLine& line) {
+    for (auto& fragment : line.fragments) {
+      fragment.attr = compacted.Intern(m_attributes.Get(fragment.attr));
+    }
+  };
+  for (size_t i = 0; i < m_count; i++) {
+    remap(HotLine(i));
+  }
+  // Compressed lines store attribute values, only decompressed ones use ids
+  m_cold.ForEachCachedLine(remap);
+  m_attributes = std::move(compacted);
+  m_attributeCompactionSize =
+      std::max(MIN_ATTRIBUTE_COMPACTION_SIZE, m_attributes.GetSize() * 2);
+}
+
+void ColoredTextBuffer::SetAttributes(size_t line_index,
+                                      int start_pos,
+                                      int end_pos,
+                                      uint32_t attr) {
+  if (line_index >= GetLineCount() || start_pos < 0)
     return;
 
-  auto& line = m_lines[line_index];
+  auto& line = GetLine(line_index);
   int line_last_pos = static_cast<int>(line.text.size() - 1);
   end_pos = std::min(end_pos, line_last_pos);
   if (start_pos > end_pos)
@@ -223,8 +559,7 @@ void ColoredTextBuffer::SetColor(size_t line_index,
 
   auto& fragments = line.fragments;
   if (fragments.empty()) {
-    // fragments.push_back({0, 0, 0, 0});
-    fragments.push_back({0, color, underline_color, background_color});
+    fragments.push_back({0, attr});
     return;  // No fragments to adjust, just add a new one
   }
 
@@ -252,8 +587,7 @@ void ColoredTextBuffer::SetColor(size_t line_index,
   if (first.pos < start_pos) {
     MaybeAddFragment(new_fragments, new_fragments_size, first);
   }
-  MaybeAddFragment(new_fragments, new_fragments_size,
-                   {start_pos, color, underline_color, background_color});
+  MaybeAddFragment(new_fragments, new_fragments_size, {start_pos, attr});
 
   int moved_right = end_pos + 1;
   int next_begin;
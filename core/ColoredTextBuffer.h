@@ -1,36 +1,100 @@
 #pragma once
 
 #include <cstdint>
-#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "AttributeTable.h"
+#include "ColdLineStore.h"
+#include "TrigramIndex.h"
+
+// Attributes apply from pos up to the next fragment; attr is an id in the
+// owning buffer's AttributeTable
 struct LineFragment {
   int pos;
-  int color;
-  int underline_color;
-  int background_color;
+  uint32_t attr;
 };
 
+// version changes with every modification and is unique across buffers, so
+// it can key caches of anything derived from the line
 struct ColoredLine {
   std::vector<char32_t> text;
   std::vector<LineFragment> fragments;
+  uint64_t version = 0;
 };
 
 namespace MTerm {
 
+constexpr size_t DEFAULT_MAX_LINES = 10000;
+constexpr size_t DEFAULT_HOT_LINES = 1024;
+constexpr size_t MIN_ATTRIBUTE_COMPACTION_SIZE = 4096;
+
 class Window;
 
+// Lines [begin, end) changed since the last TakeDamage(), empty if begin ==
+// end. end may point past the last line when lines were removed.
+struct LineDamage {
+  size_t begin;
+  size_t end;
+};
+
+// The newest lines live uncompressed in a circular store; lines further than
+// hot_lines from the bottom are compressed into a ColdLineStore. Once
+// max_lines is reached, AddLine() recycles the oldest line and shifts all
+// indices down by one; GetTrimmedLineCount() lets callers compensate.
+// max_lines == 0 means unlimited, hot_lines == 0 disables compression.
+// Not thread-safe, not even for const calls: reading a compressed line
+// caches it and may intern its attributes.
 class ColoredTextBuffer {
  public:
-  ColoredTextBuffer();
+  explicit ColoredTextBuffer(size_t max_lines = DEFAULT_MAX_LINES);
 
   void AddLine();
 
-  std::deque<ColoredLine>& GetLines();
+  // A reference to a compressed line stays valid until the next access to
+  // the buffer. The non-const overload marks the line as modified.
+  ColoredLine& GetLine(size_t line_index);
+
+  const ColoredLine& GetLine(size_t line_index) const;
 
   size_t GetLineCount() const;
 
+  uint64_t GetLineVersion(size_t line_index) const;
+
+  // Returns the lines changed by edits, insertions and removals since the
+  // previous call and resets the damage
+  LineDamage TakeDamage();
+
+  size_t GetHotLineCount() const;
+
+  void SetHotLineCount(size_t hot_lines);
+
+  ScrollbackStats GetScrollbackStats() const;
+
+  // Compressed scrollback kept in memory before the oldest blocks are moved
+  // to a temp file, 0 - never spill
+  size_t GetSpillBudget() const;
+
+  void SetSpillBudget(size_t budget);
+
+  size_t GetMaxLines() const;
+
+  void SetMaxLines(size_t max_lines);
+
+  // Total number of lines evicted from the top since creation
+  uint64_t GetTrimmedLineCount() const;
+
+  // Keeps a TrigramIndex of at most budget bytes over the lines added from
+  // now on, except the newest INDEX_LAG_LINES, 0 - no index. Lines inserted
+  // or removed above the newest ones reset the index.
+  size_t GetSearchIndexBudget() const;
+
+  void SetSearchIndexBudget(size_t budget);
+
+  // Absolute line numbers (trimmed lines included), nullptr without index
+  const TrigramIndex* GetSearchIndex() const;
+
   void InsertLines(size_t index, size_t count);
 
   void RemoveLines(size_t start_index, size_t end_index);
@@ -59,7 +123,17 @@ class ColoredTextBuffer {
                 int end_pos,
                 int color,
                 int underline_color,
-                int background_color);
+                int background_color,
+                uint32_t flags = 0);
+
+  void SetAttributes(size_t line_index,
+                     int start_pos,
+                     int end_pos,
+                     uint32_t attr);
+
+  const TextAttributes& GetAttributes(uint32_t attr) const;
+
+  size_t GetAttributeCount() const;
 
  private:
   static void ReplaceSubrange(std::vector<LineFragment>& fragments,
@@ -72,7 +146,59 @@ class ColoredTextBuffer {
                                int& size,
                                LineFragment fragment);
 
-  std::deque<ColoredLine> m_lines;
+  ColoredLine& HotLine(size_t hot_index);
+
+  // AddLine() without compressing old lines
+  void AppendLine();
+
+  void TrimOldestLine();
+
+  // Compresses hot lines beyond the hot line limit
+  void FreezeLines();
+
+  // Decompresses all lines from line_index on back into the hot store
+  void ThawLines(size_t line_index);
+
+  void PushFrontHotLine(ColoredLine&& line);
+
+  // Rotates hot lines [first, last) so that middle becomes first
+  void RotateLines(size_t first, size_t middle, size_t last);
+
+  void ReverseLines(size_t first, size_t last);
+
+  // Moves the oldest hot line to slot 0
+  void Linearize();
+
+  // Rebuilds the attribute table from the fragments that are still in use
+  void CompactAttributes();
+
+  void Damage(size_t begin, size_t end);
+
+  // The first line that is not indexed yet because it is too new
+  uint64_t GetIndexLimit() const;
+
+  void IndexLines();
+
+  // The lines from line_index on are about to move
+  void MaybeResetIndex(size_t line_index);
+
+  std::vector<ColoredLine> m_lines;  // Slots, m_first is the oldest hot line
+  size_t m_first = 0;
+  size_t m_count = 0;  // Hot lines
+  size_t m_maxLines;
+  size_t m_hotLines = DEFAULT_HOT_LINES;
+  uint64_t m_trimmedLines = 0;
+  // Absolute line numbers (trimmed lines included), so trimming does not
+  // move the damage
+  uint64_t m_damageBegin = 0;
+  uint64_t m_damageEnd = 0;
+
+  // Reading a cold line decompresses it and interns its attributes
+  mutable ColdLineStore m_cold;
+  mutable AttributeTable m_attributes;
+  size_t m_attributeCompactionSize = MIN_ATTRIBUTE_COMPACTION_SIZE;
+
+  std::unique_ptr<TrigramIndex> m_index;
 };
 
 }  // namespace MTerm
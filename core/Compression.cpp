@@ -0,0 +1,154 @@
+#include "Compression.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Stream of sequences:
+//   token    literal length (high nibble) | match length - 4 (low nibble),
+//            a nibble of 15 continues in 255-terminated extra bytes
+//   literals
+//   offset   2 bytes little endian, omitted after the last literals
+
+namespace MTerm {
+
+namespace {
+
+constexpr int kHashBits = 13;
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+
+uint32_t Read32(const char* data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+uint32_t Hash(uint32_t value) {
+  return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+void WriteLength(std::string& out, size_t length) {
+  while (length >= 255) {
+    out.push_back(static_cast<char>(255));
+    length -= 255;
+  }
+  out.push_back(static_cast<char>(length));
+}
+
+void WriteSequence(std::string& out,
+                   const char* literals,
+                   size_t literal_length,
+                   size_t match_length,
+                   size_t offset) {
+  size_t match_code = match_length ? match_length - kMinMatch : 0;
+  uint8_t token = static_cast<uint8_t>(
+      (literal_length < 15 ? literal_length : 15) << 4 |
+      (match_code < 15 ? match_code : 15));
+  out.push_back(static_cast<char>(token));
+  if (literal_length >= 15) {
+    WriteLength(out, literal_length - 15);
+  }
+  out.append(literals, literal_length);
+  if (match_length == 0) {
+    return;
+  }
+  out.push_back(static_cast<char>(offset & 0xFF));
+  out.push_back(static_cast<char>(offset >> 8));
+  if (match_code >= 15) {
+    WriteLength(out, match_code - 15);
+  }
+}
+
+size_t ReadLength(const uint8_t*& in, const uint8_t* end, size_t length) {
+  if (length != 15) {
+    return length;
+  }
+  uint8_t byte;
+  do {
+    if (in == end) {
+      throw std::runtime_error("Truncated compressed block");
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return length;
+}
+
+}  // namespace
+
+void Compression::Compress(const char* data, size_t size, std::string& out) {
+  out.clear();
+  out.reserve(size / 2 + 16);
+
+  uint32_t table[1 << kHashBits] = {};
+  size_t anchor = 0;
+  size_t pos = 0;
+  while (pos + kMinMatch <= size) {
+    uint32_t value = Read32(data + pos);
+    uint32_t& slot = table[Hash(value)];
+    size_t candidate = slot;
+    slot = static_cast<uint32_t>(pos + 1);  // 0 marks an empty slot
+
+    if (candidate == 0 || pos + 1 - candidate > kMaxOffset ||
+        Read32(data + candidate - 1) != value) {
+      pos++;
+      continue;
+    }
+    candidate--;
+
+    size_t length = kMinMatch;
+    while (pos + length < size &&
+           data[candidate + length] == data[pos + length]) {
+      length++;
+    }
+    WriteSequence(out, data + anchor, pos - anchor, length, pos - candidate);
+    pos += length;
+    anchor = pos;
+  }
+  WriteSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+void Compression::Decompress(const char* data,
+                             size_t size,
+                             size_t original_size,
+                             std::string& out) {
+  out.resize(original_size);
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* in_end = in + size;
+  size_t pos = 0;
+  while (in < in_end) {
+    uint8_t token = *in++;
+
+    size_t literal_length = ReadLength(in, in_end, token >> 4);
+    if (literal_length > static_cast<size_t>(in_end - in) ||
+        literal_length > original_size - pos) {
+      throw std::runtime_error("Corrupt compressed block");
+    }
+    memcpy(&out[pos], in, literal_length);
+    in += literal_length;
+    pos += literal_length;
+    if (in == in_end) {
+      break;  // Last sequence has no match
+    }
+
+    if (in_end - in < 2) {
+      throw std::runtime_error("Truncated compressed block");
+    }
+    size_t offset = in[0] | static_cast<size_t>(in[1]) << 8;
+    in += 2;
+    size_t match_length = ReadLength(in, in_end, token & 0x0F) + kMinMatch;
+    if (offset == 0 || offset > pos || match_length > original_size - pos) {
+      throw std::runtime_error("Corrupt compressed block");
+    }
+    // Byte by byte: the match may overlap the bytes it produces
+    for (size_t i = 0; i < match_length; i++, pos++) {
+      out[pos] = out[pos - offset];
+    }
+  }
+  if (pos != original_size) {
+    throw std::runtime_error("Truncated compressed block");
+  }
+}
+
+}  // namespace MTerm
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace MTerm {
+
+// Byte-oriented LZ77 codec in the spirit of LZ4: greedy hash-table matching,
+// no entropy coding. Fast enough to run on the terminal thread and typically
+// shrinks log text 3-6x.
+class Compression {
+ public:
+  // Replaces out with the compressed form of data
+  static void Compress(const char* data, size_t size, std::string& out);
+
+  // Replaces out with exactly original_size decompressed bytes. Throws
+  // std::runtime_error on corrupt input.
+  static void Decompress(const char* data,
+                         size_t size,
+                         size_t original_size,
+                         std::string& out);
+};
+
+}  // namespace MTerm
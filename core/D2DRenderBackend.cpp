@@ -0,0 +1,230 @@
+#include "D2DRenderBackend.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace Microsoft::WRL;
+
+static inline void ThrowIfFailed(HRESULT hr) {
+  if (FAILED(hr)) {
+    throw std::exception();
+  }
+}
+
+namespace MTerm {
+
+D2DRenderBackend::D2DRenderBackend(HWND hwnd, const std::wstring& font_name) {
+  ThrowIfFailed(D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED,
+                                  IID_PPV_ARGS(&m_d2dFactory)));
+
+  RECT window_rect;
+  GetWindowRect(hwnd, &window_rect);
+
+  m_size.width = window_rect.right - window_rect.left;
+  m_size.height = window_rect.bottom - window_rect.top;
+
+  D2D1_RENDER_TARGET_PROPERTIES props =
+      D2D1::RenderTargetProperties(D2D1_RENDER_TARGET_TYPE_HARDWARE);
+  D2D1_HWND_RENDER_TARGET_PROPERTIES hwnd_props =
+      D2D1::HwndRenderTargetProperties(hwnd, m_size);
+
+  ThrowIfFailed(m_d2dFactory->CreateHwndRenderTarget(props, hwnd_props,
+                                                     &m_renderTarget));
+
+  ThrowIfFailed(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED,
+                                    __uuidof(IDWriteFactory),
+                                    &m_dwriteFactory));
+
+  m_wcharIndexesVector.resize(0xFFFF + 1);
+  LoadFont(font_name.c_str());
+
+  m_renderTarget->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE);
+
+  ThrowIfFailed(m_renderTarget->CreateSolidColorBrush(D2D1::ColorF(0xFFFFFF),
+                                                      &m_defaultBrush));
+}
+
+D2DRenderBackend::~D2DRenderBackend() {}
+
+void D2DRenderBackend::Resize(int width, int height) {
+  m_size.width = width;
+  m_size.height = height;
+  m_renderTarget->Resize(m_size);
+}
+
+int D2DRenderBackend::GetWidth() const {
+  return m_size.width;
+}
+
+int D2DRenderBackend::GetHeight() const {
+  return m_size.height;
+}
+
+void D2DRenderBackend::OnBeginFrame() {
+  m_renderTarget->BeginDraw();
+}
+
+void D2DRenderBackend::OnEndFrame() {
+  ThrowIfFailed(m_renderTarget->EndDraw());
+}
+
+void D2DRenderBackend::Clear(int color) {
+  m_renderTarget->Clear(D2D1::ColorF(color));
+}
+
+void D2DRenderBackend::DrawGlyphs(const uint16_t* glyphs,
+                                  int length,
+                                  float font_size,
+                                  float x,
+                                  float y,
+                                  int color,
+                                  int underline_color,
+                                  float opacity) {
+  if (color != -1) {
+    float baseline_y = y + m_baselineEm * font_size;
+
+    DWRITE_GLYPH_RUN glyphRun = {};
+    glyphRun.fontFace = m_fontFace.Get();
+    glyphRun.fontEmSize = font_size;
+    glyphRun.glyphCount = length;
+    glyphRun.glyphIndices = glyphs;
+    glyphRun.glyphAdvances = nullptr;  // use natural advance
+    glyphRun.isSideways = FALSE;
+    glyphRun.bidiLevel = 0;
+
+    SetBrush(color, opacity);
+    m_renderTarget->DrawGlyphRun(D2D1::Point2F(x, baseline_y), &glyphRun,
+                                 m_defaultBrush.Get(),
+                                 DWRITE_MEASURING_MODE_NATURAL);
+  }
+  if (underline_color != -1) {
+    float underline_y = y + m_underlinePosEm * font_size;
+    float width = GetLineWidth(font_size, length);
+    float thickness = m_underlineThicknessEm * font_size;
+    SetBrush(underline_color, opacity);
+    m_renderTarget->DrawLine({x, underline_y}, {x + width, underline_y},
+                             m_defaultBrush.Get(), thickness);
+  }
+}
+
+void D2DRenderBackend::Line(float start_x,
+                            float start_y,
+                            float end_x,
+                            float end_y,
+                            float thickness,
+                            int color,
+                            float opacity) {
+  SetBrush(color, opacity);
+  m_renderTarget->DrawLine({start_x, start_y}, {end_x, end_y},
+                           m_defaultBrush.Get(), thickness);
+}
+
+void D2DRenderBackend::Rect(float left,
+                            float top,
+                            float right,
+                            float bottom,
+                            int color,
+                            float opacity) {
+  SetBrush(color, opacity);
+  D2D1_RECT_F rect = {left, top, right, bottom};
+  m_renderTarget->FillRectangle(rect, m_defaultBrush.Get());
+}
+
+void D2DRenderBackend::Outline(float left,
+                               float top,
+                               float right,
+                               float bottom,
+                               float thickness,
+                               int color,
+                               float opacity) {
+  SetBrush(color, opacity);
+  D2D1_RECT_F rect = {left, top, right, bottom};
+  m_renderTarget->DrawRectangle(rect, m_defaultBrush.Get(), thickness);
+}
+
+void D2DRenderBackend::SetBrush(int color, float opacity) {
+  if (color != m_brushColor) {
+    m_defaultBrush->SetColor(D2D1::ColorF(color));
+    m_brushColor = color;
+  }
+  if (opacity != m_brushOpacity) {
+    m_defaultBrush->SetOpacity(opacity);
+    m_brushOpacity = opacity;
+  }
+}
+
+float D2DRenderBackend::GetAdvance(float font_size) const {
+  return m_advanceEm * font_size;
+}
+
+float D2DRenderBackend::GetLineHeight(float font_size) const {
+  return m_lineHeightEm * font_size;
+}
+
+// TODO - refactor
+uint16_t D2DRenderBackend::GetGlyphIndex(char32_t codepoint) {
+  if (codepoint <= 0xFFFF && m_wcharIndexesVector[codepoint] != 0) {
+    return m_wcharIndexesVector[codepoint];
+  } else if (m_glyphIndexCache.find(codepoint) != m_glyphIndexCache.end()) {
+    return m_glyphIndexCache[codepoint];
+  }
+  UINT32 cp = static_cast<UINT32>(codepoint);
+  UINT16 index;
+  ThrowIfFailed(m_fontFace->GetGlyphIndicesW(&cp, 1, &index));
+  if (codepoint <= 0xFFFF && index > 0) {
+    m_wcharIndexesVector[codepoint] = index;
+  } else {
+    m_glyphIndexCache[codepoint] = index;
+  }
+  return index;
+}
+
+void D2DRenderBackend::LoadFont(const wchar_t* font_name) {
+  ComPtr<IDWriteFontCollection> fontCollection;
+  ThrowIfFailed(m_dwriteFactory->GetSystemFontCollection(&fontCollection));
+
+  UINT32 index = 0;
+  BOOL exists = FALSE;
+  ThrowIfFailed(fontCollection->FindFamilyName(font_name, &index, &exists));
+  if (!exists)
+    return;
+
+  ComPtr<IDWriteFontFamily> fontFamily;
+  ThrowIfFailed(fontCollection->GetFontFamily(index, &fontFamily));
+
+  ComPtr<IDWriteFont> font;
+  ThrowIfFailed(fontFamily->GetFirstMatchingFont(
+      DWRITE_FONT_WEIGHT_LIGHT, DWRITE_FONT_STRETCH_SEMI_CONDENSED,
+      DWRITE_FONT_STYLE_NORMAL, &font));
+
+  ThrowIfFailed(font->CreateFontFace(&m_fontFace));
+  m_glyphIndexCache.clear();
+  std::fill(m_wcharIndexesVector.begin(), m_wcharIndexesVector.end(), 0);
+  ResetGlyphCache();
+
+  DWRITE_FONT_METRICS metrics;
+  m_fontFace->GetMetrics(&metrics);
+
+  FLOAT designUnitsPerEm = metrics.designUnitsPerEm;
+  FLOAT lineHeightDesignUnits =
+      metrics.ascent + metrics.descent + metrics.lineGap;
+
+  m_lineHeightEm = lineHeightDesignUnits / designUnitsPerEm;
+  m_baselineEm = metrics.ascent / designUnitsPerEm;
+  m_underlinePosEm = m_baselineEm + metrics.underlinePosition /
+                                        designUnitsPerEm * -1;  // y-top
+  m_underlineThicknessEm = metrics.underlineThickness / designUnitsPerEm;
+
+  UINT32 codePoint = U'M';
+  UINT16 glyphIndex = 0;
+  m_fontFace->GetGlyphIndicesW(&codePoint, 1, &glyphIndex);
+
+  DWRITE_GLYPH_METRICS glyphMetrics = {};
+  m_fontFace->GetDesignGlyphMetrics(&glyphIndex, 1, &glyphMetrics, FALSE);
+
+  FLOAT advanceWidth = glyphMetrics.advanceWidth;  // Monospace
+
+  m_advanceEm = (advanceWidth / designUnitsPerEm);
+}
+
+}  // namespace MTerm
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Windows.h"
+
+#include <d2d1.h>
+#include <dwrite.h>
+#include <wrl/client.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderBackend.h"
+
+namespace MTerm {
+
+// Direct2D render target of a window with DirectWrite glyph runs
+class D2DRenderBackend : public RenderBackend {
+ public:
+  D2DRenderBackend(HWND hwnd, const std::wstring& font_name);
+  ~D2DRenderBackend() override;
+
+  void Resize(int width, int height);
+
+  int GetWidth() const override;
+  int GetHeight() const override;
+
+  void Clear(int color) override;
+
+  void Line(float start_x,
+            float start_y,
+            float end_x,
+            float end_y,
+            float thickness,
+            int color,
+            float opacity) override;
+
+  void Rect(float left,
+            float top,
+            float right,
+            float bottom,
+            int color,
+            float opacity) override;
+
+  void Outline(float left,
+               float top,
+               float right,
+               float bottom,
+               float thickness,
+               int color,
+               float opacity) override;
+
+  float GetAdvance(float font_size) const override;
+  float GetLineHeight(float font_size) const override;
+
+  uint16_t GetGlyphIndex(char32_t codepoint) override;
+
+ protected:
+  void OnBeginFrame() override;
+  void OnEndFrame() override;
+
+  void DrawGlyphs(const uint16_t* glyphs,
+                  int length,
+                  float font_size,
+                  float x,
+                  float y,
+                  int color,
+                  int underline_color,
+                  float opacity) override;
+
+ private:
+  void LoadFont(const wchar_t* font_name);
+
+  // Runs are grouped by color, so most calls keep the brush as it is
+  void SetBrush(int color, float opacity);
+
+  D2D1_SIZE_U m_size;
+  Microsoft::WRL::ComPtr<ID2D1Factory> m_d2dFactory;
+  Microsoft::WRL::ComPtr<ID2D1HwndRenderTarget> m_renderTarget;
+  Microsoft::WRL::ComPtr<IDWriteFactory> m_dwriteFactory;
+  Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> m_defaultBrush;
+  int m_brushColor = -1;
+  float m_brushOpacity = -1;
+
+  Microsoft::WRL::ComPtr<IDWriteFontFace> m_fontFace;
+  float m_advanceEm = 0;
+  float m_lineHeightEm = 0;
+  float m_baselineEm = 0;
+  float m_underlinePosEm = 0;
+  float m_underlineThicknessEm = 0;
+  std::unordered_map<char32_t, unsigned short> m_glyphIndexCache;
+  std::vector<unsigned short> m_wcharIndexesVector;
+};
+
+}  // namespace MTerm
@@ -0,0 +1,210 @@
+#include "DrawBatcher.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace MTerm {
+
+using namespace RenderCommands;
+
+namespace {
+
+void CopyCommand(std::vector<uint8_t>& out,
+                 uint8_t opcode,
+                 const uint8_t* data) {
+  out.push_back(opcode);
+  out.insert(out.end(), data, data + RecordSize(opcode));
+}
+
+bool IsDrawCall(uint8_t opcode) {
+  return opcode != kBeginTextBuffer && opcode != kEndTextBuffer;
+}
+
+}  // namespace
+
+DrawBatcher::DrawBatcher() {}
+
+DrawBatcher::~DrawBatcher() {}
+
+BatchStats DrawBatcher::Coalesce(RenderCommandList& list) {
+  BatchStats stats = {};
+  m_output.clear();
+  m_drawn.clear();
+  m_backgrounds.clear();
+  m_glyphs.clear();
+  m_skipped = 0;
+
+  int clear_color = -1;  // Unknown until the first clear
+  bool in_text_buffer = false;
+  bool skip_clear_color = false;
+  Box text_buffer = {};
+
+  auto end_text_buffer = [&]() {
+    FlushTextBuffer(skip_clear_color, clear_color);
+    m_drawn.push_back(text_buffer);
+    in_text_buffer = false;
+  };
+
+  ForEachCommand(list.m_commands, [&](uint8_t opcode, const uint8_t* data) {
+    if (IsDrawCall(opcode)) {
+      stats.draw_calls++;
+    }
+    if (in_text_buffer) {
+      if (opcode == kRect) {
+        auto r = ReadRecord<RectRecord>(data);
+        if (r.opacity >= 1.0f) {
+          m_backgrounds.push_back(r);
+          return;
+        }
+      } else if (opcode == kGlyphs) {
+        m_glyphs.push_back(ReadRecord<GlyphsRecord>(data));
+        return;
+      } else if (opcode == kEndTextBuffer) {
+        end_text_buffer();
+        CopyCommand(m_output, opcode, data);
+        return;
+      }
+      // Not something TextBuffer() draws, keep the order around it
+      end_text_buffer();
+    }
+
+    switch (opcode) {
+      case kClear:
+        clear_color = ReadRecord<ClearRecord>(data).color;
+        m_drawn.clear();
+        break;
+      case kLine: {
+        auto r = ReadRecord<LineRecord>(data);
+        float half = r.thickness / 2;
+        m_drawn.push_back({std::min(r.start_x, r.end_x) - half,
+                           std::min(r.start_y, r.end_y) - half,
+                           std::max(r.start_x, r.end_x) + half,
+                           std::max(r.start_y, r.end_y) + half});
+        break;
+      }
+      case kRect: {
+        auto r = ReadRecord<RectRecord>(data);
+        m_drawn.push_back({r.left, r.top, r.right, r.bottom});
+        break;
+      }
+      case kOutline: {
+        // Only the edges, an outline around the window covers nothing
+        auto r = ReadRecord<OutlineRecord>(data);
+        float half = r.thickness / 2;
+        float left = r.left - half;
+        float top = r.top - half;
+        float right = r.right + half;
+        float bottom = r.bottom + half;
+        m_drawn.push_back({left, top, right, r.top + half});
+        m_drawn.push_back({left, r.bottom - half, right, bottom});
+        m_drawn.push_back({left, top, r.left + half, bottom});
+        m_drawn.push_back({r.right - half, top, right, bottom});
+        break;
+      }
+      case kGlyphs: {
+        // Metrics are unknown here. Monospace cells are narrower than 1 em
+        // and lower than 1.5 em, with some room for overhangs.
+        auto r = ReadRecord<GlyphsRecord>(data);
+        float size = r.font_size;
+        float margin = size / 4;
+        m_drawn.push_back({r.x - margin, r.y - margin,
+                           r.x + size * r.length + margin, r.y + 1.5f * size});
+        break;
+      }
+      case kBeginTextBuffer: {
+        auto r = ReadRecord<BeginTextBufferRecord>(data);
+        text_buffer = {r.left, r.top, r.right, r.bottom};
+        skip_clear_color = clear_color != -1 && !IsCovered(text_buffer);
+        in_text_buffer = true;
+        break;
+      }
+    }
+    CopyCommand(m_output, opcode, data);
+  });
+  if (in_text_buffer) {
+    end_text_buffer();
+  }
+
+  size_t command_count = 0;
+  ForEachCommand(m_output, [&](uint8_t opcode, const uint8_t*) {
+    command_count++;
+    if (IsDrawCall(opcode)) {
+      stats.batched_draw_calls++;
+    }
+  });
+  list.m_commands.swap(m_output);
+  list.m_commandCount = command_count;
+  stats.skipped_backgrounds = m_skipped;
+  return stats;
+}
+
+void DrawBatcher::FlushTextBuffer(bool skip_clear_color, int clear_color) {
+  // Rows of one column range and color end up next to each other
+  std::sort(m_backgrounds.begin(), m_backgrounds.end(),
+            [](const RectRecord& a, const RectRecord& b) {
+              return std::tie(a.color, a.left, a.right, a.top) <
+                     std::tie(b.color, b.left, b.right, b.top);
+            });
+  bool pending = false;
+  RectRecord merged = {};
+  for (const RectRecord& r : m_backgrounds) {
+    if (skip_clear_color && r.color == clear_color) {
+      m_skipped++;
+      continue;
+    }
+    if (pending && r.color == merged.color && r.left == merged.left &&
+        r.right == merged.right && r.top <= merged.bottom) {
+      merged.bottom = std::max(merged.bottom, r.bottom);
+      continue;
+    }
+    if (pending) {
+      AppendRecord(m_output, kRect, merged);
+    }
+    merged = r;
+    pending = true;
+  }
+  if (pending) {
+    AppendRecord(m_output, kRect, merged);
+  }
+  m_backgrounds.clear();
+
+  // Runs of a line are contiguous in its glyphs and on screen
+  size_t count = 0;
+  for (const GlyphsRecord& g : m_glyphs) {
+    if (count > 0) {
+      GlyphsRecord& last = m_glyphs[count - 1];
+      if (g.source != 0 && g.source == last.source &&
+          g.offset == last.offset + last.length && g.y == last.y &&
+          g.font_size == last.font_size && g.color == last.color &&
+          g.underline_color == last.underline_color &&
+          g.opacity == last.opacity) {
+        last.length += g.length;
+        continue;
+      }
+    }
+    m_glyphs[count++] = g;
+  }
+  m_glyphs.resize(count);
+
+  // Fewer brush changes
+  std::stable_sort(m_glyphs.begin(), m_glyphs.end(),
+                   [](const GlyphsRecord& a, const GlyphsRecord& b) {
+                     return a.color < b.color;
+                   });
+  for (const GlyphsRecord& g : m_glyphs) {
+    AppendRecord(m_output, kGlyphs, g);
+  }
+  m_glyphs.clear();
+}
+
+bool DrawBatcher::IsCovered(const Box& box) const {
+  for (const Box& drawn : m_drawn) {
+    if (drawn.left < box.right && box.left < drawn.right &&
+        drawn.top < box.bottom && box.top < drawn.bottom) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace MTerm
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RenderCommandFormat.h"
+#include "RenderCommandList.h"
+
+namespace MTerm {
+
+struct BatchStats {
+  size_t draw_calls;          // Before coalescing
+  size_t batched_draw_calls;  // After
+  size_t skipped_backgrounds;
+};
+
+// Coalesces the commands of text buffers in a recorded frame before it is
+// replayed. Inside a TextBuffer() call:
+// - backgrounds are drawn first, with same-color rectangles of adjacent
+//   rows merged and fills of the clear color dropped when nothing was drawn
+//   under the text buffer since the clear;
+// - adjacent glyph runs of a line that differ only in background become one
+//   run, and runs are grouped by color.
+// Backgrounds and glyphs of a character grid do not overlap, so this only
+// changes which of two overlapping glyph or background edges is on top.
+// Commands outside text buffers keep their order.
+class DrawBatcher {
+ public:
+  DrawBatcher();
+  ~DrawBatcher();
+
+  BatchStats Coalesce(RenderCommandList& list);
+
+ private:
+  struct Box {
+    float left;
+    float top;
+    float right;
+    float bottom;
+  };
+
+  void FlushTextBuffer(bool skip_clear_color, int clear_color);
+
+  bool IsCovered(const Box& box) const;
+
+  // Boxes drawn since the last clear, text buffers included
+  std::vector<Box> m_drawn;
+  // Commands of the current text buffer
+  std::vector<RenderCommands::RectRecord> m_backgrounds;
+  std::vector<RenderCommands::GlyphsRecord> m_glyphs;
+  std::vector<uint8_t> m_output;
+  size_t m_skipped = 0;
+};
+
+}  // namespace MTerm
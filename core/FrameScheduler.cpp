@@ -0,0 +1,88 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace MTerm {
+
+namespace {
+
+constexpr double kDefaultRate = 60.0;
+constexpr auto kDefaultLatencyBudget = std::chrono::milliseconds(50);
+
+}  // namespace
+
+FrameScheduler::FrameScheduler(Clock clock)
+    : m_clock(std::move(clock)), m_latencyBudget(kDefaultLatencyBudget) {
+  SetTargetRate(kDefaultRate);
+}
+
+void FrameScheduler::SetTargetRate(double frames_per_second) {
+  if (frames_per_second <= 0) {
+    return;
+  }
+  m_targetInterval = std::chrono::duration_cast<Duration>(
+      std::chrono::duration<double>(1.0 / frames_per_second));
+}
+
+void FrameScheduler::SetLatencyBudget(Duration budget) {
+  m_latencyBudget = std::max(budget, Duration::zero());
+}
+
+void FrameScheduler::RequestFrame() {
+  m_requests++;
+  if (!m_pending) {
+    m_pending = true;
+    m_firstRequest = m_clock();
+  }
+}
+
+void FrameScheduler::RequestImmediateFrame() {
+  RequestFrame();
+  m_immediate = true;
+}
+
+bool FrameScheduler::IsPending() const {
+  return m_pending;
+}
+
+FrameScheduler::TimePoint FrameScheduler::GetFrameTime() const {
+  if (m_immediate || !m_hasFrame) {
+    return m_firstRequest;
+  }
+  // After an idle period the paced time is already behind the request
+  TimePoint paced = m_frameStart + GetFrameInterval();
+  TimePoint deadline = m_firstRequest + m_latencyBudget;
+  return std::max(m_firstRequest, std::min(paced, deadline));
+}
+
+void FrameScheduler::BeginFrame() {
+  m_pending = false;
+  m_immediate = false;
+  m_hasFrame = true;
+  m_frameStart = m_clock();
+  m_frames++;
+}
+
+void FrameScheduler::EndFrame() {
+  Duration cost = m_clock() - m_frameStart;
+  // Smoothed so that one slow frame does not halve the rate
+  m_frameCost = m_frames == 1 ? cost : (m_frameCost * 3 + cost) / 4;
+}
+
+FrameScheduler::Duration FrameScheduler::GetFrameInterval() const {
+  Duration longest = std::max(m_targetInterval, m_latencyBudget);
+  return std::clamp(m_frameCost * 2, m_targetInterval, longest);
+}
+
+FrameSchedulerStats FrameScheduler::GetStats() const {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  return {m_requests, m_frames,
+          static_cast<uint64_t>(
+              duration_cast<microseconds>(GetFrameInterval()).count()),
+          static_cast<uint64_t>(
+              duration_cast<microseconds>(m_frameCost).count())};
+}
+
+}  // namespace MTerm
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace MTerm {
+
+struct FrameSchedulerStats {
+  uint64_t requests;
+  uint64_t frames;
+  uint64_t frame_interval_us;  // Current, after adapting to frame cost
+  uint64_t frame_cost_us;      // Smoothed time from BeginFrame to EndFrame
+};
+
+// Decides when to draw the next frame. Any number of requests between two
+// frames are drawn by one frame. The first request after an idle period is
+// drawn immediately, later ones wait for the frame interval. The interval
+// starts at the target rate and grows when frames get expensive, so that
+// drawing keeps at most half of the time under a flood of output, but a
+// request never waits longer than the latency budget.
+// Not thread-safe. Time comes from an injectable clock.
+class FrameScheduler {
+ public:
+  using TimePoint = std::chrono::steady_clock::time_point;
+  using Duration = std::chrono::steady_clock::duration;
+  using Clock = std::function<TimePoint()>;
+
+  explicit FrameScheduler(Clock clock = std::chrono::steady_clock::now);
+
+  void SetTargetRate(double frames_per_second);
+  void SetLatencyBudget(Duration budget);
+
+  void RequestFrame();
+
+  // Skips pacing, e.g. to show a resized window at once
+  void RequestImmediateFrame();
+
+  bool IsPending() const;
+
+  // When the pending frame should start, may be in the past
+  TimePoint GetFrameTime() const;
+
+  // Takes all requests made until now
+  void BeginFrame();
+  void EndFrame();
+
+  Duration GetFrameInterval() const;
+
+  FrameSchedulerStats GetStats() const;
+
+ private:
+  Clock m_clock;
+  Duration m_targetInterval;
+  Duration m_latencyBudget;
+
+  bool m_pending = false;
+  bool m_immediate = false;
+  TimePoint m_firstRequest;
+
+  bool m_hasFrame = false;
+  TimePoint m_frameStart;
+  Duration m_frameCost{};
+
+  uint64_t m_requests = 0;
+  uint64_t m_frames = 0;
+};
+
+}  // namespace MTerm
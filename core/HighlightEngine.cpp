@@ -0,0 +1,280 @@
+#include "HighlightEngine.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <stdexcept>
+
+#include "Utils.h"
+
+namespace MTerm {
+
+HighlightEngine::HighlightEngine(const std::vector<HighlightRule>& rules)
+    : m_rules(rules) {
+  std::vector<std::u32string> folded;
+  // By ignore_case and anchoring
+  std::vector<uint32_t> regex_rules[2][2];
+  for (uint32_t rule = 0; rule < m_rules.size(); rule++) {
+    const HighlightRule& highlight = m_rules[rule];
+    if (highlight.pattern.empty()) {
+      throw std::runtime_error("Empty highlight pattern");
+    }
+    if (highlight.regex) {
+      regex_rules[highlight.ignore_case][IsAnchored(highlight.pattern)]
+          .push_back(rule);
+      continue;
+    }
+    std::vector<char32_t> text;
+    Utils::Utf8ToUtf32(highlight.pattern.data(), highlight.pattern.size(),
+                       text);
+    m_literals.push_back(
+        Literal{std::u32string(text.begin(), text.end()), rule, 0});
+    for (char32_t& c : text) {
+      c = Utils::FoldCase(c);
+    }
+    folded.emplace_back(text.begin(), text.end());
+  }
+  BuildAutomaton(folded);
+  for (bool ignore_case : {false, true}) {
+    for (bool anchored : {false, true}) {
+      AddAlternation(regex_rules[ignore_case][anchored], ignore_case,
+                     anchored);
+    }
+  }
+}
+
+size_t HighlightEngine::GetRuleCount() const {
+  return m_rules.size();
+}
+
+void HighlightEngine::BuildAutomaton(
+    const std::vector<std::u32string>& folded) {
+  // Trie of the folded literals
+  std::vector<std::map<char32_t, uint32_t>> children(1);
+  m_nodes.assign(1, Node{0, 0, 0, 0, 0});
+  for (size_t i = 0; i < folded.size(); i++) {
+    uint32_t node = 0;
+    for (char32_t c : folded[i]) {
+      auto it = children[node].find(c);
+      if (it != children[node].end()) {
+        node = it->second;
+        continue;
+      }
+      uint32_t child = static_cast<uint32_t>(m_nodes.size());
+      children[node].emplace(c, child);
+      children.emplace_back();
+      m_nodes.push_back(Node{0, 0, 0, 0, 0});
+      node = child;
+    }
+    m_literals[i].next = m_nodes[node].literal;
+    m_nodes[node].literal = static_cast<uint32_t>(i + 1);
+  }
+  for (size_t node = 0; node < m_nodes.size(); node++) {
+    m_nodes[node].first_edge = static_cast<uint32_t>(m_edges.size());
+    m_nodes[node].edge_count = static_cast<uint32_t>(children[node].size());
+    for (const auto& [c, child] : children[node]) {
+      m_edges.push_back(Edge{c, child});
+    }
+  }
+
+  // Fail links breadth first, so the ones of shorter prefixes are ready
+  std::deque<uint32_t> queue;
+  for (const auto& [c, child] : children[0]) {
+    queue.push_back(child);
+  }
+  while (!queue.empty()) {
+    uint32_t node = queue.front();
+    queue.pop_front();
+    for (const auto& [c, child] : children[node]) {
+      Node& next = m_nodes[child];
+      next.fail = Next(m_nodes[node].fail, c);
+      const Node& fail = m_nodes[next.fail];
+      next.output = fail.literal ? next.fail : fail.output;
+      queue.push_back(child);
+    }
+  }
+}
+
+bool HighlightEngine::IsAnchored(const std::string& pattern) {
+  return pattern[0] == '^' && pattern.find('|') == std::string::npos;
+}
+
+void HighlightEngine::AddAlternation(const std::vector<uint32_t>& rules,
+                                     bool ignore_case,
+                                     bool anchored) {
+  if (rules.empty()) {
+    return;
+  }
+  auto flags = std::regex_constants::ECMAScript;
+  if (ignore_case) {
+    flags |= std::regex_constants::icase;
+  }
+  Alternation alternation;
+  alternation.anchored = anchored;
+  std::wstring combined;
+  size_t group = 1;
+  for (uint32_t rule : rules) {
+    const std::string& pattern = m_rules[rule].pattern;
+    std::vector<char32_t> text;
+    Utils::Utf8ToUtf32(pattern.data(), pattern.size(), text);
+    std::wstring wide;
+    std::vector<int> columns;
+    Utils::Utf32ToWChar(text.data(), text.size(), wide, columns);
+    size_t groups;
+    try {
+      groups = std::wregex(wide, flags).mark_count();
+    } catch (const std::regex_error& e) {
+      throw std::runtime_error("Invalid highlight pattern " + pattern + ": " +
+                               e.what());
+    }
+    combined += combined.empty() ? L"(" : L"|(";
+    combined += wide;
+    combined += L")";
+    alternation.groups.emplace_back(group, rule);
+    group += 1 + groups;
+  }
+  alternation.regex.assign(combined, flags);
+  m_alternations.push_back(std::move(alternation));
+}
+
+uint32_t HighlightEngine::Next(uint32_t node, char32_t codepoint) const {
+  while (true) {
+    const Node& current = m_nodes[node];
+    const Edge* first = m_edges.data() + current.first_edge;
+    const Edge* last = first + current.edge_count;
+    const Edge* edge =
+        std::lower_bound(first, last, codepoint,
+                         [](const Edge& e, char32_t c) {
+                           return e.codepoint < c;
+                         });
+    if (edge != last && edge->codepoint == codepoint) {
+      return edge->node;
+    }
+    if (node == 0) {
+      return 0;
+    }
+    node = current.fail;
+  }
+}
+
+void HighlightEngine::MatchLiterals(
+    const char32_t* text,
+    size_t length,
+    std::vector<HighlightSpan>& candidates) const {
+  if (m_literals.empty()) {
+    return;
+  }
+  uint32_t node = 0;
+  for (size_t i = 0; i < length; i++) {
+    node = Next(node, Utils::FoldCase(text[i]));
+    uint32_t match = m_nodes[node].literal ? node : m_nodes[node].output;
+    for (; match != 0; match = m_nodes[match].output) {
+      for (uint32_t literal = m_nodes[match].literal; literal != 0;
+           literal = m_literals[literal - 1].next) {
+        const Literal& found = m_literals[literal - 1];
+        size_t start = i + 1 - found.text.size();
+        if (!m_rules[found.rule].ignore_case &&
+            !std::equal(found.text.begin(), found.text.end(), text + start)) {
+          continue;
+        }
+        candidates.push_back(HighlightSpan{static_cast<int>(start),
+                                           static_cast<int>(i + 1),
+                                           found.rule});
+      }
+    }
+  }
+}
+
+void HighlightEngine::MatchRegex(
+    const char32_t* text,
+    size_t length,
+    std::vector<HighlightSpan>& candidates) const {
+  if (m_alternations.empty()) {
+    return;
+  }
+  std::wstring wide;
+  std::vector<int> columns;
+  Utils::Utf32ToWChar(text, length, wide, columns);
+  for (const Alternation& alternation : m_alternations) {
+    try {
+      if (alternation.anchored) {
+        std::wsmatch match;
+        if (std::regex_search(wide.cbegin(), wide.cend(), match,
+                              alternation.regex,
+                              std::regex_constants::match_continuous)) {
+          AddRegexMatch(alternation, match, columns, candidates);
+        }
+        continue;
+      }
+      for (auto it = std::wsregex_iterator(wide.begin(), wide.end(),
+                                           alternation.regex);
+           it != std::wsregex_iterator(); ++it) {
+        AddRegexMatch(alternation, *it, columns, candidates);
+      }
+    } catch (const std::regex_error&) {
+      // Too complex for this line, e.g. backtracking on a long one
+    }
+  }
+}
+
+void HighlightEngine::AddRegexMatch(const Alternation& alternation,
+                                    const std::wsmatch& match,
+                                    const std::vector<int>& columns,
+                                    std::vector<HighlightSpan>& candidates) {
+  if (match.length() == 0) {
+    return;
+  }
+  for (const auto& [group, rule] : alternation.groups) {
+    if (match[group].matched) {
+      size_t start = static_cast<size_t>(match.position());
+      candidates.push_back(HighlightSpan{
+          columns[start], columns[start + match.length()], rule});
+      return;
+    }
+  }
+}
+
+void HighlightEngine::Match(const char32_t* text,
+                            size_t length,
+                            std::vector<HighlightSpan>& spans) const {
+  spans.clear();
+  std::vector<HighlightSpan> candidates;
+  MatchLiterals(text, length, candidates);
+  MatchRegex(text, length, candidates);
+  std::sort(candidates.begin(), candidates.end(),
+            [](const HighlightSpan& a, const HighlightSpan& b) {
+              if (a.start != b.start) {
+                return a.start < b.start;
+              }
+              if (a.end != b.end) {
+                return a.end > b.end;
+              }
+              return a.rule < b.rule;
+            });
+  int end = 0;
+  for (const HighlightSpan& span : candidates) {
+    if (span.start >= end) {
+      spans.push_back(span);
+      end = span.end;
+    }
+  }
+}
+
+TextAttributes HighlightEngine::Apply(const TextAttributes& attributes,
+                                      uint32_t rule) const {
+  const HighlightRule& highlight = m_rules[rule];
+  TextAttributes result = attributes;
+  if (highlight.color != HIGHLIGHT_KEEP) {
+    result.color = highlight.color;
+  }
+  if (highlight.underline_color != HIGHLIGHT_KEEP) {
+    result.underline_color = highlight.underline_color;
+  }
+  if (highlight.background_color != HIGHLIGHT_KEEP) {
+    result.background_color = highlight.background_color;
+  }
+  result.flags |= highlight.flags;
+  return result;
+}
+
+}  // namespace MTerm
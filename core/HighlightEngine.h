@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AttributeTable.h"
+
+namespace MTerm {
+
+// Attribute of a rule that leaves the text's own value
+constexpr int HIGHLIGHT_KEEP = -2;
+
+struct HighlightRule {
+  std::string pattern;  // UTF-8
+  bool regex = false;   // ECMAScript, otherwise a literal
+  bool ignore_case = false;
+  int color = HIGHLIGHT_KEEP;
+  int underline_color = HIGHLIGHT_KEEP;
+  int background_color = HIGHLIGHT_KEEP;
+  uint32_t flags = 0;  // Added to the text's own
+};
+
+// Columns [start, end) of a line matched by a rule, an index into the rules
+// the engine was built from
+struct HighlightSpan {
+  int start;
+  int end;
+  uint32_t rule;
+};
+
+// A set of highlight rules compiled into one matcher: literals into an
+// Aho-Corasick automaton over case-folded text, regular expressions into one
+// alternation for each case mode. Expressions that start with ^ (and have
+// no |) are only tried at the start of a line, which is much cheaper than
+// searching it. Matches do not overlap: the leftmost one wins, then the
+// longest, then the earliest rule. Within one alternation (same case mode
+// and anchoring) ECMAScript takes the first alternative that matches, so of
+// two expressions matching at the same column the earlier rule wins even
+// if its match is shorter. Backreferences in regular expressions are not
+// supported, their groups are renumbered in the alternation. The engine
+// does not change once built, so renderers on other threads may share it.
+// Throws std::runtime_error for an empty or invalid pattern.
+class HighlightEngine {
+ public:
+  explicit HighlightEngine(const std::vector<HighlightRule>& rules);
+
+  size_t GetRuleCount() const;
+
+  // Replaces spans with the matches in text, in order
+  void Match(const char32_t* text,
+             size_t length,
+             std::vector<HighlightSpan>& spans) const;
+
+  // attributes with the overrides of a rule
+  TextAttributes Apply(const TextAttributes& attributes, uint32_t rule) const;
+
+ private:
+  struct Node {
+    uint32_t first_edge;  // Into m_edges, sorted by code point
+    uint32_t edge_count;
+    uint32_t fail;     // Longest proper suffix that is also in the trie
+    uint32_t output;   // Nearest node on the fail chain ending a literal
+    uint32_t literal;  // First literal ending here, plus one, 0 - none
+  };
+
+  struct Edge {
+    char32_t codepoint;
+    uint32_t node;
+  };
+
+  struct Literal {
+    std::u32string text;  // As written, for case-sensitive rules
+    uint32_t rule;
+    uint32_t next;  // Next literal ending at the same node, plus one
+  };
+
+  // Alternation of the regular expression rules with one case mode, each
+  // in its own group
+  struct Alternation {
+    std::wregex regex;
+    std::vector<std::pair<size_t, uint32_t>> groups;  // Group, rule
+    bool anchored;
+  };
+
+  static bool IsAnchored(const std::string& pattern);
+
+  void BuildAutomaton(const std::vector<std::u32string>& folded);
+
+  void AddAlternation(const std::vector<uint32_t>& rules,
+                      bool ignore_case,
+                      bool anchored);
+
+  static void AddRegexMatch(const Alternation& alternation,
+                            const std::wsmatch& match,
+                            const std::vector<int>& columns,
+                            std::vector<HighlightSpan>& candidates);
+
+  // Node after node on codepoint
+  uint32_t Next(uint32_t node, char32_t codepoint) const;
+
+  void MatchLiterals(const char32_t* text,
+                     size_t length,
+                     std::vector<HighlightSpan>& candidates) const;
+
+  void MatchRegex(const char32_t* text,
+                  size_t length,
+                  std::vector<HighlightSpan>& candidates) const;
+
+  std::vector<HighlightRule> m_rules;
+  std::vector<Node> m_nodes;  // 0 - root
+  std::vector<Edge> m_edges;
+  std::vector<Literal> m_literals;
+  std::vector<Alternation> m_alternations;
+};
+
+}  // namespace MTerm
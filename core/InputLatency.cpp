@@ -0,0 +1,236 @@
+#include "InputLatency.h"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace MTerm {
+
+namespace {
+
+// Input that shows no echo for this long is given up, e.g. a key the
+// program ignores or a password prompt
+constexpr uint64_t kTimeoutNs = 1000000000;
+
+// Key presses in flight at once, more are not followed
+constexpr size_t kMaxInFlight = 256;
+
+// Percentiles are taken over the most recent samples
+constexpr size_t kMaxSamples = 10000;
+
+struct InFlight {
+  const void* source;
+  uint64_t input;
+  uint64_t send;
+  uint64_t echo = 0;
+  uint64_t applied = 0;
+};
+
+struct Sample {
+  uint64_t total;
+  uint64_t send;
+  uint64_t echo;
+  uint64_t apply;
+  uint64_t frame;
+};
+
+struct State {
+  std::atomic<bool> enabled{false};
+  std::atomic<uint64_t> lastInput{0};
+
+  std::mutex mutex;
+  std::deque<InFlight> inFlight;
+  std::vector<Sample> samples;  // Ring of kMaxSamples
+  size_t nextSample = 0;
+  uint64_t completed = 0;
+  uint64_t unanswered = 0;
+  uint64_t maxNs = 0;
+};
+
+// Never destroyed: hooks may run on threads that outlive static destructors
+State& GetState() {
+  static State* state = new State;
+  return *state;
+}
+
+// Gives up on stale input. Lock held.
+void Prune(State& state, uint64_t now) {
+  auto stale = [&](const InFlight& entry) {
+    return now - entry.input > kTimeoutNs;
+  };
+  size_t before = state.inFlight.size();
+  state.inFlight.erase(
+      std::remove_if(state.inFlight.begin(), state.inFlight.end(), stale),
+      state.inFlight.end());
+  state.unanswered += before - state.inFlight.size();
+}
+
+uint64_t Median(std::vector<uint64_t>& values) {
+  if (values.empty()) {
+    return 0;
+  }
+  auto middle = values.begin() + values.size() / 2;
+  std::nth_element(values.begin(), middle, values.end());
+  return *middle;
+}
+
+uint64_t Percentile(std::vector<uint64_t>& values, double share) {
+  if (values.empty()) {
+    return 0;
+  }
+  size_t index = std::min(values.size() - 1,
+                          static_cast<size_t>(share * values.size()));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+}  // namespace
+
+std::atomic<unsigned> InputLatency::s_awaiting{0};
+
+unsigned InputLatency::GetNextStage(uint64_t echo, uint64_t applied) {
+  return !echo ? kAwaitEcho : !applied ? kAwaitApply : kAwaitFrame;
+}
+
+void InputLatency::SetEnabled(bool enabled) {
+  State& state = GetState();
+  state.enabled = enabled;
+  if (!enabled) {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.lastInput = 0;
+    state.inFlight.clear();
+    s_awaiting = 0;
+  }
+}
+
+bool InputLatency::IsEnabled() {
+  return GetState().enabled.load(std::memory_order_relaxed);
+}
+
+void InputLatency::OnInput() {
+  State& state = GetState();
+  if (state.enabled.load(std::memory_order_relaxed)) {
+    state.lastInput.store(Instrumentation::Now(), std::memory_order_relaxed);
+  }
+}
+
+void InputLatency::OnSend(const void* source) {
+  State& state = GetState();
+  if (!state.enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  // Sends not caused by a key, e.g. replies to terminal queries, are not
+  // followed
+  uint64_t input = state.lastInput.exchange(0, std::memory_order_relaxed);
+  if (!input) {
+    return;
+  }
+  uint64_t now = Instrumentation::Now();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  Prune(state, now);
+  if (state.inFlight.size() < kMaxInFlight) {
+    state.inFlight.push_back({source, input, now});
+    s_awaiting.fetch_or(kAwaitEcho);
+  }
+}
+
+void InputLatency::MarkEcho(const void* source) {
+  State& state = GetState();
+  uint64_t now = Instrumentation::Now();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  Prune(state, now);
+  unsigned awaiting = 0;
+  for (InFlight& entry : state.inFlight) {
+    if (!entry.echo && entry.source == source) {
+      entry.echo = now;
+    }
+    awaiting |= GetNextStage(entry.echo, entry.applied);
+  }
+  s_awaiting = awaiting;
+}
+
+void InputLatency::MarkApplied(const void* source, uint64_t begin) {
+  State& state = GetState();
+  uint64_t now = Instrumentation::Now();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  Prune(state, now);
+  unsigned awaiting = 0;
+  for (InFlight& entry : state.inFlight) {
+    // A callback that began before the read cannot have seen the echo
+    if (entry.echo && !entry.applied && entry.source == source &&
+        entry.echo <= begin) {
+      entry.applied = now;
+    }
+    awaiting |= GetNextStage(entry.echo, entry.applied);
+  }
+  s_awaiting = awaiting;
+}
+
+void InputLatency::MarkPresented(uint64_t begin) {
+  State& state = GetState();
+  uint64_t now = Instrumentation::Now();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  Prune(state, now);
+  unsigned awaiting = 0;
+  for (auto it = state.inFlight.begin(); it != state.inFlight.end();) {
+    // The frame must have been recorded from the edited buffer
+    if (it->applied && it->applied <= begin) {
+      Sample sample = {now - it->input, it->send - it->input,
+                       it->echo - it->send, it->applied - it->echo,
+                       now - it->applied};
+      if (state.samples.size() < kMaxSamples) {
+        state.samples.push_back(sample);
+      } else {
+        state.samples[state.nextSample] = sample;
+      }
+      state.nextSample = (state.nextSample + 1) % kMaxSamples;
+      state.completed++;
+      state.maxNs = std::max(state.maxNs, sample.total);
+      it = state.inFlight.erase(it);
+      continue;
+    }
+    awaiting |= GetNextStage(it->echo, it->applied);
+    ++it;
+  }
+  s_awaiting = awaiting;
+}
+
+InputLatencyStats InputLatency::GetStats() {
+  State& state = GetState();
+  std::vector<uint64_t> total, send, echo, apply, frame;
+  InputLatencyStats stats = {};
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    Prune(state, Instrumentation::Now());
+    for (const Sample& sample : state.samples) {
+      total.push_back(sample.total);
+      send.push_back(sample.send);
+      echo.push_back(sample.echo);
+      apply.push_back(sample.apply);
+      frame.push_back(sample.frame);
+    }
+    stats.samples = state.completed;
+    stats.unanswered = state.unanswered;
+    stats.max_us = state.maxNs / 1000;
+  }
+  stats.p50_us = Percentile(total, 0.5) / 1000;
+  stats.p99_us = Percentile(total, 0.99) / 1000;
+  stats.send_us = Median(send) / 1000;
+  stats.echo_us = Median(echo) / 1000;
+  stats.apply_us = Median(apply) / 1000;
+  stats.frame_us = Median(frame) / 1000;
+  return stats;
+}
+
+void InputLatency::Reset() {
+  State& state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.samples.clear();
+  state.nextSample = 0;
+  state.completed = 0;
+  state.unanswered = 0;
+  state.maxNs = 0;
+}
+
+}  // namespace MTerm
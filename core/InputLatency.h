@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Instrumentation.h"
+
+namespace MTerm {
+
+struct InputLatencyStats {
+  uint64_t samples;     // Key presses followed to a presented frame
+  uint64_t unanswered;  // Sent, but no frame showed the echo within a second
+  // Key press to the first frame presented after the echo was applied
+  uint64_t p50_us;
+  uint64_t p99_us;
+  uint64_t max_us;
+  // Medians of the stages, in order
+  uint64_t send_us;   // Key press to PseudoConsole::Send()
+  uint64_t echo_us;   // Send() to the read that returned output
+  uint64_t apply_us;  // Read to the data callback returning, which parses
+                      // and edits the buffer
+  uint64_t frame_us;  // Callback to the frame being presented
+};
+
+// Follows key presses through the pipeline: the window event, the input
+// sent to a console, the first output read from that console afterwards
+// (the echo), the data callback that applies it, and the next frame that
+// started after that. Off by default; while off, or while nothing is in
+// flight, the hooks cost a relaxed load.
+//
+// Sources are the output rings of the consoles: Send() and the reads of
+// one console pass the same pointer, so output of other tabs is not taken
+// for the echo.
+class InputLatency {
+ public:
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+
+  // A key event; the next Send() is attributed to the latest one
+  static void OnInput();
+
+  static void OnSend(const void* source);
+
+  static void OnOutputRead(const void* source) {
+    if (s_awaiting.load(std::memory_order_relaxed) & kAwaitEcho) {
+      MarkEcho(source);
+    }
+  }
+
+  // Start of a data callback, pass to OnOutputApplied(). 0 when nothing
+  // waits for it.
+  static uint64_t BeginOutput() {
+    return (s_awaiting.load(std::memory_order_relaxed) & kAwaitApply)
+               ? Instrumentation::Now()
+               : 0;
+  }
+
+  static void OnOutputApplied(const void* source, uint64_t begin) {
+    if (begin) {
+      MarkApplied(source, begin);
+    }
+  }
+
+  // When a frame starts recording, pass to OnFramePresented()
+  static uint64_t BeginFrame() {
+    return (s_awaiting.load(std::memory_order_relaxed) & kAwaitFrame)
+               ? Instrumentation::Now()
+               : 0;
+  }
+
+  static void OnFramePresented(uint64_t begin) {
+    if (begin) {
+      MarkPresented(begin);
+    }
+  }
+
+  static InputLatencyStats GetStats();
+  static void Reset();
+
+ private:
+  static constexpr unsigned kAwaitEcho = 1;
+  static constexpr unsigned kAwaitApply = 2;
+  static constexpr unsigned kAwaitFrame = 4;
+
+  // The flag a key press in flight waits on
+  static unsigned GetNextStage(uint64_t echo, uint64_t applied);
+  static void MarkEcho(const void* source);
+  static void MarkApplied(const void* source, uint64_t begin);
+  static void MarkPresented(uint64_t begin);
+
+  static std::atomic<unsigned> s_awaiting;
+};
+
+}  // namespace MTerm
@@ -0,0 +1,375 @@
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+
+#include "Utils.h"
+
+namespace MTerm {
+
+namespace {
+
+constexpr unsigned kStatsFlag = 1;
+constexpr unsigned kTraceFlag = 2;
+
+constexpr size_t kProbeCount = static_cast<size_t>(Probe::Count);
+
+const char* const kProbeNames[] = {
+    "pty_read",
+    "pty_callback",
+    "gil_wait",
+    "parse",
+    "buffer_add_line",
+    "buffer_insert_lines",
+    "buffer_remove_lines",
+    "buffer_resize_lines",
+    "buffer_set_text",
+    "buffer_erase_in_line",
+    "buffer_set_color",
+    "render_record",
+    "render_present",
+};
+static_assert(std::size(kProbeNames) == kProbeCount);
+
+struct Counters {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> totalNs{0};
+  std::atomic<uint64_t> maxNs{0};
+  std::atomic<uint64_t> amount{0};
+  std::atomic<uint64_t> histogram[INSTRUMENTATION_BUCKETS] = {};
+};
+
+struct TraceEvent {
+  uint64_t start;
+  uint64_t duration;
+  uint64_t amount;
+  Probe probe;
+  uint32_t thread;
+};
+
+// Written only by its thread, read by snapshots
+struct ThreadBlock {
+  uint32_t id;
+  // Counters are from this Reset() generation
+  std::atomic<uint64_t> epoch{0};
+  Counters counters[kProbeCount];
+
+  std::mutex traceMutex;
+  uint64_t traceGeneration = 0;
+  std::vector<TraceEvent> trace;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<ThreadBlock*> blocks;
+  uint32_t nextThreadId = 1;
+
+  // Counters of threads that have exited
+  ProbeStats retired[kProbeCount] = {};
+
+  // Bumped by Reset() and StartTrace(), read on the probe path
+  std::atomic<uint64_t> epoch{1};
+  std::atomic<uint64_t> traceGeneration{1};
+
+  uint64_t traceStart = 0;
+  std::atomic<size_t> traceLimit{0};
+  std::atomic<size_t> traceEvents{0};
+  std::atomic<uint64_t> traceDropped{0};
+  std::vector<TraceEvent> retiredTrace;
+};
+
+// Never destroyed: threads may exit after static destructors have run
+Registry& GetRegistry() {
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+// Only the owning thread writes, so no read-modify-write is needed
+void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+int GetBucket(uint64_t duration) {
+  int bucket = std::bit_width(duration / INSTRUMENTATION_MIN_BUCKET_NS);
+  return std::min(bucket, INSTRUMENTATION_BUCKETS - 1);
+}
+
+void ClearCounters(ThreadBlock& block, uint64_t epoch) {
+  for (Counters& counters : block.counters) {
+    counters.calls.store(0, std::memory_order_relaxed);
+    counters.totalNs.store(0, std::memory_order_relaxed);
+    counters.maxNs.store(0, std::memory_order_relaxed);
+    counters.amount.store(0, std::memory_order_relaxed);
+    for (auto& bucket : counters.histogram) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+  block.epoch.store(epoch, std::memory_order_release);
+}
+
+void MergeCounters(const ThreadBlock& block, ProbeStats* totals) {
+  for (size_t i = 0; i < kProbeCount; i++) {
+    const Counters& counters = block.counters[i];
+    ProbeStats& stats = totals[i];
+    stats.calls += counters.calls.load(std::memory_order_relaxed);
+    stats.total_ns += counters.totalNs.load(std::memory_order_relaxed);
+    stats.max_ns = std::max(stats.max_ns,
+                            counters.maxNs.load(std::memory_order_relaxed));
+    stats.amount += counters.amount.load(std::memory_order_relaxed);
+    for (int j = 0; j < INSTRUMENTATION_BUCKETS; j++) {
+      stats.histogram[j] +=
+          counters.histogram[j].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// Moves the events of the current trace out of the block. Registry lock
+// held.
+void CollectTrace(ThreadBlock& block,
+                  uint64_t generation,
+                  std::vector<TraceEvent>& events) {
+  std::lock_guard<std::mutex> lock(block.traceMutex);
+  if (block.traceGeneration == generation) {
+    events.insert(events.end(), block.trace.begin(), block.trace.end());
+  }
+  block.trace.clear();
+  block.trace.shrink_to_fit();
+}
+
+void RetireBlock(ThreadBlock* block) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  if (block->epoch.load(std::memory_order_relaxed) ==
+      registry.epoch.load(std::memory_order_relaxed)) {
+    MergeCounters(*block, registry.retired);
+  }
+  CollectTrace(*block, registry.traceGeneration.load(), registry.retiredTrace);
+  registry.blocks.erase(
+      std::find(registry.blocks.begin(), registry.blocks.end(), block));
+  delete block;
+}
+
+struct ThreadSlot {
+  ThreadBlock* block = nullptr;
+
+  ~ThreadSlot() {
+    if (block) {
+      RetireBlock(block);
+    }
+  }
+};
+
+ThreadBlock& GetThreadBlock() {
+  thread_local ThreadSlot slot;
+  if (!slot.block) {
+    Registry& registry = GetRegistry();
+    auto block = new ThreadBlock;
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    block->id = registry.nextThreadId++;
+    block->epoch.store(registry.epoch.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+    registry.blocks.push_back(block);
+    slot.block = block;
+  }
+  return *slot.block;
+}
+
+FILE* OpenFile(const std::string& path) {
+#ifdef _WIN32
+  return _wfopen(Utils::Utf8ToWChar(path).c_str(), L"wb");
+#else
+  return fopen(path.c_str(), "wb");
+#endif
+}
+
+}  // namespace
+
+std::atomic<unsigned> Instrumentation::s_flags{0};
+
+void Instrumentation::SetEnabled(bool enabled) {
+  if (enabled) {
+    s_flags.fetch_or(kStatsFlag);
+  } else {
+    s_flags.fetch_and(~kStatsFlag);
+  }
+}
+
+bool Instrumentation::IsEnabled() {
+  return (s_flags.load() & kStatsFlag) != 0;
+}
+
+void Instrumentation::Record(Probe probe,
+                             uint64_t start,
+                             uint64_t end,
+                             uint64_t amount) {
+  unsigned flags = s_flags.load(std::memory_order_relaxed);
+  if (!flags) {
+    return;
+  }
+  Registry& registry = GetRegistry();
+  ThreadBlock& block = GetThreadBlock();
+  uint64_t duration = end - start;
+
+  if (flags & kStatsFlag) {
+    uint64_t epoch = registry.epoch.load(std::memory_order_relaxed);
+    if (block.epoch.load(std::memory_order_relaxed) != epoch) {
+      ClearCounters(block, epoch);
+    }
+    Counters& counters = block.counters[static_cast<size_t>(probe)];
+    Add(counters.calls, 1);
+    Add(counters.totalNs, duration);
+    Add(counters.amount, amount);
+    Add(counters.histogram[GetBucket(duration)], 1);
+    if (duration > counters.maxNs.load(std::memory_order_relaxed)) {
+      counters.maxNs.store(duration, std::memory_order_relaxed);
+    }
+  }
+
+  if (flags & kTraceFlag) {
+    if (registry.traceEvents.fetch_add(1, std::memory_order_relaxed) >=
+        registry.traceLimit.load(std::memory_order_relaxed)) {
+      registry.traceDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    uint64_t generation = registry.traceGeneration.load();
+    std::lock_guard<std::mutex> lock(block.traceMutex);
+    if (block.traceGeneration != generation) {
+      block.trace.clear();
+      block.traceGeneration = generation;
+    }
+    block.trace.push_back({start, duration, amount, probe, block.id});
+  }
+}
+
+const char* Instrumentation::GetProbeName(Probe probe) {
+  return kProbeNames[static_cast<size_t>(probe)];
+}
+
+std::vector<ProbeStats> Instrumentation::GetSnapshot() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::vector<ProbeStats> result(registry.retired,
+                                 registry.retired + kProbeCount);
+  uint64_t epoch = registry.epoch.load(std::memory_order_relaxed);
+  for (const ThreadBlock* block : registry.blocks) {
+    // A block from before the last Reset() is cleared by its next probe
+    if (block->epoch.load(std::memory_order_acquire) == epoch) {
+      MergeCounters(*block, result.data());
+    }
+  }
+  for (size_t i = 0; i < kProbeCount; i++) {
+    result[i].name = kProbeNames[i];
+  }
+  return result;
+}
+
+void Instrumentation::Reset() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.epoch.fetch_add(1);
+  std::fill(std::begin(registry.retired), std::end(registry.retired),
+            ProbeStats{});
+}
+
+uint64_t Instrumentation::GetBucketBound(int bucket) {
+  if (bucket >= INSTRUMENTATION_BUCKETS - 1) {
+    return 0;
+  }
+  return INSTRUMENTATION_MIN_BUCKET_NS << bucket;
+}
+
+uint64_t Instrumentation::GetPercentile(const ProbeStats& stats,
+                                        double share) {
+  uint64_t total = 0;
+  for (uint64_t count : stats.histogram) {
+    total += count;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t target = static_cast<uint64_t>(
+      std::ceil(std::clamp(share, 0.0, 1.0) * static_cast<double>(total)));
+  uint64_t seen = 0;
+  for (int i = 0; i < INSTRUMENTATION_BUCKETS; i++) {
+    seen += stats.histogram[i];
+    if (seen >= std::max<uint64_t>(target, 1)) {
+      uint64_t bound = GetBucketBound(i);
+      // The slowest call is a tighter bound for the top bucket
+      return bound == 0 ? stats.max_ns : std::min(bound, stats.max_ns);
+    }
+  }
+  return stats.max_ns;
+}
+
+void Instrumentation::StartTrace(size_t max_events) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  // Events of an earlier trace are dropped by the next probe of a thread
+  registry.traceGeneration.fetch_add(1);
+  registry.retiredTrace.clear();
+  registry.traceLimit = max_events;
+  registry.traceEvents = 0;
+  registry.traceDropped = 0;
+  registry.traceStart = Now();
+  s_flags.fetch_or(kTraceFlag);
+}
+
+bool Instrumentation::IsTracing() {
+  return (s_flags.load() & kTraceFlag) != 0;
+}
+
+bool Instrumentation::StopTrace(const std::string& path) {
+  s_flags.fetch_and(~kTraceFlag);
+
+  Registry& registry = GetRegistry();
+  std::vector<TraceEvent> events;
+  uint64_t start, dropped;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    events.swap(registry.retiredTrace);
+    uint64_t generation = registry.traceGeneration.load();
+    for (ThreadBlock* block : registry.blocks) {
+      CollectTrace(*block, generation, events);
+    }
+    // Nothing is recorded into this trace any more
+    registry.traceGeneration.fetch_add(1);
+    start = registry.traceStart;
+    dropped = registry.traceDropped.load();
+  }
+  std::sort(events.begin(), events.end(),
+            [](const TraceEvent& a, const TraceEvent& b) {
+              return a.start < b.start;
+            });
+
+  FILE* file = OpenFile(path);
+  if (!file) {
+    return false;
+  }
+  fprintf(file,
+          "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%" PRIu64
+          "},\"traceEvents\":[",
+          dropped);
+  bool first = true;
+  for (const TraceEvent& event : events) {
+    // Microseconds; a probe may have started before the trace
+    double ts = (static_cast<double>(event.start) - static_cast<double>(start)) /
+                1000.0;
+    fprintf(file,
+            "%s\n{\"name\":\"%s\",\"cat\":\"mterm\",\"ph\":\"X\",\"pid\":1,"
+            "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"amount\":%" PRIu64
+            "}}",
+            first ? "" : ",", GetProbeName(event.probe), event.thread, ts,
+            static_cast<double>(event.duration) / 1000.0, event.amount);
+    first = false;
+  }
+  fprintf(file, "\n]}\n");
+  bool ok = !ferror(file);
+  return fclose(file) == 0 && ok;
+}
+
+}  // namespace MTerm
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MTerm {
+
+// Places on the output path that are timed
+enum class Probe : uint8_t {
+  PtyRead,        // One read from the console, amount is bytes. On Windows
+                  // the time the overlapped read was pending.
+  PtyCallback,    // Output handed to the data callback, amount is bytes
+  GilWait,        // Acquiring the GIL before calling into Python
+  Parse,          // AnsiParser.feed() including the conversion of actions
+  BufferAddLine,
+  BufferInsertLines,  // Amount is lines
+  BufferRemoveLines,  // Amount is lines
+  BufferResizeLines,  // Amount is lines
+  BufferSetText,      // SetText() and WriteToLine(), amount is characters
+  BufferEraseInLine,
+  BufferSetColor,
+  RenderRecord,   // The render callback recording a frame
+  RenderPresent,  // Replaying a recorded frame on the backend
+  Count
+};
+
+// Latency buckets: the first holds durations below
+// INSTRUMENTATION_MIN_BUCKET_NS, each next one twice as long ones and the
+// last everything above
+constexpr int INSTRUMENTATION_BUCKETS = 26;
+constexpr uint64_t INSTRUMENTATION_MIN_BUCKET_NS = 128;
+
+struct ProbeStats {
+  const char* name;
+  uint64_t calls;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t amount;
+  uint64_t histogram[INSTRUMENTATION_BUCKETS];
+};
+
+// Counters and latency histograms of the probes, and a recorder of
+// individual calls for chrome://tracing. Off by default; while off a probe
+// costs a relaxed load. Every thread counts into its own block, which is
+// merged when a snapshot is taken or the thread exits, so probes on
+// different threads never share a cache line or a lock.
+class Instrumentation {
+ public:
+  static bool IsActive() {
+    return s_flags.load(std::memory_order_relaxed) != 0;
+  }
+
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+
+  static uint64_t Now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+
+  // Counts a call that ran from start to end (Now() values)
+  static void Record(Probe probe, uint64_t start, uint64_t end,
+                     uint64_t amount = 0);
+
+  static const char* GetProbeName(Probe probe);
+
+  // Totals of all threads since the last Reset(), one entry per probe
+  static std::vector<ProbeStats> GetSnapshot();
+
+  static void Reset();
+
+  // Exclusive upper bound of a bucket, 0 for the last one
+  static uint64_t GetBucketBound(int bucket);
+
+  // Estimate of the duration below which the given share (0..1) of the
+  // calls finished: the bound of the bucket it falls in
+  static uint64_t GetPercentile(const ProbeStats& stats, double share);
+
+  // Also records every call, up to max_events, until StopTrace()
+  static void StartTrace(size_t max_events = 1000000);
+  static bool IsTracing();
+
+  // Writes the calls in the Chrome trace_event JSON format. Path is UTF-8.
+  // False if the file could not be written; tracing stops either way.
+  static bool StopTrace(const std::string& path);
+
+ private:
+  static std::atomic<unsigned> s_flags;
+};
+
+// Times the enclosing scope
+class ScopedProbe {
+ public:
+  explicit ScopedProbe(Probe probe, uint64_t amount = 0)
+      : m_probe(probe),
+        m_amount(amount),
+        m_start(Instrumentation::IsActive() ? Instrumentation::Now() : 0) {}
+
+  ~ScopedProbe() {
+    if (m_start) {
+      Instrumentation::Record(m_probe, m_start, Instrumentation::Now(),
+                              m_amount);
+    }
+  }
+
+  ScopedProbe(const ScopedProbe&) = delete;
+  ScopedProbe& operator=(const ScopedProbe&) = delete;
+
+  void SetAmount(uint64_t amount) { m_amount = amount; }
+
+ private:
+  Probe m_probe;
+  uint64_t m_amount;
+  uint64_t m_start;
+};
+
+}  // namespace MTerm
@@ -0,0 +1,173 @@
+#include "LineRenderCache.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace MTerm {
+
+namespace {
+
+// Columns past the visible ones that highlight rules see, so that a match
+// running off the right edge is still found. Long lines cost no more.
+constexpr int kHighlightLookahead = 256;
+
+}  // namespace
+
+LineRenderCache::LineRenderCache(GlyphLookup glyph_lookup)
+    : m_glyphLookup(std::move(glyph_lookup)) {}
+
+std::shared_ptr<const PreparedLine> LineRenderCache::Prepare(
+    const ColoredTextBuffer& buffer,
+    size_t line_index,
+    int x_offset,
+    int max_chars) {
+  const ColoredLine& line = buffer.GetLine(line_index);
+  std::shared_ptr<PreparedLine>& prepared = m_lines[line.version];
+  if (!prepared) {
+    prepared = std::make_shared<PreparedLine>();
+  }
+  if (prepared->version == line.version && prepared->x_offset == x_offset &&
+      prepared->max_chars == max_chars && line.version != 0) {
+    m_hits++;
+  } else {
+    m_misses++;
+    if (prepared.use_count() > 1) {
+      prepared = std::make_shared<PreparedLine>();
+    }
+    prepared->version = line.version;
+    prepared->x_offset = x_offset;
+    prepared->max_chars = max_chars;
+    Build(*prepared, buffer, line);
+  }
+  if (prepared->last_frame != m_frame) {
+    prepared->last_frame = m_frame;
+    m_frameLines++;
+  }
+  return prepared;
+}
+
+void LineRenderCache::Build(PreparedLine& prepared,
+                            const ColoredTextBuffer& buffer,
+                            const ColoredLine& line) {
+  prepared.glyphs.clear();
+  prepared.runs.clear();
+  prepared.backgrounds.clear();
+
+  const auto& text = line.text;
+  const auto& fragments = line.fragments;
+  int text_size = static_cast<int>(text.size());
+  int x_offset = prepared.x_offset;
+  if (fragments.empty() || x_offset >= text_size) {
+    return;
+  }
+
+  // Last fragment that starts at or before the first visible column
+  auto it = std::upper_bound(
+      fragments.begin(), fragments.end(), x_offset,
+      [](int pos, const LineFragment& frag) { return pos < frag.pos; });
+  if (it != fragments.begin()) {
+    --it;
+  }
+
+  int visible_end = std::min(text_size, x_offset + prepared.max_chars);
+  m_spans.clear();
+  if (m_highlighter) {
+    // From the start of the line, matches may begin before the first
+    // visible column
+    m_highlighter->Match(text.data(),
+                         std::min(text_size, visible_end + kHighlightLookahead),
+                         m_spans);
+  }
+  auto span = m_spans.begin();
+  for (; it != fragments.end(); ++it) {
+    int start = std::max(it->pos, x_offset);
+    auto next = std::next(it);
+    int end = std::min(next != fragments.end() ? next->pos : text_size,
+                       visible_end);
+    if (start >= visible_end) {
+      break;
+    }
+    if (end <= start) {
+      continue;
+    }
+
+    const TextAttributes& attributes = buffer.GetAttributes(it->attr);
+    while (start < end) {
+      while (span != m_spans.end() && span->end <= start) {
+        ++span;
+      }
+      if (span == m_spans.end() || span->start >= end) {
+        AddRun(prepared, text, start, end, attributes);
+        break;
+      }
+      if (span->start > start) {
+        AddRun(prepared, text, start, span->start, attributes);
+        start = span->start;
+      }
+      int span_end = std::min(end, span->end);
+      AddRun(prepared, text, start, span_end,
+             m_highlighter->Apply(attributes, span->rule));
+      start = span_end;
+    }
+  }
+}
+
+void LineRenderCache::AddRun(PreparedLine& prepared,
+                             const std::vector<char32_t>& text,
+                             int start,
+                             int end,
+                             const TextAttributes& attributes) {
+  GlyphRun run;
+  run.column = start - prepared.x_offset;
+  run.length = end - start;
+  run.glyph_offset = static_cast<uint32_t>(prepared.glyphs.size());
+  run.attributes = attributes;
+  for (int i = start; i < end; i++) {
+    prepared.glyphs.push_back(m_glyphLookup(text[i]));
+  }
+  prepared.runs.push_back(run);
+
+  int background = run.attributes.background_color;
+  if (background == COLOR_DEFAULT) {
+    return;
+  }
+  auto& spans = prepared.backgrounds;
+  if (!spans.empty() && spans.back().color == background &&
+      spans.back().column + spans.back().length == run.column) {
+    spans.back().length += run.length;
+  } else {
+    spans.push_back({run.column, run.length, background});
+  }
+}
+
+void LineRenderCache::EndFrame() {
+  if (m_lines.size() > 2 * m_frameLines) {
+    for (auto it = m_lines.begin(); it != m_lines.end();) {
+      if (it->second->last_frame != m_frame) {
+        it = m_lines.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  m_frame++;
+  m_frameLines = 0;
+}
+
+void LineRenderCache::Clear() {
+  m_lines.clear();
+  m_frameLines = 0;
+}
+
+void LineRenderCache::SetHighlighter(
+    std::shared_ptr<const HighlightEngine> highlighter) {
+  m_highlighter = std::move(highlighter);
+  Clear();
+}
+
+RenderCacheStats LineRenderCache::GetStats() const {
+  return {m_lines.size(), m_hits, m_misses};
+}
+
+}  // namespace MTerm
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "AttributeTable.h"
+#include "ColoredTextBuffer.h"
+#include "HighlightEngine.h"
+
+namespace MTerm {
+
+// Columns are relative to the first visible column. Attributes are stored
+// by value: ids change when the buffer compacts its table, and palette
+// colors are resolved by the renderer at draw time.
+struct GlyphRun {
+  int column;
+  int length;
+  uint32_t glyph_offset;  // Into PreparedLine::glyphs
+  TextAttributes attributes;
+};
+
+// Adjacent runs with the same background merged into one rectangle
+struct BackgroundSpan {
+  int column;
+  int length;
+  int color;
+};
+
+struct PreparedLine {
+  uint64_t version = 0;
+  int x_offset = 0;
+  int max_chars = 0;
+  uint64_t last_frame = 0;
+  std::vector<uint16_t> glyphs;
+  std::vector<GlyphRun> runs;
+  std::vector<BackgroundSpan> backgrounds;
+};
+
+struct RenderCacheStats {
+  size_t lines;
+  uint64_t hits;
+  uint64_t misses;
+};
+
+// Glyph indices and runs of visible lines, kept between frames and rebuilt
+// only when the line version or the visible column range changes. Line
+// versions are unique across buffers, so one cache serves all of them.
+// Highlight rules are matched when a line is built, so only visible lines
+// pay for them, once per version.
+// Independent of the graphics API: glyph lookup is supplied by the renderer.
+class LineRenderCache {
+ public:
+  using GlyphLookup = std::function<uint16_t(char32_t)>;
+
+  explicit LineRenderCache(GlyphLookup glyph_lookup);
+
+  // Shared so that a recorded frame can hold on to the line after the cache
+  // dropped it. Lines are never modified while someone else holds them.
+  std::shared_ptr<const PreparedLine> Prepare(const ColoredTextBuffer& buffer,
+                              size_t line_index,
+                              int x_offset,
+                              int max_chars);
+
+  // Drops lines that were not drawn in the frame once the cache holds more
+  // than twice the lines that were
+  void EndFrame();
+
+  // Glyph indices depend on the font, call after changing it
+  void Clear();
+
+  // nullptr - no highlighting. Clears the cache.
+  void SetHighlighter(std::shared_ptr<const HighlightEngine> highlighter);
+
+  RenderCacheStats GetStats() const;
+
+ private:
+  void Build(PreparedLine& prepared, const ColoredTextBuffer& buffer,
+             const ColoredLine& line);
+
+  // Columns [start, end) of text, absolute
+  void AddRun(PreparedLine& prepared,
+              const std::vector<char32_t>& text,
+              int start,
+              int end,
+              const TextAttributes& attributes);
+
+  GlyphLookup m_glyphLookup;
+  std::shared_ptr<const HighlightEngine> m_highlighter;
+  std::vector<HighlightSpan> m_spans;
+  // By line version
+  std::unordered_map<uint64_t, std::shared_ptr<PreparedLine>> m_lines;
+  uint64_t m_frame = 1;
+  size_t m_frameLines = 0;
+  uint64_t m_hits = 0;
+  uint64_t m_misses = 0;
+};
+
+}  // namespace MTerm
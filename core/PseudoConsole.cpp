@@ -2,15 +2,76 @@
 
 #include <cassert>
 
+#ifdef _WIN32
 #include "Windows.h"
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <exception>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "ByteRing.h"
+#include "InputLatency.h"
+#include "Instrumentation.h"
+#include "PtyReactor.h"
+#include "PtyRecording.h"
+#include "Utils.h"
+
+#ifndef _WIN32
+extern char** environ;
+#endif
+
 namespace MTerm {
 
+#ifdef _WIN32
+
+namespace {
+
+// Quotes an argument the way CommandLineToArgvW splits it back
+std::wstring QuoteArgument(const std::wstring& arg) {
+  if (!arg.empty() &&
+      arg.find_first_of(L" \t\n\v\"") == std::wstring::npos) {
+    return arg;
+  }
+  std::wstring quoted = L"\"";
+  size_t backslashes = 0;
+  for (wchar_t c : arg) {
+    if (c == L'\\') {
+      backslashes++;
+      continue;
+    }
+    // Backslashes are literal unless they precede a quote
+    quoted.append(c == L'"' ? backslashes * 2 + 1 : backslashes, L'\\');
+    quoted += c;
+    backslashes = 0;
+  }
+  quoted.append(backslashes * 2, L'\\');
+  quoted += L'"';
+  return quoted;
+}
+
+}  // namespace
+
 class PseudoConsole::Impl {
  private:
   HANDLE m_hInput = INVALID_HANDLE_VALUE;
@@ -18,24 +79,73 @@ class PseudoConsole::Impl {
   HPCON m_hPseudoConsole = nullptr;
   PROCESS_INFORMATION m_processInfo{};
 
+  // Threadpool reads land directly in the ring; the consumer thread drains
+  // it. A full ring postpones the next read until the consumer frees space.
+  // The consumer thread shares its ownership, so a callback may destroy the
+  // console: the thread then ends on its own once the callback returns.
   struct PtyReadBuffer {
+    std::function<void(const char*, unsigned int)> onData;
     OVERLAPPED ovl{};
     HANDLE hPipe = INVALID_HANDLE_VALUE;
-    std::unique_ptr<char[]> buffer;
+    ByteRing ring{PTY_RING_SIZE};
+    HANDLE dataEvent = nullptr;
     PTP_IO io = nullptr;
     PTP_TIMER timer = nullptr;
-    std::function<void(const char*, DWORD)> onData;
+    std::atomic<bool> stalled = false;
+    std::atomic<bool> finished = false;
+    std::atomic<bool> stopping = false;
+    std::atomic<uint64_t> stalls = 0;
+    std::atomic<uint64_t> batches = 0;
+    std::vector<char> staging;
+    uint64_t readStart = 0;  // When the pending read was issued, for probes
+
+    ~PtyReadBuffer() {
+      if (dataEvent)
+        CloseHandle(dataEvent);
+    }
   };
 
-  std::unique_ptr<PtyReadBuffer> m_readBuffer = nullptr;
+  std::shared_ptr<PtyReadBuffer> m_readBuffer = nullptr;
+
+  // Queued input is written by threadpool work, one overlapped write at a
+  // time, so that Close() can cancel a write the child does not take
+  mutable std::mutex m_writeMutex;
+  PtyWriteQueue m_writes;
+  PTP_WORK m_writeWork = nullptr;
+  HANDLE m_writeEvent = nullptr;
+  OVERLAPPED m_writeOvl{};
+  bool m_writeScheduled = false;  // Under m_writeMutex
+  bool m_writeClosed = false;     // Under m_writeMutex
 
   short m_numRows = 24;
   short m_numColumns = 80;
   std::function<void(const char*, unsigned int)> m_onData;
 
+  std::thread m_consumerThread;
+  uint64_t m_droppedBytes = 0;
+
+  std::vector<std::string> m_command;
+  std::vector<std::string> m_environment;
+
+  std::shared_ptr<PtyReactor> m_reactor;
+  uint64_t m_session = 0;
+  PtyRingStats m_closedStats{};
+  PtyWriteStats m_closedWriteStats{};
+
  public:
+  explicit Impl(std::shared_ptr<PtyReactor> reactor)
+      : m_reactor(std::move(reactor)) {}
+
   ~Impl() { Close(); }
 
+  void SetCommand(std::vector<std::string> argv) {
+    m_command = std::move(argv);
+  }
+
+  void SetEnvironment(std::vector<std::string> environment) {
+    m_environment = std::move(environment);
+  }
+
   bool Start(short num_rows,
              short num_columns,
              std::function<void(const char*, unsigned int)> on_data_callback) {
@@ -60,9 +170,17 @@ class PseudoConsole::Impl {
         CreateFileW(pipeName, GENERIC_WRITE, 0, &sa, OPEN_EXISTING, 0, nullptr);
     assert(hPipePTYOutWrite != INVALID_HANDLE_VALUE);
 
-    // --- Создаём обычный пайп для ввода PTY (можно без OVERLAPPED) ---
-    HANDLE hPipePTYInRead = nullptr, hPipePTYInWrite = nullptr;
-    BOOL ok = CreatePipe(&hPipePTYInRead, &hPipePTYInWrite, &sa, 0);
+    // --- Именованный пайп для ввода PTY (запись асинхронная, OVERLAPPED) ---
+    wchar_t inPipeName[64];
+    swprintf_s(inPipeName, L"\\\\.\\pipe\\pty_in_%p", this);
+    HANDLE hPipePTYInWrite = CreateNamedPipeW(
+        inPipeName, PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED,
+        PIPE_TYPE_BYTE | PIPE_WAIT, 1, PTY_BUFFER_SIZE, PTY_BUFFER_SIZE, 0,
+        nullptr);
+    HANDLE hPipePTYInRead = CreateFileW(inPipeName, GENERIC_READ, 0, &sa,
+                                        OPEN_EXISTING, 0, nullptr);
+    BOOL ok = hPipePTYInWrite != INVALID_HANDLE_VALUE &&
+              hPipePTYInRead != INVALID_HANDLE_VALUE;
     assert(ok);
 
     HRESULT hr = CreatePseudoConsole({m_numColumns, m_numRows}, hPipePTYInRead,
@@ -84,10 +202,27 @@ class PseudoConsole::Impl {
         m_hPseudoConsole, sizeof(m_hPseudoConsole), nullptr, nullptr);
 
     std::wstring cmd = L"pwsh.exe -NoLogo";
+    if (!m_command.empty()) {
+      cmd.clear();
+      for (const std::string& arg : m_command) {
+        if (!cmd.empty()) {
+          cmd += L' ';
+        }
+        cmd += QuoteArgument(Utils::Utf8ToWChar(arg));
+      }
+    }
+    // NAME=value\0...\0\0, or inherit ours when empty
+    std::wstring environment;
+    for (const std::string& entry : m_environment) {
+      environment += Utils::Utf8ToWChar(entry);
+      environment += L'\0';
+    }
+    environment += L'\0';
     ok = CreateProcessW(
         nullptr, &cmd[0], nullptr, nullptr, FALSE,
-        EXTENDED_STARTUPINFO_PRESENT | CREATE_UNICODE_ENVIRONMENT | CREATE_NEW_PROCESS_GROUP, nullptr,
-        nullptr, &si.StartupInfo, &m_processInfo);
+        EXTENDED_STARTUPINFO_PRESENT | CREATE_UNICODE_ENVIRONMENT | CREATE_NEW_PROCESS_GROUP,
+        m_environment.empty() ? nullptr : &environment[0], nullptr,
+        &si.StartupInfo, &m_processInfo);
     assert(ok);
 
     DeleteProcThreadAttributeList(si.lpAttributeList);
@@ -95,17 +230,52 @@ class PseudoConsole::Impl {
     m_hInput = hPipePTYInWrite;
     m_hOutput = hPipePTYOutRead;
 
+    if (m_reactor) {
+      m_session = m_reactor->AddSession(m_hInput, m_hOutput, m_onData);
+      m_reactor->StartSession(m_session);
+      return true;
+    }
+
     // --- Асинхронное чтение из PTY ---
-    m_readBuffer = std::make_unique<PtyReadBuffer>();
-    InitPtyRead(m_readBuffer.get(), m_hOutput, m_onData);
+    m_readBuffer = std::make_shared<PtyReadBuffer>();
+    m_readBuffer->onData = m_onData;
+    InitPtyRead(m_readBuffer.get(), m_hOutput);
+    m_consumerThread = std::thread(&Impl::ConsumerThread, m_readBuffer);
     ScheduleRead(m_readBuffer.get());
 
+    // --- Асинхронная запись в PTY ---
+    m_writeEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    m_writeWork = CreateThreadpoolWork(WriteCallback, this, nullptr);
+    m_writeClosed = false;
+
     return true;
   }
 
   bool Send(const char* data, unsigned int length) {
-    DWORD written;
-    return WriteFile(m_hInput, data, length, &written, nullptr);
+    if (m_session) {
+      return m_reactor->Send(m_session, data, length);
+    }
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    if (!m_writeWork || m_writeClosed) {
+      return false;
+    }
+    InputLatency::OnSend(&m_readBuffer->ring);
+    m_writes.Send(data, length);
+    ScheduleWrite();
+    return true;
+  }
+
+  bool Paste(const char* data, size_t length, bool bracketed) {
+    if (m_session) {
+      return m_reactor->Paste(m_session, data, length, bracketed);
+    }
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    if (!m_writeWork || m_writeClosed) {
+      return false;
+    }
+    m_writes.Paste(data, length, bracketed);
+    ScheduleWrite();
+    return true;
   }
 
   void Resize(short num_rows, short num_columns) {
@@ -119,7 +289,16 @@ class PseudoConsole::Impl {
     }
   }
 
+  uint64_t GetSessionId() const { return m_session; }
+
   void Close() {
+    if (m_session) {
+      m_closedWriteStats = m_reactor->GetWriteStats(m_session);
+      m_closedStats = m_reactor->RemoveSession(m_session);
+      m_session = 0;
+    }
+    StopWriter();
+    StopConsumer();
     if (m_readBuffer) {
       /*if (m_readBuffer->io)
         CloseThreadpoolIo(m_readBuffer->io);
@@ -142,6 +321,151 @@ class PseudoConsole::Impl {
       CloseHandle(m_processInfo.hThread);
   }
 
+  PtyRingStats GetRingStats() const {
+    if (m_reactor) {
+      return m_session ? m_reactor->GetRingStats(m_session) : m_closedStats;
+    }
+    PtyRingStats stats{};
+    stats.capacity = PTY_RING_SIZE;
+    if (m_readBuffer) {
+      const ByteRing& ring = m_readBuffer->ring;
+      stats.capacity = ring.GetCapacity();
+      stats.size = ring.GetSize();
+      stats.peak_size = ring.GetPeakSize();
+      stats.bytes_read = ring.GetTotalWritten();
+      stats.stalls = m_readBuffer->stalls.load(std::memory_order_relaxed);
+      stats.batches = m_readBuffer->batches.load(std::memory_order_relaxed);
+    }
+    stats.dropped_bytes = m_droppedBytes;
+    return stats;
+  }
+
+  PtyWriteStats GetWriteStats() const {
+    if (m_reactor) {
+      return m_session ? m_reactor->GetWriteStats(m_session)
+                       : m_closedWriteStats;
+    }
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    return m_writes.GetStats();
+  }
+
+  // Under m_writeMutex
+  void ScheduleWrite() {
+    if (!m_writeScheduled) {
+      m_writeScheduled = true;
+      SubmitThreadpoolWork(m_writeWork);
+    }
+  }
+
+  static void CALLBACK WriteCallback(PTP_CALLBACK_INSTANCE,
+                                     void* context,
+                                     PTP_WORK) {
+    static_cast<Impl*>(context)->FlushWrites();
+  }
+
+  void FlushWrites() {
+    std::unique_lock<std::mutex> lock(m_writeMutex);
+    while (!m_writeClosed && m_writes.HasChunk()) {
+      const std::string& chunk = m_writes.Take();
+      // Issued under the lock, so that Close() either cancels the write or
+      // stops the loop before it
+      m_writeOvl = {};
+      m_writeOvl.hEvent = m_writeEvent;
+      BOOL ok = WriteFile(m_hInput, chunk.data(),
+                          static_cast<DWORD>(chunk.size()), nullptr,
+                          &m_writeOvl);
+      DWORD written = 0;
+      if (ok || GetLastError() == ERROR_IO_PENDING) {
+        lock.unlock();
+        // Waits while the child is not reading its input
+        ok = GetOverlappedResult(m_hInput, &m_writeOvl, &written, TRUE);
+        lock.lock();
+      }
+      m_writes.Complete(written);
+      if (!ok) {
+        // Cancelled, or the console is gone
+        m_writes.Clear();
+      }
+    }
+    m_writeScheduled = false;
+  }
+
+  void StopWriter() {
+    if (!m_writeWork) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      m_writeClosed = true;
+      m_writes.Clear();
+      CancelIoEx(m_hInput, nullptr);
+    }
+    WaitForThreadpoolWorkCallbacks(m_writeWork, TRUE);
+    CloseThreadpoolWork(m_writeWork);
+    CloseHandle(m_writeEvent);
+    m_writeWork = nullptr;
+    m_writeEvent = nullptr;
+  }
+
+  static void ConsumerThread(std::shared_ptr<PtyReadBuffer> buf) {
+    while (!buf->stopping) {
+      WaitForSingleObject(buf->dataEvent, INFINITE);
+      if (buf->stopping) {
+        break;
+      }
+      Drain(buf.get());
+      if (buf->finished && buf->ring.GetSize() == 0) {
+        break;
+      }
+    }
+  }
+
+  // Hands everything that is currently in the ring to the callback at once,
+  // so a burst of small reads costs a single callback (and GIL acquisition)
+  static void Drain(PtyReadBuffer* buf) {
+    size_t size = buf->ring.GetSize();
+    if (size == 0) {
+      return;
+    }
+    size_t region_size;
+    const char* region = buf->ring.GetReadRegion(&region_size);
+    if (region_size < size) {
+      // Data wraps around the end of the ring
+      buf->staging.resize(size);
+      buf->ring.Peek(buf->staging.data(), size);
+      region = buf->staging.data();
+    }
+    uint64_t begin = InputLatency::BeginOutput();
+    {
+      ScopedProbe probe(Probe::PtyCallback, size);
+      buf->onData(region, static_cast<unsigned int>(size));
+    }
+    InputLatency::OnOutputApplied(&buf->ring, begin);
+    buf->ring.CommitRead(size);
+    buf->batches.fetch_add(1, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (buf->stalled.exchange(false)) {
+      ScheduleRead(buf);
+    }
+  }
+
+  void StopConsumer() {
+    if (!m_consumerThread.joinable()) {
+      return;
+    }
+    m_readBuffer->stopping = true;
+    SetEvent(m_readBuffer->dataEvent);
+    if (m_consumerThread.get_id() == std::this_thread::get_id()) {
+      // Closed from inside the data callback, the thread ends as soon as
+      // the callback returns
+      m_consumerThread.detach();
+    } else {
+      m_consumerThread.join();
+    }
+    m_droppedBytes = m_readBuffer->ring.GetSize();
+  }
+
   static void CALLBACK ReadCompleteCallback(PTP_CALLBACK_INSTANCE,
                                             void* context,
                                             void* /*overlapped*/,
@@ -152,18 +476,41 @@ class PseudoConsole::Impl {
     if (ioResult == ERROR_OPERATION_ABORTED) {
       CloseThreadpoolTimer(buf->timer);
       CloseThreadpoolIo(buf->io);
+      buf->finished = true;
+      SetEvent(buf->dataEvent);
       return;
     }
     bool eof = (ioResult == ERROR_HANDLE_EOF || ioResult == ERROR_BROKEN_PIPE);
     if (bytesTransferred > 0) {
-      buf->onData(buf->buffer.get(), (DWORD)bytesTransferred);
+      if (buf->readStart) {
+        Instrumentation::Record(Probe::PtyRead, buf->readStart,
+                                Instrumentation::Now(), bytesTransferred);
+      }
+      InputLatency::OnOutputRead(&buf->ring);
+      buf->ring.CommitWrite(bytesTransferred);
     }
     if (eof) {
       CloseThreadpoolTimer(buf->timer);
       CloseThreadpoolIo(buf->io);
+      buf->finished = true;
     } else {
-      ScheduleRead(buf);
+      ScheduleNextRead(buf);
+    }
+    SetEvent(buf->dataEvent);
+  }
+
+  static void ScheduleNextRead(PtyReadBuffer* buf) {
+    if (buf->ring.GetFreeSize() == 0) {
+      // Backpressure: leave the data in the pipe until the consumer catches up
+      buf->stalls.fetch_add(1, std::memory_order_relaxed);
+      buf->stalled = true;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      // The consumer may have freed space before it could see the flag
+      if (buf->ring.GetFreeSize() == 0 || !buf->stalled.exchange(false)) {
+        return;
+      }
     }
+    ScheduleRead(buf);
   }
 
   static void CALLBACK RetryTimerCallback(PTP_CALLBACK_INSTANCE,
@@ -173,10 +520,21 @@ class PseudoConsole::Impl {
   }
 
   static void ScheduleRead(PtyReadBuffer* buf) {
+    if (buf->stopping) {
+      // Closed, possibly by the data callback, along with the pipe
+      return;
+    }
+    size_t size;
+    char* region = buf->ring.GetWriteRegion(&size);
+    if (size > PTY_BUFFER_SIZE) {
+      size = PTY_BUFFER_SIZE;
+    }
     while (true) {
+      buf->readStart =
+          Instrumentation::IsActive() ? Instrumentation::Now() : 0;
       StartThreadpoolIo(buf->io);
-      BOOL ok = ReadFile(buf->hPipe, buf->buffer.get(), PTY_BUFFER_SIZE,
-                         nullptr, &buf->ovl);
+      BOOL ok = ReadFile(buf->hPipe, region, static_cast<DWORD>(size), nullptr,
+                         &buf->ovl);
       if (ok || GetLastError() == ERROR_IO_PENDING) {
         // Успешно инициировано асинхронное чтение
         return;
@@ -192,39 +550,642 @@ class PseudoConsole::Impl {
     }
   }
 
-  static void InitPtyRead(PtyReadBuffer* buf,
-                          HANDLE hPipe,
-                          std::function<void(const char*, DWORD)> cb) {
+  static void InitPtyRead(PtyReadBuffer* buf, HANDLE hPipe) {
     buf->hPipe = hPipe;
-    buf->buffer = std::make_unique<char[]>(PTY_BUFFER_SIZE);
-    buf->onData = std::move(cb);
+    buf->dataEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
     buf->io = CreateThreadpoolIo(hPipe, ReadCompleteCallback, buf, nullptr);
     buf->timer = CreateThreadpoolTimer(RetryTimerCallback, buf, nullptr);
   }
 };
 
-PseudoConsole::PseudoConsole() : m_impl(std::make_unique<Impl>()) {}
+#else
+
+class PseudoConsole::Impl {
+ private:
+  int m_master = -1;
+  pid_t m_pid = -1;
+  int m_epoll = -1;
+  // Wakes the I/O thread to stop, to write or to resume after a stall
+  int m_wakeFd = -1;
+
+  // What the consumer thread uses. The thread shares its ownership, so a
+  // callback may destroy the console: the thread then ends on its own once
+  // the callback returns.
+  struct Consumer {
+    std::function<void(const char*, unsigned int)> onData;
+    ByteRing ring{PTY_RING_SIZE};
+    int wakeFd = -1;
+    std::mutex dataMutex;
+    std::condition_variable dataCv;
+    bool dataReady = false;  // Under dataMutex
+    std::atomic<bool> stopping = false;
+    std::atomic<bool> stalled = false;
+    std::atomic<bool> finished = false;
+    std::vector<char> staging;
+    std::atomic<uint64_t> batches = 0;
+  };
+
+  // The I/O thread reads the non-blocking master side straight into the
+  // ring whenever epoll reports it readable; the consumer thread drains it.
+  // A full ring stops reading until the consumer frees space. The same
+  // thread writes the queued input when the master is writable.
+  std::shared_ptr<Consumer> m_consumer;
+  std::thread m_readerThread;
+  uint32_t m_events = 0;   // Registered with epoll
+  bool m_readable = true;  // Cleared while stalled
+  std::atomic<uint64_t> m_stalls = 0;
+
+  mutable std::mutex m_writeMutex;
+  PtyWriteQueue m_writes;
+
+  short m_numRows = 24;
+  short m_numColumns = 80;
+  std::function<void(const char*, unsigned int)> m_onData;
+
+  std::thread m_consumerThread;
+  uint64_t m_batches = 0;  // Of the consumers that have ended
+  uint64_t m_droppedBytes = 0;
+
+  std::vector<std::string> m_command;
+  std::vector<std::string> m_environment;
+
+  std::shared_ptr<PtyReactor> m_reactor;
+  uint64_t m_session = 0;
+  PtyRingStats m_closedStats{};
+  PtyWriteStats m_closedWriteStats{};
+
+ public:
+  explicit Impl(std::shared_ptr<PtyReactor> reactor)
+      : m_reactor(std::move(reactor)) {}
+
+  ~Impl() { Close(); }
+
+  void SetCommand(std::vector<std::string> argv) {
+    m_command = std::move(argv);
+  }
+
+  void SetEnvironment(std::vector<std::string> environment) {
+    m_environment = std::move(environment);
+  }
+
+  bool Start(short num_rows,
+             short num_columns,
+             std::function<void(const char*, unsigned int)> on_data_callback) {
+    if (m_master >= 0) {
+      return false;
+    }
+    StopConsumer();
+    m_numRows = num_rows;
+    m_numColumns = num_columns;
+    m_onData = std::move(on_data_callback);
+
+    std::vector<std::string> command = m_command;
+    if (command.empty()) {
+      const char* shell = getenv("SHELL");
+      command.push_back(shell && *shell ? shell : "/bin/sh");
+    }
+    // Everything the child needs is prepared before fork(), after it only
+    // async-signal-safe calls are allowed
+    std::vector<char*> argv;
+    for (std::string& arg : command) {
+      argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+    std::vector<std::string> environment = m_environment;
+    std::vector<char*> envp;
+    for (std::string& entry : environment) {
+      envp.push_back(entry.data());
+    }
+    envp.push_back(nullptr);
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0) {
+      return false;
+    }
+    char slave_name[128];
+    winsize size{};
+    size.ws_row = static_cast<unsigned short>(num_rows);
+    size.ws_col = static_cast<unsigned short>(num_columns);
+    int slave = -1;
+    if (grantpt(master) == 0 && unlockpt(master) == 0 &&
+        ptsname_r(master, slave_name, sizeof(slave_name)) == 0) {
+      // Keeping the slave open until the child has it prevents the master
+      // from reporting a hangup before the child starts
+      slave = open(slave_name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    }
+    if (slave < 0 || ioctl(master, TIOCSWINSZ, &size) < 0) {
+      if (slave >= 0) {
+        close(slave);
+      }
+      close(master);
+      return false;
+    }
+    fcntl(master, F_SETFD, FD_CLOEXEC);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      setsid();
+      ioctl(slave, TIOCSCTTY, 0);
+      dup2(slave, STDIN_FILENO);
+      dup2(slave, STDOUT_FILENO);
+      dup2(slave, STDERR_FILENO);
+      // Python ignores SIGPIPE and the mask may block signals, both would
+      // be inherited by the shell
+      signal(SIGPIPE, SIG_DFL);
+      sigset_t mask;
+      sigemptyset(&mask);
+      sigprocmask(SIG_SETMASK, &mask, nullptr);
+      if (!environment.empty()) {
+        environ = envp.data();
+      }
+      execvp(argv[0], argv.data());
+      _exit(127);
+    }
+    close(slave);
+    if (pid < 0) {
+      close(master);
+      return false;
+    }
+    m_master = master;
+    m_pid = pid;
+
+    if (m_reactor) {
+      m_session = m_reactor->AddSession(master, master, m_onData);
+      m_reactor->StartSession(m_session);
+      return true;
+    }
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeFd;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeFd, &event);
+    m_events = 0;
+    m_readable = true;
+    UpdateEvents();
+
+    if (m_consumer) {
+      m_batches += m_consumer->batches.load(std::memory_order_relaxed);
+    }
+    m_consumer = std::make_shared<Consumer>();
+    m_consumer->onData = m_onData;
+    m_consumer->wakeFd = m_wakeFd;
+    m_consumerThread = std::thread(&Impl::ConsumerThread, m_consumer);
+    {
+      // Data reaches the consumer under this lock, so a callback that
+      // closes the console sees the reader thread it has to join
+      std::lock_guard<std::mutex> lock(m_consumer->dataMutex);
+      m_readerThread = std::thread(&Impl::ReaderThread, this);
+    }
+    return true;
+  }
+
+  bool Send(const char* data, unsigned int length) {
+    if (m_master < 0) {
+      return false;
+    }
+    if (m_session) {
+      return m_reactor->Send(m_session, data, length);
+    }
+    if (m_consumer->finished) {
+      return false;
+    }
+    InputLatency::OnSend(&m_consumer->ring);
+    bool was_empty;
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      was_empty = m_writes.IsEmpty();
+      m_writes.Send(data, length);
+    }
+    if (was_empty) {
+      WakeReader();
+    }
+    return true;
+  }
+
+  bool Paste(const char* data, size_t length, bool bracketed) {
+    if (m_master < 0) {
+      return false;
+    }
+    if (m_session) {
+      return m_reactor->Paste(m_session, data, length, bracketed);
+    }
+    if (m_consumer->finished) {
+      return false;
+    }
+    bool was_empty;
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      was_empty = m_writes.IsEmpty();
+      m_writes.Paste(data, length, bracketed);
+    }
+    if (was_empty) {
+      WakeReader();
+    }
+    return true;
+  }
+
+  void Resize(short num_rows, short num_columns) {
+    if (num_rows != m_numRows || num_columns != m_numColumns) {
+      if (m_master >= 0) {
+        winsize size{};
+        size.ws_row = static_cast<unsigned short>(num_rows);
+        size.ws_col = static_cast<unsigned short>(num_columns);
+        // The kernel sends SIGWINCH to the foreground process group
+        if (ioctl(m_master, TIOCSWINSZ, &size) < 0) {
+          throw std::runtime_error("Failed to resize the pseudo terminal");
+        }
+      }
+      m_numRows = num_rows;
+      m_numColumns = num_columns;
+    }
+  }
+
+  uint64_t GetSessionId() const { return m_session; }
+
+  void Close() {
+    if (m_master < 0) {
+      StopConsumer();
+      return;
+    }
+    if (m_session) {
+      m_closedWriteStats = m_reactor->GetWriteStats(m_session);
+      m_closedStats = m_reactor->RemoveSession(m_session);
+      m_session = 0;
+    } else {
+      {
+        std::lock_guard<std::mutex> lock(m_consumer->dataMutex);
+        m_consumer->stopping = true;
+      }
+      WakeReader();
+      m_readerThread.join();
+      StopConsumer();
+      {
+        // Input the child has not taken is dropped with the console
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        m_writes.Clear();
+      }
+      close(m_epoll);
+      close(m_wakeFd);
+      m_epoll = -1;
+      m_wakeFd = -1;
+    }
+    close(m_master);
+    m_master = -1;
+
+    // Closing the master hangs up the session, which usually ends the shell
+    kill(m_pid, SIGHUP);
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (waitpid(m_pid, nullptr, WNOHANG) == 0) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        kill(m_pid, SIGKILL);
+        waitpid(m_pid, nullptr, 0);
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    m_pid = -1;
+  }
+
+  PtyRingStats GetRingStats() const {
+    if (m_reactor) {
+      return m_session ? m_reactor->GetRingStats(m_session) : m_closedStats;
+    }
+    PtyRingStats stats{};
+    stats.capacity = PTY_RING_SIZE;
+    stats.batches = m_batches;
+    if (m_consumer) {
+      const ByteRing& ring = m_consumer->ring;
+      stats.capacity = ring.GetCapacity();
+      stats.size = ring.GetSize();
+      stats.peak_size = ring.GetPeakSize();
+      stats.bytes_read = ring.GetTotalWritten();
+      stats.batches += m_consumer->batches.load(std::memory_order_relaxed);
+    }
+    stats.stalls = m_stalls.load(std::memory_order_relaxed);
+    stats.dropped_bytes = m_droppedBytes;
+    return stats;
+  }
+
+  PtyWriteStats GetWriteStats() const {
+    if (m_reactor) {
+      return m_session ? m_reactor->GetWriteStats(m_session)
+                       : m_closedWriteStats;
+    }
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    return m_writes.GetStats();
+  }
+
+ private:
+  void ReaderThread() {
+    Consumer& consumer = *m_consumer;
+    epoll_event events[2];
+    while (!consumer.stopping) {
+      int count = epoll_wait(m_epoll, events, 2, -1);
+      if (count < 0 && errno != EINTR) {
+        break;
+      }
+      for (int i = 0; i < count; i++) {
+        if (events[i].data.fd == m_wakeFd) {
+          uint64_t value;
+          [[maybe_unused]] ssize_t result =
+              read(m_wakeFd, &value, sizeof(value));
+          if (!consumer.stopping && consumer.ring.GetFreeSize() > 0) {
+            // The consumer freed space after a stall
+            m_readable = true;
+          }
+        }
+      }
+      if (consumer.stopping) {
+        break;
+      }
+      // Also serves input queued since the last wake
+      Flush();
+      if (m_readable && !ReadAvailable()) {
+        break;
+      }
+      UpdateEvents();
+    }
+    consumer.finished = true;
+    NotifyConsumer();
+  }
+
+  // Reads until the master would block or the ring is full. Returns false
+  // when the output has ended.
+  bool ReadAvailable() {
+    ByteRing& ring = m_consumer->ring;
+    while (true) {
+      size_t size;
+      char* region = ring.GetWriteRegion(&size);
+      if (size == 0) {
+        if (Stall()) {
+          return true;
+        }
+        continue;
+      }
+      ssize_t result;
+      {
+        ScopedProbe probe(Probe::PtyRead);
+        result =
+            read(m_master, region, std::min<size_t>(size, PTY_BUFFER_SIZE));
+        probe.SetAmount(result > 0 ? static_cast<uint64_t>(result) : 0);
+      }
+      if (result > 0) {
+        InputLatency::OnOutputRead(&ring);
+        ring.CommitWrite(static_cast<size_t>(result));
+        NotifyConsumer();
+      } else if (result < 0 && errno == EAGAIN) {
+        return true;
+      } else if (result == 0 || errno != EINTR) {
+        // EIO once every process has closed the slave side
+        return false;
+      }
+    }
+  }
+
+  // Backpressure: leaves the data in the pty until the consumer catches
+  // up. Returns false if space was freed in the meantime.
+  bool Stall() {
+    m_stalls.fetch_add(1, std::memory_order_relaxed);
+    Consumer& consumer = *m_consumer;
+    consumer.stalled = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // The consumer may have freed space before it could see the flag
+    if (consumer.ring.GetFreeSize() == 0 || !consumer.stalled.exchange(false)) {
+      m_readable = false;
+      return true;
+    }
+    return false;
+  }
+
+  // Writes queued input until the master would block, at most
+  // PTY_BUFFER_SIZE bytes so that reading gets its turn
+  void Flush() {
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    size_t total = 0;
+    while (total < PTY_BUFFER_SIZE && m_writes.HasChunk()) {
+      const std::string& chunk = m_writes.Take();
+      ssize_t result = write(m_master, chunk.data(), chunk.size());
+      int error = result < 0 ? errno : 0;
+      m_writes.Complete(result > 0 ? static_cast<size_t>(result) : 0);
+      if (result > 0) {
+        total += static_cast<size_t>(result);
+      } else if (result == 0 || error == EAGAIN) {
+        break;
+      } else if (error != EINTR) {
+        // The child side is gone, drop the input
+        m_writes.Clear();
+        break;
+      }
+    }
+  }
+
+  void UpdateEvents() {
+    uint32_t events = m_readable ? uint32_t{EPOLLIN} : 0;
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      if (!m_writes.IsEmpty()) {
+        events |= EPOLLOUT;
+      }
+    }
+    if (events == m_events) {
+      return;
+    }
+    // Unregistered when there is nothing to wait for, which also stops
+    // hangup events, as epoll reports them regardless of the requested ones
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = m_master;
+    int op = events == 0    ? EPOLL_CTL_DEL
+             : m_events == 0 ? EPOLL_CTL_ADD
+                             : EPOLL_CTL_MOD;
+    epoll_ctl(m_epoll, op, m_master, &event);
+    m_events = events;
+  }
+
+  void WakeReader() { WakeReader(m_wakeFd); }
+
+  static void WakeReader(int wake_fd) {
+    uint64_t value = 1;
+    [[maybe_unused]] ssize_t result = write(wake_fd, &value, sizeof(value));
+  }
+
+  void NotifyConsumer() {
+    {
+      std::lock_guard<std::mutex> lock(m_consumer->dataMutex);
+      m_consumer->dataReady = true;
+    }
+    m_consumer->dataCv.notify_one();
+  }
+
+  static void ConsumerThread(std::shared_ptr<Consumer> consumer) {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(consumer->dataMutex);
+        consumer->dataCv.wait(lock, [&consumer] {
+          return consumer->dataReady || consumer->stopping;
+        });
+        consumer->dataReady = false;
+      }
+      if (consumer->stopping) {
+        break;
+      }
+      Drain(*consumer);
+      if (consumer->finished && consumer->ring.GetSize() == 0) {
+        break;
+      }
+    }
+  }
+
+  // Hands everything that is currently in the ring to the callback at once,
+  // so a burst of small reads costs a single callback (and GIL acquisition)
+  static void Drain(Consumer& consumer) {
+    ByteRing& ring = consumer.ring;
+    size_t size = ring.GetSize();
+    if (size == 0) {
+      return;
+    }
+    size_t region_size;
+    const char* region = ring.GetReadRegion(&region_size);
+    if (region_size < size) {
+      // Data wraps around the end of the ring
+      consumer.staging.resize(size);
+      ring.Peek(consumer.staging.data(), size);
+      region = consumer.staging.data();
+    }
+    uint64_t begin = InputLatency::BeginOutput();
+    {
+      ScopedProbe probe(Probe::PtyCallback, size);
+      consumer.onData(region, static_cast<unsigned int>(size));
+    }
+    InputLatency::OnOutputApplied(&ring, begin);
+    ring.CommitRead(size);
+    consumer.batches.fetch_add(1, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // The callback may have closed the console, which also closes wakeFd
+    if (consumer.stalled.exchange(false) && !consumer.stopping) {
+      WakeReader(consumer.wakeFd);
+    }
+  }
+
+  void StopConsumer() {
+    if (!m_consumerThread.joinable()) {
+      return;
+    }
+    m_consumer->dataCv.notify_one();
+    if (m_consumerThread.get_id() == std::this_thread::get_id()) {
+      // Closed from inside the data callback, the thread ends as soon as
+      // the callback returns
+      m_consumerThread.detach();
+    } else {
+      m_consumerThread.join();
+    }
+    m_droppedBytes = m_consumer->ring.GetSize();
+  }
+};
+
+#endif
+
+struct PseudoConsole::Recording {
+  std::mutex mutex;
+  PtyRecorder recorder;
+  short numRows = 24;
+  short numColumns = 80;
+
+  void Output(const char* data, unsigned int length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    recorder.RecordOutput(data, length);
+  }
+
+  void Resize(short num_rows, short num_columns) {
+    std::lock_guard<std::mutex> lock(mutex);
+    numRows = num_rows;
+    numColumns = num_columns;
+    recorder.RecordResize(num_rows, num_columns);
+  }
+};
+
+PseudoConsole::PseudoConsole(std::shared_ptr<PtyReactor> reactor)
+    : m_recording(std::make_unique<Recording>()),
+      m_impl(std::make_unique<Impl>(std::move(reactor))) {}
 
 PseudoConsole::~PseudoConsole() {
 }
 
+void PseudoConsole::SetCommand(std::vector<std::string> argv) {
+  m_impl->SetCommand(std::move(argv));
+}
+
+void PseudoConsole::SetEnvironment(std::vector<std::string> environment) {
+  m_impl->SetEnvironment(std::move(environment));
+}
+
 bool PseudoConsole::Start(
     short num_rows,
     short num_columns,
     std::function<void(const char*, unsigned int)> on_data_callback) {
-  return m_impl->Start(num_rows, num_columns, on_data_callback);
+  m_recording->Resize(num_rows, num_columns);
+  Recording* recording = m_recording.get();
+  return m_impl->Start(
+      num_rows, num_columns,
+      [recording, on_data = std::move(on_data_callback)](
+          const char* data, unsigned int length) {
+        recording->Output(data, length);
+        on_data(data, length);
+      });
 }
 
 bool PseudoConsole::Send(const char* data, unsigned int length) {
   return m_impl->Send(data, length);
 }
 
+bool PseudoConsole::Paste(const char* data, size_t length, bool bracketed) {
+  return m_impl->Paste(data, length, bracketed);
+}
+
 void PseudoConsole::Resize(short num_rows, short num_columns) {
   m_impl->Resize(num_rows, num_columns);
+  if (num_rows != m_recording->numRows ||
+      num_columns != m_recording->numColumns) {
+    m_recording->Resize(num_rows, num_columns);
+  }
 }
 
 void PseudoConsole::Close() {
   m_impl->Close();
+  StopRecording();
+}
+
+PtyRingStats PseudoConsole::GetRingStats() const {
+  return m_impl->GetRingStats();
+}
+
+PtyWriteStats PseudoConsole::GetWriteStats() const {
+  return m_impl->GetWriteStats();
+}
+
+uint64_t PseudoConsole::GetSessionId() const {
+  return m_impl->GetSessionId();
+}
+
+bool PseudoConsole::StartRecording(const std::string& path) {
+  std::lock_guard<std::mutex> lock(m_recording->mutex);
+  if (!m_recording->recorder.Open(path)) {
+    return false;
+  }
+  // Replay starts with the size the output was written for
+  m_recording->recorder.RecordResize(m_recording->numRows,
+                                     m_recording->numColumns);
+  return true;
+}
+
+void PseudoConsole::StopRecording() {
+  std::lock_guard<std::mutex> lock(m_recording->mutex);
+  m_recording->recorder.Close();
 }
 
 }  // namespace MTerm
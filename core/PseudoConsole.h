@@ -1,25 +1,72 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
+
+#include "PtyWriteQueue.h"
 
 namespace MTerm {
 constexpr auto PTY_BUFFER_SIZE = 65536;
+constexpr auto PTY_RING_SIZE = 1 << 20;
+
+struct PtyRingStats {
+  size_t capacity;
+  size_t size;       // Bytes waiting for the consumer
+  size_t peak_size;
+  uint64_t bytes_read;
+  uint64_t batches;  // Consumer callbacks, each covering all available bytes
+  uint64_t stalls;   // Reads postponed because the ring was full
+  uint64_t dropped_bytes;  // Bytes discarded at shutdown
+};
+
+class PtyReactor;
 
 class PseudoConsole {
  public:
-  PseudoConsole();
+  // With a reactor the session's I/O and callbacks run on the reactor's
+  // threads instead of threads of its own
+  explicit PseudoConsole(std::shared_ptr<PtyReactor> reactor = nullptr);
   ~PseudoConsole();
 
+  // Program and arguments to run, UTF-8. Empty runs the default shell:
+  // pwsh.exe -NoLogo on Windows, $SHELL or /bin/sh elsewhere. Applies to
+  // the next Start().
+  void SetCommand(std::vector<std::string> argv);
+
+  // NAME=value entries replacing the inherited environment; empty inherits
+  void SetEnvironment(std::vector<std::string> environment);
+
   bool Start(short num_rows,
              short num_columns,
              std::function<void(const char*, unsigned int)> on_data_callback);
+  // Input is queued and written by a background thread, neither call
+  // waits for the child to read it. Send() is meant for keystrokes, which
+  // are written ahead of the rest of a paste in progress.
   bool Send(const char* data, unsigned int length);
+  // Streams the text in chunks, framed as a bracketed paste if requested
+  bool Paste(const char* data, size_t length, bool bracketed);
   void Resize(short num_rows, short num_columns);
   void Close();
 
+  PtyRingStats GetRingStats() const;
+  PtyWriteStats GetWriteStats() const;
+
+  // Saves the output received from now on, and resizes, to a PtyRecorder
+  // file at the UTF-8 path, until StopRecording() or Close()
+  bool StartRecording(const std::string& path);
+  void StopRecording();
+
+  // Id in the reactor's session stats, 0 without a reactor or when closed
+  uint64_t GetSessionId() const;
+
  private:
   class Impl;
+  struct Recording;
+  // Used by the data callback, so it is destroyed after the Impl
+  std::unique_ptr<Recording> m_recording;
   std::unique_ptr<Impl> m_impl;
 };
 
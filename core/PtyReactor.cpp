@@ -0,0 +1,781 @@
+#include "PtyReactor.h"
+
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "ByteRing.h"
+#include "InputLatency.h"
+#include "Instrumentation.h"
+#include "PtyWriteQueue.h"
+
+namespace MTerm {
+
+namespace {
+
+constexpr size_t kDefaultByteBudget = PTY_BUFFER_SIZE;
+
+}  // namespace
+
+class PtyReactor::Impl {
+ private:
+  struct Session : std::enable_shared_from_this<Session> {
+    uint64_t id = 0;
+    Handle input;
+    Handle output;
+    DataCallback onData;
+    ByteRing ring{PTY_RING_SIZE};
+
+    // Set under m_mutex; nothing is posted or queued for the session after
+    std::atomic<bool> closed = false;
+    std::atomic<bool> stalled = false;
+    std::atomic<bool> finished = false;
+
+    // Under m_deliveryMutex
+    bool queued = false;
+    bool delivering = false;
+
+    // Held by the I/O thread while it uses the handles
+    std::mutex ioMutex;
+
+    mutable std::mutex writeMutex;
+    PtyWriteQueue writes;  // Queued by Send() and Paste()
+
+    std::atomic<uint64_t> deliveries = 0;
+    std::atomic<uint64_t> yields = 0;
+    std::atomic<uint64_t> stalls = 0;
+
+    // Under m_mutex, for GetSessionStats()
+    uint64_t rateBytes = 0;
+    std::chrono::steady_clock::time_point rateTime;
+
+#ifdef _WIN32
+    // Under ioMutex
+    OVERLAPPED readOvl{};
+    OVERLAPPED writeOvl{};
+    bool reading = false;
+    bool writing = false;  // A chunk of writes is taken
+    uint64_t readStart = 0;  // When the pending read was issued, for probes
+    // Operations and posted packets the I/O thread has yet to complete
+    std::atomic<int> pendingIo = 0;
+#else
+    // Under ioMutex
+    uint32_t events = 0;  // Registered with epoll, 0 when not registered
+    bool readable = true;  // Cleared while stalled and at the end of output
+#endif
+  };
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<uint64_t, std::shared_ptr<Session>> m_sessions;
+  uint64_t m_nextId = 1;
+  bool m_stopping = false;
+  std::atomic<size_t> m_budget = kDefaultByteBudget;
+
+  // Sessions with data for their callbacks, served in turn
+  std::mutex m_deliveryMutex;
+  std::condition_variable m_deliveryCv;
+  std::condition_variable m_deliveredCv;
+  std::deque<std::shared_ptr<Session>> m_ready;
+  bool m_deliveryStopping = false;
+  std::vector<char> m_staging;
+
+  std::thread m_ioThread;
+  std::thread m_deliveryThread;
+
+#ifdef _WIN32
+  HANDLE m_port = nullptr;
+  std::condition_variable m_ioDone;  // With m_mutex
+#else
+  int m_epoll = -1;
+  int m_wakeFd = -1;
+  // Sessions that need the I/O thread: new ones, pending writes and
+  // resuming after a stall
+  std::vector<std::shared_ptr<Session>> m_posted;
+#endif
+
+ public:
+  Impl() {
+#ifdef _WIN32
+    m_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+#else
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = 0;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeFd, &event);
+#endif
+    m_ioThread = std::thread(&Impl::IoThread, this);
+    m_deliveryThread = std::thread(&Impl::DeliveryThread, this);
+  }
+
+  ~Impl() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+#ifdef _WIN32
+    PostQueuedCompletionStatus(m_port, 0, 0, nullptr);
+#else
+    WakeIoThread();
+#endif
+    m_ioThread.join();
+    {
+      std::lock_guard<std::mutex> lock(m_deliveryMutex);
+      m_deliveryStopping = true;
+    }
+    m_deliveryCv.notify_one();
+    m_deliveryThread.join();
+#ifdef _WIN32
+    CloseHandle(m_port);
+#else
+    close(m_epoll);
+    close(m_wakeFd);
+#endif
+  }
+
+  void SetByteBudget(size_t bytes) {
+    m_budget = std::max<size_t>(bytes, 1);
+  }
+
+  size_t GetByteBudget() const { return m_budget; }
+
+  std::vector<PtySessionStats> GetSessionStats() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<PtySessionStats> result;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [id, session] : m_sessions) {
+      uint64_t bytes = session->ring.GetTotalWritten();
+      double seconds =
+          std::chrono::duration<double>(now - session->rateTime).count();
+      PtySessionStats stats{};
+      stats.id = id;
+      stats.bytes_read = bytes;
+      {
+        std::lock_guard<std::mutex> write_lock(session->writeMutex);
+        stats.bytes_written = session->writes.GetStats().bytes_written;
+      }
+      stats.deliveries = session->deliveries;
+      stats.budget_yields = session->yields;
+      stats.stalls = session->stalls;
+      stats.pending_size = session->ring.GetSize();
+      stats.read_rate =
+          seconds > 0 ? (bytes - session->rateBytes) / seconds : 0;
+      session->rateBytes = bytes;
+      session->rateTime = now;
+      result.push_back(stats);
+    }
+    std::sort(result.begin(), result.end(),
+              [](const PtySessionStats& a, const PtySessionStats& b) {
+                return a.id < b.id;
+              });
+    return result;
+  }
+
+  uint64_t AddSession(Handle input, Handle output, DataCallback on_data) {
+    auto session = std::make_shared<Session>();
+    session->input = input;
+    session->output = output;
+    session->onData = std::move(on_data);
+    session->rateTime = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      session->id = m_nextId++;
+      m_sessions[session->id] = session;
+    }
+#ifdef _WIN32
+    auto key = reinterpret_cast<ULONG_PTR>(session.get());
+    CreateIoCompletionPort(output, m_port, key, 0);
+    if (input != output) {
+      CreateIoCompletionPort(input, m_port, key, 0);
+    }
+#endif
+    return session->id;
+  }
+
+  void StartSession(uint64_t id) {
+    if (std::shared_ptr<Session> session = Find(id)) {
+      // The I/O thread starts reading
+      Post(session);
+    }
+  }
+
+  bool Send(uint64_t id, const char* data, size_t length) {
+    std::shared_ptr<Session> session = Find(id);
+    if (!session || session->finished) {
+      return false;
+    }
+    InputLatency::OnSend(&session->ring);
+    bool was_empty;
+    {
+      std::lock_guard<std::mutex> lock(session->writeMutex);
+      was_empty = session->writes.IsEmpty();
+      session->writes.Send(data, length);
+    }
+    if (was_empty) {
+      Post(session);
+    }
+    return true;
+  }
+
+  bool Paste(uint64_t id, const char* data, size_t length, bool bracketed) {
+    std::shared_ptr<Session> session = Find(id);
+    if (!session || session->finished) {
+      return false;
+    }
+    bool was_empty;
+    {
+      std::lock_guard<std::mutex> lock(session->writeMutex);
+      was_empty = session->writes.IsEmpty();
+      session->writes.Paste(data, length, bracketed);
+    }
+    if (was_empty) {
+      Post(session);
+    }
+    return true;
+  }
+
+  PtyRingStats RemoveSession(uint64_t id) {
+    std::shared_ptr<Session> session;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_sessions.find(id);
+      if (it == m_sessions.end()) {
+        return {};
+      }
+      session = std::move(it->second);
+      m_sessions.erase(it);
+      session->closed = true;
+    }
+#ifdef _WIN32
+    {
+      std::lock_guard<std::mutex> io_lock(session->ioMutex);
+      CancelIoEx(session->output, nullptr);
+      if (session->input != session->output) {
+        CancelIoEx(session->input, nullptr);
+      }
+    }
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_ioDone.wait(lock, [&] { return session->pendingIo == 0; });
+    }
+#else
+    {
+      std::lock_guard<std::mutex> io_lock(session->ioMutex);
+      if (session->events != 0) {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, session->output, nullptr);
+        session->events = 0;
+      }
+    }
+#endif
+    {
+      std::unique_lock<std::mutex> lock(m_deliveryMutex);
+      if (session->queued) {
+        m_ready.erase(std::find(m_ready.begin(), m_ready.end(), session));
+        session->queued = false;
+      }
+      // From inside the callback the delivery ends when it returns
+      if (m_deliveryThread.get_id() != std::this_thread::get_id()) {
+        m_deliveredCv.wait(lock, [&] { return !session->delivering; });
+      }
+    }
+    PtyRingStats stats = MakeRingStats(*session);
+    stats.dropped_bytes = stats.size;
+    return stats;
+  }
+
+  PtyRingStats GetRingStats(uint64_t id) const {
+    std::shared_ptr<Session> session = Find(id);
+    return session ? MakeRingStats(*session) : PtyRingStats{};
+  }
+
+  PtyWriteStats GetWriteStats(uint64_t id) const {
+    std::shared_ptr<Session> session = Find(id);
+    if (!session) {
+      return {};
+    }
+    std::lock_guard<std::mutex> lock(session->writeMutex);
+    return session->writes.GetStats();
+  }
+
+ private:
+  std::shared_ptr<Session> Find(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(id);
+    return it != m_sessions.end() ? it->second : nullptr;
+  }
+
+  static PtyRingStats MakeRingStats(const Session& session) {
+    PtyRingStats stats{};
+    stats.capacity = session.ring.GetCapacity();
+    stats.size = session.ring.GetSize();
+    stats.peak_size = session.ring.GetPeakSize();
+    stats.bytes_read = session.ring.GetTotalWritten();
+    stats.batches = session.deliveries;
+    stats.stalls = session.stalls;
+    return stats;
+  }
+
+  // Backpressure, as in PseudoConsole: the data stays in the pipe until the
+  // callback catches up. Returns false if space was freed in the meantime.
+  static bool Stall(Session& session) {
+    session.stalls.fetch_add(1, std::memory_order_relaxed);
+    session.stalled = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return session.ring.GetFreeSize() == 0 || !session.stalled.exchange(false);
+  }
+
+  // Called by the I/O thread after reading
+  void Queue(const std::shared_ptr<Session>& session) {
+    {
+      std::lock_guard<std::mutex> lock(m_deliveryMutex);
+      // A running delivery requeues the session itself if data is left
+      if (session->queued || session->delivering) {
+        return;
+      }
+      session->queued = true;
+      m_ready.push_back(session);
+    }
+    m_deliveryCv.notify_one();
+  }
+
+  void DeliveryThread() {
+    std::unique_lock<std::mutex> lock(m_deliveryMutex);
+    while (true) {
+      m_deliveryCv.wait(
+          lock, [this] { return m_deliveryStopping || !m_ready.empty(); });
+      if (m_deliveryStopping) {
+        return;
+      }
+      std::shared_ptr<Session> session = std::move(m_ready.front());
+      m_ready.pop_front();
+      session->queued = false;
+      session->delivering = true;
+      lock.unlock();
+      bool yielded = Deliver(session);
+      lock.lock();
+      session->delivering = false;
+      if (!session->closed && session->ring.GetSize() > 0) {
+        // Behind the other busy sessions
+        session->queued = true;
+        m_ready.push_back(session);
+        if (yielded) {
+          session->yields.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      m_deliveredCv.notify_all();
+    }
+  }
+
+  // Hands up to the byte budget to the callback. Returns true if more data
+  // was available.
+  bool Deliver(const std::shared_ptr<Session>& session) {
+    if (session->closed) {
+      return false;
+    }
+    ByteRing& ring = session->ring;
+    size_t available = ring.GetSize();
+    if (available == 0) {
+      return false;
+    }
+    size_t size = std::min<size_t>(available, m_budget);
+    size_t region_size;
+    const char* region = ring.GetReadRegion(&region_size);
+    if (region_size < size) {
+      // Data wraps around the end of the ring
+      m_staging.resize(size);
+      ring.Peek(m_staging.data(), size);
+      region = m_staging.data();
+    }
+    uint64_t begin = InputLatency::BeginOutput();
+    {
+      ScopedProbe probe(Probe::PtyCallback, size);
+      session->onData(region, static_cast<unsigned int>(size));
+    }
+    InputLatency::OnOutputApplied(&ring, begin);
+    ring.CommitRead(size);
+    session->deliveries.fetch_add(1, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (session->stalled.exchange(false)) {
+      Post(session);
+    }
+    return size < available;
+  }
+
+#ifdef _WIN32
+
+  void Post(const std::shared_ptr<Session>& session) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (session->closed) {
+        return;
+      }
+      session->pendingIo++;
+    }
+    PostQueuedCompletionStatus(m_port, 0,
+                               reinterpret_cast<ULONG_PTR>(session.get()),
+                               nullptr);
+  }
+
+  void IoThread() {
+    OVERLAPPED_ENTRY entries[64];
+    while (true) {
+      ULONG count = 0;
+      if (!GetQueuedCompletionStatusEx(m_port, entries, 64, &count, INFINITE,
+                                       FALSE)) {
+        return;
+      }
+      for (ULONG i = 0; i < count; i++) {
+        if (entries[i].lpCompletionKey == 0) {
+          return;
+        }
+        // Kept alive by RemoveSession() until its operations complete
+        auto session = reinterpret_cast<Session*>(entries[i].lpCompletionKey);
+        {
+          std::lock_guard<std::mutex> io_lock(session->ioMutex);
+          if (entries[i].lpOverlapped == &session->readOvl) {
+            OnReadComplete(*session);
+          } else if (entries[i].lpOverlapped == &session->writeOvl) {
+            OnWriteComplete(*session);
+          }
+          // Also serves posted packets: the first read, resuming after a
+          // stall and new writes
+          if (!session->closed) {
+            IssueRead(*session);
+            IssueWrite(*session);
+          }
+        }
+        {
+          // Under the lock RemoveSession() closes and waits with, so it
+          // cannot miss the last completion. The session may be freed as
+          // soon as the lock is released.
+          std::lock_guard<std::mutex> lock(m_mutex);
+          if (--session->pendingIo == 0 && session->closed) {
+            m_ioDone.notify_all();
+          }
+        }
+      }
+    }
+  }
+
+  void OnReadComplete(Session& session) {
+    session.reading = false;
+    DWORD bytes = 0;
+    BOOL ok =
+        GetOverlappedResult(session.output, &session.readOvl, &bytes, FALSE);
+    if (!ok && GetLastError() != ERROR_OPERATION_ABORTED) {
+      // ERROR_BROKEN_PIPE when the console has closed
+      session.finished = true;
+    }
+    if (bytes > 0) {
+      if (session.readStart) {
+        Instrumentation::Record(Probe::PtyRead, session.readStart,
+                                Instrumentation::Now(), bytes);
+      }
+      InputLatency::OnOutputRead(&session.ring);
+      session.ring.CommitWrite(bytes);
+      Queue(session.shared_from_this());
+    }
+  }
+
+  void IssueRead(Session& session) {
+    if (session.reading || session.finished || session.closed) {
+      return;
+    }
+    size_t size;
+    char* region = session.ring.GetWriteRegion(&size);
+    if (size == 0) {
+      if (Stall(session)) {
+        return;
+      }
+      region = session.ring.GetWriteRegion(&size);
+    }
+    // One read per turn: completions are served in order, so busy sessions
+    // alternate
+    size = std::min<size_t>(size, m_budget);
+    session.readOvl = {};
+    session.pendingIo++;
+    session.reading = true;
+    session.readStart =
+        Instrumentation::IsActive() ? Instrumentation::Now() : 0;
+    if (!ReadFile(session.output, region, static_cast<DWORD>(size), nullptr,
+                  &session.readOvl) &&
+        GetLastError() != ERROR_IO_PENDING) {
+      session.reading = false;
+      session.pendingIo--;
+      session.finished = true;
+    }
+  }
+
+  void OnWriteComplete(Session& session) {
+    session.writing = false;
+    DWORD bytes = 0;
+    BOOL ok =
+        GetOverlappedResult(session.input, &session.writeOvl, &bytes, FALSE);
+    std::lock_guard<std::mutex> lock(session.writeMutex);
+    session.writes.Complete(bytes);
+    if (!ok) {
+      session.writes.Clear();
+    }
+  }
+
+  void IssueWrite(Session& session) {
+    if (session.writing || session.closed) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(session.writeMutex);
+    if (!session.writes.HasChunk()) {
+      return;
+    }
+    // Stays valid until OnWriteComplete()
+    const std::string& chunk = session.writes.Take();
+    session.writeOvl = {};
+    session.pendingIo++;
+    session.writing = true;
+    if (!WriteFile(session.input, chunk.data(),
+                   static_cast<DWORD>(chunk.size()), nullptr,
+                   &session.writeOvl) &&
+        GetLastError() != ERROR_IO_PENDING) {
+      // The console is gone, drop the input
+      session.writing = false;
+      session.pendingIo--;
+      session.writes.Complete(0);
+      session.writes.Clear();
+    }
+  }
+
+#else
+
+  void Post(const std::shared_ptr<Session>& session) {
+    bool wake;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (session->closed) {
+        return;
+      }
+      wake = m_posted.empty();
+      m_posted.push_back(session);
+    }
+    if (wake) {
+      WakeIoThread();
+    }
+  }
+
+  void WakeIoThread() {
+    uint64_t value = 1;
+    [[maybe_unused]] ssize_t result = write(m_wakeFd, &value, sizeof(value));
+  }
+
+  void IoThread() {
+    epoll_event events[64];
+    std::vector<std::shared_ptr<Session>> posted;
+    while (true) {
+      // Level-triggered: a session with data left after its turn is
+      // reported again, after the others
+      int count = epoll_wait(m_epoll, events, 64, -1);
+      if (count < 0 && errno != EINTR) {
+        return;
+      }
+      for (int i = 0; i < count; i++) {
+        if (events[i].data.u64 == 0) {
+          uint64_t value;
+          [[maybe_unused]] ssize_t result =
+              read(m_wakeFd, &value, sizeof(value));
+          continue;
+        }
+        std::shared_ptr<Session> session = Find(events[i].data.u64);
+        if (!session) {
+          continue;
+        }
+        std::lock_guard<std::mutex> io_lock(session->ioMutex);
+        if (session->closed) {
+          continue;
+        }
+        if (events[i].events & EPOLLOUT) {
+          Flush(*session);
+        }
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+          Read(session);
+        }
+        UpdateEvents(*session);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+          return;
+        }
+        posted.swap(m_posted);
+      }
+      for (const std::shared_ptr<Session>& session : posted) {
+        std::lock_guard<std::mutex> io_lock(session->ioMutex);
+        if (session->closed) {
+          continue;
+        }
+        if (!session->finished && session->ring.GetFreeSize() > 0) {
+          session->readable = true;
+        }
+        Read(session);
+        Flush(*session);
+        UpdateEvents(*session);
+      }
+      posted.clear();
+    }
+  }
+
+  // Reads at most the byte budget
+  void Read(const std::shared_ptr<Session>& session) {
+    if (!session->readable) {
+      return;
+    }
+    size_t budget = m_budget;
+    size_t total = 0;
+    while (total < budget) {
+      size_t size;
+      char* region = session->ring.GetWriteRegion(&size);
+      if (size == 0) {
+        if (Stall(*session)) {
+          session->readable = false;
+          break;
+        }
+        continue;
+      }
+      ssize_t result;
+      {
+        ScopedProbe probe(Probe::PtyRead);
+        result = read(session->output, region, std::min(size, budget - total));
+        probe.SetAmount(result > 0 ? static_cast<uint64_t>(result) : 0);
+      }
+      if (result > 0) {
+        InputLatency::OnOutputRead(&session->ring);
+        session->ring.CommitWrite(static_cast<size_t>(result));
+        total += static_cast<size_t>(result);
+      } else if (result < 0 && errno == EAGAIN) {
+        break;
+      } else if (result == 0 || errno != EINTR) {
+        // EIO once every process has closed the slave side
+        session->finished = true;
+        session->readable = false;
+        break;
+      }
+    }
+    if (total > 0) {
+      Queue(session);
+    }
+  }
+
+  // Writes at most the byte budget
+  void Flush(Session& session) {
+    std::lock_guard<std::mutex> lock(session.writeMutex);
+    size_t budget = m_budget;
+    size_t total = 0;
+    while (total < budget && session.writes.HasChunk()) {
+      const std::string& chunk = session.writes.Take();
+      ssize_t result = write(session.input, chunk.data(), chunk.size());
+      int error = result < 0 ? errno : 0;
+      session.writes.Complete(result > 0 ? static_cast<size_t>(result) : 0);
+      if (result > 0) {
+        total += static_cast<size_t>(result);
+      } else if (result == 0 || error == EAGAIN) {
+        break;
+      } else if (error != EINTR) {
+        // The child side is gone, drop the input
+        session.writes.Clear();
+        break;
+      }
+    }
+  }
+
+  void UpdateEvents(Session& session) {
+    uint32_t events = session.readable ? uint32_t{EPOLLIN} : 0;
+    {
+      std::lock_guard<std::mutex> lock(session.writeMutex);
+      if (!session.writes.IsEmpty()) {
+        events |= EPOLLOUT;
+      }
+    }
+    if (events == session.events) {
+      return;
+    }
+    // Unregistered when there is nothing to wait for, as epoll reports
+    // hangups regardless of the requested events
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = session.id;
+    int op = events == 0            ? EPOLL_CTL_DEL
+             : session.events == 0 ? EPOLL_CTL_ADD
+                                   : EPOLL_CTL_MOD;
+    epoll_ctl(m_epoll, op, session.output, &event);
+    session.events = events;
+  }
+
+#endif
+};
+
+PtyReactor::PtyReactor() : m_impl(std::make_unique<Impl>()) {}
+
+PtyReactor::~PtyReactor() = default;
+
+void PtyReactor::SetByteBudget(size_t bytes) {
+  m_impl->SetByteBudget(bytes);
+}
+
+size_t PtyReactor::GetByteBudget() const {
+  return m_impl->GetByteBudget();
+}
+
+std::vector<PtySessionStats> PtyReactor::GetSessionStats() {
+  return m_impl->GetSessionStats();
+}
+
+uint64_t PtyReactor::AddSession(Handle input,
+                                Handle output,
+                                DataCallback on_data) {
+  return m_impl->AddSession(input, output, std::move(on_data));
+}
+
+void PtyReactor::StartSession(uint64_t id) {
+  m_impl->StartSession(id);
+}
+
+bool PtyReactor::Send(uint64_t id, const char* data, size_t length) {
+  return m_impl->Send(id, data, length);
+}
+
+bool PtyReactor::Paste(uint64_t id,
+                       const char* data,
+                       size_t length,
+                       bool bracketed) {
+  return m_impl->Paste(id, data, length, bracketed);
+}
+
+PtyRingStats PtyReactor::RemoveSession(uint64_t id) {
+  return m_impl->RemoveSession(id);
+}
+
+PtyRingStats PtyReactor::GetRingStats(uint64_t id) const {
+  return m_impl->GetRingStats(id);
+}
+
+PtyWriteStats PtyReactor::GetWriteStats(uint64_t id) const {
+  return m_impl->GetWriteStats(id);
+}
+
+}  // namespace MTerm
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "PseudoConsole.h"
+
+namespace MTerm {
+
+struct PtySessionStats {
+  uint64_t id;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  uint64_t deliveries;     // Callbacks
+  uint64_t budget_yields;  // Turns cut short by the byte budget
+  uint64_t stalls;         // Reads postponed because the ring was full
+  size_t pending_size;     // Bytes waiting for the callback
+  double read_rate;  // Bytes per second since the previous GetSessionStats()
+};
+
+// Services the output and input of any number of pseudo console sessions
+// with one I/O thread (epoll, or an I/O completion port on Windows) and one
+// thread calling the data callbacks, instead of a reader and a consumer per
+// session. Busy sessions take turns: each turn reads, and delivers, at most
+// the byte budget before the next session is served. An idle session is
+// only a registration with the I/O thread.
+// Sessions are added by PseudoConsole, which keeps the reactor alive.
+class PtyReactor {
+ public:
+#ifdef _WIN32
+  using Handle = void*;
+#else
+  using Handle = int;
+#endif
+  using DataCallback = std::function<void(const char*, unsigned int)>;
+
+  PtyReactor();
+  ~PtyReactor();
+
+  PtyReactor(const PtyReactor&) = delete;
+  PtyReactor& operator=(const PtyReactor&) = delete;
+
+  // Bytes a session may read, and hand to its callback, per turn
+  void SetByteBudget(size_t bytes);
+  size_t GetByteBudget() const;
+
+  std::vector<PtySessionStats> GetSessionStats();
+
+  // Session interface used by PseudoConsole. Handles stay owned by the
+  // caller and must be non-blocking: overlapped pipes on Windows, the pty
+  // master as both input and output elsewhere. Returns the session id,
+  // never 0. Nothing is read before StartSession(), so the caller can
+  // store the id before its callback may run.
+  uint64_t AddSession(Handle input, Handle output, DataCallback on_data);
+  void StartSession(uint64_t id);
+
+  // Queue input for the I/O thread, do not block. See PtyWriteQueue for
+  // how keystrokes and pastes are ordered.
+  bool Send(uint64_t id, const char* data, size_t length);
+  bool Paste(uint64_t id, const char* data, size_t length, bool bracketed);
+
+  // Waits until the reactor no longer uses the handles or calls the
+  // callback, except when called from inside the callback. Returns the
+  // final ring stats.
+  PtyRingStats RemoveSession(uint64_t id);
+
+  PtyRingStats GetRingStats(uint64_t id) const;
+  PtyWriteStats GetWriteStats(uint64_t id) const;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> m_impl;
+};
+
+}  // namespace MTerm
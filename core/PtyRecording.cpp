@@ -0,0 +1,180 @@
+#include "PtyRecording.h"
+
+#include <cstring>
+
+#include "Utils.h"
+
+namespace MTerm {
+
+namespace {
+
+constexpr char kMagic[4] = {'M', 'T', 'R', 'C'};
+constexpr uint8_t kVersion = 1;
+
+// Records larger than this are taken for a corrupt file
+constexpr uint64_t kMaxRecordSize = 64 * 1024 * 1024;
+
+FILE* OpenFile(const std::string& path, bool write) {
+#ifdef _WIN32
+  return _wfopen(Utils::Utf8ToWChar(path).c_str(), write ? L"wb" : L"rb");
+#else
+  return fopen(path.c_str(), write ? "wb" : "rb");
+#endif
+}
+
+}  // namespace
+
+PtyRecorder::~PtyRecorder() {
+  Close();
+}
+
+bool PtyRecorder::Open(const std::string& path) {
+  Close();
+  m_file = OpenFile(path, true);
+  if (!m_file) {
+    return false;
+  }
+  fwrite(kMagic, 1, sizeof(kMagic), m_file);
+  fputc(kVersion, m_file);
+  m_start = std::chrono::steady_clock::now();
+  m_lastTime = 0;
+  m_recordedBytes = 0;
+  return true;
+}
+
+void PtyRecorder::Close() {
+  if (m_file) {
+    fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+bool PtyRecorder::IsOpen() const {
+  return m_file != nullptr;
+}
+
+void PtyRecorder::RecordOutput(const char* data, size_t size) {
+  if (!m_file || size == 0) {
+    return;
+  }
+  WriteRecordHeader(PtyRecordType::Output);
+  WriteVarint(size);
+  fwrite(data, 1, size, m_file);
+  m_recordedBytes += size;
+}
+
+void PtyRecorder::RecordResize(short num_rows, short num_columns) {
+  if (!m_file) {
+    return;
+  }
+  WriteRecordHeader(PtyRecordType::Resize);
+  WriteVarint(static_cast<uint16_t>(num_rows));
+  WriteVarint(static_cast<uint16_t>(num_columns));
+}
+
+uint64_t PtyRecorder::GetRecordedBytes() const {
+  return m_recordedBytes;
+}
+
+void PtyRecorder::WriteRecordHeader(PtyRecordType type) {
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - m_start);
+  uint64_t time = static_cast<uint64_t>(elapsed.count());
+  // Deltas of bursts fit in a byte or two
+  WriteVarint(time - m_lastTime);
+  m_lastTime = time;
+  fputc(static_cast<uint8_t>(type), m_file);
+}
+
+void PtyRecorder::WriteVarint(uint64_t value) {
+  uint8_t bytes[10];
+  int count = 0;
+  do {
+    bytes[count] = value & 0x7F;
+    value >>= 7;
+    if (value) {
+      bytes[count] |= 0x80;
+    }
+    count++;
+  } while (value);
+  fwrite(bytes, 1, count, m_file);
+}
+
+PtyRecordingReader::~PtyRecordingReader() {
+  Close();
+}
+
+bool PtyRecordingReader::Open(const std::string& path) {
+  Close();
+  m_file = OpenFile(path, false);
+  if (!m_file) {
+    return false;
+  }
+  char magic[sizeof(kMagic)];
+  if (fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) ||
+      memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      fgetc(m_file) != kVersion) {
+    Close();
+    return false;
+  }
+  m_time = 0;
+  return true;
+}
+
+void PtyRecordingReader::Close() {
+  if (m_file) {
+    fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+bool PtyRecordingReader::Next(PtyRecord& record) {
+  uint64_t delta;
+  if (!m_file || !ReadVarint(delta)) {
+    return false;
+  }
+  int type = fgetc(m_file);
+  uint64_t first, second;
+  switch (type) {
+    case static_cast<int>(PtyRecordType::Output):
+      if (!ReadVarint(first) || first > kMaxRecordSize) {
+        return false;
+      }
+      record.data.resize(first);
+      if (fread(record.data.data(), 1, first, m_file) != first) {
+        return false;
+      }
+      break;
+    case static_cast<int>(PtyRecordType::Resize):
+      if (!ReadVarint(first) || !ReadVarint(second)) {
+        return false;
+      }
+      record.data.clear();
+      record.num_rows = static_cast<short>(first);
+      record.num_columns = static_cast<short>(second);
+      break;
+    default:
+      return false;
+  }
+  m_time += delta;
+  record.time_us = m_time;
+  record.type = static_cast<PtyRecordType>(type);
+  return true;
+}
+
+bool PtyRecordingReader::ReadVarint(uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int byte = fgetc(m_file);
+    if (byte == EOF) {
+      return false;
+    }
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace MTerm
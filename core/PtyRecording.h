@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace MTerm {
+
+enum class PtyRecordType : uint8_t {
+  Output = 0,
+  Resize = 1,
+};
+
+struct PtyRecord {
+  uint64_t time_us;  // Since the recording started
+  PtyRecordType type;
+  std::string data;  // Output
+  short num_rows;    // Resize
+  short num_columns;
+};
+
+// Saves what a pseudo console receives, with timestamps, so that a workload
+// can be replayed without the program that produced it. The file starts
+// with "MTRC" and a version byte; each record is a varint time delta in
+// microseconds, the record type and its payload: a varint length and the
+// bytes for output, varint rows and columns for a resize.
+// Not thread-safe.
+class PtyRecorder {
+ public:
+  PtyRecorder() = default;
+  ~PtyRecorder();
+
+  PtyRecorder(const PtyRecorder&) = delete;
+  PtyRecorder& operator=(const PtyRecorder&) = delete;
+
+  // Path is UTF-8. Replaces an existing file.
+  bool Open(const std::string& path);
+  void Close();
+  bool IsOpen() const;
+
+  void RecordOutput(const char* data, size_t size);
+  void RecordResize(short num_rows, short num_columns);
+
+  uint64_t GetRecordedBytes() const;
+
+ private:
+  void WriteRecordHeader(PtyRecordType type);
+  void WriteVarint(uint64_t value);
+
+  FILE* m_file = nullptr;
+  std::chrono::steady_clock::time_point m_start;
+  uint64_t m_lastTime = 0;
+  uint64_t m_recordedBytes = 0;
+};
+
+// Reads records written by PtyRecorder in order
+class PtyRecordingReader {
+ public:
+  PtyRecordingReader() = default;
+  ~PtyRecordingReader();
+
+  PtyRecordingReader(const PtyRecordingReader&) = delete;
+  PtyRecordingReader& operator=(const PtyRecordingReader&) = delete;
+
+  // False if the file cannot be read or is not a recording
+  bool Open(const std::string& path);
+  void Close();
+
+  // False at the end of the recording, also when the last record was cut
+  // short because the recorder did not close the file
+  bool Next(PtyRecord& record);
+
+ private:
+  bool ReadVarint(uint64_t& value);
+
+  FILE* m_file = nullptr;
+  uint64_t m_time = 0;
+};
+
+}  // namespace MTerm
@@ -0,0 +1,163 @@
+#include "PtyWriteQueue.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Utils.h"
+
+namespace MTerm {
+
+namespace {
+
+constexpr char kPasteStart[] = "\x1b[200~";
+constexpr char kPasteEnd[] = "\x1b[201~";
+
+}  // namespace
+
+PtyWriteQueue::PtyWriteQueue(size_t chunk_size)
+    : m_chunkSize(std::max<size_t>(chunk_size, 16)) {}
+
+void PtyWriteQueue::Send(const char* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (m_keystrokeOffset < m_keystrokes.size()) {
+    m_coalescedSends++;
+  }
+  m_keystrokes.append(data, size);
+  m_keystrokeSends++;
+}
+
+void PtyWriteQueue::Paste(const char* data, size_t size, bool bracketed) {
+  if (size == 0) {
+    return;
+  }
+  PendingPaste paste;
+  paste.data.assign(data, size);
+  paste.bracketed = bracketed;
+  if (bracketed) {
+    size_t pos;
+    while ((pos = paste.data.find(kPasteEnd)) != std::string::npos) {
+      paste.data.erase(pos, sizeof(kPasteEnd) - 1);
+    }
+  }
+  m_pastes.push_back(std::move(paste));
+}
+
+bool PtyWriteQueue::IsEmpty() const {
+  return !m_taken && !HasChunk();
+}
+
+bool PtyWriteQueue::HasChunk() const {
+  return !m_taken &&
+         (!m_chunk.empty() || m_keystrokeOffset < m_keystrokes.size() ||
+          !m_pastes.empty());
+}
+
+const std::string& PtyWriteQueue::Take() {
+  assert(!m_taken);
+  m_taken = true;
+  if (!m_chunk.empty()) {
+    // Rest of a partly written chunk, which may have opened a paste
+    return m_chunk;
+  }
+  m_chunkSends = 0;
+  size_t available = m_keystrokes.size() - m_keystrokeOffset;
+  if (available > 0) {
+    if (m_bracketOpen) {
+      m_chunk = kPasteEnd;
+      m_bracketOpen = false;
+    }
+    size_t size = std::min(available, m_chunkSize);
+    m_chunk.append(m_keystrokes, m_keystrokeOffset, size);
+    m_keystrokeOffset += size;
+    if (m_keystrokeOffset == m_keystrokes.size()) {
+      m_keystrokes.clear();
+      m_keystrokeOffset = 0;
+      m_chunkSends = m_keystrokeSends;
+      m_keystrokeSends = 0;
+    } else if (m_keystrokeOffset > m_keystrokes.size() / 2) {
+      m_keystrokes.erase(0, m_keystrokeOffset);
+      m_keystrokeOffset = 0;
+    }
+  } else if (!m_pastes.empty()) {
+    TakePaste();
+  }
+  return m_chunk;
+}
+
+void PtyWriteQueue::TakePaste() {
+  PendingPaste& paste = m_pastes.front();
+  if (paste.bracketed && !m_bracketOpen) {
+    m_chunk = kPasteStart;
+    m_bracketOpen = true;
+  }
+  size_t available = paste.data.size() - paste.offset;
+  size_t size = std::min(available, m_chunkSize);
+  if (size < available) {
+    // Keystrokes may come between two chunks, keep characters whole
+    size_t complete =
+        Utils::CompleteUtf8Length(paste.data.data() + paste.offset, size);
+    if (complete > 0) {
+      size = complete;
+    }
+  }
+  m_chunk.append(paste.data, paste.offset, size);
+  paste.offset += size;
+  if (paste.offset == paste.data.size()) {
+    if (paste.bracketed) {
+      m_chunk += kPasteEnd;
+      m_bracketOpen = false;
+    }
+    m_chunkSends = 1;
+    m_pastes.pop_front();
+  }
+}
+
+void PtyWriteQueue::Complete(size_t written) {
+  assert(m_taken);
+  m_taken = false;
+  written = std::min(written, m_chunk.size());
+  if (written > 0) {
+    m_bytesWritten += written;
+    m_writes++;
+  }
+  if (m_dropChunk || written == m_chunk.size()) {
+    m_chunk.clear();
+    m_chunkSends = 0;
+    m_dropChunk = false;
+  } else {
+    m_chunk.erase(0, written);
+  }
+}
+
+void PtyWriteQueue::Clear() {
+  m_keystrokes.clear();
+  m_keystrokeOffset = 0;
+  m_keystrokeSends = 0;
+  m_pastes.clear();
+  m_bracketOpen = false;
+  if (m_taken) {
+    // Still being written from, dropped by Complete()
+    m_dropChunk = true;
+  } else {
+    m_chunk.clear();
+    m_chunkSends = 0;
+  }
+}
+
+PtyWriteStats PtyWriteQueue::GetStats() const {
+  PtyWriteStats stats{};
+  stats.queue_depth = m_keystrokeSends + m_pastes.size() + m_chunkSends;
+  stats.bytes_in_flight = m_keystrokes.size() - m_keystrokeOffset +
+                          (m_dropChunk ? 0 : m_chunk.size());
+  for (const PendingPaste& paste : m_pastes) {
+    stats.bytes_in_flight += paste.data.size() - paste.offset;
+  }
+  stats.bytes_written = m_bytesWritten;
+  stats.writes = m_writes;
+  stats.coalesced_sends = m_coalescedSends;
+  return stats;
+}
+
+}  // namespace MTerm
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace MTerm {
+
+constexpr size_t PTY_WRITE_CHUNK_SIZE = 4096;
+
+struct PtyWriteStats {
+  size_t queue_depth;      // Send() and Paste() calls not completely written
+  size_t bytes_in_flight;  // Accepted but not yet written to the console
+  uint64_t bytes_written;
+  uint64_t writes;          // Chunks handed to the OS
+  uint64_t coalesced_sends; // Send() calls merged into an earlier write
+};
+
+// Input waiting to be written to a pseudo console. Keystrokes (Send) are
+// merged into one write and go ahead of pastes, which are cut into chunks,
+// so typing during a large paste is not queued behind all of it. A
+// bracketed paste is framed with ESC[200~ ... ESC[201~; keystrokes that
+// arrive in the middle close the frame and the rest of the paste reopens
+// it, so they are never taken for pasted text.
+// Not thread-safe.
+class PtyWriteQueue {
+ public:
+  explicit PtyWriteQueue(size_t chunk_size = PTY_WRITE_CHUNK_SIZE);
+
+  void Send(const char* data, size_t size);
+
+  // The end-of-paste marker is removed from bracketed data, so that the
+  // pasted text cannot end the paste itself
+  void Paste(const char* data, size_t size, bool bracketed);
+
+  // Nothing to take and nothing taken
+  bool IsEmpty() const;
+
+  // Whether Take() has a chunk, false while one is taken
+  bool HasChunk() const;
+
+  // The next chunk to write. Stays valid until Complete().
+  const std::string& Take();
+
+  // Reports how much of the taken chunk was written, the rest is taken
+  // again first
+  void Complete(size_t written);
+
+  // Drops everything, e.g. when the console is gone
+  void Clear();
+
+  PtyWriteStats GetStats() const;
+
+ private:
+  struct PendingPaste {
+    std::string data;
+    size_t offset = 0;
+    bool bracketed = false;
+  };
+
+  void TakePaste();
+
+  size_t m_chunkSize;
+
+  std::string m_keystrokes;
+  size_t m_keystrokeOffset = 0;  // Taken prefix of m_keystrokes
+  size_t m_keystrokeSends = 0;
+  std::deque<PendingPaste> m_pastes;
+  bool m_bracketOpen = false;
+
+  // Taken, or left unwritten by Complete()
+  std::string m_chunk;
+  bool m_taken = false;
+  bool m_dropChunk = false;
+  // Calls that end in m_chunk
+  size_t m_chunkSends = 0;
+
+  uint64_t m_bytesWritten = 0;
+  uint64_t m_writes = 0;
+  uint64_t m_coalescedSends = 0;
+};
+
+}  // namespace MTerm
@@ -0,0 +1,148 @@
+#include "RenderBackend.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace MTerm {
+
+RenderBackend::RenderBackend()
+    : m_lineCache([this](char32_t codepoint) {
+        return GetGlyphIndex(codepoint);
+      }),
+      m_textGlyphs(TEXT_BUFFER_SIZE) {}
+
+RenderBackend::~RenderBackend() {}
+
+void RenderBackend::BeginFrame() {
+  m_textGlyphsPos = 0;
+  OnBeginFrame();
+}
+
+void RenderBackend::EndFrame() {
+  OnEndFrame();
+  // Drawing may reference cached glyphs until the backend finished the frame
+  m_lineCache.EndFrame();
+}
+
+void RenderBackend::OnBeginTextBuffer(float, float, float, float) {}
+
+void RenderBackend::OnEndTextBuffer() {}
+
+void RenderBackend::Text(const char32_t* text,
+                         int length,
+                         float font_size,
+                         float x,
+                         float y,
+                         int color,
+                         int underline_color,
+                         int background_color,
+                         float opacity) {
+  if (length <= 0) {
+    return;
+  }
+  if (m_textGlyphsPos + length > TEXT_BUFFER_SIZE) {
+    throw std::runtime_error(
+        "Text buffer overflow! Do you really want to draw so many "
+        "characters?!");
+  }
+  if (background_color != -1) {
+    float width = GetLineWidth(font_size, length);
+    float height = std::ceil(GetLineHeight(font_size));
+    Rect(x, y, x + width, y + height, background_color, opacity);
+  }
+  uint16_t* glyphs = m_textGlyphs.data() + m_textGlyphsPos;
+  for (int i = 0; i < length; i++) {
+    glyphs[i] = GetGlyphIndex(text[i]);
+  }
+  m_textGlyphsPos += length;
+  DrawGlyphs(glyphs, length, font_size, x, y, color, underline_color,
+             opacity);
+}
+
+void RenderBackend::TextBuffer(ColoredTextBuffer* buffer,
+                               float left,
+                               float top,
+                               float width,
+                               float height,
+                               int x_offset_chars,
+                               int y_offset_lines,
+                               float font_size) {
+  size_t line_count = buffer->GetLineCount();
+  std::lock_guard<std::mutex> style_lock(m_styleMutex);
+
+  float y = top;
+  float line_height = std::ceil(GetLineHeight(font_size));
+  float advance = GetAdvance(font_size);
+
+  int max_visible_chars = static_cast<int>(width / advance);
+
+  OnBeginTextBuffer(left, top, left + width, top + height);
+
+  for (size_t i = y_offset_lines; i < line_count; ++i) {
+    if (y > top + height)
+      break;
+
+    // Unchanged lines come from the cache without touching the glyph map
+    std::shared_ptr<const PreparedLine> line =
+        m_lineCache.Prepare(*buffer, i, x_offset_chars, max_visible_chars);
+
+    for (const BackgroundSpan& span : line->backgrounds) {
+      int color = ResolveColor(span.color);
+      if (color == -1)
+        continue;
+      float x = left + advance * span.column;
+      Rect(x, y, x + advance * span.length, y + line_height, color, 1.0f);
+    }
+    for (const GlyphRun& run : line->runs) {
+      float x = left + advance * run.column;
+      DrawLineRun(line, run, font_size, x, y,
+                  ResolveColor(run.attributes.color),
+                  ResolveColor(run.attributes.underline_color));
+    }
+
+    y += line_height;
+  }
+  OnEndTextBuffer();
+}
+
+void RenderBackend::SetPalette(const std::vector<int>& colors) {
+  std::lock_guard<std::mutex> lock(m_styleMutex);
+  m_palette.assign(colors.begin(), colors.end());
+}
+
+void RenderBackend::SetHighlighter(
+    std::shared_ptr<const HighlightEngine> highlighter) {
+  std::lock_guard<std::mutex> lock(m_styleMutex);
+  m_lineCache.SetHighlighter(std::move(highlighter));
+}
+
+int RenderBackend::ResolveColor(int color) const {
+  if (color < 0 || !(color & COLOR_PALETTE_FLAG)) {
+    return color;
+  }
+  size_t index = static_cast<size_t>(color & ~COLOR_PALETTE_FLAG);
+  return index < m_palette.size() ? m_palette[index] : COLOR_DEFAULT;
+}
+
+float RenderBackend::GetLineWidth(float font_size, int num_chars) const {
+  return GetAdvance(font_size) * num_chars;
+}
+
+void RenderBackend::DrawLineRun(
+    const std::shared_ptr<const PreparedLine>& line,
+    const GlyphRun& run,
+    float font_size,
+    float x,
+    float y,
+    int color,
+    int underline_color) {
+  DrawGlyphs(line->glyphs.data() + run.glyph_offset, run.length, font_size, x,
+             y, color, underline_color, 1.0f);
+}
+
+void RenderBackend::ResetGlyphCache() {
+  m_lineCache.Clear();
+}
+
+}  // namespace MTerm
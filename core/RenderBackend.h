@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ColoredTextBuffer.h"
+#include "LineRenderCache.h"
+
+namespace MTerm {
+
+constexpr auto TEXT_BUFFER_SIZE = 1024 * 1024;
+
+// Drawing primitives of a window or an offscreen target. Colors are
+// 0xRRGGBB; -1 skips the text, underline or background. Text() and
+// TextBuffer() are implemented here on top of GetGlyphIndex() and
+// DrawGlyphs(), so a backend only has to rasterize glyph runs.
+class RenderBackend {
+ public:
+  RenderBackend();
+  virtual ~RenderBackend();
+
+  // Every frame is drawn between these calls
+  void BeginFrame();
+  void EndFrame();
+
+  virtual int GetWidth() const = 0;
+  virtual int GetHeight() const = 0;
+
+  virtual void Clear(int color) = 0;
+
+  void Text(const char32_t* text,
+            int length,
+            float font_size,
+            float x,
+            float y,
+            int color,
+            int underline_color,
+            int background_color,
+            float opacity);
+
+  virtual void Line(float start_x,
+                    float start_y,
+                    float end_x,
+                    float end_y,
+                    float thickness,
+                    int color,
+                    float opacity) = 0;
+
+  virtual void Rect(float left,
+                    float top,
+                    float right,
+                    float bottom,
+                    int color,
+                    float opacity) = 0;
+
+  virtual void Outline(float left,
+                       float top,
+                       float right,
+                       float bottom,
+                       float thickness,
+                       int color,
+                       float opacity) = 0;
+
+  void TextBuffer(ColoredTextBuffer* buffer,
+                  float left,
+                  float top,
+                  float width,
+                  float height,
+                  int x_offset_chars,
+                  int y_offset_lines,
+                  float font_size);
+
+  // Colors for COLOR_PALETTE_FLAG indices used by text buffers
+  void SetPalette(const std::vector<int>& colors);
+
+  // Rules applied to the visible lines of text buffers, nullptr - none
+  void SetHighlighter(std::shared_ptr<const HighlightEngine> highlighter);
+
+  virtual float GetAdvance(float font_size) const = 0;
+
+  float GetLineWidth(float font_size, int num_chars) const;
+
+  virtual float GetLineHeight(float font_size) const = 0;
+
+  // Glyph of codepoint in the backend font, 0 if the font has none
+  virtual uint16_t GetGlyphIndex(char32_t codepoint) = 0;
+
+ protected:
+  virtual void OnBeginFrame() {}
+
+  virtual void OnEndFrame() {}
+
+  // Around the drawing of each TextBuffer() call
+  virtual void OnBeginTextBuffer(float left,
+                                 float top,
+                                 float right,
+                                 float bottom);
+  virtual void OnEndTextBuffer();
+
+  // glyphs stay valid until the end of the frame
+  virtual void DrawGlyphs(const uint16_t* glyphs,
+                          int length,
+                          float font_size,
+                          float x,
+                          float y,
+                          int color,
+                          int underline_color,
+                          float opacity) = 0;
+
+  // Draws a run of a cached text buffer line. Recorders override it to keep
+  // a reference to the line instead of copying its glyphs.
+  virtual void DrawLineRun(const std::shared_ptr<const PreparedLine>& line,
+                           const GlyphRun& run,
+                           float font_size,
+                           float x,
+                           float y,
+                           int color,
+                           int underline_color);
+
+  // Call when glyph indices change, e.g. after loading another font
+  void ResetGlyphCache();
+
+ private:
+  friend class RenderCommandList;  // Replays glyph runs
+
+  // Callers hold m_styleMutex
+  int ResolveColor(int color) const;
+
+  LineRenderCache m_lineCache;
+  std::vector<uint16_t> m_textGlyphs;  // Glyphs of Text() calls in a frame
+  size_t m_textGlyphsPos = 0;
+  std::vector<int> m_palette;
+  // Guards the palette and the highlighter of m_lineCache
+  std::mutex m_styleMutex;
+};
+
+}  // namespace MTerm
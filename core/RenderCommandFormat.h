@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Binary layout of RenderCommandList, shared by the passes that rewrite it.
+// Every command is an opcode byte followed by the record of that opcode.
+namespace MTerm::RenderCommands {
+
+enum Opcode : uint8_t {
+  kClear = 1,
+  kLine,
+  kRect,
+  kOutline,
+  kGlyphs,
+  kBeginTextBuffer,
+  kEndTextBuffer,
+};
+
+struct ClearRecord {
+  int32_t color;
+};
+
+struct LineRecord {
+  float start_x;
+  float start_y;
+  float end_x;
+  float end_y;
+  float thickness;
+  int32_t color;
+  float opacity;
+};
+
+struct RectRecord {
+  float left;
+  float top;
+  float right;
+  float bottom;
+  int32_t color;
+  float opacity;
+};
+
+struct OutlineRecord {
+  float left;
+  float top;
+  float right;
+  float bottom;
+  float thickness;
+  int32_t color;
+  float opacity;
+};
+
+struct GlyphsRecord {
+  uint32_t source;  // 0 for the list's glyphs, n for its line n - 1
+  uint32_t offset;
+  uint32_t length;
+  float font_size;
+  float x;
+  float y;
+  int32_t color;
+  int32_t underline_color;
+  float opacity;
+};
+
+// Commands between this and kEndTextBuffer were drawn by one TextBuffer()
+// call inside these bounds: backgrounds and glyph runs on a character grid
+struct BeginTextBufferRecord {
+  float left;
+  float top;
+  float right;
+  float bottom;
+};
+
+struct EndTextBufferRecord {};
+
+inline size_t RecordSize(uint8_t opcode) {
+  switch (opcode) {
+    case kClear:
+      return sizeof(ClearRecord);
+    case kLine:
+      return sizeof(LineRecord);
+    case kRect:
+      return sizeof(RectRecord);
+    case kOutline:
+      return sizeof(OutlineRecord);
+    case kGlyphs:
+      return sizeof(GlyphsRecord);
+    case kBeginTextBuffer:
+      return sizeof(BeginTextBufferRecord);
+    case kEndTextBuffer:
+      return 0;
+  }
+  return SIZE_MAX;
+}
+
+template <typename T>
+T ReadRecord(const uint8_t* data) {
+  T record;
+  memcpy(&record, data, sizeof(T));
+  return record;
+}
+
+template <typename T>
+void AppendRecord(std::vector<uint8_t>& commands,
+                  uint8_t opcode,
+                  const T& record) {
+  size_t pos = commands.size();
+  commands.resize(pos + 1 + RecordSize(opcode));
+  commands[pos] = opcode;
+  memcpy(commands.data() + pos + 1, &record, RecordSize(opcode));
+}
+
+// Calls fn(opcode, record data) for every command
+template <typename Fn>
+void ForEachCommand(const std::vector<uint8_t>& commands, Fn&& fn) {
+  size_t pos = 0;
+  while (pos < commands.size()) {
+    uint8_t opcode = commands[pos++];
+    size_t size = RecordSize(opcode);
+    if (size == SIZE_MAX || commands.size() - pos < size) {
+      throw std::runtime_error("Corrupt render command list");
+    }
+    fn(opcode, commands.data() + pos);
+    pos += size;
+  }
+}
+
+}  // namespace MTerm::RenderCommands
@@ -0,0 +1,465 @@
+#include "RenderCommandList.h"
+
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+
+#include "RenderCommandFormat.h"
+
+namespace MTerm {
+
+using namespace RenderCommands;
+
+namespace {
+
+constexpr char kMagic[4] = {'M', 'T', 'C', 'L'};
+constexpr uint32_t kFormatVersion = 2;
+
+struct SerializedHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t command_count;
+  uint32_t commands_size;
+  uint32_t glyph_count;
+};
+
+void FormatColor(std::string& out, int color) {
+  char buf[16];
+  if (color < 0) {
+    snprintf(buf, sizeof(buf), " %d", color);
+  } else {
+    snprintf(buf, sizeof(buf), " #%06x", color);
+  }
+  out += buf;
+}
+
+void FormatFloats(std::string& out, std::initializer_list<float> values) {
+  char buf[32];
+  for (float value : values) {
+    snprintf(buf, sizeof(buf), " %g", value);
+    out += buf;
+  }
+}
+
+}  // namespace
+
+RenderCommandList::RenderCommandList() {}
+
+RenderCommandList::~RenderCommandList() {}
+
+void RenderCommandList::Reset() {
+  m_commands.clear();
+  m_commandCount = 0;
+  m_glyphs.clear();
+  m_lines.clear();
+}
+
+template <typename T>
+void RenderCommandList::Append(uint8_t opcode, const T& record) {
+  AppendRecord(m_commands, opcode, record);
+  m_commandCount++;
+}
+
+void RenderCommandList::Clear(int color) {
+  Append(kClear, ClearRecord{color});
+}
+
+void RenderCommandList::Line(float start_x,
+                             float start_y,
+                             float end_x,
+                             float end_y,
+                             float thickness,
+                             int color,
+                             float opacity) {
+  Append(kLine, LineRecord{start_x, start_y, end_x, end_y, thickness, color,
+                           opacity});
+}
+
+void RenderCommandList::Rect(float left,
+                             float top,
+                             float right,
+                             float bottom,
+                             int color,
+                             float opacity) {
+  Append(kRect, RectRecord{left, top, right, bottom, color, opacity});
+}
+
+void RenderCommandList::Outline(float left,
+                                float top,
+                                float right,
+                                float bottom,
+                                float thickness,
+                                int color,
+                                float opacity) {
+  Append(kOutline,
+         OutlineRecord{left, top, right, bottom, thickness, color, opacity});
+}
+
+void RenderCommandList::Glyphs(const uint16_t* glyphs,
+                               int length,
+                               float font_size,
+                               float x,
+                               float y,
+                               int color,
+                               int underline_color,
+                               float opacity) {
+  if (length <= 0) {
+    return;
+  }
+  uint32_t offset = static_cast<uint32_t>(m_glyphs.size());
+  m_glyphs.insert(m_glyphs.end(), glyphs, glyphs + length);
+  Append(kGlyphs, GlyphsRecord{0, offset, static_cast<uint32_t>(length),
+                               font_size, x, y, color, underline_color,
+                               opacity});
+}
+
+void RenderCommandList::LineRun(const std::shared_ptr<const PreparedLine>& line,
+                                const GlyphRun& run,
+                                float font_size,
+                                float x,
+                                float y,
+                                int color,
+                                int underline_color) {
+  if (run.length <= 0) {
+    return;
+  }
+  // Runs of a line are drawn one after another
+  if (m_lines.empty() || m_lines.back() != line) {
+    m_lines.push_back(line);
+  }
+  Append(kGlyphs, GlyphsRecord{static_cast<uint32_t>(m_lines.size()),
+                               run.glyph_offset,
+                               static_cast<uint32_t>(run.length), font_size, x,
+                               y, color, underline_color, 1.0f});
+}
+
+void RenderCommandList::BeginTextBuffer(float left,
+                                        float top,
+                                        float right,
+                                        float bottom) {
+  Append(kBeginTextBuffer, BeginTextBufferRecord{left, top, right, bottom});
+}
+
+void RenderCommandList::EndTextBuffer() {
+  Append(kEndTextBuffer, EndTextBufferRecord{});
+}
+
+const uint16_t* RenderCommandList::GetGlyphs(uint32_t source,
+                                             uint32_t offset) const {
+  if (source == 0) {
+    return m_glyphs.data() + offset;
+  }
+  return m_lines[source - 1]->glyphs.data() + offset;
+}
+
+void RenderCommandList::Replay(RenderBackend& backend) const {
+  ForEachCommand(m_commands, [&](uint8_t opcode, const uint8_t* data) {
+    switch (opcode) {
+      case kClear: {
+        auto r = ReadRecord<ClearRecord>(data);
+        backend.Clear(r.color);
+        break;
+      }
+      case kLine: {
+        auto r = ReadRecord<LineRecord>(data);
+        backend.Line(r.start_x, r.start_y, r.end_x, r.end_y, r.thickness,
+                     r.color, r.opacity);
+        break;
+      }
+      case kRect: {
+        auto r = ReadRecord<RectRecord>(data);
+        backend.Rect(r.left, r.top, r.right, r.bottom, r.color, r.opacity);
+        break;
+      }
+      case kOutline: {
+        auto r = ReadRecord<OutlineRecord>(data);
+        backend.Outline(r.left, r.top, r.right, r.bottom, r.thickness,
+                        r.color, r.opacity);
+        break;
+      }
+      case kGlyphs: {
+        auto r = ReadRecord<GlyphsRecord>(data);
+        backend.DrawGlyphs(GetGlyphs(r.source, r.offset),
+                           static_cast<int>(r.length), r.font_size, r.x, r.y,
+                           r.color, r.underline_color, r.opacity);
+        break;
+      }
+    }
+  });
+}
+
+size_t RenderCommandList::GetCommandCount() const {
+  return m_commandCount;
+}
+
+size_t RenderCommandList::GetSize() const {
+  return m_commands.size();
+}
+
+std::string RenderCommandList::Dump() const {
+  std::string out;
+  ForEachCommand(m_commands, [&](uint8_t opcode, const uint8_t* data) {
+    switch (opcode) {
+      case kClear: {
+        auto r = ReadRecord<ClearRecord>(data);
+        out += "clear";
+        FormatColor(out, r.color);
+        break;
+      }
+      case kLine: {
+        auto r = ReadRecord<LineRecord>(data);
+        out += "line";
+        FormatFloats(out, {r.start_x, r.start_y, r.end_x, r.end_y, r.thickness});
+        FormatColor(out, r.color);
+        FormatFloats(out, {r.opacity});
+        break;
+      }
+      case kRect: {
+        auto r = ReadRecord<RectRecord>(data);
+        out += "rect";
+        FormatFloats(out, {r.left, r.top, r.right, r.bottom});
+        FormatColor(out, r.color);
+        FormatFloats(out, {r.opacity});
+        break;
+      }
+      case kOutline: {
+        auto r = ReadRecord<OutlineRecord>(data);
+        out += "outline";
+        FormatFloats(out, {r.left, r.top, r.right, r.bottom, r.thickness});
+        FormatColor(out, r.color);
+        FormatFloats(out, {r.opacity});
+        break;
+      }
+      case kGlyphs: {
+        auto r = ReadRecord<GlyphsRecord>(data);
+        char buf[64];
+        snprintf(buf, sizeof(buf), "glyphs %u:%u+%u", r.source, r.offset,
+                 r.length);
+        out += buf;
+        FormatFloats(out, {r.font_size, r.x, r.y});
+        FormatColor(out, r.color);
+        FormatColor(out, r.underline_color);
+        FormatFloats(out, {r.opacity});
+        break;
+      }
+      case kBeginTextBuffer: {
+        auto r = ReadRecord<BeginTextBufferRecord>(data);
+        out += "text_buffer";
+        FormatFloats(out, {r.left, r.top, r.right, r.bottom});
+        break;
+      }
+      case kEndTextBuffer:
+        out += "end_text_buffer";
+        break;
+    }
+    out += '\n';
+  });
+  return out;
+}
+
+std::vector<uint8_t> RenderCommandList::Serialize() const {
+  // Glyphs of referenced lines go after the list's own ones
+  std::vector<uint8_t> commands = m_commands;
+  std::vector<uint16_t> glyphs = m_glyphs;
+  size_t pos = 0;
+  ForEachCommand(m_commands, [&](uint8_t opcode, const uint8_t* data) {
+    pos++;
+    if (opcode == kGlyphs) {
+      auto r = ReadRecord<GlyphsRecord>(data);
+      if (r.source != 0) {
+        const uint16_t* line_glyphs = GetGlyphs(r.source, r.offset);
+        r.source = 0;
+        r.offset = static_cast<uint32_t>(glyphs.size());
+        glyphs.insert(glyphs.end(), line_glyphs, line_glyphs + r.length);
+        memcpy(commands.data() + pos, &r, sizeof(r));
+      }
+    }
+    pos += RecordSize(opcode);
+  });
+
+  SerializedHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFormatVersion;
+  header.command_count = static_cast<uint32_t>(m_commandCount);
+  header.commands_size = static_cast<uint32_t>(commands.size());
+  header.glyph_count = static_cast<uint32_t>(glyphs.size());
+
+  size_t glyphs_size = glyphs.size() * sizeof(uint16_t);
+  std::vector<uint8_t> out(sizeof(header) + commands.size() + glyphs_size);
+  uint8_t* dst = out.data();
+  memcpy(dst, &header, sizeof(header));
+  dst += sizeof(header);
+  if (!commands.empty()) {
+    memcpy(dst, commands.data(), commands.size());
+    dst += commands.size();
+  }
+  if (!glyphs.empty()) {
+    memcpy(dst, glyphs.data(), glyphs_size);
+  }
+  return out;
+}
+
+RenderCommandList RenderCommandList::Deserialize(const uint8_t* data,
+                                                 size_t size) {
+  SerializedHeader header;
+  if (size < sizeof(header)) {
+    throw std::runtime_error("Render command list is truncated");
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kFormatVersion) {
+    throw std::runtime_error("Not a render command list");
+  }
+  size_t glyphs_size = size_t{header.glyph_count} * sizeof(uint16_t);
+  if (size - sizeof(header) != size_t{header.commands_size} + glyphs_size) {
+    throw std::runtime_error("Render command list is truncated");
+  }
+
+  RenderCommandList list;
+  const uint8_t* src = data + sizeof(header);
+  list.m_commands.assign(src, src + header.commands_size);
+  src += header.commands_size;
+  list.m_glyphs.resize(header.glyph_count);
+  if (glyphs_size > 0) {
+    memcpy(list.m_glyphs.data(), src, glyphs_size);
+  }
+
+  size_t count = 0;
+  ForEachCommand(list.m_commands, [&](uint8_t opcode, const uint8_t* record) {
+    count++;
+    if (opcode != kGlyphs) {
+      return;
+    }
+    auto r = ReadRecord<GlyphsRecord>(record);
+    if (r.source != 0 || r.offset > header.glyph_count ||
+        r.length > header.glyph_count - r.offset) {
+      throw std::runtime_error("Corrupt render command list");
+    }
+  });
+  if (count != header.command_count) {
+    throw std::runtime_error("Corrupt render command list");
+  }
+  list.m_commandCount = count;
+  return list;
+}
+
+RenderCommandRecorder::RenderCommandRecorder(RenderBackend& target)
+    : m_target(target) {}
+
+RenderCommandRecorder::~RenderCommandRecorder() {}
+
+void RenderCommandRecorder::SetList(RenderCommandList* list) {
+  m_list = list;
+}
+
+int RenderCommandRecorder::GetWidth() const {
+  return m_target.GetWidth();
+}
+
+int RenderCommandRecorder::GetHeight() const {
+  return m_target.GetHeight();
+}
+
+void RenderCommandRecorder::Clear(int color) {
+  if (m_list) {
+    m_list->Clear(color);
+  }
+}
+
+void RenderCommandRecorder::Line(float start_x,
+                                 float start_y,
+                                 float end_x,
+                                 float end_y,
+                                 float thickness,
+                                 int color,
+                                 float opacity) {
+  if (m_list) {
+    m_list->Line(start_x, start_y, end_x, end_y, thickness, color, opacity);
+  }
+}
+
+void RenderCommandRecorder::Rect(float left,
+                                 float top,
+                                 float right,
+                                 float bottom,
+                                 int color,
+                                 float opacity) {
+  if (m_list) {
+    m_list->Rect(left, top, right, bottom, color, opacity);
+  }
+}
+
+void RenderCommandRecorder::Outline(float left,
+                                    float top,
+                                    float right,
+                                    float bottom,
+                                    float thickness,
+                                    int color,
+                                    float opacity) {
+  if (m_list) {
+    m_list->Outline(left, top, right, bottom, thickness, color, opacity);
+  }
+}
+
+float RenderCommandRecorder::GetAdvance(float font_size) const {
+  return m_target.GetAdvance(font_size);
+}
+
+float RenderCommandRecorder::GetLineHeight(float font_size) const {
+  return m_target.GetLineHeight(font_size);
+}
+
+uint16_t RenderCommandRecorder::GetGlyphIndex(char32_t codepoint) {
+  return m_target.GetGlyphIndex(codepoint);
+}
+
+void RenderCommandRecorder::OnBeginFrame() {
+  if (m_list) {
+    m_list->Reset();
+  }
+}
+
+void RenderCommandRecorder::OnBeginTextBuffer(float left,
+                                              float top,
+                                              float right,
+                                              float bottom) {
+  if (m_list) {
+    m_list->BeginTextBuffer(left, top, right, bottom);
+  }
+}
+
+void RenderCommandRecorder::OnEndTextBuffer() {
+  if (m_list) {
+    m_list->EndTextBuffer();
+  }
+}
+
+void RenderCommandRecorder::DrawGlyphs(const uint16_t* glyphs,
+                                       int length,
+                                       float font_size,
+                                       float x,
+                                       float y,
+                                       int color,
+                                       int underline_color,
+                                       float opacity) {
+  if (m_list) {
+    m_list->Glyphs(glyphs, length, font_size, x, y, color, underline_color,
+                   opacity);
+  }
+}
+
+void RenderCommandRecorder::DrawLineRun(
+    const std::shared_ptr<const PreparedLine>& line,
+    const GlyphRun& run,
+    float font_size,
+    float x,
+    float y,
+    int color,
+    int underline_color) {
+  if (m_list) {
+    m_list->LineRun(line, run, font_size, x, y, color, underline_color);
+  }
+}
+
+}  // namespace MTerm
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LineRenderCache.h"
+#include "RenderBackend.h"
+
+namespace MTerm {
+
+// One frame of drawing commands in a compact binary form, recorded on one
+// thread and replayed on another. Every command is an opcode byte followed
+// by a fixed-size record. Glyphs are not copied into the records: they
+// refer to a range of the list's own glyph storage (for Text() calls) or of
+// a prepared text buffer line that the list keeps alive.
+class RenderCommandList {
+ public:
+  RenderCommandList();
+  ~RenderCommandList();
+
+  // Forgets all commands but keeps the memory for the next frame
+  void Reset();
+
+  void Clear(int color);
+
+  void Line(float start_x,
+            float start_y,
+            float end_x,
+            float end_y,
+            float thickness,
+            int color,
+            float opacity);
+
+  void Rect(float left,
+            float top,
+            float right,
+            float bottom,
+            int color,
+            float opacity);
+
+  void Outline(float left,
+               float top,
+               float right,
+               float bottom,
+               float thickness,
+               int color,
+               float opacity);
+
+  // Copies glyphs, they are usually a temporary of a Text() call
+  void Glyphs(const uint16_t* glyphs,
+              int length,
+              float font_size,
+              float x,
+              float y,
+              int color,
+              int underline_color,
+              float opacity);
+
+  void LineRun(const std::shared_ptr<const PreparedLine>& line,
+               const GlyphRun& run,
+               float font_size,
+               float x,
+               float y,
+               int color,
+               int underline_color);
+
+  // Mark the commands of one TextBuffer() call, which DrawBatcher may
+  // reorder and merge. Replay ignores the marks.
+  void BeginTextBuffer(float left, float top, float right, float bottom);
+  void EndTextBuffer();
+
+  // Draws the commands in order, between BeginFrame() and EndFrame()
+  void Replay(RenderBackend& backend) const;
+
+  // Including text buffer marks
+  size_t GetCommandCount() const;
+
+  // Bytes of command records, without glyphs
+  size_t GetSize() const;
+
+  // One command per line, e.g. "rect 0 0 100 20 #1e1e1e 1"
+  std::string Dump() const;
+
+  // Self-contained copy with the glyphs of referenced lines inlined, for
+  // replaying a frame offline. Native byte order.
+  std::vector<uint8_t> Serialize() const;
+
+  // Throws std::runtime_error on malformed data
+  static RenderCommandList Deserialize(const uint8_t* data, size_t size);
+
+ private:
+  friend class DrawBatcher;
+
+  template <typename T>
+  void Append(uint8_t opcode, const T& record);
+
+  const uint16_t* GetGlyphs(uint32_t source, uint32_t offset) const;
+
+  std::vector<uint8_t> m_commands;
+  size_t m_commandCount = 0;
+  std::vector<uint16_t> m_glyphs;
+  // Source n > 0 of a glyph command is m_lines[n - 1]
+  std::vector<std::shared_ptr<const PreparedLine>> m_lines;
+};
+
+// Backend that records drawing into a command list instead of rasterizing.
+// Glyph indices and metrics come from the target, so the recorded frame
+// can be replayed there.
+class RenderCommandRecorder : public RenderBackend {
+ public:
+  // target must outlive the recorder
+  explicit RenderCommandRecorder(RenderBackend& target);
+  ~RenderCommandRecorder() override;
+
+  // Frames are recorded into list, which BeginFrame() resets. Drawing while
+  // no list is set is ignored.
+  void SetList(RenderCommandList* list);
+
+  int GetWidth() const override;
+  int GetHeight() const override;
+
+  void Clear(int color) override;
+
+  void Line(float start_x,
+            float start_y,
+            float end_x,
+            float end_y,
+            float thickness,
+            int color,
+            float opacity) override;
+
+  void Rect(float left,
+            float top,
+            float right,
+            float bottom,
+            int color,
+            float opacity) override;
+
+  void Outline(float left,
+               float top,
+               float right,
+               float bottom,
+               float thickness,
+               int color,
+               float opacity) override;
+
+  float GetAdvance(float font_size) const override;
+  float GetLineHeight(float font_size) const override;
+
+  uint16_t GetGlyphIndex(char32_t codepoint) override;
+
+ protected:
+  void OnBeginFrame() override;
+
+  void OnBeginTextBuffer(float left,
+                         float top,
+                         float right,
+                         float bottom) override;
+  void OnEndTextBuffer() override;
+
+  void DrawGlyphs(const uint16_t* glyphs,
+                  int length,
+                  float font_size,
+                  float x,
+                  float y,
+                  int color,
+                  int underline_color,
+                  float opacity) override;
+
+  void DrawLineRun(const std::shared_ptr<const PreparedLine>& line,
+                   const GlyphRun& run,
+                   float font_size,
+                   float x,
+                   float y,
+                   int color,
+                   int underline_color) override;
+
+ private:
+  RenderBackend& m_target;
+  RenderCommandList* m_list = nullptr;
+};
+
+}  // namespace MTerm
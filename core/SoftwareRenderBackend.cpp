@@ -0,0 +1,332 @@
+#include "SoftwareRenderBackend.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace MTerm {
+
+namespace {
+
+constexpr int kGlyphColumns = 5;
+constexpr int kGlyphRows = 7;
+
+// Cell proportions in font size units
+constexpr float kAdvanceEm = 0.6f;
+constexpr float kLineHeightEm = 1.2f;
+constexpr float kGlyphTopEm = 0.15f;
+constexpr float kGlyphHeightEm = 0.875f;
+constexpr float kUnderlineEm = 1.1f;
+
+// Rows of 5 pixels, bit 4 is the leftmost column. Glyph 0 is the box drawn
+// for characters without a bitmap, glyphs 1-95 are U+0020-U+007E.
+constexpr uint8_t kFont[][kGlyphRows] = {
+    {0x1F, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1F},  // box
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // space
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04},  // !
+    {0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00},  // "
+    {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A},  // #
+    {0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04},  // $
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03},  // %
+    {0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D},  // &
+    {0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00},  // '
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02},  // (
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08},  // )
+    {0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00},  // *
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00},  // +
+    {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08},  // ,
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00},  // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C},  // .
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00},  // /
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E},  // 0
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},  // 1
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F},  // 2
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},  // 3
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02},  // 4
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},  // 5
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E},  // 6
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},  // 7
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E},  // 8
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},  // 9
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00},  // :
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08},  // ;
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02},  // <
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00},  // =
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08},  // >
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04},  // ?
+    {0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E},  // @
+    {0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11},  // A
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},  // B
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},  // C
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},  // D
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},  // E
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},  // F
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},  // G
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},  // H
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},  // I
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},  // J
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},  // K
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},  // L
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11},  // M
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},  // N
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},  // O
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},  // P
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D},  // Q
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},  // R
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},  // S
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},  // T
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},  // U
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},  // V
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A},  // W
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},  // X
+    {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04},  // Y
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},  // Z
+    {0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E},  // [
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00},  // backslash
+    {0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E},  // ]
+    {0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00},  // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F},  // _
+    {0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00},  // `
+    {0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F},  // a
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E},  // b
+    {0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E},  // c
+    {0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F},  // d
+    {0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E},  // e
+    {0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08},  // f
+    {0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E},  // g
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11},  // h
+    {0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E},  // i
+    {0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C},  // j
+    {0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12},  // k
+    {0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},  // l
+    {0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11},  // m
+    {0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11},  // n
+    {0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E},  // o
+    {0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10},  // p
+    {0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01},  // q
+    {0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10},  // r
+    {0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E},  // s
+    {0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06},  // t
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D},  // u
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04},  // v
+    {0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A},  // w
+    {0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11},  // x
+    {0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E},  // y
+    {0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F},  // z
+    {0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02},  // {
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},  // |
+    {0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08},  // }
+    {0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00},  // ~
+};
+
+constexpr size_t kNumGlyphs = sizeof(kFont) / sizeof(kFont[0]);
+
+// Index of the first pixel whose center is at or after pos
+int PixelEdge(float pos) {
+  return static_cast<int>(std::ceil(pos - 0.5f));
+}
+
+int ToAlpha(float opacity) {
+  return static_cast<int>(std::clamp(opacity, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+}  // namespace
+
+static_assert(kNumGlyphs == 96, "Font must cover U+0020-U+007E");
+
+SoftwareRenderBackend::SoftwareRenderBackend(int width, int height) {
+  Resize(width, height);
+}
+
+SoftwareRenderBackend::~SoftwareRenderBackend() {}
+
+void SoftwareRenderBackend::Resize(int width, int height) {
+  m_width = std::max(width, 0);
+  m_height = std::max(height, 0);
+  m_pixels.assign(static_cast<size_t>(m_width) * m_height * 4, 0);
+}
+
+int SoftwareRenderBackend::GetWidth() const {
+  return m_width;
+}
+
+int SoftwareRenderBackend::GetHeight() const {
+  return m_height;
+}
+
+const uint8_t* SoftwareRenderBackend::GetPixels() const {
+  return m_pixels.data();
+}
+
+size_t SoftwareRenderBackend::GetPixelsSize() const {
+  return m_pixels.size();
+}
+
+void SoftwareRenderBackend::Clear(int color) {
+  for (size_t i = 0; i < m_pixels.size(); i += 4) {
+    m_pixels[i] = static_cast<uint8_t>(color >> 16);
+    m_pixels[i + 1] = static_cast<uint8_t>(color >> 8);
+    m_pixels[i + 2] = static_cast<uint8_t>(color);
+    m_pixels[i + 3] = 0xFF;
+  }
+}
+
+void SoftwareRenderBackend::BlendSpan(int x0,
+                                      int x1,
+                                      int y,
+                                      int color,
+                                      int alpha) {
+  x0 = std::max(x0, 0);
+  x1 = std::min(x1, m_width);
+  if (y < 0 || y >= m_height || x0 >= x1) {
+    return;
+  }
+  int src[3] = {(color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF};
+  uint8_t* pixel = m_pixels.data() + (static_cast<size_t>(y) * m_width + x0) * 4;
+  for (int x = x0; x < x1; x++, pixel += 4) {
+    for (int c = 0; c < 3; c++) {
+      pixel[c] = static_cast<uint8_t>(
+          pixel[c] + ((src[c] - pixel[c]) * alpha + 127) / 255);
+    }
+    pixel[3] = 0xFF;
+  }
+}
+
+void SoftwareRenderBackend::FillRect(float left,
+                                     float top,
+                                     float right,
+                                     float bottom,
+                                     int color,
+                                     int alpha) {
+  if (color == -1 || alpha == 0) {
+    return;
+  }
+  int x0 = PixelEdge(left);
+  int x1 = PixelEdge(right);
+  int y0 = std::max(PixelEdge(top), 0);
+  int y1 = std::min(PixelEdge(bottom), m_height);
+  for (int y = y0; y < y1; y++) {
+    BlendSpan(x0, x1, y, color, alpha);
+  }
+}
+
+void SoftwareRenderBackend::Line(float start_x,
+                                 float start_y,
+                                 float end_x,
+                                 float end_y,
+                                 float thickness,
+                                 int color,
+                                 float opacity) {
+  int alpha = ToAlpha(opacity);
+  float half = thickness / 2;
+  if (start_x == end_x || start_y == end_y) {
+    // Axis-aligned lines are rectangles with the thickness across
+    FillRect(std::min(start_x, end_x) - (start_x == end_x ? half : 0),
+             std::min(start_y, end_y) - (start_y == end_y ? half : 0),
+             std::max(start_x, end_x) + (start_x == end_x ? half : 0),
+             std::max(start_y, end_y) + (start_y == end_y ? half : 0), color,
+             alpha);
+    return;
+  }
+  // Pixels whose centers are within half the thickness of the segment
+  float dx = end_x - start_x;
+  float dy = end_y - start_y;
+  float length_sq = dx * dx + dy * dy;
+  int x0 = std::max(PixelEdge(std::min(start_x, end_x) - half), 0);
+  int x1 = std::min(PixelEdge(std::max(start_x, end_x) + half), m_width);
+  int y0 = std::max(PixelEdge(std::min(start_y, end_y) - half), 0);
+  int y1 = std::min(PixelEdge(std::max(start_y, end_y) + half), m_height);
+  for (int y = y0; y < y1; y++) {
+    for (int x = x0; x < x1; x++) {
+      float px = x + 0.5f - start_x;
+      float py = y + 0.5f - start_y;
+      float t = std::clamp((px * dx + py * dy) / length_sq, 0.0f, 1.0f);
+      float ex = px - t * dx;
+      float ey = py - t * dy;
+      if (ex * ex + ey * ey <= half * half) {
+        BlendSpan(x, x + 1, y, color, alpha);
+      }
+    }
+  }
+}
+
+void SoftwareRenderBackend::Rect(float left,
+                                 float top,
+                                 float right,
+                                 float bottom,
+                                 int color,
+                                 float opacity) {
+  FillRect(left, top, right, bottom, color, ToAlpha(opacity));
+}
+
+void SoftwareRenderBackend::Outline(float left,
+                                    float top,
+                                    float right,
+                                    float bottom,
+                                    float thickness,
+                                    int color,
+                                    float opacity) {
+  // Stroke centered on the edges like Direct2D, corners drawn once
+  int alpha = ToAlpha(opacity);
+  float half = thickness / 2;
+  FillRect(left - half, top - half, right + half, top + half, color, alpha);
+  FillRect(left - half, bottom - half, right + half, bottom + half, color,
+           alpha);
+  FillRect(left - half, top + half, left + half, bottom - half, color, alpha);
+  FillRect(right - half, top + half, right + half, bottom - half, color,
+           alpha);
+}
+
+float SoftwareRenderBackend::GetAdvance(float font_size) const {
+  return kAdvanceEm * font_size;
+}
+
+float SoftwareRenderBackend::GetLineHeight(float font_size) const {
+  return kLineHeightEm * font_size;
+}
+
+uint16_t SoftwareRenderBackend::GetGlyphIndex(char32_t codepoint) {
+  if (codepoint >= U' ' && codepoint < U' ' + kNumGlyphs - 1) {
+    return static_cast<uint16_t>(codepoint - U' ' + 1);
+  }
+  return 0;
+}
+
+void SoftwareRenderBackend::DrawGlyphs(const uint16_t* glyphs,
+                                       int length,
+                                       float font_size,
+                                       float x,
+                                       float y,
+                                       int color,
+                                       int underline_color,
+                                       float opacity) {
+  int alpha = ToAlpha(opacity);
+  float advance = GetAdvance(font_size);
+  if (color != -1) {
+    // The glyph fills 5 of the 6 columns of a cell
+    float dot_width = advance / (kGlyphColumns + 1);
+    float dot_height = kGlyphHeightEm * font_size / kGlyphRows;
+    float glyph_top = y + kGlyphTopEm * font_size;
+    for (int i = 0; i < length; i++) {
+      const uint8_t* rows = kFont[glyphs[i] < kNumGlyphs ? glyphs[i] : 0];
+      float glyph_left = x + advance * i;
+      for (int row = 0; row < kGlyphRows; row++) {
+        float dot_top = glyph_top + dot_height * row;
+        for (int column = 0; column < kGlyphColumns; column++) {
+          if (rows[row] & (0x10 >> column)) {
+            float dot_left = glyph_left + dot_width * column;
+            FillRect(dot_left, dot_top, dot_left + dot_width,
+                     dot_top + dot_height, color, alpha);
+          }
+        }
+      }
+    }
+  }
+  if (underline_color != -1) {
+    float underline_y = y + kUnderlineEm * font_size;
+    float thickness = std::max(1.0f, font_size / 14);
+    FillRect(x, underline_y - thickness / 2, x + advance * length,
+             underline_y + thickness / 2, underline_color, alpha);
+  }
+}
+
+}  // namespace MTerm
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RenderBackend.h"
+
+namespace MTerm {
+
+// Rasterizes into an in-memory framebuffer with a built-in 5x7 bitmap font
+// (printable ASCII, other characters are drawn as boxes). No anti-aliasing,
+// so frames are deterministic and can be compared byte for byte.
+class SoftwareRenderBackend : public RenderBackend {
+ public:
+  SoftwareRenderBackend(int width, int height);
+  ~SoftwareRenderBackend() override;
+
+  // Reallocates the framebuffer, its contents are undefined until Clear()
+  void Resize(int width, int height);
+
+  int GetWidth() const override;
+  int GetHeight() const override;
+
+  // Rows top to bottom, 4 bytes per pixel in R, G, B, A order
+  const uint8_t* GetPixels() const;
+
+  size_t GetPixelsSize() const;
+
+  void Clear(int color) override;
+
+  void Line(float start_x,
+            float start_y,
+            float end_x,
+            float end_y,
+            float thickness,
+            int color,
+            float opacity) override;
+
+  void Rect(float left,
+            float top,
+            float right,
+            float bottom,
+            int color,
+            float opacity) override;
+
+  void Outline(float left,
+               float top,
+               float right,
+               float bottom,
+               float thickness,
+               int color,
+               float opacity) override;
+
+  float GetAdvance(float font_size) const override;
+  float GetLineHeight(float font_size) const override;
+
+  uint16_t GetGlyphIndex(char32_t codepoint) override;
+
+ protected:
+  void DrawGlyphs(const uint16_t* glyphs,
+                  int length,
+                  float font_size,
+                  float x,
+                  float y,
+                  int color,
+                  int underline_color,
+                  float opacity) override;
+
+ private:
+  // Covers pixels whose centers lie inside the rectangle
+  void FillRect(float left,
+                float top,
+                float right,
+                float bottom,
+                int color,
+                int alpha);
+
+  void BlendSpan(int x0, int x1, int y, int color, int alpha);
+
+  int m_width = 0;
+  int m_height = 0;
+  std::vector<uint8_t> m_pixels;
+};
+
+}  // namespace MTerm
@@ -0,0 +1,343 @@
+#include "SpillFile.h"
+
+#ifdef _WIN32
+#include "Windows.h"
+
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace MTerm {
+
+class SpillFile::Impl {
+ private:
+  struct Pending {
+    uint64_t offset;
+    std::string data;
+  };
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<Pending> m_pending;  // Ascending offsets, front is being written
+  // Appends that failed to write (disk full, I/O error) stay in memory
+  std::map<uint64_t, std::string> m_unwritten;
+  std::vector<std::pair<uint64_t, uint64_t>> m_discarded;
+  size_t m_pendingSize = 0;
+  uint64_t m_size = 0;
+  uint64_t m_writtenSize = 0;  // Everything below is on disk or in m_unwritten
+  uint64_t m_fileSize = 0;     // End of the last successful write
+  bool m_isOpen = false;
+  bool m_stopping = false;
+  std::thread m_writerThread;
+
+#ifdef _WIN32
+  HANDLE m_file = INVALID_HANDLE_VALUE;
+  HANDLE m_mapping = nullptr;
+#else
+  int m_fd = -1;
+#endif
+  const char* m_view = nullptr;
+  uint64_t m_viewSize = 0;
+
+ public:
+  ~Impl() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_cv.notify_all();
+    if (m_writerThread.joinable()) {
+      m_writerThread.join();
+    }
+    Unmap();
+#ifdef _WIN32
+    if (m_file != INVALID_HANDLE_VALUE)
+      CloseHandle(m_file);
+#else
+    if (m_fd >= 0)
+      close(m_fd);
+#endif
+  }
+
+  uint64_t Append(std::string&& data) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_isOpen) {
+      Open();
+      m_isOpen = true;
+      m_writerThread = std::thread(&Impl::WriterThread, this);
+    }
+    uint64_t offset = m_size;
+    m_size += data.size();
+    m_pendingSize += data.size();
+    m_pending.push_back({offset, std::move(data)});
+    lock.unlock();
+    m_cv.notify_one();
+    return offset;
+  }
+
+  void Read(uint64_t offset, size_t size, std::string& out) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (offset + size > m_size) {
+      throw std::runtime_error("Spill file read out of range");
+    }
+    auto unwritten = m_unwritten.upper_bound(offset);
+    if (unwritten != m_unwritten.begin()) {
+      --unwritten;
+      uint64_t skip = offset - unwritten->first;
+      if (skip < unwritten->second.size()) {
+        out.assign(unwritten->second, static_cast<size_t>(skip), size);
+        return;
+      }
+    }
+    if (offset + size > m_writtenSize) {
+      // Still queued: pending entries are whole appends
+      auto it = std::upper_bound(
+          m_pending.begin(), m_pending.end(), offset,
+          [](uint64_t value, const Pending& pending) {
+            return value < pending.offset;
+          });
+      if (it == m_pending.begin()) {
+        throw std::runtime_error("Spill file read out of range");
+      }
+      --it;
+      out.assign(it->data, static_cast<size_t>(offset - it->offset), size);
+      return;
+    }
+    if (offset + size > m_viewSize) {
+      Map(m_fileSize);
+    }
+    out.assign(m_view + offset, size);
+  }
+
+  void Discard(uint64_t offset, size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_isOpen) {
+        return;
+      }
+      auto unwritten = m_unwritten.find(offset);
+      if (unwritten != m_unwritten.end()) {
+        m_pendingSize -= unwritten->second.size();
+        m_unwritten.erase(unwritten);
+        return;
+      }
+      m_discarded.push_back({offset, size});
+    }
+    m_cv.notify_one();
+  }
+
+  uint64_t GetSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+  }
+
+  size_t GetPendingSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pendingSize;
+  }
+
+ private:
+  void WriterThread() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_cv.wait(lock, [this] {
+        return m_stopping || !m_pending.empty() || !m_discarded.empty();
+      });
+      if (m_stopping) {
+        return;
+      }
+      if (!m_discarded.empty()) {
+        auto discarded = std::move(m_discarded);
+        m_discarded.clear();
+        lock.unlock();
+        for (const auto& [offset, size] : discarded) {
+          PunchHole(offset, size);
+        }
+        lock.lock();
+        continue;
+      }
+      // The entry stays readable from the queue until it is on disk
+      const Pending& pending = m_pending.front();
+      lock.unlock();
+      bool written =
+          WriteAt(pending.offset, pending.data.data(), pending.data.size());
+      lock.lock();
+      m_writtenSize = pending.offset + pending.data.size();
+      if (written) {
+        m_fileSize = m_writtenSize;
+        m_pendingSize -= pending.data.size();
+      } else {
+        m_unwritten.emplace(pending.offset, std::move(m_pending.front().data));
+      }
+      m_pending.pop_front();
+    }
+  }
+
+#ifdef _WIN32
+  void Open() {
+    wchar_t directory[MAX_PATH];
+    wchar_t path[MAX_PATH];
+    if (!GetTempPathW(MAX_PATH, directory) ||
+        !GetTempFileNameW(directory, L"mtm", 0, path)) {
+      throw std::runtime_error("Failed to create scrollback spill file");
+    }
+    m_file = CreateFileW(
+        path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+        nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+      throw std::runtime_error("Failed to create scrollback spill file");
+    }
+    DWORD returned;
+    DeviceIoControl(m_file, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0,
+                    &returned, nullptr);
+  }
+
+  bool WriteAt(uint64_t offset, const char* data, size_t size) {
+    while (size > 0) {
+      OVERLAPPED ovl{};
+      ovl.Offset = static_cast<DWORD>(offset);
+      ovl.OffsetHigh = static_cast<DWORD>(offset >> 32);
+      DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1 << 30));
+      DWORD written = 0;
+      if (!WriteFile(m_file, data, chunk, &written, &ovl) || written == 0) {
+        return false;
+      }
+      offset += written;
+      data += written;
+      size -= written;
+    }
+    return true;
+  }
+
+  void PunchHole(uint64_t offset, uint64_t size) {
+    FILE_ZERO_DATA_INFORMATION info;
+    info.FileOffset.QuadPart = static_cast<LONGLONG>(offset);
+    info.BeyondFinalZero.QuadPart = static_cast<LONGLONG>(offset + size);
+    DWORD returned;
+    DeviceIoControl(m_file, FSCTL_SET_ZERO_DATA, &info, sizeof(info), nullptr,
+                    0, &returned, nullptr);
+  }
+
+  void Map(uint64_t size) {
+    Unmap();
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY,
+                                   static_cast<DWORD>(size >> 32),
+                                   static_cast<DWORD>(size), nullptr);
+    if (!m_mapping) {
+      throw std::runtime_error("Failed to map scrollback spill file");
+    }
+    m_view = static_cast<const char*>(
+        MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, static_cast<SIZE_T>(size)));
+    if (!m_view) {
+      throw std::runtime_error("Failed to map scrollback spill file");
+    }
+    m_viewSize = size;
+  }
+
+  void Unmap() {
+    if (m_view) {
+      UnmapViewOfFile(m_view);
+      m_view = nullptr;
+    }
+    if (m_mapping) {
+      CloseHandle(m_mapping);
+      m_mapping = nullptr;
+    }
+    m_viewSize = 0;
+  }
+#else
+  void Open() {
+    const char* directory = getenv("TMPDIR");
+    std::string path = directory && *directory ? directory : "/tmp";
+    path += "/mterm-spill-XXXXXX";
+    m_fd = mkstemp(&path[0]);
+    if (m_fd < 0) {
+      throw std::runtime_error("Failed to create scrollback spill file");
+    }
+    unlink(path.c_str());
+  }
+
+  bool WriteAt(uint64_t offset, const char* data, size_t size) {
+    while (size > 0) {
+      ssize_t written = pwrite(m_fd, data, size, static_cast<off_t>(offset));
+      if (written <= 0) {
+        return false;
+      }
+      offset += written;
+      data += written;
+      size -= written;
+    }
+    return true;
+  }
+
+  void PunchHole(uint64_t offset, uint64_t size) {
+#ifdef FALLOC_FL_PUNCH_HOLE
+    fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              static_cast<off_t>(offset), static_cast<off_t>(size));
+#else
+    (void)offset;
+    (void)size;
+#endif
+  }
+
+  void Map(uint64_t size) {
+    Unmap();
+    void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (view == MAP_FAILED) {
+      throw std::runtime_error("Failed to map scrollback spill file");
+    }
+    m_view = static_cast<const char*>(view);
+    m_viewSize = size;
+  }
+
+  void Unmap() {
+    if (m_view) {
+      munmap(const_cast<char*>(m_view), m_viewSize);
+      m_view = nullptr;
+    }
+    m_viewSize = 0;
+  }
+#endif
+};
+
+SpillFile::SpillFile() : m_impl(std::make_unique<Impl>()) {}
+
+SpillFile::~SpillFile() {}
+
+uint64_t SpillFile::Append(std::string&& data) {
+  return m_impl->Append(std::move(data));
+}
+
+void SpillFile::Read(uint64_t offset, size_t size, std::string& out) {
+  m_impl->Read(offset, size, out);
+}
+
+void SpillFile::Discard(uint64_t offset, size_t size) {
+  m_impl->Discard(offset, size);
+}
+
+uint64_t SpillFile::GetSize() const {
+  return m_impl->GetSize();
+}
+
+size_t SpillFile::GetPendingSize() const {
+  return m_impl->GetPendingSize();
+}
+
+}  // namespace MTerm
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace MTerm {
+
+// Append-only temporary file for scrollback that does not fit in memory.
+// Appends are queued and written by a background thread, so the caller never
+// waits for the disk; reads go through a read-only memory map, or come
+// straight from the queue if the data is not written yet. Appends that fail
+// to write (disk full, I/O error) stay in memory. The file is created on
+// first use and deleted when the object is destroyed.
+class SpillFile {
+ public:
+  SpillFile();
+  ~SpillFile();
+
+  // Takes the data and returns its offset in the file. Throws
+  // std::runtime_error, leaving data untouched, if the file cannot be created.
+  uint64_t Append(std::string&& data);
+
+  // Replaces out with size bytes at offset
+  void Read(uint64_t offset, size_t size, std::string& out);
+
+  // Releases the disk space of a range that is no longer referenced
+  void Discard(uint64_t offset, size_t size);
+
+  uint64_t GetSize() const;
+
+  // Bytes held in memory: queued, or kept after a failed write
+  size_t GetPendingSize() const;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> m_impl;
+};
+
+}  // namespace MTerm
@@ -0,0 +1,331 @@
+#include "TrigramIndex.h"
+
+#include <algorithm>
+
+#include "Utils.h"
+
+namespace MTerm {
+
+namespace {
+
+constexpr size_t kInitialSlots = 1024;
+
+// Posting lists longer than the shortest candidate set by this factor cost
+// more to decode than verifying the candidates
+constexpr size_t kMaxIntersectRatio = 16;
+
+// Candidates left after which no more lists are intersected
+constexpr size_t kEnoughCandidates = 8;
+
+const size_t kInlineCapacity = std::string().capacity();
+
+inline uint64_t MakeKey(char32_t a, char32_t b, char32_t c) {
+  // Code points take 21 bits; + 1 keeps 0 free for empty slots
+  return ((static_cast<uint64_t>(a) << 42) | (static_cast<uint64_t>(b) << 21) |
+          c) +
+         1;
+}
+
+inline char32_t Fold(char32_t c) {
+  if (c < 0x80) {
+    return c - U'A' < 26 ? c + 0x20 : c;
+  }
+  return Utils::FoldCase(c);
+}
+
+inline size_t HashKey(uint64_t key, size_t mask) {
+  return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+void WriteVarint(std::string& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void AddRange(std::vector<std::pair<uint64_t, uint64_t>>& ranges,
+              uint64_t begin,
+              uint64_t end) {
+  if (begin >= end) {
+    return;
+  }
+  if (!ranges.empty() && ranges.back().second >= begin) {
+    ranges.back().second = std::max(ranges.back().second, end);
+  } else {
+    ranges.emplace_back(begin, end);
+  }
+}
+
+}  // namespace
+
+size_t TrigramIndex::Segment::GetMemory() const {
+  return slots.capacity() * sizeof(Slot) +
+         lists.capacity() * sizeof(std::string) + heap_bytes;
+}
+
+TrigramIndex::TrigramIndex(size_t budget) : m_budget(budget) {}
+
+size_t TrigramIndex::GetBudget() const {
+  return m_budget;
+}
+
+void TrigramIndex::SetBudget(size_t budget) {
+  m_budget = budget;
+  while (m_memory > m_budget && m_segments.size() > 1) {
+    DropFrontSegment();
+  }
+}
+
+uint64_t TrigramIndex::GetBegin() const {
+  return m_begin;
+}
+
+uint64_t TrigramIndex::GetEnd() const {
+  return m_end;
+}
+
+void TrigramIndex::GetKeys(const char32_t* text,
+                           size_t length,
+                           std::vector<uint64_t>& keys) {
+  keys.clear();
+  if (length < 3) {
+    return;
+  }
+  char32_t a = Fold(text[0]);
+  char32_t b = Fold(text[1]);
+  for (size_t i = 2; i < length; i++) {
+    char32_t c = Fold(text[i]);
+    // Padding of resized lines
+    if (a != U' ' || b != U' ' || c != U' ') {
+      keys.push_back(MakeKey(a, b, c));
+    }
+    a = b;
+    b = c;
+  }
+}
+
+TrigramIndex::Slot& TrigramIndex::FindOrAddSlot(Segment& segment,
+                                               uint64_t key) {
+  if ((segment.lists.size() + 1) * 2 > segment.slots.size()) {
+    std::vector<Slot> old_slots(
+        std::max(kInitialSlots, segment.slots.size() * 2), Slot{0, 0, 0});
+    old_slots.swap(segment.slots);
+    size_t mask = segment.slots.size() - 1;
+    for (const Slot& slot : old_slots) {
+      if (slot.key != 0) {
+        size_t i = HashKey(slot.key, mask);
+        while (segment.slots[i].key != 0) {
+          i = (i + 1) & mask;
+        }
+        segment.slots[i] = slot;
+      }
+    }
+  }
+  size_t mask = segment.slots.size() - 1;
+  size_t i = HashKey(key, mask);
+  while (segment.slots[i].key != 0) {
+    if (segment.slots[i].key == key) {
+      return segment.slots[i];
+    }
+    i = (i + 1) & mask;
+  }
+  segment.slots[i] = {key, static_cast<uint32_t>(segment.lists.size()), 0};
+  segment.lists.emplace_back();
+  return segment.slots[i];
+}
+
+const std::string* TrigramIndex::FindList(const Segment& segment,
+                                          uint64_t key) {
+  if (segment.slots.empty()) {
+    return nullptr;
+  }
+  size_t mask = segment.slots.size() - 1;
+  size_t i = HashKey(key, mask);
+  while (segment.slots[i].key != 0) {
+    if (segment.slots[i].key == key) {
+      return &segment.lists[segment.slots[i].list];
+    }
+    i = (i + 1) & mask;
+  }
+  return nullptr;
+}
+
+void TrigramIndex::Decode(const std::string& list, std::vector<uint32_t>& out) {
+  out.clear();
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(list.data());
+  const uint8_t* end = p + list.size();
+  uint32_t offset = 0;
+  while (p < end) {
+    uint32_t delta = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+      delta |= static_cast<uint32_t>(*p++ & 0x7F) << shift;
+      shift += 7;
+    }
+    delta |= static_cast<uint32_t>(*p++) << shift;
+    offset += delta;
+    out.push_back(offset - 1);
+  }
+}
+
+void TrigramIndex::AddLine(const char32_t* text, size_t length) {
+  if (m_segments.empty() ||
+      m_segments.back().end - m_segments.back().begin == INDEX_SEGMENT_LINES) {
+    m_segments.push_back(Segment{m_end, m_end, {}, {}});
+  }
+  Segment& segment = m_segments.back();
+  size_t memory = segment.GetMemory();
+  uint32_t position =
+      static_cast<uint32_t>((m_end - segment.begin) / INDEX_GROUP_LINES) + 1;
+  GetKeys(text, length, m_keys);
+  for (uint64_t key : m_keys) {
+    Slot& slot = FindOrAddSlot(segment, key);
+    if (slot.last == position) {
+      continue;  // Trigram repeated within the group
+    }
+    std::string& list = segment.lists[slot.list];
+    size_t capacity = list.capacity();
+    WriteVarint(list, position - slot.last);
+    slot.last = position;
+    if (list.capacity() != capacity) {
+      segment.heap_bytes +=
+          list.capacity() - (capacity > kInlineCapacity ? capacity : 0);
+    }
+  }
+  segment.end++;
+  m_end++;
+  m_memory += segment.GetMemory() - memory;
+  while (m_memory > m_budget && m_segments.size() > 1) {
+    DropFrontSegment();
+  }
+}
+
+void TrigramIndex::DropFrontSegment() {
+  const Segment& segment = m_segments.front();
+  m_memory -= segment.GetMemory();
+  m_droppedLines += segment.end - std::max(segment.begin, m_begin);
+  m_segments.pop_front();
+  m_begin = m_segments.empty() ? m_end : m_segments.front().begin;
+  m_dirty.erase(m_dirty.begin(), m_dirty.lower_bound(m_begin));
+}
+
+void TrigramIndex::MarkDirty(uint64_t line) {
+  if (line >= m_begin && line < m_end) {
+    m_dirty.insert(line);
+  }
+}
+
+void TrigramIndex::Reset(uint64_t line) {
+  m_segments.clear();
+  m_dirty.clear();
+  m_memory = 0;
+  m_begin = m_end = line;
+}
+
+void TrigramIndex::Trim(uint64_t line) {
+  if (line <= m_begin) {
+    return;
+  }
+  while (!m_segments.empty() && m_segments.front().end <= line) {
+    m_memory -= m_segments.front().GetMemory();
+    m_segments.pop_front();
+  }
+  m_begin = std::min(line, m_end);
+  m_dirty.erase(m_dirty.begin(), m_dirty.lower_bound(m_begin));
+}
+
+bool TrigramIndex::FindCandidates(
+    const char32_t* needle,
+    size_t length,
+    uint64_t begin,
+    uint64_t end,
+    std::vector<std::pair<uint64_t, uint64_t>>& ranges) const {
+  std::vector<uint64_t> keys;
+  GetKeys(needle, length, keys);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  if (keys.empty()) {
+    return false;
+  }
+
+  AddRange(ranges, begin, std::min(end, m_begin));
+  std::vector<const std::string*> lists;
+  std::vector<uint32_t> candidates, offsets, merged;
+  for (const Segment& segment : m_segments) {
+    uint64_t first = std::max({begin, segment.begin, m_begin});
+    uint64_t last = std::min(end, segment.end);
+    if (first >= last) {
+      continue;
+    }
+
+    // The rarest trigrams first
+    lists.clear();
+    for (uint64_t key : keys) {
+      const std::string* list = FindList(segment, key);
+      if (!list) {
+        lists.clear();
+        break;
+      }
+      lists.push_back(list);
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const std::string* a, const std::string* b) {
+                return a->size() < b->size();
+              });
+    candidates.clear();
+    if (!lists.empty()) {
+      Decode(*lists[0], candidates);
+      for (size_t i = 1; i < lists.size(); i++) {
+        if (candidates.size() <= kEnoughCandidates ||
+            lists[i]->size() >
+                candidates.size() * kMaxIntersectRatio) {
+          break;
+        }
+        Decode(*lists[i], offsets);
+        merged.clear();
+        std::set_intersection(candidates.begin(), candidates.end(),
+                              offsets.begin(), offsets.end(),
+                              std::back_inserter(merged));
+        candidates.swap(merged);
+      }
+    }
+
+    // Whole groups, with the dirty lines between them
+    auto dirty = m_dirty.lower_bound(first);
+    for (uint32_t group : candidates) {
+      uint64_t group_begin =
+          std::max(first, segment.begin + group * INDEX_GROUP_LINES);
+      uint64_t group_end =
+          std::min(last, segment.begin + (group + 1) * INDEX_GROUP_LINES);
+      if (group_begin >= group_end) {
+        continue;
+      }
+      for (; dirty != m_dirty.end() && *dirty < group_begin; ++dirty) {
+        AddRange(ranges, *dirty, *dirty + 1);
+      }
+      AddRange(ranges, group_begin, group_end);
+    }
+    for (; dirty != m_dirty.end() && *dirty < last; ++dirty) {
+      AddRange(ranges, *dirty, *dirty + 1);
+    }
+  }
+  AddRange(ranges, std::max(begin, m_end), end);
+  return true;
+}
+
+SearchIndexStats TrigramIndex::GetStats() const {
+  SearchIndexStats stats = {};
+  stats.indexed_lines = m_end - m_begin;
+  stats.dropped_lines = m_droppedLines;
+  stats.segments = m_segments.size();
+  for (const Segment& segment : m_segments) {
+    stats.trigrams += segment.lists.size();
+  }
+  stats.memory_bytes = m_memory;
+  stats.dirty_lines = m_dirty.size();
+  return stats;
+}
+
+}  // namespace MTerm
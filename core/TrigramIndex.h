@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace MTerm {
+
+// Newest lines of a buffer that are not indexed: the screen and what a
+// program may still redraw above it
+constexpr size_t INDEX_LAG_LINES = 1024;
+constexpr size_t INDEX_SEGMENT_LINES = 65536;
+
+// Posting lists hold groups of lines: neighbouring lines share most of
+// their trigrams, and verifying a few extra lines is cheaper than indexing
+// each one
+constexpr size_t INDEX_GROUP_LINES = 8;
+
+struct SearchIndexStats {
+  uint64_t indexed_lines;
+  uint64_t dropped_lines;  // Dropped to stay within the budget
+  size_t segments;
+  size_t trigrams;  // Distinct per segment, summed
+  size_t memory_bytes;
+  size_t dirty_lines;
+};
+
+// Case-insensitive trigram index that narrows a literal search to the
+// groups of INDEX_GROUP_LINES lines containing every trigram of the needle.
+// Lines are absolute numbers, added in order and grouped into segments of
+// INDEX_SEGMENT_LINES, each with a hash table of posting lists (varint
+// group deltas). The oldest segments are
+// dropped once their lines are evicted or the index outgrows its budget;
+// the segment being filled is always kept. Lines changed after they were
+// indexed are marked dirty and always searched.
+class TrigramIndex {
+ public:
+  explicit TrigramIndex(size_t budget);
+
+  size_t GetBudget() const;
+
+  void SetBudget(size_t budget);
+
+  // Lines [GetBegin(), GetEnd()) are indexed
+  uint64_t GetBegin() const;
+
+  uint64_t GetEnd() const;
+
+  // Indexes line GetEnd()
+  void AddLine(const char32_t* text, size_t length);
+
+  void MarkDirty(uint64_t line);
+
+  // Drops everything, the next line added is line
+  void Reset(uint64_t line);
+
+  // Drops the segments that only hold lines before line
+  void Trim(uint64_t line);
+
+  // Appends to ranges, in order, the parts of lines [begin, end) that can
+  // contain needle: candidate and dirty lines, and lines the index does not
+  // cover. Returns false, appending nothing, if the needle has no trigram
+  // to look up.
+  bool FindCandidates(const char32_t* needle,
+                      size_t length,
+                      uint64_t begin,
+                      uint64_t end,
+                      std::vector<std::pair<uint64_t, uint64_t>>& ranges) const;
+
+  SearchIndexStats GetStats() const;
+
+ private:
+  struct Slot {
+    uint64_t key;   // 0 - empty
+    uint32_t list;  // Posting list: varint distances between groups
+    uint32_t last;  // Last group in the list, plus one
+  };
+
+  struct Segment {
+    uint64_t begin;
+    uint64_t end;
+    std::vector<Slot> slots;  // Open addressing, power of two
+    std::vector<std::string> lists;
+    size_t heap_bytes = 0;  // Posting lists that outgrew the inline buffer
+
+    size_t GetMemory() const;
+  };
+
+  // Trigram keys of text, folded; blank trigrams are not indexed
+  static void GetKeys(const char32_t* text,
+                      size_t length,
+                      std::vector<uint64_t>& keys);
+
+  static Slot& FindOrAddSlot(Segment& segment, uint64_t key);
+
+  static const std::string* FindList(const Segment& segment, uint64_t key);
+
+  static void Decode(const std::string& list, std::vector<uint32_t>& out);
+
+  void DropFrontSegment();
+
+  size_t m_budget;
+  uint64_t m_begin = 0;
+  uint64_t m_end = 0;
+  std::deque<Segment> m_segments;
+  std::set<uint64_t> m_dirty;
+  size_t m_memory = 0;
+  uint64_t m_droppedLines = 0;
+  std::vector<uint64_t> m_keys;
+};
+
+}  // namespace MTerm
@@ -1,77 +1,586 @@
 #include "Utils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <stdexcept>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MTERM_X86_64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define MTERM_TARGET_AVX2
+#else
+#define MTERM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 namespace MTerm {
 
-void Utils::Utf8ToUtf32(const char* utf8,
-                        size_t size,
-                        std::vector<char32_t>& utf32) {
+namespace {
+
+inline int CountTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+inline bool IsControlByte(uint8_t byte) {
+  return byte < 0x20 || byte == 0x7F;
+}
+
+size_t FindControlByteScalar(const char* data, size_t size) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    if (IsControlByte(bytes[i])) {
+      return i;
+    }
+  }
+  return size;
+}
+
+// The first and the last code point of the needle are known to match at
+// start, compares the rest
+inline bool MatchesAt(const char32_t* text,
+                      size_t start,
+                      const char32_t* needle,
+                      size_t needle_length) {
+  return needle_length <= 2 ||
+         std::equal(needle + 1, needle + needle_length - 1, text + start + 1);
+}
+
+size_t FindUtf32Scalar(const char32_t* text,
+                       size_t length,
+                       const char32_t* needle,
+                       size_t needle_length) {
+  if (needle_length == 0) {
+    return 0;
+  }
+  if (needle_length > length) {
+    return length;
+  }
+  char32_t first = needle[0];
+  char32_t last = needle[needle_length - 1];
+  for (size_t i = 0; i + needle_length <= length; i++) {
+    if (text[i] == first && text[i + needle_length - 1] == last &&
+        MatchesAt(text, i, needle, needle_length)) {
+      return i;
+    }
+  }
+  return length;
+}
+
+#ifdef MTERM_X86_64
+size_t FindControlByteSse2(const char* data, size_t size) {
+  const __m128i max_control = _mm_set1_epi8(0x1F);
+  const __m128i del = _mm_set1_epi8(0x7F);
   size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    // x <= 0x1F  <=>  max(x, 0x1F) == 0x1F
+    __m128i is_control =
+        _mm_cmpeq_epi8(_mm_max_epu8(chunk, max_control), max_control);
+    __m128i is_del = _mm_cmpeq_epi8(chunk, del);
+    uint32_t mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_or_si128(is_control, is_del)));
+    if (mask != 0) {
+      return i + CountTrailingZeros(mask);
+    }
+  }
+  return i + FindControlByteScalar(data + i, size - i);
+}
 
-  while (i < size) {
-    uint32_t codepoint = 0;
-    uint8_t byte = utf8[i];
+MTERM_TARGET_AVX2 size_t FindControlByteAvx2(const char* data, size_t size) {
+  const __m256i max_control = _mm256_set1_epi8(0x1F);
+  const __m256i del = _mm256_set1_epi8(0x7F);
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    __m256i is_control = _mm256_cmpeq_epi8(
+        _mm256_max_epu8(chunk, max_control), max_control);
+    __m256i is_del = _mm256_cmpeq_epi8(chunk, del);
+    uint32_t mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_or_si256(is_control, is_del)));
+    if (mask != 0) {
+      return i + CountTrailingZeros(mask);
+    }
+  }
+  return i + FindControlByteSse2(data + i, size - i);
+}
 
-    if ((byte & 0x80) == 0) {
-      // 1-byte sequence
-      codepoint = byte;
-      i += 1;
-    } else if ((byte & 0xE0) == 0xC0) {
-      // 2-byte sequence
-      if (i + 1 >= size)
-        throw std::runtime_error("Truncated UTF-8 sequence");
-      codepoint = ((byte & 0x1F) << 6) | (utf8[i + 1] & 0x3F);
-      i += 2;
-    } else if ((byte & 0xF0) == 0xE0) {
-      // 3-byte sequence
-      if (i + 2 >= size)
-        throw std::runtime_error("Truncated UTF-8 sequence");
-      codepoint = ((byte & 0x0F) << 12) | ((utf8[i + 1] & 0x3F) << 6) |
-                  (utf8[i + 2] & 0x3F);
-      i += 3;
-    } else if ((byte & 0xF8) == 0xF0) {
-      // 4-byte sequence
-      if (i + 3 >= size)
-        throw std::runtime_error("Truncated UTF-8 sequence");
-      codepoint = ((byte & 0x07) << 18) | ((utf8[i + 1] & 0x3F) << 12) |
-                  ((utf8[i + 2] & 0x3F) << 6) | (utf8[i + 3] & 0x3F);
-      i += 4;
+// Compares the first code point of the needle with the candidate starts and
+// the last one with the code points needle_length - 1 further, 4 or 8
+// starts at a time; only starts where both match are verified
+size_t FindUtf32Sse2(const char32_t* text,
+                     size_t length,
+                     const char32_t* needle,
+                     size_t needle_length) {
+  if (needle_length == 0 || needle_length > length) {
+    return FindUtf32Scalar(text, length, needle, needle_length);
+  }
+  const __m128i first = _mm_set1_epi32(static_cast<int>(needle[0]));
+  const __m128i last =
+      _mm_set1_epi32(static_cast<int>(needle[needle_length - 1]));
+  size_t starts = length - needle_length + 1;
+  size_t i = 0;
+  for (; i + 4 <= starts; i += 4) {
+    __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    __m128i tail = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(text + i + needle_length - 1));
+    __m128i candidates = _mm_and_si128(_mm_cmpeq_epi32(head, first),
+                                       _mm_cmpeq_epi32(tail, last));
+    uint32_t mask = static_cast<uint32_t>(
+        _mm_movemask_ps(_mm_castsi128_ps(candidates)));
+    while (mask != 0) {
+      size_t start = i + CountTrailingZeros(mask);
+      if (MatchesAt(text, start, needle, needle_length)) {
+        return start;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return i + FindUtf32Scalar(text + i, length - i, needle, needle_length);
+}
+
+MTERM_TARGET_AVX2 size_t FindUtf32Avx2(const char32_t* text,
+                                       size_t length,
+                                       const char32_t* needle,
+                                       size_t needle_length) {
+  if (needle_length == 0 || needle_length > length) {
+    return FindUtf32Scalar(text, length, needle, needle_length);
+  }
+  const __m256i first = _mm256_set1_epi32(static_cast<int>(needle[0]));
+  const __m256i last =
+      _mm256_set1_epi32(static_cast<int>(needle[needle_length - 1]));
+  size_t starts = length - needle_length + 1;
+  size_t i = 0;
+  for (; i + 8 <= starts; i += 8) {
+    __m256i head =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+    __m256i tail = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(text + i + needle_length - 1));
+    __m256i candidates = _mm256_and_si256(_mm256_cmpeq_epi32(head, first),
+                                          _mm256_cmpeq_epi32(tail, last));
+    uint32_t mask = static_cast<uint32_t>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(candidates)));
+    while (mask != 0) {
+      size_t start = i + CountTrailingZeros(mask);
+      if (MatchesAt(text, start, needle, needle_length)) {
+        return start;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return i + FindUtf32Sse2(text + i, length - i, needle, needle_length);
+}
+
+bool CpuSupportsAvx2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;  // OS does not preserve YMM registers
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+SimdLevel DetectSimdLevel() {
+#ifdef MTERM_X86_64
+  return CpuSupportsAvx2() ? SimdLevel::Avx2 : SimdLevel::Sse2;
+#else
+  return SimdLevel::Scalar;
+#endif
+}
+
+const SimdLevel kSupportedSimdLevel = DetectSimdLevel();
+std::atomic<SimdLevel> g_simdLevel = kSupportedSimdLevel;
+
+constexpr char32_t kReplacementChar = 0xFFFD;
+
+enum class DecodeResult { Ok, Invalid, Truncated };
+
+inline bool IsContinuation(uint8_t byte) {
+  return (byte & 0xC0) == 0x80;
+}
+
+// Decodes one sequence starting at data[i] and advances i. For malformed
+// input i is moved past the longest valid prefix (at least one byte).
+inline DecodeResult DecodeSequence(const uint8_t* data,
+                                   size_t size,
+                                   size_t& i,
+                                   char32_t& codepoint) {
+  uint8_t lead = data[i];
+  int length;
+  uint8_t min_second = 0x80;
+  uint8_t max_second = 0xBF;
+  if (lead < 0x80) {
+    codepoint = lead;
+    i += 1;
+    return DecodeResult::Ok;
+  } else if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+    codepoint = lead & 0x1F;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    codepoint = lead & 0x0F;
+    if (lead == 0xE0) {
+      min_second = 0xA0;  // Overlong
+    } else if (lead == 0xED) {
+      max_second = 0x9F;  // Surrogates
+    }
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    codepoint = lead & 0x07;
+    if (lead == 0xF0) {
+      min_second = 0x90;  // Overlong
+    } else if (lead == 0xF4) {
+      max_second = 0x8F;  // Above U+10FFFF
+    }
+  } else {
+    i += 1;
+    return DecodeResult::Invalid;
+  }
+  for (int k = 1; k < length; k++) {
+    if (i + k >= size) {
+      i = size;
+      return DecodeResult::Truncated;
+    }
+    uint8_t byte = data[i + k];
+    bool valid = k == 1 ? (byte >= min_second && byte <= max_second)
+                        : IsContinuation(byte);
+    if (!valid) {
+      i += k;
+      return DecodeResult::Invalid;
+    }
+    codepoint = (codepoint << 6) | (byte & 0x3F);
+  }
+  i += length;
+  return DecodeResult::Ok;
+}
+
+// Decodes data[i..end) sequence by sequence, sequences may extend past end
+inline void DecodeRange(const uint8_t* data,
+                        size_t size,
+                        size_t& i,
+                        size_t end,
+                        char32_t* out,
+                        size_t& written,
+                        bool strict) {
+  while (i < end) {
+    if (data[i] < 0x80) {
+      out[written++] = data[i++];
+      continue;
+    }
+    char32_t codepoint;
+    DecodeResult result = DecodeSequence(data, size, i, codepoint);
+    if (result == DecodeResult::Ok) {
+      out[written++] = codepoint;
+    } else if (strict) {
+      throw std::runtime_error(result == DecodeResult::Truncated
+                                   ? "Truncated UTF-8 sequence"
+                                   : "Invalid UTF-8 sequence");
     } else {
-      throw std::runtime_error("Invalid UTF-8 byte");
+      out[written++] = kReplacementChar;
     }
+  }
+}
 
-    utf32.push_back(static_cast<char32_t>(codepoint));
+size_t DecodeUtf8Scalar(const uint8_t* data,
+                        size_t size,
+                        char32_t* out,
+                        bool strict) {
+  size_t i = 0;
+  size_t written = 0;
+  DecodeRange(data, size, i, size, out, written, strict);
+  return written;
+}
+
+inline size_t EncodedLength(char32_t codepoint) {
+  // Invalid values are written as U+FFFD, which takes 3 bytes
+  return 1 + (codepoint >= 0x80) + (codepoint >= 0x800) +
+         (codepoint >= 0x10000 && codepoint <= 0x10FFFF);
+}
+
+inline char* EncodeRange(const char32_t* utf32,
+                         size_t start,
+                         size_t end,
+                         char* out,
+                         bool strict) {
+  for (size_t i = start; i < end; i++) {
+    char32_t codepoint = utf32[i];
+    if (codepoint < 0x80) {
+      *out++ = static_cast<char>(codepoint);
+      continue;
+    }
+    if ((codepoint >= 0xD800 && codepoint <= 0xDFFF) ||
+        codepoint > 0x10FFFF) {
+      if (strict) {
+        throw std::runtime_error("Invalid UTF-32 codepoint");
+      }
+      codepoint = kReplacementChar;
+    }
+    int out_len;
+    Utils::Utf32CharToUtf8(codepoint, out, out_len);
+    out += out_len;
   }
+  return out;
 }
 
-void Utils::Utf32ToUtf8(const char32_t* utf32,
+#ifdef MTERM_X86_64
+size_t DecodeUtf8Sse2(const uint8_t* data,
+                      size_t size,
+                      char32_t* out,
+                      bool strict) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  size_t written = 0;
+  while (i + 16 <= size) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    if (_mm_movemask_epi8(chunk) != 0) {
+      DecodeRange(data, size, i, i + 16, out, written, strict);
+      continue;
+    }
+    // All ASCII: zero-extend 16 bytes to 16 code points
+    __m128i lo16 = _mm_unpacklo_epi8(chunk, zero);
+    __m128i hi16 = _mm_unpackhi_epi8(chunk, zero);
+    __m128i* dst = reinterpret_cast<__m128i*>(out + written);
+    _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(lo16, zero));
+    _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo16, zero));
+    _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi16, zero));
+    _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi16, zero));
+    i += 16;
+    written += 16;
+  }
+  DecodeRange(data, size, i, size, out, written, strict);
+  return written;
+}
+
+MTERM_TARGET_AVX2 size_t DecodeUtf8Avx2(const uint8_t* data,
+                                        size_t size,
+                                        char32_t* out,
+                                        bool strict) {
+  size_t i = 0;
+  size_t written = 0;
+  while (i + 32 <= size) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    if (_mm256_movemask_epi8(chunk) != 0) {
+      DecodeRange(data, size, i, i + 32, out, written, strict);
+      continue;
+    }
+    __m256i* dst = reinterpret_cast<__m256i*>(out + written);
+    for (int k = 0; k < 4; k++) {
+      __m128i bytes =
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data + i + k * 8));
+      _mm256_storeu_si256(dst + k, _mm256_cvtepu8_epi32(bytes));
+    }
+    i += 32;
+    written += 32;
+  }
+  DecodeRange(data, size, i, size, out, written, strict);
+  return written;
+}
+
+void EncodeUtf8Sse2(const char32_t* utf32,
+                    size_t length,
+                    char* out,
+                    bool strict) {
+  const __m128i non_ascii = _mm_set1_epi32(~0x7F);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf32 + i));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf32 + i + 4));
+    __m128i high = _mm_and_si128(_mm_or_si128(a, b), non_ascii);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, zero)) != 0xFFFF) {
+      out = EncodeRange(utf32, i, i + 8, out, strict);
+      continue;
+    }
+    // All ASCII: narrow 8 code points to 8 bytes
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), zero);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), packed);
+    out += 8;
+  }
+  EncodeRange(utf32, i, length, out, strict);
+}
+#endif
+
+size_t DecodeUtf8(const uint8_t* data,
+                  size_t size,
+                  char32_t* out,
+                  bool strict) {
+#ifdef MTERM_X86_64
+  switch (g_simdLevel.load(std::memory_order_relaxed)) {
+    case SimdLevel::Avx2:
+      return DecodeUtf8Avx2(data, size, out, strict);
+    case SimdLevel::Sse2:
+      return DecodeUtf8Sse2(data, size, out, strict);
+    default:
+      break;
+  }
+#endif
+  return DecodeUtf8Scalar(data, size, out, strict);
+}
+
+void EncodeUtf8(const char32_t* utf32, size_t length, char* out, bool strict) {
+#ifdef MTERM_X86_64
+  if (g_simdLevel.load(std::memory_order_relaxed) != SimdLevel::Scalar) {
+    EncodeUtf8Sse2(utf32, length, out, strict);
+    return;
+  }
+#endif
+  EncodeRange(utf32, 0, length, out, strict);
+}
+
+size_t Utf8Length(const char32_t* utf32, size_t length) {
+  size_t total = 0;
+  for (size_t i = 0; i < length; i++) {
+    total += EncodedLength(utf32[i]);
+  }
+  return total;
+}
+
+}  // namespace
+
+SimdLevel Utils::GetSupportedSimdLevel() {
+  return kSupportedSimdLevel;
+}
+
+SimdLevel Utils::GetSimdLevel() {
+  return g_simdLevel.load(std::memory_order_relaxed);
+}
+
+void Utils::SetSimdLevel(SimdLevel level) {
+  if (level > kSupportedSimdLevel) {
+    level = kSupportedSimdLevel;
+  }
+  g_simdLevel.store(level, std::memory_order_relaxed);
+}
+
+size_t Utils::FindControlByte(const char* data, size_t size) {
+#ifdef MTERM_X86_64
+  switch (g_simdLevel.load(std::memory_order_relaxed)) {
+    case SimdLevel::Avx2:
+      return FindControlByteAvx2(data, size);
+    case SimdLevel::Sse2:
+      return FindControlByteSse2(data, size);
+    default:
+      break;
+  }
+#endif
+  return FindControlByteScalar(data, size);
+}
+
+size_t Utils::FindUtf32(const char32_t* text,
                         size_t length,
-                        std::vector<char>& utf8) {
-  for (int i = 0; i < length; i++) {
-    char32_t codepoint = utf32[i];
-    if (codepoint <= 0x7F) {
-      // 1-byte sequence
-      utf8.push_back(static_cast<char>(codepoint));
-    } else if (codepoint <= 0x7FF) {
-      // 2-byte sequence
-      utf8.push_back(static_cast<char>(0xC0 | ((codepoint >> 6) & 0x1F)));
-      utf8.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
-    } else if (codepoint <= 0xFFFF) {
-      // 3-byte sequence
-      utf8.push_back(static_cast<char>(0xE0 | ((codepoint >> 12) & 0x0F)));
-      utf8.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
-      utf8.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
-    } else if (codepoint <= 0x10FFFF) {
-      // 4-byte sequence
-      utf8.push_back(static_cast<char>(0xF0 | ((codepoint >> 18) & 0x07)));
-      utf8.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
-      utf8.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
-      utf8.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
-    } else {
-      throw std::runtime_error("Invalid UTF-32 codepoint");
+                        const char32_t* needle,
+                        size_t needle_length) {
+#ifdef MTERM_X86_64
+  switch (g_simdLevel.load(std::memory_order_relaxed)) {
+    case SimdLevel::Avx2:
+      return FindUtf32Avx2(text, length, needle, needle_length);
+    case SimdLevel::Sse2:
+      return FindUtf32Sse2(text, length, needle, needle_length);
+    default:
+      break;
+  }
+#endif
+  return FindUtf32Scalar(text, length, needle, needle_length);
+}
+
+char32_t Utils::FoldCase(char32_t c) {
+  if (c < 0x80) {
+    return c >= U'A' && c <= U'Z' ? c + 0x20 : c;
+  }
+  if (c >= 0xC0 && c <= 0xDE && c != 0xD7) {  // Latin-1, except ×
+    return c + 0x20;
+  }
+  if (c >= 0x100 && c <= 0x17F) {  // Latin Extended-A, pairs
+    if (c == 0x178) {
+      return 0xFF;
     }
+    bool odd_upper = (c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E);
+    if (c == 0x130 || c == 0x131 || c == 0x138 || c == 0x149 || c == 0x17F) {
+      return c;  // Dotted and dotless i, kra, 'n, long s
+    }
+    return (c % 2 == 1) == odd_upper ? c + 1 : c;
+  }
+  if (c >= 0x391 && c <= 0x3A9 && c != 0x3A2) {  // Greek
+    return c + 0x20;
+  }
+  if (c >= 0x410 && c <= 0x42F) {  // Cyrillic
+    return c + 0x20;
+  }
+  if (c >= 0x400 && c <= 0x40F) {
+    return c + 0x50;
+  }
+  return c;
+}
+
+void Utils::Utf8ToUtf32(const char* utf8,
+                        size_t size,
+                        std::vector<char32_t>& utf32,
+                        bool strict) {
+  // Every byte produces at most one code point
+  size_t old_size = utf32.size();
+  utf32.resize(old_size + size);
+  try {
+    size_t written = DecodeUtf8(reinterpret_cast<const uint8_t*>(utf8), size,
+                                utf32.data() + old_size, strict);
+    utf32.resize(old_size + written);
+  } catch (...) {
+    utf32.resize(old_size);
+    throw;
+  }
+}
+
+void Utils::Utf32ToUtf8(const char32_t* utf32,
+                        size_t length,
+                        std::vector<char>& utf8,
+                        bool strict) {
+  size_t old_size = utf8.size();
+  utf8.resize(old_size + Utf8Length(utf32, length));
+  try {
+    EncodeUtf8(utf32, length, utf8.data() + old_size, strict);
+  } catch (...) {
+    utf8.resize(old_size);
+    throw;
+  }
+}
+
+void Utils::Utf32ToUtf8(const char32_t* utf32,
+                        size_t length,
+                        std::string& utf8,
+                        bool strict) {
+  size_t old_size = utf8.size();
+  utf8.resize(old_size + Utf8Length(utf32, length));
+  try {
+    EncodeUtf8(utf32, length, utf8.data() + old_size, strict);
+  } catch (...) {
+    utf8.resize(old_size);
+    throw;
   }
 }
 
@@ -99,6 +608,26 @@ void Utils::Utf32CharToUtf8(char32_t codepoint, char out[4], int& out_len) {
   }
 }
 
+size_t Utils::CompleteUtf8Length(const char* data, size_t size) {
+  size_t max_back = size < 3 ? size : 3;
+  for (size_t back = 1; back <= max_back; back++) {
+    uint8_t byte = data[size - back];
+    if (IsContinuation(byte)) {
+      continue;
+    }
+    size_t length = 1;
+    if (byte >= 0xC0 && byte < 0xE0) {
+      length = 2;
+    } else if (byte >= 0xE0 && byte < 0xF0) {
+      length = 3;
+    } else if (byte >= 0xF0 && byte < 0xF8) {
+      length = 4;
+    }
+    return length > back ? size - back : size;
+  }
+  return size;
+}
+
 std::wstring Utils::Utf8ToWChar(const std::string& utf8) {
   std::wstring wcharStr;
   size_t i = 0;
@@ -167,4 +696,81 @@ std::string Utils::WCharToUtf8(const std::wstring& wcharStr) {
   return utf8;
 }
 
+void Utils::Utf32ToWChar(const char32_t* utf32,
+                         size_t length,
+                         std::wstring& wide,
+                         std::vector<int>& columns) {
+  wide.clear();
+  columns.clear();
+  for (size_t i = 0; i < length; i++) {
+    char32_t c = utf32[i];
+    if constexpr (sizeof(wchar_t) == 2) {
+      if (c >= 0x10000 && c <= 0x10FFFF) {
+        c -= 0x10000;
+        wide.push_back(static_cast<wchar_t>(0xD800 + (c >> 10)));
+        wide.push_back(static_cast<wchar_t>(0xDC00 + (c & 0x3FF)));
+        columns.push_back(static_cast<int>(i));
+        columns.push_back(static_cast<int>(i));
+        continue;
+      }
+    }
+    wide.push_back(static_cast<wchar_t>(c));
+    columns.push_back(static_cast<int>(i));
+  }
+  columns.push_back(static_cast<int>(length));
+}
+
+void Utf8StreamDecoder::Decode(const char* data,
+                               size_t size,
+                               std::vector<char32_t>& utf32) {
+  if (m_pendingSize > 0) {
+    // Complete the pending sequence with continuation bytes from this chunk
+    while (size > 0 && IsContinuation(data[0]) && m_pendingSize < 4 &&
+           Utils::CompleteUtf8Length(m_pending, m_pendingSize) == 0) {
+      m_pending[m_pendingSize++] = *data++;
+      size--;
+    }
+    if (size == 0 && Utils::CompleteUtf8Length(m_pending, m_pendingSize) == 0) {
+      return;  // Still incomplete
+    }
+    Utils::Utf8ToUtf32(m_pending, m_pendingSize, utf32);
+    m_pendingSize = 0;
+  }
+  size_t complete = Utils::CompleteUtf8Length(data, size);
+  Utils::Utf8ToUtf32(data, complete, utf32);
+  m_pendingSize = size - complete;
+  std::copy_n(data + complete, m_pendingSize, m_pending);
+}
+
+void Utf8StreamDecoder::Decode(const char* data,
+                               size_t size,
+                               std::string& utf8) {
+  size_t start = utf8.size();
+  utf8.append(m_pending, m_pendingSize);
+  utf8.append(data, size);
+  size_t complete =
+      Utils::CompleteUtf8Length(utf8.data() + start, utf8.size() - start);
+  m_pendingSize = utf8.size() - start - complete;
+  std::copy_n(utf8.data() + start + complete, m_pendingSize, m_pending);
+  utf8.resize(start + complete);
+}
+
+void Utf8StreamDecoder::Flush(std::vector<char32_t>& utf32) {
+  Utils::Utf8ToUtf32(m_pending, m_pendingSize, utf32);
+  m_pendingSize = 0;
+}
+
+void Utf8StreamDecoder::Flush(std::string& utf8) {
+  utf8.append(m_pending, m_pendingSize);
+  m_pendingSize = 0;
+}
+
+size_t Utf8StreamDecoder::GetPendingSize() const {
+  return m_pendingSize;
+}
+
+void Utf8StreamDecoder::Reset() {
+  m_pendingSize = 0;
+}
+
 }  // namespace MTerm
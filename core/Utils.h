@@ -5,21 +5,95 @@
 
 namespace MTerm {
 
+enum class SimdLevel { Scalar, Sse2, Avx2 };
+
 class Utils {
  public:
+  // Highest instruction set supported by the CPU
+  static SimdLevel GetSupportedSimdLevel();
+
+  static SimdLevel GetSimdLevel();
+
+  // Forces a lower level for the vectorized helpers (used by benchmarks).
+  // Levels above the supported one are clamped.
+  static void SetSimdLevel(SimdLevel level);
+
+  // Returns the index of the first C0 control byte (< 0x20, including ESC)
+  // or DEL in data, or size if the whole chunk is printable.
+  static size_t FindControlByte(const char* data, size_t size);
+
+  // Returns the index of the first occurrence of needle in text, or length
+  // if there is none. An empty needle is found at 0.
+  static size_t FindUtf32(const char32_t* text,
+                          size_t length,
+                          const char32_t* needle,
+                          size_t needle_length);
+
+  // Simple case folding of Latin, Greek and Cyrillic letters, other code
+  // points are returned unchanged. Folding never changes the length of a
+  // text, so positions in folded text are positions in the original.
+  static char32_t FoldCase(char32_t codepoint);
+
+  // Appends decoded code points to utf32. Malformed input is replaced with
+  // U+FFFD, or rejected with std::runtime_error when strict is set.
   static void Utf8ToUtf32(const char* utf8,
                           size_t size,
-                          std::vector<char32_t>& utf32);
+                          std::vector<char32_t>& utf32,
+                          bool strict = false);
+
+  // Appends the encoded text to utf8. Surrogates and values above U+10FFFF
+  // are replaced with U+FFFD, or rejected when strict is set.
+  static void Utf32ToUtf8(const char32_t* utf32,
+                          size_t length,
+                          std::vector<char>& utf8,
+                          bool strict = false);
 
   static void Utf32ToUtf8(const char32_t* utf32,
                           size_t length,
-                          std::vector<char>& utf8);
+                          std::string& utf8,
+                          bool strict = false);
 
   static void Utf32CharToUtf8(char32_t codepoint, char out[4], int& out_len);
 
+  // Length of the prefix of data which does not end in the middle of a
+  // multi-byte sequence. At most 3 trailing bytes are excluded.
+  static size_t CompleteUtf8Length(const char* data, size_t size);
+
   static std::wstring Utf8ToWChar(const std::string& utf8);
 
   static std::string WCharToUtf8(const std::wstring& wcharStr);
+
+  // Replaces wide with the text for std::wregex. wchar_t is UTF-16 on
+  // Windows, where code points above the BMP take two units: columns maps
+  // each unit, and the end of the text, back to a position in utf32.
+  static void Utf32ToWChar(const char32_t* utf32,
+                           size_t length,
+                           std::wstring& wide,
+                           std::vector<int>& columns);
+};
+
+// Decodes UTF-8 delivered in arbitrary chunks. A sequence split between two
+// chunks is kept (up to 3 bytes) and completed by the next call.
+class Utf8StreamDecoder {
+ public:
+  // Appends the code points completed by this chunk
+  void Decode(const char* data, size_t size, std::vector<char32_t>& utf32);
+
+  // Appends the bytes of all sequences completed by this chunk
+  void Decode(const char* data, size_t size, std::string& utf8);
+
+  // Gives up on the pending sequence, e.g. when a control byte interrupts it
+  void Flush(std::vector<char32_t>& utf32);
+
+  void Flush(std::string& utf8);
+
+  size_t GetPendingSize() const;
+
+  void Reset();
+
+ private:
+  char m_pending[4];
+  size_t m_pendingSize = 0;
 };
 
 }  // namespace MTerm
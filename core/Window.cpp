@@ -5,25 +5,23 @@
 #define GET_X_LPARAM(lp) ((int)(short)LOWORD(lp))
 #define GET_Y_LPARAM(lp) ((int)(short)HIWORD(lp))
 
-#include <d2d1.h>
 #include <dwmapi.h>
-#include <dwrite.h>
 #include <shlobj.h>
-#include <wrl/client.h>
 
-#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
-#include <stdexcept>
 #include <thread>
+#include <utility>
 
-using namespace Microsoft::WRL;
-
-static inline void ThrowIfFailed(HRESULT hr) {
-  if (FAILED(hr)) {
-    throw std::exception();
-  }
-}
+#include "D2DRenderBackend.h"
+#include "DrawBatcher.h"
+#include "FrameScheduler.h"
+#include "InputLatency.h"
+#include "Instrumentation.h"
+#include "RenderCommandList.h"
 
 namespace MTerm {
 
@@ -35,29 +33,38 @@ class Window::Impl {
   std::atomic<HCURSOR> m_hCursor;
 
   D2D1_SIZE_U m_windowSize;
-  Microsoft::WRL::ComPtr<ID2D1Factory> m_d2dFactory;
-  Microsoft::WRL::ComPtr<ID2D1HwndRenderTarget> m_renderTarget;
-  Microsoft::WRL::ComPtr<IDWriteFactory> m_dwriteFactory;
-  Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> m_defaultBrush;
-
-  Microsoft::WRL::ComPtr<IDWriteFontFace> m_fontFace;
-  float m_advanceEm;
-  float m_lineHeightEm;
-  float m_baselineEm;
-  float m_underlinePosEm;
-  float m_underlineThicknessEm;
-  std::unordered_map<char32_t, unsigned short> m_glyphIndexCache;
-  std::vector<unsigned short> m_wcharIndexesVector;
-
-  std::vector<unsigned short> m_textBuffer;
-  unsigned int m_textBufferPos = 0;
-
-  std::atomic<long long> m_contentVersion = 0;
-  std::atomic<long long> m_renderedVersion = 0;
+  std::unique_ptr<D2DRenderBackend> m_backend;
+  // Drawing of the render callback is recorded and replayed on the render
+  // thread, so a slow callback does not hold up presenting
+  std::unique_ptr<RenderCommandRecorder> m_recorder;
+  // Palette and highlighter set before the renderer exists are applied on
+  // creation
+  std::vector<int> m_palette;
+  std::shared_ptr<const HighlightEngine> m_highlighter;
+  std::mutex m_backendMutex;
+
   std::atomic<bool> m_stopRendering = false;
+  std::thread m_recordThread;
+  // Guards the scheduler and the content version
+  std::mutex m_recordMutex;
+  std::condition_variable m_recordCv;
+  FrameScheduler m_scheduler;
+  long long m_contentVersion = 0;
   std::thread m_renderThread;
-  std::mutex m_renderMutex;
-  std::condition_variable m_renderCv;
+
+  // Frame N + 1 is recorded into one list while the other one is replayed
+  RenderCommandList m_frames[2];
+  long long m_frameVersions[2] = {};
+  uint64_t m_frameStarts[2] = {};  // For InputLatency
+  int m_recordFrame = 0;
+  int m_pendingFrame = -1;  // Recorded, not yet taken by the render thread
+  int m_presentingFrame = -1;
+  long long m_presentedVersion = 0;
+  DrawBatcher m_batcher;
+  BatchStats m_batchStats = {};  // Of the last recorded frame
+  std::mutex m_frameMutex;
+  std::condition_variable m_frameCv;
+
   std::atomic<bool> m_windowResized = false;
   std::mutex m_resizeMutex;
 
@@ -226,8 +233,12 @@ class Window::Impl {
   }
 
   void InitRenderer() {
-    ThrowIfFailed(D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED,
-                                    IID_PPV_ARGS(&m_d2dFactory)));
+    {
+      std::lock_guard<std::mutex> lock(m_recordMutex);
+      m_scheduler.SetTargetRate(m_config.frame_rate);
+      m_scheduler.SetLatencyBudget(
+          std::chrono::milliseconds(m_config.frame_latency_ms));
+    }
 
     RECT window_rect;
     GetWindowRect(m_hWindow, &window_rect);
@@ -235,28 +246,16 @@ class Window::Impl {
     m_windowSize.width = window_rect.right - window_rect.left;
     m_windowSize.height = window_rect.bottom - window_rect.top;
 
-    D2D1_RENDER_TARGET_PROPERTIES props =
-        D2D1::RenderTargetProperties(D2D1_RENDER_TARGET_TYPE_HARDWARE);
-    D2D1_HWND_RENDER_TARGET_PROPERTIES hwnd_props =
-        D2D1::HwndRenderTargetProperties(m_hWindow, m_windowSize);
-
-    ThrowIfFailed(m_d2dFactory->CreateHwndRenderTarget(props, hwnd_props,
-                                                       &m_renderTarget));
-
-    ThrowIfFailed(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED,
-                                      __uuidof(IDWriteFactory),
-                                      &m_dwriteFactory));
-
-    LoadFont(m_config.font_name.c_str());
-
-    m_renderTarget->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_CLEARTYPE);
-
-    ThrowIfFailed(m_renderTarget->CreateSolidColorBrush(D2D1::ColorF(0xFFFFFF),
-                                                        &m_defaultBrush));
-
-    m_textBuffer.resize(TEXT_BUFFER_SIZE);
-    m_wcharIndexesVector.resize(0xFFFF + 1);
+    {
+      std::lock_guard<std::mutex> lock(m_backendMutex);
+      m_backend =
+          std::make_unique<D2DRenderBackend>(m_hWindow, m_config.font_name);
+      m_recorder = std::make_unique<RenderCommandRecorder>(*m_backend);
+      m_recorder->SetPalette(m_palette);
+      m_recorder->SetHighlighter(m_highlighter);
+    }
 
+    m_recordThread = std::thread([this]() { this->RecordThread(); });
     m_renderThread = std::thread([this]() { this->RenderThread(); });
 
     m_isInitialized = true;
@@ -264,8 +263,13 @@ class Window::Impl {
   }
 
   void StopRenderer() {
-    m_stopRendering.store(true);
-    m_renderCv.notify_one();
+    {
+      std::scoped_lock lock(m_recordMutex, m_frameMutex);
+      m_stopRendering.store(true);
+    }
+    m_recordCv.notify_one();
+    m_frameCv.notify_all();
+    m_recordThread.join();
     m_renderThread.join();
   }
 
@@ -273,37 +277,95 @@ class Window::Impl {
     if (!m_isInitialized) {
       return;
     }
-    m_contentVersion.fetch_add(1);
-    m_renderCv.notify_one();
+    {
+      std::lock_guard<std::mutex> lock(m_recordMutex);
+      m_contentVersion++;
+      m_scheduler.RequestFrame();
+    }
+    m_recordCv.notify_one();
   }
 
-  void RenderThread() {
-    std::unique_lock<std::mutex> lock(m_renderMutex);
+  void RecordThread() {
+    std::unique_lock<std::mutex> lock(m_recordMutex);
     while (true) {
-      m_renderCv.wait(lock, [this]() {
-        return m_renderedVersion.load() != m_contentVersion.load() ||
-               this->m_stopRendering.load();
+      m_recordCv.wait(lock, [this]() {
+        return m_scheduler.IsPending() || m_stopRendering.load();
       });
-
+      // Requests until the frame starts are drawn by it. Waking up early for
+      // an immediate frame moves the frame time.
+      while (!m_stopRendering.load() &&
+             std::chrono::steady_clock::now() < m_scheduler.GetFrameTime()) {
+        m_recordCv.wait_until(lock, m_scheduler.GetFrameTime());
+      }
       if (m_stopRendering.load()) {
         break;
       }
-      std::unique_lock lock(m_resizeMutex);
-      Render();
+      m_scheduler.BeginFrame();
+      long long version = m_contentVersion;
+      lock.unlock();
+      Record(version);
+      lock.lock();
+      m_scheduler.EndFrame();
     }
   }
 
-  void Render() {
-    if (!m_isInitialized) {
-      return;
+  void Record(long long version) {
+    int index = m_recordFrame;
+    m_recorder->SetList(&m_frames[index]);
+    m_frameStarts[index] = InputLatency::BeginFrame();
+    {
+      ScopedProbe probe(Probe::RenderRecord);
+      m_recorder->BeginFrame();
+      m_config.render_callback();
+      m_recorder->EndFrame();
     }
-    m_renderedVersion.store(m_contentVersion.load());
-    m_renderTarget->BeginDraw();
-
-    m_textBufferPos = 0;
-    m_config.render_callback();
+    m_recorder->SetList(nullptr);
+    BatchStats stats = m_batcher.Coalesce(m_frames[index]);
+
+    std::unique_lock<std::mutex> lock(m_frameMutex);
+    m_batchStats = stats;
+    m_frameCv.wait(lock, [this]() {
+      return m_pendingFrame == -1 || m_stopRendering.load();
+    });
+    m_frameVersions[index] = version;
+    m_pendingFrame = index;
+    m_recordFrame = index ^ 1;
+    m_frameCv.notify_all();
+    // The other list may still be replayed
+    m_frameCv.wait(lock, [this]() {
+      return m_presentingFrame != m_recordFrame || m_stopRendering.load();
+    });
+  }
 
-    ThrowIfFailed(m_renderTarget->EndDraw());
+  void RenderThread() {
+    while (true) {
+      int index;
+      {
+        std::unique_lock<std::mutex> lock(m_frameMutex);
+        m_frameCv.wait(lock, [this]() {
+          return m_pendingFrame != -1 || m_stopRendering.load();
+        });
+        if (m_stopRendering.load()) {
+          break;
+        }
+        index = m_pendingFrame;
+        m_pendingFrame = -1;
+        m_presentingFrame = index;
+        m_frameCv.notify_all();
+      }
+      {
+        std::unique_lock lock(m_resizeMutex);
+        ScopedProbe probe(Probe::RenderPresent);
+        m_backend->BeginFrame();
+        m_frames[index].Replay(*m_backend);
+        m_backend->EndFrame();
+      }
+      InputLatency::OnFramePresented(m_frameStarts[index]);
+      std::lock_guard<std::mutex> lock(m_frameMutex);
+      m_presentingFrame = -1;
+      m_presentedVersion = m_frameVersions[index];
+      m_frameCv.notify_all();
+    }
   }
 
   void Resize(unsigned int width, unsigned int height) {
@@ -320,262 +382,63 @@ class Window::Impl {
     if (m_config.resize_callback) {
       m_config.resize_callback(width, height);
     }
-    std::unique_lock lock(m_resizeMutex);
+    {
+      std::unique_lock lock(m_resizeMutex);
+      m_windowSize.width = width;
+      m_windowSize.height = height;
+      m_backend->Resize(width, height);
+    }
 
-    m_windowSize.width = width;
-    m_windowSize.height = height;
-    m_renderTarget->Resize(m_windowSize);
-    Render();
+    // Present a frame of the new size before the system shows the window,
+    // but not forever: the render callback may be waiting for this thread
+    long long version;
+    {
+      std::lock_guard<std::mutex> lock(m_recordMutex);
+      version = ++m_contentVersion;
+      m_scheduler.RequestImmediateFrame();
+    }
+    m_recordCv.notify_one();
+    std::unique_lock<std::mutex> lock(m_frameMutex);
+    m_frameCv.wait_for(lock, std::chrono::milliseconds(100), [&]() {
+      return m_presentedVersion >= version || m_stopRendering.load();
+    });
   }
 
   int GetWidth() const { return m_windowSize.width; }
 
   int GetHeight() const { return m_windowSize.height; }
 
-  void Clear(int color) { m_renderTarget->Clear(D2D1::ColorF(color)); }
-
-  void Text(const char32_t* text,
-            int length,
-            float font_size,
-            float x,
-            float y,
-            int color,
-            int underline_color,
-            int background_color,
-            float opacity) {
-    if (m_textBufferPos + length > TEXT_BUFFER_SIZE) {
-      throw std::exception(
-          "Text buffer overflow! Do you really want to draw so many "
-          "characters?!");
-    }
-    m_defaultBrush->SetOpacity(opacity);
-    if (background_color != -1) {
-      float width = GetLineWidth(font_size, length);
-      float height = ceil(GetLineHeight(font_size));
-      m_defaultBrush->SetColor(D2D1::ColorF(background_color));
-      m_renderTarget->FillRectangle({x, y, x + width, y + height},
-                                    m_defaultBrush.Get());
+  void SetPalette(const std::vector<int>& colors) {
+    std::lock_guard<std::mutex> lock(m_backendMutex);
+    m_palette = colors;
+    if (m_recorder) {
+      m_recorder->SetPalette(colors);
     }
-    if (color != -1) {
-      int buffer_offset = m_textBufferPos;
-      for (int i = 0; i < length; i++) {
-        m_textBuffer[m_textBufferPos] = GetGlyphIndex(text[i]);
-        m_textBufferPos++;
-      }
-
-      float baseline_y = y + m_baselineEm * font_size;
-
-      DWRITE_GLYPH_RUN glyphRun = {};
-      glyphRun.fontFace = m_fontFace.Get();
-      glyphRun.fontEmSize = font_size;
-      glyphRun.glyphCount = length;
-      glyphRun.glyphIndices = m_textBuffer.data() + buffer_offset;
-      glyphRun.glyphAdvances = nullptr;  // use natural advance
-      glyphRun.isSideways = FALSE;
-      glyphRun.bidiLevel = 0;
-
-      m_defaultBrush->SetColor(D2D1::ColorF(color));
-
-      m_renderTarget->DrawGlyphRun(D2D1::Point2F(x, baseline_y), &glyphRun,
-                                   m_defaultBrush.Get(),
-                                   DWRITE_MEASURING_MODE_NATURAL);
-    }
-    if (underline_color != -1) {
-      float underline_y = y + m_underlinePosEm * font_size;
-      float width = GetLineWidth(font_size, length);
-      float thickness = m_underlineThicknessEm * font_size;
-      m_defaultBrush->SetColor(D2D1::ColorF(underline_color));
-      m_renderTarget->DrawLine({x, underline_y}, {x + width, underline_y},
-                               m_defaultBrush.Get(), thickness);
-    }
-  }
-
-  void Line(float start_x,
-            float start_y,
-            float end_x,
-            float end_y,
-            float thickness,
-            int color,
-            float opacity) {
-    m_defaultBrush->SetColor(D2D1::ColorF(color));
-    m_defaultBrush->SetOpacity(opacity);
-    m_renderTarget->DrawLine({start_x, start_y}, {end_x, end_y},
-                             m_defaultBrush.Get(), thickness);
   }
 
-  void Rect(float left,
-            float top,
-            float right,
-            float bottom,
-            int color,
-            float opacity) {
-    m_defaultBrush->SetColor(D2D1::ColorF(color));
-    m_defaultBrush->SetOpacity(opacity);
-    D2D1_RECT_F rect = {left, top, right, bottom};
-    m_renderTarget->FillRectangle(rect, m_defaultBrush.Get());
-  }
-
-  void Outline(float left,
-               float top,
-               float right,
-               float bottom,
-               float thickness,
-               int color,
-               float opacity) {
-    m_defaultBrush->SetColor(D2D1::ColorF(color));
-    m_defaultBrush->SetOpacity(opacity);
-    D2D1_RECT_F rect = {left, top, right, bottom};
-    m_renderTarget->DrawRectangle(rect, m_defaultBrush.Get(), thickness);
-  }
-
-  void TextBuffer(ColoredTextBuffer* buffer,
-                  float left,
-                  float top,
-                  float width,
-                  float height,
-                  int x_offset_chars,
-                  int y_offset_lines,
-                  float font_size) {
-    std::deque<ColoredLine>& lines = buffer->GetLines();
-
-    float y = top;
-    float line_height = ceil(GetLineHeight(font_size));
-    float advance = GetAdvance(font_size);
-
-    int max_visible_chars = static_cast<int>(width / advance);
-
-    for (size_t i = y_offset_lines; i < lines.size(); ++i) {
-      if (y > top + height)
-        break;
-
-      const auto& line = lines[i];
-      const auto& text = line.text;
-      const auto& fragments = line.fragments;
-      if (fragments.empty()) {
-        y += line_height;
-        continue;  // No fragments, skip this line
-      }
-
-      // Binary search for first relevant fragment
-      auto frag_less = [](const LineFragment& frag, int pos) {
-        return frag.pos < pos;
-      };
-      auto it = std::lower_bound(fragments.begin(), fragments.end(),
-                                 x_offset_chars, frag_less);
-
-      if (it != fragments.begin() &&
-          (it == fragments.end() || it->pos > x_offset_chars)) {
-        --it;
-      }
-
-      int remaining_chars = max_visible_chars;
-      for (; it != fragments.end(); ++it) {
-        int frag_start = it->pos;
-        size_t frag_index = std::distance(fragments.begin(), it);
-        int frag_end = (frag_index + 1 < fragments.size())
-                           ? fragments[frag_index + 1].pos
-                           : static_cast<int>(text.size());
-
-        if (frag_end <= x_offset_chars)
-          continue;
-        if (frag_start >= static_cast<int>(text.size()))
-          break;
-
-        int visible_start = std::max(frag_start, x_offset_chars);
-        int max_end = visible_start + remaining_chars;
-        int visible_end =
-            std::min({frag_end, static_cast<int>(text.size()), max_end});
-        int visible_len = visible_end - visible_start;
-
-        if (visible_len <= 0)
-          break;  // No more visible chars in this line, stop rendering
-
-        float x = left + advance * (visible_start - x_offset_chars);
-
-        Text(&text[visible_start], visible_len, font_size, x, y, it->color,
-             it->underline_color, it->background_color, 1.0f);
-
-        remaining_chars -= visible_len;
-      }
-
-      y += line_height;
+  void SetHighlighter(std::shared_ptr<const HighlightEngine> highlighter) {
+    std::lock_guard<std::mutex> lock(m_backendMutex);
+    m_highlighter = std::move(highlighter);
+    if (m_recorder) {
+      m_recorder->SetHighlighter(m_highlighter);
     }
   }
 
-  float GetAdvance(float font_size) const { return m_advanceEm * font_size; }
-
-  float GetLineWidth(float font_size, int num_chars) const {
-    return m_advanceEm * font_size * num_chars;
-  }
-
-  float GetLineHeight(float font_size) const {
-    return m_lineHeightEm * font_size;
+  FrameSchedulerStats GetFrameStats() {
+    std::lock_guard<std::mutex> lock(m_recordMutex);
+    return m_scheduler.GetStats();
   }
 
- private:
-  // TODO - refactor
-  UINT16 GetGlyphIndex(char32_t codepoint) {
-    if (codepoint <= 0xFFFF && m_wcharIndexesVector[codepoint] != 0) {
-      return m_wcharIndexesVector[codepoint];
-    } else if (m_glyphIndexCache.find(codepoint) != m_glyphIndexCache.end()) {
-      return m_glyphIndexCache[codepoint];
-    }
-    UINT32 cp = static_cast<UINT32>(codepoint);
-    UINT16 index;
-    ThrowIfFailed(m_fontFace->GetGlyphIndicesW(&cp, 1, &index));
-    if (codepoint <= 0xFFFF && index > 0) {
-      m_wcharIndexesVector[codepoint] = index;
-    } else {
-      m_glyphIndexCache[codepoint] = index;
-    }
-    return index;
+  BatchStats GetBatchStats() {
+    std::lock_guard<std::mutex> lock(m_frameMutex);
+    return m_batchStats;
   }
 
-  void LoadFont(const wchar_t* font_name) {
-    ComPtr<IDWriteFontCollection> fontCollection;
-    ThrowIfFailed(m_dwriteFactory->GetSystemFontCollection(&fontCollection));
-
-    UINT32 index = 0;
-    BOOL exists = FALSE;
-    ThrowIfFailed(fontCollection->FindFamilyName(font_name, &index, &exists));
-    if (!exists)
-      return;
-
-    ComPtr<IDWriteFontFamily> fontFamily;
-    ThrowIfFailed(fontCollection->GetFontFamily(index, &fontFamily));
-
-    ComPtr<IDWriteFont> font;
-    ThrowIfFailed(fontFamily->GetFirstMatchingFont(
-        DWRITE_FONT_WEIGHT_LIGHT, DWRITE_FONT_STRETCH_SEMI_CONDENSED,
-        DWRITE_FONT_STYLE_NORMAL, &font));
-
-    ThrowIfFailed(font->CreateFontFace(&m_fontFace));
-
-    DWRITE_FONT_METRICS metrics;
-    m_fontFace->GetMetrics(&metrics);
-
-    FLOAT designUnitsPerEm = metrics.designUnitsPerEm;
-    FLOAT lineHeightDesignUnits =
-        metrics.ascent + metrics.descent + metrics.lineGap;
-
-    m_lineHeightEm = lineHeightDesignUnits / designUnitsPerEm;
-    m_baselineEm = metrics.ascent / designUnitsPerEm;
-    m_underlinePosEm = m_baselineEm + metrics.underlinePosition /
-                                          designUnitsPerEm * -1;  // y-top
-    m_underlineThicknessEm = metrics.underlineThickness / designUnitsPerEm;
-
-    UINT32 codePoint = U'M';
-    UINT16 glyphIndex = 0;
-    m_fontFace->GetGlyphIndicesW(&codePoint, 1, &glyphIndex);
-
-    DWRITE_GLYPH_METRICS glyphMetrics = {};
-    m_fontFace->GetDesignGlyphMetrics(&glyphIndex, 1, &glyphMetrics, FALSE);
-
-    FLOAT advanceWidth = glyphMetrics.advanceWidth;  // Monospace
-
-    m_advanceEm = (advanceWidth / designUnitsPerEm);
+  RenderBackend* GetRecorder() const {
+    return m_isInitialized ? m_recorder.get() : nullptr;
   }
 
+ private:
   wchar_t pending_high_surrogate = 0;
   bool is_sizing = false;
   bool is_tracking = false;
@@ -708,6 +571,7 @@ class Window::Impl {
         return 0;
       }
       case WM_CHAR: {
+        InputLatency::OnInput();
         wchar_t ch = (wchar_t)wParam;
 
         if (ch >= 0xD800 && ch <= 0xDBFF) {
@@ -740,6 +604,7 @@ class Window::Impl {
       }
       case WM_SYSKEYDOWN:
       case WM_KEYDOWN: {
+        InputLatency::OnInput();
         if (window->m_config.keydown_callback) {
           window->m_config.keydown_callback(wParam);
         }
@@ -917,8 +782,18 @@ int Window::GetHeight() const {
   return m_impl->GetHeight();
 }
 
+FrameSchedulerStats Window::GetFrameStats() const {
+  return m_impl->GetFrameStats();
+}
+
+BatchStats Window::GetBatchStats() const {
+  return m_impl->GetBatchStats();
+}
+
 void Window::Clear(int color) {
-  m_impl->Clear(color);
+  if (RenderBackend* backend = m_impl->GetRecorder()) {
+    backend->Clear(color);
+  }
 }
 
 void Window::Text(const char32_t* text,
@@ -930,8 +805,10 @@ void Window::Text(const char32_t* text,
                   int underline_color,
                   int background_color,
                   float opacity) {
-  m_impl->Text(text, length, font_size, x, y, color, underline_color,
-               background_color, opacity);
+  if (RenderBackend* backend = m_impl->GetRecorder()) {
+    backend->Text(text, length, font_size, x, y, color, underline_color,
+                  background_color, opacity);
+  }
 }
 
 void Window::Line(float start_x,
@@ -941,7 +818,9 @@ void Window::Line(float start_x,
                   float thickness,
                   int color,
                   float opacity) {
-  m_impl->Line(start_x, start_y, end_x, end_y, thickness, color, opacity);
+  if (RenderBackend* backend = m_impl->GetRecorder()) {
+    backend->Line(start_x, start_y, end_x, end_y, thickness, color, opacity);
+  }
 }
 
 void Window::Rect(float left,
@@ -950,7 +829,9 @@ void Window::Rect(float left,
                   float bottom,
                   int color,
                   float opacity) {
-  m_impl->Rect(left, top, right, bottom, color, opacity);
+  if (RenderBackend* backend = m_impl->GetRecorder()) {
+    backend->Rect(left, top, right, bottom, color, opacity);
+  }
 }
 
 void Window::Outline(float left,
@@ -960,7 +841,9 @@ void Window::Outline(float left,
                      float thickness,
                      int color,
                      float opacity) {
-  m_impl->Outline(left, top, right, bottom, thickness, color, opacity);
+  if (RenderBackend* backend = m_impl->GetRecorder()) {
+    backend->Outline(left, top, right, bottom, thickness, color, opacity);
+  }
 }
 
 void Window::TextBuffer(ColoredTextBuffer* buffer,
@@ -971,20 +854,35 @@ void Window::TextBuffer(ColoredTextBuffer* buffer,
                         int x_offset_chars,
                         int y_offset_lines,
                         float font_size) {
-  m_impl->TextBuffer(buffer, left, top, width, height, x_offset_chars,
-                     y_offset_lines, font_size);
+  if (RenderBackend* backend = m_impl->GetRecorder()) {
+    backend->TextBuffer(buffer, left, top, width, height, x_offset_chars,
+                        y_offset_lines, font_size);
+  }
+}
+
+void Window::SetPalette(const std::vector<int>& colors) {
+  m_impl->SetPalette(colors);
+}
+
+void Window::SetHighlighter(
+    std::shared_ptr<const HighlightEngine> highlighter) {
+  m_impl->SetHighlighter(std::move(highlighter));
 }
 
+// Metrics are 0 until the renderer has loaded the font
 float Window::GetAdvance(float font_size) const {
-  return m_impl->GetAdvance(font_size);
+  RenderBackend* backend = m_impl->GetRecorder();
+  return backend ? backend->GetAdvance(font_size) : 0.0f;
 }
 
 float Window::GetLineWidth(float font_size, int num_chars) const {
-  return m_impl->GetLineWidth(font_size, num_chars);
+  RenderBackend* backend = m_impl->GetRecorder();
+  return backend ? backend->GetLineWidth(font_size, num_chars) : 0.0f;
 }
 
 float Window::GetLineHeight(float font_size) const {
-  return m_impl->GetLineHeight(font_size);
+  RenderBackend* backend = m_impl->GetRecorder();
+  return backend ? backend->GetLineHeight(font_size) : 0.0f;
 }
 
 }  // namespace MTerm
@@ -3,13 +3,15 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "ColoredTextBuffer.h"
+#include "DrawBatcher.h"
+#include "FrameScheduler.h"
+#include "RenderBackend.h"
 
 namespace MTerm {
 
-constexpr auto TEXT_BUFFER_SIZE = 1024 * 1024;
-
 struct Config {
   std::wstring font_name;
   std::wstring icon_path;
@@ -19,6 +21,10 @@ struct Config {
   int window_min_height;
   int border_size;
   int cursor_id;
+  // Redraws are paced to this rate, but a frame never starts later than
+  // the latency after the first redraw it draws
+  int frame_rate = 60;
+  int frame_latency_ms = 50;
 
   std::function<void()> render_callback;
   std::function<void(int width, int height)> resize_callback;
@@ -53,6 +59,11 @@ class Window {
   int GetWidth() const;
   int GetHeight() const;
 
+  FrameSchedulerStats GetFrameStats() const;
+
+  // Draw calls of the last recorded frame before and after batching
+  BatchStats GetBatchStats() const;
+
   void Clear(int color);
 
   void Text(const char32_t* text,
@@ -97,6 +108,12 @@ class Window {
                   int y_offset_lines,
                   float font_size);
 
+  // Colors for COLOR_PALETTE_FLAG indices used by text buffers
+  void SetPalette(const std::vector<int>& colors);
+
+  // Rules applied to the visible lines of text buffers, nullptr - none
+  void SetHighlighter(std::shared_ptr<const HighlightEngine> highlighter);
+
   float GetAdvance(float font_size) const;
   float GetLineWidth(float font_size, int num_chars) const;
   float GetLineHeight(float font_size) const;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "Utils.h"
+
+namespace MTerm::Bench {
+
+const char* SimdLevelName(SimdLevel level);
+
+// Runs fn once per SIMD level supported by this CPU, then restores the
+// detected level.
+void ForEachSimdLevel(const std::function<void(SimdLevel)>& fn);
+
+// Seconds per call of a measured function
+struct Measurement {
+  double best;
+  double median;
+  double mad;  // Median absolute deviation, the noise of the median
+  int samples;
+};
+
+// Calls fn once to warm caches, then repeatedly for at least min_seconds and
+// at least five times.
+Measurement Measure(const std::function<void()>& fn, double min_seconds = 0.5);
+
+// The fastest call of Measure() in seconds
+double MeasureBest(const std::function<void()>& fn, double min_seconds = 0.5);
+
+void ReportThroughput(const std::string& name, size_t bytes, double seconds);
+
+// Prints the median time per operation, and the throughput when bytes is not
+// 0, for a call that performs ops operations on bytes of input
+void Report(const std::string& name,
+            const Measurement& measurement,
+            size_t ops,
+            size_t bytes = 0);
+
+void RunBufferBench();
+
+void RunFramePacingBench();
+
+void RunInputLatencyBench();
+
+void RunInstrumentationBench();
+
+void RunPtyBench();
+
+void RunPtyReactorBench();
+
+void RunPtyWriteBench();
+
+void RunReplayBench();
+
+void RunRenderCacheBench();
+
+void RunRenderCommandBench();
+
+void RunScanBench();
+
+void RunScrollbackBench();
+
+void RunSearchBench();
+
+void RunSoftwareRenderBench();
+
+void RunTranscodeBench();
+
+}  // namespace MTerm::Bench
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Bench.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+// Everything reported, for --json
+struct Result {
+  std::string name;
+  size_t ops;
+  size_t bytes;
+  Measurement measurement;
+};
+
+std::vector<Result> g_results;
+
+double Median(std::vector<double>& values) {
+  size_t middle = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + middle, values.end());
+  return values[middle];
+}
+
+void WriteJsonString(FILE* file, const std::string& value) {
+  fputc('"', file);
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      fputc('\\', file);
+    }
+    fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+// One object per result, times in nanoseconds. Results that only have the
+// best time, from ReportThroughput(), have no median, mad and samples.
+bool WriteJson(const char* path) {
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    return false;
+  }
+  fprintf(file, "[\n");
+  for (size_t i = 0; i < g_results.size(); i++) {
+    const Result& result = g_results[i];
+    const Measurement& m = result.measurement;
+    fprintf(file, "  {\"name\": ");
+    WriteJsonString(file, result.name);
+    fprintf(file, ", \"best_ns\": %.1f", m.best * 1e9);
+    if (m.samples > 0) {
+      double ops = static_cast<double>(std::max<size_t>(result.ops, 1));
+      fprintf(file,
+              ", \"median_ns\": %.1f, \"mad_ns\": %.1f, \"samples\": %d"
+              ", \"ns_per_op\": %.3f",
+              m.median * 1e9, m.mad * 1e9, m.samples, m.median * 1e9 / ops);
+    }
+    if (result.bytes > 0) {
+      double seconds = m.samples > 0 ? m.median : m.best;
+      fprintf(file, ", \"bytes_per_second\": %.0f",
+              result.bytes / seconds);
+    }
+    fprintf(file, "}%s\n", i + 1 < g_results.size() ? "," : "");
+  }
+  fprintf(file, "]\n");
+  return fclose(file) == 0;
+}
+
+}  // namespace
+
+const char* SimdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::Avx2:
+      return "avx2";
+    case SimdLevel::Sse2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
+
+void ForEachSimdLevel(const std::function<void(SimdLevel)>& fn) {
+  SimdLevel supported = Utils::GetSupportedSimdLevel();
+  for (SimdLevel level :
+       {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2}) {
+    if (level > supported) {
+      continue;
+    }
+    Utils::SetSimdLevel(level);
+    fn(level);
+  }
+  Utils::SetSimdLevel(supported);
+}
+
+Measurement Measure(const std::function<void()>& fn, double min_seconds) {
+  using Clock = std::chrono::steady_clock;
+  fn();
+  std::vector<double> times;
+  double total = 0;
+  while (total < min_seconds || times.size() < 5) {
+    auto start = Clock::now();
+    fn();
+    double elapsed =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    times.push_back(elapsed);
+    total += elapsed;
+  }
+  Measurement measurement{};
+  measurement.samples = static_cast<int>(times.size());
+  measurement.best = *std::min_element(times.begin(), times.end());
+  measurement.median = Median(times);
+  for (double& time : times) {
+    time = std::fabs(time - measurement.median);
+  }
+  measurement.mad = Median(times);
+  return measurement;
+}
+
+double MeasureBest(const std::function<void()>& fn, double min_seconds) {
+  return Measure(fn, min_seconds).best;
+}
+
+void ReportThroughput(const std::string& name, size_t bytes, double seconds) {
+  printf("%-40s %10.3f GB/s\n", name.c_str(), bytes / seconds / 1e9);
+  g_results.push_back({name, 1, bytes, {seconds, 0, 0, 0}});
+}
+
+void Report(const std::string& name,
+            const Measurement& measurement,
+            size_t ops,
+            size_t bytes) {
+  double ns_per_op = measurement.median * 1e9 / std::max<size_t>(ops, 1);
+  double spread = measurement.median > 0
+                      ? measurement.mad / measurement.median * 100
+                      : 0;
+  printf("%-40s %10.1f ns/op", name.c_str(), ns_per_op);
+  if (bytes > 0) {
+    printf(" %8.3f GB/s", bytes / measurement.median / 1e9);
+  }
+  printf("  +-%.1f%%\n", spread);
+  g_results.push_back({name, ops, bytes, measurement});
+}
+
+}  // namespace MTerm::Bench
+
+int main(int argc, char** argv) {
+  struct Entry {
+    const char* name;
+    void (*run)();
+  };
+  const Entry entries[] = {
+      {"buffer", MTerm::Bench::RunBufferBench},
+      {"frame_pacing", MTerm::Bench::RunFramePacingBench},
+      {"input_latency", MTerm::Bench::RunInputLatencyBench},
+      {"instrumentation", MTerm::Bench::RunInstrumentationBench},
+      {"pty", MTerm::Bench::RunPtyBench},
+      {"pty_reactor", MTerm::Bench::RunPtyReactorBench},
+      {"pty_write", MTerm::Bench::RunPtyWriteBench},
+      {"replay", MTerm::Bench::RunReplayBench},
+      {"render_cache", MTerm::Bench::RunRenderCacheBench},
+      {"render_commands", MTerm::Bench::RunRenderCommandBench},
+      {"scan", MTerm::Bench::RunScanBench},
+      {"scrollback", MTerm::Bench::RunScrollbackBench},
+      {"search", MTerm::Bench::RunSearchBench},
+      {"software_render", MTerm::Bench::RunSoftwareRenderBench},
+      {"transcode", MTerm::Bench::RunTranscodeBench},
+  };
+  // mterm_bench [--json results.json] [name...]
+  const char* json_path = nullptr;
+  std::vector<const char*> names;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      json_path = argv[++i];
+    } else {
+      names.push_back(argv[i]);
+    }
+  }
+  for (const char* name : names) {
+    bool known = false;
+    for (const Entry& entry : entries) {
+      known |= strcmp(name, entry.name) == 0;
+    }
+    if (!known) {
+      fprintf(stderr, "unknown bench %s\nusage: %s [--json results.json]",
+              name, argv[0]);
+      const char* separator = " [";
+      for (const Entry& entry : entries) {
+        fprintf(stderr, "%s%s", separator, entry.name);
+        separator = "|";
+      }
+      fprintf(stderr, "]...\n");
+      return 2;
+    }
+  }
+  for (const Entry& entry : entries) {
+    bool selected = names.empty();
+    for (const char* name : names) {
+      selected |= strcmp(name, entry.name) == 0;
+    }
+    if (selected) {
+      printf("== %s\n", entry.name);
+      entry.run();
+    }
+  }
+  if (json_path && !MTerm::Bench::WriteJson(json_path)) {
+    fprintf(stderr, "failed to write %s\n", json_path);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "ColoredTextBuffer.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+std::vector<char32_t> MakeLineText(int length) {
+  std::vector<char32_t> text(length);
+  for (int i = 0; i < length; i++) {
+    text[i] = U'a' + i % 26;
+  }
+  return text;
+}
+
+// A buffer of num_lines lines of the given length, each with a couple of
+// color runs like FillBuffer() makes
+void MakeBuffer(ColoredTextBuffer& buffer, size_t num_lines, int length) {
+  std::vector<char32_t> text = MakeLineText(length);
+  for (size_t i = 0; i < num_lines; i++) {
+    buffer.AddLine();
+    size_t line = buffer.GetLineCount() - 1;
+    buffer.SetText(line, 0, text.data(), length);
+    buffer.SetColor(line, 0, length - 1, 0xCCCCCC, -1, -1);
+    buffer.SetColor(line, 0, length / 4, COLOR_PALETTE_FLAG | (line % 16), -1,
+                    -1);
+  }
+}
+
+// Output streaming past the bottom of the screen
+void RunAppend() {
+  const size_t kLines = 100000;
+  const int kLength = 120;
+  std::vector<char32_t> text = MakeLineText(kLength);
+  Measurement m = Measure([&]() {
+    ColoredTextBuffer buffer(0);
+    for (size_t i = 0; i < kLines; i++) {
+      buffer.AddLine();
+      buffer.WriteToLine(buffer.GetLineCount() - 1, text.data(), kLength);
+    }
+  });
+  Report("append_line", m, kLines, kLines * kLength);
+}
+
+// Syntax highlighted output and prompts: many short runs in one line
+void RunSetColor() {
+  const size_t kLines = 100;
+  const int kLength = 2000;
+  const int kRun = 10;
+  ColoredTextBuffer buffer(0);
+  MakeBuffer(buffer, kLines, kLength);
+  int round = 0;
+  Measurement m = Measure([&]() {
+    // Other colors each time, so every call splits and merges fragments
+    round++;
+    for (size_t line = 0; line < kLines; line++) {
+      for (int pos = 0; pos < kLength; pos += kRun) {
+        buffer.SetColor(line, pos, pos + kRun - 1,
+                        COLOR_PALETTE_FLAG | ((pos / kRun + round) % 16), -1,
+                        -1);
+      }
+    }
+  });
+  Report("set_color/2000_cols_200_runs", m, kLines * (kLength / kRun));
+}
+
+// DCH in long lines: the rest of the line and its fragments shift left.
+// What is erased is appended again to keep the length, as a shell does when
+// it redraws the line.
+void RunEraseInLine() {
+  const size_t kLines = 100;
+  const int kLength = 4000;
+  const int kErase = 5;
+  ColoredTextBuffer buffer(0);
+  MakeBuffer(buffer, kLines, kLength);
+  for (size_t line = 0; line < kLines; line++) {
+    for (int pos = 0; pos < kLength; pos += 40) {
+      buffer.SetColor(line, pos, pos + 19, COLOR_PALETTE_FLAG | (pos % 16),
+                      -1, -1);
+    }
+  }
+  std::vector<char32_t> text = MakeLineText(kErase);
+  const int kOps = 20;
+  Measurement m = Measure([&]() {
+    for (size_t line = 0; line < kLines; line++) {
+      for (int i = 0; i < kOps; i++) {
+        int pos = kLength / 2 + i * 7;
+        buffer.EraseInLine(line, pos, pos + kErase - 1);
+        buffer.WriteToLine(line, text.data(), kErase);
+      }
+    }
+  });
+  Report("erase_in_line/4000_cols", m, kLines * kOps);
+}
+
+// IL and DL in the middle of a big scrollback, as a full screen editor
+// scrolling a region. Lines past the hot ones are compressed, so this also
+// covers thawing them.
+void RunInsertRemoveLines() {
+  const size_t kLines = 200000;
+  const int kOps = 2;
+  ColoredTextBuffer buffer(0);
+  MakeBuffer(buffer, kLines, 80);
+  size_t middle = kLines / 2;
+  Measurement m = Measure([&]() {
+    for (int i = 0; i < kOps; i++) {
+      buffer.InsertLines(middle, 1);
+      buffer.RemoveLines(middle, middle + 1);
+    }
+  });
+  Report("insert_remove_lines/200k", m, kOps * 2);
+}
+
+// A window resize of a full screen, alternating widths
+void RunResizeLines() {
+  const size_t kLines = 10000;
+  ColoredTextBuffer buffer(0);
+  MakeBuffer(buffer, kLines, 80);
+  bool wide = false;
+  Measurement m = Measure([&]() {
+    wide = !wide;
+    buffer.ResizeLines(0, kLines - 1, wide ? 160 : 80);
+  });
+  Report("resize_lines/10k", m, kLines);
+}
+
+}  // namespace
+
+void RunBufferBench() {
+  RunAppend();
+  RunSetColor();
+  RunEraseInLine();
+  RunInsertRemoveLines();
+  RunResizeLines();
+}
+
+}  // namespace MTerm::Bench
@@ -0,0 +1,197 @@
+#include "Corpus.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#include "Utils.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+// Small xorshift generator so that corpora are identical between runs
+class Random {
+ public:
+  explicit Random(uint32_t seed) : m_state(seed) {}
+
+  uint32_t Next() {
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state;
+  }
+
+  uint32_t Below(uint32_t n) { return Next() % n; }
+
+  template <typename T, size_t N>
+  const T& Pick(const T (&items)[N]) {
+    return items[Below(N)];
+  }
+
+ private:
+  uint32_t m_state;
+};
+
+const char* const kWords[] = {
+    "buffer", "render", "console", "terminal", "fragment", "parser",
+    "window", "glyph",  "utils",   "process",  "session",  "request",
+    "index",  "line",   "color",   "thread",   "handle",   "result"};
+
+const char* const kExtensions[] = {".cpp", ".h", ".py", ".txt", ".json",
+                                   ".md"};
+
+}  // namespace
+
+std::string MakeCompilerLog(size_t target_size) {
+  Random random(1);
+  std::string out;
+  char line[512];
+  while (out.size() < target_size) {
+    const char* file = random.Pick(kWords);
+    const char* symbol = random.Pick(kWords);
+    int line_no = random.Below(2000) + 1;
+    int column = random.Below(80) + 1;
+    switch (random.Below(4)) {
+      case 0:
+        snprintf(line, sizeof(line),
+                 "[%3u%%] Building CXX object src/CMakeFiles/%s.dir/%s.cpp.o"
+                 "\r\n",
+                 random.Below(101), file, symbol);
+        break;
+      case 1:
+        snprintf(line, sizeof(line),
+                 "\x1b[1msrc/%s.cpp:%d:%d:\x1b[m \x1b[1;35mwarning: \x1b[m"
+                 "unused variable '\x1b[1m%s_%s\x1b[m' "
+                 "[\x1b[1;35m-Wunused-variable\x1b[m]\r\n"
+                 "  %4d |   int %s_%s = 0;\r\n"
+                 "       |       \x1b[1;35m^~~~~~~~~~~~\x1b[m\r\n",
+                 file, line_no, column, symbol, file, line_no, symbol, file);
+        break;
+      case 2:
+        snprintf(line, sizeof(line),
+                 "\x1b[1msrc/%s.cpp:%d:%d:\x1b[m \x1b[1;31merror: \x1b[m"
+                 "no member named '%s' in 'MTerm::%s'\r\n",
+                 file, line_no, column, symbol, file);
+        break;
+      default:
+        snprintf(line, sizeof(line),
+                 "   Compiling %s v0.%u.%u (/home/build/%s)\r\n", symbol,
+                 random.Below(10), random.Below(30), file);
+        break;
+    }
+    out += line;
+  }
+  return out;
+}
+
+std::string MakeDirectoryListing(size_t target_size) {
+  Random random(2);
+  std::string out;
+  char line[512];
+  while (out.size() < target_size) {
+    snprintf(line, sizeof(line), "\r\n./%s/%s:\r\ntotal %u\r\n",
+             random.Pick(kWords), random.Pick(kWords), random.Below(5000));
+    out += line;
+    int entries = random.Below(20) + 1;
+    for (int i = 0; i < entries; i++) {
+      bool is_dir = random.Below(4) == 0;
+      const char* name = random.Pick(kWords);
+      if (is_dir) {
+        snprintf(line, sizeof(line),
+                 "drwxr-xr-x  2 user user %8u Jan %2u %02u:%02u "
+                 "\x1b[01;34m%s\x1b[0m\r\n",
+                 4096u, random.Below(31) + 1, random.Below(24),
+                 random.Below(60), name);
+      } else {
+        snprintf(line, sizeof(line),
+                 "-rw-r--r--  1 user user %8u Jan %2u %02u:%02u %s_%u%s\r\n",
+                 random.Below(1000000), random.Below(31) + 1,
+                 random.Below(24), random.Below(60), name, random.Below(100),
+                 random.Pick(kExtensions));
+      }
+      out += line;
+    }
+  }
+  return out;
+}
+
+std::string MakeMinifiedJson(size_t target_size) {
+  Random random(3);
+  std::string out = "[";
+  char item[512];
+  while (out.size() < target_size) {
+    snprintf(item, sizeof(item),
+             "{\"id\":%u,\"name\":\"%s-%s\",\"active\":%s,\"score\":%u.%02u,"
+             "\"tags\":[\"%s\",\"%s\"],\"meta\":{\"host\":\"%s-%u.example."
+             "com\",\"path\":\"/api/v1/%s/%u\"}},",
+             random.Next() % 1000000, random.Pick(kWords), random.Pick(kWords),
+             random.Below(2) ? "true" : "false", random.Below(100),
+             random.Below(100), random.Pick(kWords), random.Pick(kWords),
+             random.Pick(kWords), random.Below(64), random.Pick(kWords),
+             random.Below(100000));
+    out += item;
+  }
+  out.back() = ']';
+  return out;
+}
+
+std::string MakeServiceLog(size_t lines) {
+  Random random(4);
+  const char* const levels[] = {"INFO ", "INFO ", "INFO ", "DEBUG", "WARN ",
+                                "ERROR"};
+  std::string out;
+  char line[512];
+  for (size_t i = 0; i < lines; i++) {
+    uint32_t ms = static_cast<uint32_t>(i % 86400000);
+    snprintf(line, sizeof(line),
+             "2024-03-14 %02u:%02u:%02u.%03u %s [%s-%02u.prod] req=%s %s "
+             "/api/v1/%s/%u %u %ums\r\n",
+             ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000,
+             random.Pick(levels), random.Pick(kWords), random.Below(64),
+             GetServiceLogRequestId(i).c_str(),
+             random.Below(4) ? "GET" : "POST", random.Pick(kWords),
+             random.Below(100000), random.Below(8) ? 200u : 500u,
+             random.Below(2000));
+    out += line;
+  }
+  return out;
+}
+
+std::string GetServiceLogRequestId(size_t line) {
+  // A bijection of 32-bit numbers, so ids look random but never repeat
+  uint32_t id = static_cast<uint32_t>(line) * 2654435761u;
+  id ^= id >> 16;
+  char text[16];
+  snprintf(text, sizeof(text), "%08x", id);
+  return text;
+}
+
+std::vector<Corpus> MakeCorpora(size_t target_size) {
+  return {{"compiler_log", MakeCompilerLog(target_size)},
+          {"ls_lR", MakeDirectoryListing(target_size)},
+          {"minified_json", MakeMinifiedJson(target_size)}};
+}
+
+void FillBuffer(ColoredTextBuffer& buffer, const std::string& data) {
+  std::vector<char32_t> text;
+  size_t pos = 0;
+  while (pos < data.size()) {
+    size_t end = data.find('\n', pos);
+    end = end == std::string::npos ? data.size() : end;
+    text.clear();
+    Utils::Utf8ToUtf32(data.data() + pos, end - pos, text);
+
+    buffer.AddLine();
+    size_t line = buffer.GetLineCount() - 1;
+    int length = static_cast<int>(text.size());
+    if (length > 0) {
+      buffer.SetText(line, 0, text.data(), length);
+      buffer.SetColor(line, 0, length - 1, 0xCCCCCC, -1, -1);
+      buffer.SetColor(line, 0, length / 4, COLOR_PALETTE_FLAG | (line % 16),
+                      -1, -1);
+    }
+    pos = end + 1;
+  }
+}
+
+}  // namespace MTerm::Bench
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ColoredTextBuffer.h"
+
+namespace MTerm::Bench {
+
+struct Corpus {
+  std::string name;
+  std::string data;
+};
+
+// Deterministic synthetic PTY output resembling common workloads: colored
+// compiler diagnostics, `ls -lR --color` listings and minified JSON.
+std::vector<Corpus> MakeCorpora(size_t target_size);
+
+std::string MakeCompilerLog(size_t target_size);
+
+std::string MakeDirectoryListing(size_t target_size);
+
+std::string MakeMinifiedJson(size_t target_size);
+
+// Plain lines of a service log with request ids and host names, as searched
+// during an incident. Request ids are unique, GetServiceLogRequestId()
+// returns the one on a given line.
+std::string MakeServiceLog(size_t lines);
+
+std::string GetServiceLogRequestId(size_t line);
+
+// Appends the corpus line by line with a couple of color runs per line
+void FillBuffer(ColoredTextBuffer& buffer, const std::string& data);
+
+}  // namespace MTerm::Bench
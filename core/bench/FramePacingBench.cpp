@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "Bench.h"
+#include "FrameScheduler.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+using Clock = FrameScheduler::TimePoint;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+// Drives a scheduler with a simulated clock like the window's record thread
+// does: redraw requests come at a fixed interval, every frame takes cost.
+void Simulate(const std::string& name,
+              microseconds request_interval,
+              microseconds cost) {
+  Clock now;
+  FrameScheduler scheduler([&now]() { return now; });
+  const Clock end = now + std::chrono::seconds(10);
+
+  Clock next_request = now;
+  Clock oldest_request = now;
+  microseconds total_latency{};
+  microseconds max_latency{};
+  uint64_t frames = 0;
+  auto request = [&]() {
+    now = next_request;
+    if (!scheduler.IsPending()) {
+      oldest_request = now;
+    }
+    scheduler.RequestFrame();
+    next_request += request_interval;
+  };
+
+  while (now < end) {
+    if (!scheduler.IsPending() ||
+        next_request <= std::max(now, scheduler.GetFrameTime())) {
+      request();
+      continue;
+    }
+    now = std::max(now, scheduler.GetFrameTime());
+    auto latency =
+        std::chrono::duration_cast<microseconds>(now - oldest_request);
+    total_latency += latency;
+    max_latency = std::max(max_latency, latency);
+    frames++;
+
+    scheduler.BeginFrame();
+    Clock frame_end = now + cost;
+    // Output keeps coming while the frame is drawn
+    while (next_request < frame_end) {
+      request();
+    }
+    now = frame_end;
+    scheduler.EndFrame();
+  }
+
+  FrameSchedulerStats stats = scheduler.GetStats();
+  printf("%-40s %7.1f fps %7.2f ms avg %7.2f ms max latency, %llu requests\n",
+         name.c_str(), frames / 10.0,
+         frames ? total_latency.count() / 1e3 / frames : 0.0,
+         max_latency.count() / 1e3,
+         static_cast<unsigned long long>(stats.requests));
+}
+
+}  // namespace
+
+void RunFramePacingBench() {
+  Simulate("typing", milliseconds(150), milliseconds(2));
+  Simulate("flood/cheap_frames", microseconds(50), milliseconds(2));
+  Simulate("flood/expensive_frames", microseconds(50), milliseconds(20));
+  Simulate("flood/slower_than_budget", microseconds(50), milliseconds(80));
+  Simulate("steady_30hz_updates", microseconds(33333), milliseconds(4));
+}
+
+}  // namespace MTerm::Bench
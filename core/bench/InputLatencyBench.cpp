@@ -0,0 +1,205 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AnsiParser.h"
+#include "Bench.h"
+#include "ColoredTextBuffer.h"
+#include "FrameScheduler.h"
+#include "InputLatency.h"
+#include "PseudoConsole.h"
+#include "PtyReactor.h"
+#include "SoftwareRenderBackend.h"
+#include "Utils.h"
+
+namespace MTerm::Bench {
+
+#ifdef _WIN32
+
+void RunInputLatencyBench() {
+  printf("input_latency: not supported on Windows\n");
+}
+
+#else
+
+namespace {
+
+constexpr int kWidth = 1000;
+constexpr int kHeight = 600;
+constexpr float kFontSize = 10.0f;
+
+// The pipeline of the application without a window: output is parsed into
+// a buffer on the console's thread, and a render thread paced by a
+// FrameScheduler, as the Window's, draws the screen of the first terminal
+// into memory
+class HeadlessFrontend {
+ public:
+  HeadlessFrontend() : m_backend(kWidth, kHeight) {
+    m_scheduler.SetTargetRate(60);
+    m_scheduler.SetLatencyBudget(std::chrono::milliseconds(50));
+  }
+
+  ~HeadlessFrontend() {
+    for (auto& terminal : m_terminals) {
+      terminal->console.Close();
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_cv.notify_one();
+    if (m_renderThread.joinable()) {
+      m_renderThread.join();
+    }
+  }
+
+  PseudoConsole& AddTerminal(const std::shared_ptr<PtyReactor>& reactor,
+                             std::vector<std::string> argv) {
+    m_terminals.push_back(std::make_unique<Terminal>(reactor));
+    Terminal& terminal = *m_terminals.back();
+    terminal.buffer.AddLine();
+    terminal.console.SetCommand(std::move(argv));
+    terminal.console.Start(24, 80, [this, &terminal](const char* data,
+                                                     unsigned int length) {
+      OnOutput(terminal, data, length);
+    });
+    if (!m_renderThread.joinable()) {
+      m_renderThread = std::thread(&HeadlessFrontend::RenderThread, this);
+    }
+    return terminal.console;
+  }
+
+ private:
+  struct Terminal {
+    explicit Terminal(std::shared_ptr<PtyReactor> reactor)
+        : console(std::move(reactor)) {}
+
+    PseudoConsole console;
+    AnsiParser parser;
+    ColoredTextBuffer buffer{10000};
+    std::vector<char32_t> text;
+  };
+
+  // Printable runs and line feeds are enough for an echo and for yes
+  void OnOutput(Terminal& terminal, const char* data, unsigned int length) {
+    terminal.parser.Feed(data, length);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ColoredTextBuffer& buffer = terminal.buffer;
+      const std::string& parsed = terminal.parser.GetData();
+      for (const ParserAction& action : terminal.parser.GetActions()) {
+        if (action.type == ParserActionType::Print) {
+          terminal.text.clear();
+          Utils::Utf8ToUtf32(parsed.data() + action.data_offset,
+                             action.data_length, terminal.text);
+          buffer.WriteToLine(buffer.GetLineCount() - 1, terminal.text.data(),
+                             static_cast<int>(terminal.text.size()));
+        } else if (action.type == ParserActionType::Execute &&
+                   action.final_byte == '\n') {
+          buffer.AddLine();
+        }
+      }
+      m_scheduler.RequestFrame();
+    }
+    terminal.parser.ClearActions();
+    m_cv.notify_one();
+  }
+
+  void RenderThread() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_cv.wait(lock, [this]() {
+        return m_scheduler.IsPending() || m_stopping;
+      });
+      while (!m_stopping &&
+             std::chrono::steady_clock::now() < m_scheduler.GetFrameTime()) {
+        m_cv.wait_until(lock, m_scheduler.GetFrameTime());
+      }
+      if (m_stopping) {
+        break;
+      }
+      m_scheduler.BeginFrame();
+      uint64_t begin = InputLatency::BeginFrame();
+      ColoredTextBuffer& buffer = m_terminals.front()->buffer;
+      m_backend.BeginFrame();
+      m_backend.Clear(0x1e1e1e);
+      float line_height = m_backend.GetLineHeight(kFontSize);
+      int rows = static_cast<int>(kHeight / line_height);
+      int first = static_cast<int>(buffer.GetLineCount()) - rows;
+      m_backend.TextBuffer(&buffer, 0, 0, kWidth, kHeight, 0,
+                           first > 0 ? first : 0, kFontSize);
+      m_backend.EndFrame();
+      InputLatency::OnFramePresented(begin);
+      m_scheduler.EndFrame();
+    }
+  }
+
+  std::vector<std::unique_ptr<Terminal>> m_terminals;
+  SoftwareRenderBackend m_backend;
+  FrameScheduler m_scheduler;
+  std::mutex m_mutex;  // Buffers and the scheduler
+  std::condition_variable m_cv;
+  bool m_stopping = false;
+  std::thread m_renderThread;
+};
+
+// Types into a raw cat at a steady pace, optionally while another terminal
+// floods output, and reports key press to frame latency
+void MeasureTyping(const std::string& name,
+                   const std::shared_ptr<PtyReactor>& reactor,
+                   bool noisy) {
+  const int kKeys = 200;
+  InputLatency::Reset();
+  InputLatency::SetEnabled(true);
+  {
+    HeadlessFrontend frontend;
+    PseudoConsole& console = frontend.AddTerminal(
+        reactor, {"/bin/sh", "-c", "stty raw -echo && exec cat"});
+    if (noisy) {
+      frontend.AddTerminal(reactor,
+                           {"/bin/sh", "-c",
+                            "stty raw -echo && exec yes "
+                            "0123456789012345678901234567890123456789"});
+    }
+    // Lets stty run first, the kernel would echo otherwise
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    for (int i = 0; i < kKeys; i++) {
+      char key = static_cast<char>('a' + i % 26);
+      InputLatency::OnInput();
+      console.Send(&key, 1);
+      // Not a multiple of the frame interval, so keys land anywhere in it
+      std::this_thread::sleep_for(std::chrono::microseconds(7300));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  InputLatencyStats stats = InputLatency::GetStats();
+  InputLatency::SetEnabled(false);
+
+  printf("%-40s %10.3f ms p50, %.3f ms p99, %.3f ms max\n", name.c_str(),
+         stats.p50_us / 1000.0, stats.p99_us / 1000.0, stats.max_us / 1000.0);
+  printf("%-40s %10llu samples, %llu unanswered; medians: send %.3f, echo "
+         "%.3f, apply %.3f, frame %.3f ms\n",
+         "", static_cast<unsigned long long>(stats.samples),
+         static_cast<unsigned long long>(stats.unanswered),
+         stats.send_us / 1000.0, stats.echo_us / 1000.0,
+         stats.apply_us / 1000.0, stats.frame_us / 1000.0);
+}
+
+}  // namespace
+
+void RunInputLatencyBench() {
+  auto reactor = std::make_shared<PtyReactor>();
+  MeasureTyping("key_to_frame/threads", nullptr, false);
+  MeasureTyping("key_to_frame/reactor", reactor, false);
+  MeasureTyping("key_to_frame/threads_noisy", nullptr, true);
+  MeasureTyping("key_to_frame/reactor_noisy", reactor, true);
+}
+
+#endif
+
+}  // namespace MTerm::Bench
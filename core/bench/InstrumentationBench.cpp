@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "ColoredTextBuffer.h"
+#include "Instrumentation.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+// What a probe costs by itself: a relaxed load while off, two clock reads
+// and the counters while on
+void RunProbe() {
+  const int kCalls = 1000000;
+  auto probe = [&]() {
+    for (int i = 0; i < kCalls; i++) {
+      ScopedProbe probe(Probe::BufferSetColor, 1);
+    }
+  };
+
+  Instrumentation::SetEnabled(false);
+  Report("probe/off", Measure(probe), kCalls);
+
+  Instrumentation::SetEnabled(true);
+  Report("probe/stats", Measure(probe), kCalls);
+
+  // Every call is kept and written, so the trace is restarted for each
+  // sample
+  std::string path =
+      (std::filesystem::temp_directory_path() / "mterm_bench_trace.json")
+          .string();
+  Measurement m = Measure([&]() {
+    Instrumentation::StartTrace(kCalls);
+    probe();
+    Instrumentation::StopTrace(path);
+  });
+  Report("probe/trace_and_write", m, kCalls);
+  std::filesystem::remove(path);
+  Instrumentation::SetEnabled(false);
+  Instrumentation::Reset();
+}
+
+// The probes in a hot path: short lines streaming past the screen, where an
+// edit takes a few tens of nanoseconds
+void RunAppend() {
+  const size_t kLines = 100000;
+  const int kLength = 40;
+  std::vector<char32_t> text(kLength, U'x');
+  auto append = [&]() {
+    ColoredTextBuffer buffer(0);
+    for (size_t i = 0; i < kLines; i++) {
+      buffer.AddLine();
+      size_t line = buffer.GetLineCount() - 1;
+      buffer.WriteToLine(line, text.data(), kLength);
+      buffer.SetColor(line, 0, kLength / 2, COLOR_PALETTE_FLAG | 1, -1, -1);
+    }
+  };
+
+  Instrumentation::SetEnabled(false);
+  Report("append_line/off", Measure(append), kLines, kLines * kLength);
+
+  Instrumentation::SetEnabled(true);
+  Report("append_line/stats", Measure(append), kLines, kLines * kLength);
+  Instrumentation::SetEnabled(false);
+  Instrumentation::Reset();
+}
+
+// Threads probing at once never touch each other's counters
+void RunThreads() {
+  const int kCalls = 1000000;
+  int num_threads = std::clamp(
+      static_cast<int>(std::thread::hardware_concurrency()), 2, 8);
+  Instrumentation::SetEnabled(true);
+  Measurement m = Measure([&]() {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&]() {
+        for (int i = 0; i < kCalls; i++) {
+          ScopedProbe probe(Probe::PtyRead, 1);
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  });
+  Report("probe/stats_" + std::to_string(num_threads) + "_threads", m,
+         static_cast<size_t>(kCalls) * num_threads);
+  Instrumentation::SetEnabled(false);
+
+  // Exited threads are merged into the totals
+  std::vector<ProbeStats> stats = Instrumentation::GetSnapshot();
+  const ProbeStats& read = stats[static_cast<size_t>(Probe::PtyRead)];
+  printf("  %llu calls counted, p50 %llu ns, p99 %llu ns\n",
+         static_cast<unsigned long long>(read.calls),
+         static_cast<unsigned long long>(
+             Instrumentation::GetPercentile(read, 0.5)),
+         static_cast<unsigned long long>(
+             Instrumentation::GetPercentile(read, 0.99)));
+  Instrumentation::Reset();
+}
+
+}  // namespace
+
+void RunInstrumentationBench() {
+  RunProbe();
+  RunAppend();
+  RunThreads();
+}
+
+}  // namespace MTerm::Bench
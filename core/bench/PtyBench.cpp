@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+#include "AnsiParser.h"
+#include "Bench.h"
+#include "Corpus.h"
+#include "PseudoConsole.h"
+#include "PtyReactor.h"
+#include "PtyRecording.h"
+
+namespace MTerm::Bench {
+
+#ifdef _WIN32
+
+void RunPtyBench() {
+  printf("skipped: needs a POSIX pty\n");
+}
+
+void RunPtyReactorBench() {
+  printf("skipped: needs a POSIX pty\n");
+}
+
+void RunPtyWriteBench() {
+  printf("skipped: needs a POSIX pty\n");
+}
+
+void RunReplayBench() {
+  printf("skipped: needs a POSIX pty\n");
+}
+
+#else
+
+namespace {
+
+// Streams a corpus file through a real pty, with the terminal in raw mode
+// so that the bytes arrive unchanged, until all of it has been received
+double MeasurePty(const std::string& path, size_t size, PtyRingStats& stats) {
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t received = 0;
+
+  PseudoConsole console;
+  console.SetCommand(
+      {"/bin/sh", "-c", "stty raw -echo && exec cat \"$0\"", path});
+  auto start = std::chrono::steady_clock::now();
+  console.Start(24, 80, [&](const char*, unsigned int length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    received += length;
+    if (received >= size) {
+      done.notify_one();
+    }
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait_for(lock, std::chrono::seconds(30),
+                  [&] { return received >= size; });
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  stats = console.GetRingStats();
+  console.Close();
+  return seconds;
+}
+
+int CountThreads() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("Threads:", 0) == 0) {
+      return std::stoi(line.substr(8));
+    }
+  }
+  return 0;
+}
+
+// Echo round trips of quiet sessions while one session floods output, as a
+// keystroke in one tab while another tails a busy log
+void MeasureNoisyNeighbour(const std::shared_ptr<PtyReactor>& reactor,
+                           int num_quiet) {
+  std::atomic<size_t> flooded = 0;
+  volatile unsigned int sink = 0;
+  PseudoConsole noisy(reactor);
+  noisy.SetCommand({"/bin/sh", "-c",
+                    "stty raw -echo && exec yes "
+                    "0123456789012345678901234567890123456789"});
+  noisy.Start(24, 80, [&](const char* data, unsigned int length) {
+    // Stands in for parsing
+    unsigned int sum = 0;
+    for (unsigned int i = 0; i < length; i++) {
+      sum += static_cast<unsigned char>(data[i]);
+    }
+    sink = sum;
+    flooded += length;
+  });
+
+  std::mutex mutex;
+  std::condition_variable echoed;
+  std::vector<size_t> received(num_quiet);
+  std::vector<std::unique_ptr<PseudoConsole>> quiet;
+  for (int i = 0; i < num_quiet; i++) {
+    quiet.push_back(std::make_unique<PseudoConsole>(reactor));
+    quiet[i]->SetCommand({"/bin/sh", "-c", "stty raw -echo && exec cat"});
+    quiet[i]->Start(24, 80, [&, i](const char*, unsigned int length) {
+      std::lock_guard<std::mutex> lock(mutex);
+      received[i] += length;
+      echoed.notify_all();
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  int threads = CountThreads();
+
+  using Clock = std::chrono::steady_clock;
+  std::vector<double> latencies;
+  size_t flooded_before = flooded;
+  auto start = Clock::now();
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < num_quiet; i++) {
+      auto sent = Clock::now();
+      std::unique_lock<std::mutex> lock(mutex);
+      size_t before = received[i];
+      quiet[i]->Send("x", 1);
+      echoed.wait_for(lock, std::chrono::seconds(2),
+                      [&] { return received[i] > before; });
+      latencies.push_back(
+          std::chrono::duration<double, std::milli>(Clock::now() - sent)
+              .count());
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-40s %10.3f GB/s\n",
+         reactor ? "noisy/reactor" : "noisy/threads",
+         (flooded - flooded_before) / seconds / 1e9);
+  printf("%-40s %10.3f ms p50, %.3f ms p99, %d threads\n",
+         reactor ? "echo/reactor" : "echo/threads",
+         latencies[latencies.size() / 2],
+         latencies[latencies.size() * 99 / 100], threads);
+
+  noisy.Close();
+  for (auto& console : quiet) {
+    console->Close();
+  }
+}
+
+// Pastes text into a raw cat and types a key right after it: how long the
+// paste call takes, and how soon the key is echoed. Without Paste() the key
+// waits behind the whole paste.
+// Records a corpus streamed through a pty, then replays the recording as
+// fast as possible: reading it back and parsing, the part of a replay that
+// does not need Python
+void RecordAndReplay(const Corpus& corpus) {
+  char path[] = "/tmp/mterm_replay_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0 ||
+      write(fd, corpus.data.data(), corpus.data.size()) !=
+          static_cast<ssize_t>(corpus.data.size())) {
+    printf("%s: failed to write %s\n", corpus.name.c_str(), path);
+    return;
+  }
+  close(fd);
+  std::string recording = std::string(path) + ".mtrec";
+
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t received = 0;
+  PseudoConsole console;
+  console.SetCommand(
+      {"/bin/sh", "-c", "stty raw -echo && exec cat \"$0\"", path});
+  console.StartRecording(recording);
+  console.Start(24, 80, [&](const char*, unsigned int length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    received += length;
+    if (received >= corpus.data.size()) {
+      done.notify_one();
+    }
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait_for(lock, std::chrono::seconds(30),
+                  [&] { return received >= corpus.data.size(); });
+  }
+  console.Close();
+  unlink(path);
+
+  using Clock = std::chrono::steady_clock;
+  size_t bytes = 0;
+  size_t chunks = 0;
+  double read_seconds = 0;
+  double parse_seconds = 0;
+  double duration = 0;
+  AnsiParser parser;
+  PtyRecordingReader reader;
+  PtyRecord record;
+  auto start = Clock::now();
+  reader.Open(recording);
+  while (true) {
+    auto read_start = Clock::now();
+    if (!reader.Next(record)) {
+      break;
+    }
+    auto parse_start = Clock::now();
+    if (record.type == PtyRecordType::Output) {
+      parser.Feed(record.data.data(), record.data.size());
+      parser.ClearActions();
+      bytes += record.data.size();
+      chunks++;
+      duration = record.time_us / 1e6;
+    }
+    auto parse_end = Clock::now();
+    read_seconds +=
+        std::chrono::duration<double>(parse_start - read_start).count();
+    parse_seconds +=
+        std::chrono::duration<double>(parse_end - parse_start).count();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  unlink(recording.c_str());
+
+  printf("%-40s %10.1f MB/s, %.0f chunks/s (recorded %.1f MB/s)\n",
+         ("replay/" + corpus.name).c_str(), bytes / seconds / 1e6,
+         chunks / seconds, duration > 0 ? bytes / duration / 1e6 : 0.0);
+  printf("%-40s %10.1f%% read, %.1f%% parse, %zu of %zu bytes\n", "",
+         read_seconds / seconds * 100, parse_seconds / seconds * 100, bytes,
+         corpus.data.size());
+}
+
+void MeasurePasteAndType(const std::shared_ptr<PtyReactor>& reactor,
+                         bool use_paste,
+                         size_t paste_size) {
+  using Clock = std::chrono::steady_clock;
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t received = 0;
+  Clock::time_point typed_at{};
+  bool typed = false;
+
+  PseudoConsole console(reactor);
+  console.SetCommand({"/bin/sh", "-c", "stty raw -echo && exec cat"});
+  console.Start(24, 80, [&](const char* data, unsigned int length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!typed && memchr(data, 'Z', length)) {
+      typed = true;
+      typed_at = Clock::now();
+    }
+    received += length;
+    if (received >= paste_size + 1) {
+      done.notify_one();
+    }
+  });
+  // Lets stty run first, the paste would be echoed otherwise
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  std::string text(paste_size, 'a');
+  for (size_t i = 0; i < text.size(); i++) {
+    text[i] = static_cast<char>('a' + i % 26);
+  }
+  auto start = Clock::now();
+  if (use_paste) {
+    console.Paste(text.data(), text.size(), false);
+  } else {
+    console.Send(text.data(), static_cast<unsigned int>(text.size()));
+  }
+  auto call_end = Clock::now();
+  console.Send("Z", 1);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait_for(lock, std::chrono::seconds(60),
+                  [&] { return received >= paste_size + 1; });
+  }
+  auto end = Clock::now();
+  auto ms = [](Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+  };
+  std::string name = std::string(use_paste ? "paste" : "send") +
+                     (reactor ? "/reactor" : "/threads");
+  printf("%-40s %10.3f ms call, key after %.1f ms, all after %.1f ms\n",
+         name.c_str(), ms(call_end - start), ms(typed_at - start),
+         ms(end - start));
+  console.Close();
+}
+
+// Single-byte sends in a burst, as a held key or a fast typist
+void MeasureCoalescing(const std::shared_ptr<PtyReactor>& reactor) {
+  const unsigned int kSends = 1000;
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t received = 0;
+  PseudoConsole console(reactor);
+  console.SetCommand({"/bin/sh", "-c", "stty raw -echo && exec cat"});
+  console.Start(24, 80, [&](const char*, unsigned int length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    received += length;
+    if (received >= kSends) {
+      done.notify_one();
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  for (unsigned int i = 0; i < kSends; i++) {
+    console.Send("k", 1);
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait_for(lock, std::chrono::seconds(10),
+                  [&] { return received >= kSends; });
+  }
+  PtyWriteStats stats = console.GetWriteStats();
+  printf("%-40s %10llu writes, %llu coalesced sends\n",
+         reactor ? "keys/reactor" : "keys/threads",
+         static_cast<unsigned long long>(stats.writes),
+         static_cast<unsigned long long>(stats.coalesced_sends));
+  console.Close();
+}
+
+}  // namespace
+
+void RunPtyBench() {
+  std::vector<Corpus> corpora = MakeCorpora(32 * 1024 * 1024);
+  for (const Corpus& corpus : corpora) {
+    char path[] = "/tmp/mterm_pty_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 ||
+        write(fd, corpus.data.data(), corpus.data.size()) !=
+            static_cast<ssize_t>(corpus.data.size())) {
+      printf("%s: failed to write %s\n", corpus.name.c_str(), path);
+      continue;
+    }
+    close(fd);
+
+    PtyRingStats stats{};
+    double seconds = MeasurePty(path, corpus.data.size(), stats);
+    unlink(path);
+    ReportThroughput("pty/" + corpus.name, corpus.data.size(), seconds);
+    printf("%-40s %10llu batches, %llu stalls, peak %zu KiB\n", "",
+           static_cast<unsigned long long>(stats.batches),
+           static_cast<unsigned long long>(stats.stalls),
+           stats.peak_size / 1024);
+  }
+}
+
+void RunPtyReactorBench() {
+  const int kQuiet = 16;
+  MeasureNoisyNeighbour(nullptr, kQuiet);
+  MeasureNoisyNeighbour(std::make_shared<PtyReactor>(), kQuiet);
+}
+
+void RunReplayBench() {
+  for (const Corpus& corpus : MakeCorpora(16 * 1024 * 1024)) {
+    RecordAndReplay(corpus);
+  }
+}
+
+void RunPtyWriteBench() {
+  const size_t kPasteSize = 8 * 1024 * 1024;
+  auto reactor = std::make_shared<PtyReactor>();
+  for (const std::shared_ptr<PtyReactor>& r : {std::shared_ptr<PtyReactor>(),
+                                               reactor}) {
+    MeasurePasteAndType(r, false, kPasteSize);
+    MeasurePasteAndType(r, true, kPasteSize);
+    MeasureCoalescing(r);
+  }
+}
+
+#endif
+
+}  // namespace MTerm::Bench
@@ -0,0 +1,108 @@
+#include <cstdio>
+
+#include "Bench.h"
+#include "ColoredTextBuffer.h"
+#include "Corpus.h"
+#include "HighlightEngine.h"
+#include "LineRenderCache.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+constexpr size_t kScreenRows = 50;
+constexpr int kScreenColumns = 200;
+
+// Prepares the bottom screen of the buffer like RenderBackend::TextBuffer does
+void DrawScreen(LineRenderCache& cache, const ColoredTextBuffer& buffer) {
+  size_t line_count = buffer.GetLineCount();
+  size_t first = line_count > kScreenRows ? line_count - kScreenRows : 0;
+  volatile size_t sink = 0;
+  for (size_t i = first; i < line_count; i++) {
+    sink = sink + cache.Prepare(buffer, i, 0, kScreenColumns)->runs.size();
+  }
+  cache.EndFrame();
+}
+
+void ReportFrame(const std::string& name, double seconds) {
+  printf("%-40s %10.2f us/frame\n", name.c_str(), seconds * 1e6);
+}
+
+// A prompt, a few words of build and service logs and some values
+std::shared_ptr<const HighlightEngine> MakeHighlighter() {
+  std::vector<HighlightRule> rules = {
+      {R"(^PS\s+[A-Z]:\\[^>]*>)", true, false, 0x5AF78E},
+      {"error", false, true, 0xFF5C57},
+      {"warning", false, true, 0xF3F99D},
+      {"failed", false, true, 0xFF5C57},
+      {"TODO", false, false, 0x57C7FF},
+      {R"(\b\d{1,3}(\.\d{1,3}){3}\b)", true, false, 0x9AEDFE},
+      {R"(\b\d+ms\b)", true, false, HIGHLIGHT_KEEP, HIGHLIGHT_KEEP,
+       HIGHLIGHT_KEEP, ATTR_BOLD},
+  };
+  return std::make_shared<const HighlightEngine>(rules);
+}
+
+}  // namespace
+
+void RunRenderCacheBench() {
+  // Stand-in for a font lookup, cheap enough not to flatter the cache
+  LineRenderCache cache([](char32_t codepoint) {
+    return static_cast<uint16_t>(codepoint * 2654435761u >> 16);
+  });
+  for (const Corpus& corpus : MakeCorpora(1024 * 1024)) {
+    ColoredTextBuffer buffer(0);
+    FillBuffer(buffer, corpus.data);
+
+    double rebuild_seconds = MeasureBest([&]() {
+      cache.Clear();
+      DrawScreen(cache, buffer);
+    });
+    ReportFrame(corpus.name + "/full_rebuild", rebuild_seconds);
+
+    double static_seconds = MeasureBest([&]() { DrawScreen(cache, buffer); });
+    ReportFrame(corpus.name + "/static", static_seconds);
+
+    // A prompt line that changes every frame next to static output
+    size_t cursor_line = buffer.GetLineCount() - 1;
+    char32_t blink = U'_';
+    double cursor_seconds = MeasureBest([&]() {
+      blink = blink == U'_' ? U' ' : U'_';
+      buffer.SetText(cursor_line, 0, &blink, 1);
+      DrawScreen(cache, buffer);
+    });
+    ReportFrame(corpus.name + "/one_line_changed", cursor_seconds);
+
+    // Rules cost a rebuilt line, cached lines only the lookup
+    cache.SetHighlighter(MakeHighlighter());
+    double highlight_seconds = MeasureBest([&]() {
+      cache.Clear();
+      DrawScreen(cache, buffer);
+    });
+    ReportFrame(corpus.name + "/full_rebuild_highlighted", highlight_seconds);
+    double highlight_static_seconds =
+        MeasureBest([&]() { DrawScreen(cache, buffer); });
+    ReportFrame(corpus.name + "/static_highlighted", highlight_static_seconds);
+    cache.SetHighlighter(nullptr);
+  }
+
+  // What matching every written line would cost, as highlighting on insert
+  // did, against the visible lines per frame above
+  std::shared_ptr<const HighlightEngine> highlighter = MakeHighlighter();
+  for (const Corpus& corpus : MakeCorpora(1024 * 1024)) {
+    ColoredTextBuffer buffer(0);
+    FillBuffer(buffer, corpus.data);
+    const ColoredTextBuffer& lines = buffer;
+    std::vector<HighlightSpan> spans;
+    Measurement m = Measure([&]() {
+      for (size_t i = 0; i < lines.GetLineCount(); i++) {
+        const ColoredLine& line = lines.GetLine(i);
+        highlighter->Match(line.text.data(), line.text.size(), spans);
+      }
+    });
+    Report("highlight_match/" + corpus.name, m, buffer.GetLineCount(),
+           corpus.data.size());
+  }
+}
+
+}  // namespace MTerm::Bench
@@ -0,0 +1,129 @@
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "ColoredTextBuffer.h"
+#include "Corpus.h"
+#include "DrawBatcher.h"
+#include "RenderCommandList.h"
+#include "SoftwareRenderBackend.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+constexpr int kWidth = 1000;
+constexpr int kHeight = 600;
+constexpr float kFontSize = 10.0f;
+
+// Roughly what the terminal app draws: title, selector and the screen
+void RecordFrame(RenderBackend& recorder, ColoredTextBuffer& buffer) {
+  recorder.BeginFrame();
+  recorder.Clear(0x1e1e1e);
+  recorder.Rect(0, 0, kWidth, 20, 0x2d2d2d, 1.0f);
+  const char32_t title[] = U"mterm - bench";
+  recorder.Text(title, static_cast<int>(std::size(title)) - 1, kFontSize, 4,
+                4, 0xcccccc, -1, -1, 1.0f);
+  recorder.Outline(0, 0, kWidth, kHeight, 1, 0x3c3c3c, 1.0f);
+  float line_height = recorder.GetLineHeight(kFontSize);
+  // Inside the border
+  int rows = static_cast<int>((kHeight - 22) / line_height);
+  int first = static_cast<int>(buffer.GetLineCount()) - rows;
+  recorder.TextBuffer(&buffer, 1, 21, kWidth - 2, kHeight - 22, 0,
+                      first > 0 ? first : 0, kFontSize);
+  recorder.EndFrame();
+}
+
+// htop-like screen: meters and a process table with colored columns,
+// selection bar and cells that repeat the clear color as background
+void FillTable(ColoredTextBuffer& buffer) {
+  const int column_colors[] = {0x1e1e1e, 0x005f87, 0x1e1e1e, 0x303030};
+  const int widths[] = {8, 10, 40, 30};
+  for (int row = 0; row < 60; row++) {
+    buffer.AddLine();
+    std::u32string text(88, U' ');
+    for (size_t i = 0; i < text.size(); i++) {
+      text[i] = U'a' + static_cast<char32_t>((row * 7 + i) % 26);
+    }
+    buffer.SetText(row, 0, text.data(), static_cast<int>(text.size()));
+    int start = 0;
+    for (int column = 0; column < 4; column++) {
+      int end = start + widths[column];
+      int background = row == 30 ? 0x00af00 : column_colors[column];
+      for (int cell = start; cell < end; cell += 4) {
+        int color = (cell / 4 + row) % 3 == 0 ? 0xff5f5f : 0xd0d0d0;
+        buffer.SetColor(row, cell, cell + 4, color, -1, background);
+      }
+      start = end;
+    }
+  }
+}
+
+void ReportFrame(const std::string& name, double seconds) {
+  printf("%-40s %10.2f us/frame\n", name.c_str(), seconds * 1e6);
+}
+
+}  // namespace
+
+void RunRenderCommandBench() {
+  SoftwareRenderBackend backend(kWidth, kHeight);
+  RenderCommandRecorder recorder(backend);
+  RenderCommandList list;
+  recorder.SetList(&list);
+  std::vector<Corpus> corpora = MakeCorpora(1024 * 1024);
+  corpora.push_back({"table", ""});
+  for (const Corpus& corpus : corpora) {
+    ColoredTextBuffer buffer(0);
+    if (corpus.data.empty()) {
+      FillTable(buffer);
+    } else {
+      FillBuffer(buffer, corpus.data);
+    }
+
+    double record_seconds =
+        MeasureBest([&]() { RecordFrame(recorder, buffer); });
+    ReportFrame(corpus.name + "/record", record_seconds);
+
+    double replay_seconds = MeasureBest([&]() {
+      backend.BeginFrame();
+      list.Replay(backend);
+      backend.EndFrame();
+    });
+    ReportFrame(corpus.name + "/replay", replay_seconds);
+
+    DrawBatcher batcher;
+    RenderCommandList batched;
+    BatchStats stats = {};
+    double coalesce_seconds = MeasureBest([&]() {
+      batched = list;
+      stats = batcher.Coalesce(batched);
+    });
+    ReportFrame(corpus.name + "/copy_and_coalesce", coalesce_seconds);
+    printf("%-40s %10zu -> %zu draw calls, %zu backgrounds skipped\n",
+           (corpus.name + "/batching").c_str(), stats.draw_calls,
+           stats.batched_draw_calls, stats.skipped_backgrounds);
+    double batched_seconds = MeasureBest([&]() {
+      backend.BeginFrame();
+      batched.Replay(backend);
+      backend.EndFrame();
+    });
+    ReportFrame(corpus.name + "/replay_batched", batched_seconds);
+
+    std::vector<uint8_t> data = list.Serialize();
+    RenderCommandList loaded =
+        RenderCommandList::Deserialize(data.data(), data.size());
+    double offline_seconds = MeasureBest([&]() {
+      backend.BeginFrame();
+      loaded.Replay(backend);
+      backend.EndFrame();
+    });
+    ReportFrame(corpus.name + "/replay_deserialized", offline_seconds);
+    printf("%-40s %10zu commands %8zu bytes, %zu serialized\n",
+           (corpus.name + "/size").c_str(), list.GetCommandCount(),
+           list.GetSize(), data.size());
+  }
+}
+
+}  // namespace MTerm::Bench
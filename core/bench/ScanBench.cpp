@@ -0,0 +1,34 @@
+#include "Bench.h"
+#include "Corpus.h"
+#include "Utils.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+// Splits the corpus into printable runs the same way AnsiParser does
+size_t CountRuns(const std::string& data) {
+  size_t runs = 0;
+  size_t pos = 0;
+  while (pos < data.size()) {
+    pos += Utils::FindControlByte(data.data() + pos, data.size() - pos) + 1;
+    runs++;
+  }
+  return runs;
+}
+
+}  // namespace
+
+void RunScanBench() {
+  std::vector<Corpus> corpora = MakeCorpora(8 * 1024 * 1024);
+  for (const Corpus& corpus : corpora) {
+    ForEachSimdLevel([&](SimdLevel level) {
+      volatile size_t sink = 0;
+      double seconds = MeasureBest([&]() { sink = CountRuns(corpus.data); });
+      ReportThroughput(corpus.name + "/" + SimdLevelName(level),
+                       corpus.data.size(), seconds);
+    });
+  }
+}
+
+}  // namespace MTerm::Bench
@@ -0,0 +1,51 @@
+#include <cstdio>
+
+#include "Bench.h"
+#include "ColoredTextBuffer.h"
+#include "Corpus.h"
+
+namespace MTerm::Bench {
+
+void RunScrollbackBench() {
+  for (const Corpus& corpus : MakeCorpora(16 * 1024 * 1024)) {
+    ScrollbackStats stats{};
+    double fill_seconds = MeasureBest([&]() {
+      ColoredTextBuffer buffer(0);
+      FillBuffer(buffer, corpus.data);
+      stats = buffer.GetScrollbackStats();
+    });
+    ReportThroughput(corpus.name + "/fill", corpus.data.size(), fill_seconds);
+
+    ColoredTextBuffer buffer(0);
+    FillBuffer(buffer, corpus.data);
+    const ColoredTextBuffer& lines = buffer;
+    size_t line_count = lines.GetLineCount();
+    volatile size_t sink = 0;
+    // Per line: the reads only look up each line, its text is not touched
+    Measurement scan = Measure([&]() {
+      for (size_t i = 0; i < line_count; i++) {
+        sink = sink + lines.GetLine(i).text.size();
+      }
+    });
+    Report(corpus.name + "/sequential_read", scan, line_count);
+
+    // Everything but the hot lines is read back from the spill file
+    buffer.SetSpillBudget(1);
+    Measurement spilled = Measure([&]() {
+      for (size_t i = 0; i < line_count; i++) {
+        sink = sink + lines.GetLine(i).text.size();
+      }
+    });
+    Report(corpus.name + "/spilled_read", spilled, line_count);
+
+    printf("%-40s %zu cold lines, %zu -> %zu bytes (%.1fx)\n",
+           (corpus.name + "/compression").c_str(), stats.cold_lines,
+           stats.uncompressed_bytes, stats.compressed_bytes,
+           stats.compressed_bytes
+               ? static_cast<double>(stats.uncompressed_bytes) /
+                     stats.compressed_bytes
+               : 0.0);
+  }
+}
+
+}  // namespace MTerm::Bench
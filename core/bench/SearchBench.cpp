@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "BufferSearch.h"
+#include "ColoredTextBuffer.h"
+#include "Corpus.h"
+#include "TrigramIndex.h"
+#include "Utils.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+constexpr size_t kLines = 1000000;
+
+// Enough for every line of the log
+constexpr size_t kIndexBudget = size_t(1) << 30;
+
+// Utils::FindUtf32 over a whole corpus for a needle that is not in it, so
+// every candidate start is compared
+void RunLiteralScan() {
+  std::vector<Corpus> corpora = MakeCorpora(8 * 1024 * 1024);
+  const std::u32string needle = U"requestX";
+  for (const Corpus& corpus : corpora) {
+    std::vector<char32_t> text;
+    Utils::Utf8ToUtf32(corpus.data.data(), corpus.data.size(), text);
+    ForEachSimdLevel([&](SimdLevel level) {
+      volatile size_t sink = 0;
+      double seconds = MeasureBest([&]() {
+        sink = Utils::FindUtf32(text.data(), text.size(), needle.data(),
+                                needle.size());
+      });
+      ReportThroughput("find_utf32/" + corpus.name + "/" +
+                           SimdLevelName(level),
+                       text.size() * sizeof(char32_t), seconds);
+    });
+  }
+}
+
+// A search over a million line scrollback the way a terminal runs it: one
+// Update() per frame on the thread that owns the buffer, which must stay
+// short, while the search thread catches up
+void RunScrollbackSearch(ColoredTextBuffer& buffer,
+                         const std::string& name,
+                         const std::string& pattern,
+                         SearchMode mode,
+                         bool ignore_case) {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  double max_update = 0;
+  int updates = 0;
+  size_t matches;
+  {
+    BufferSearch search(buffer, pattern, mode, ignore_case);
+    while (true) {
+      Clock::time_point update_start = Clock::now();
+      search.Update();
+      max_update = std::max(
+          max_update,
+          std::chrono::duration<double>(Clock::now() - update_start).count());
+      updates++;
+      if (search.GetStats().done) {
+        break;
+      }
+      // Leaves the search thread what a 60 Hz frame would
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    matches = search.GetMatchCount();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%-40s %10.1f ms total, %zu matches, %d updates, %.3f ms max "
+         "update\n",
+         ("search/" + name).c_str(), seconds * 1000, matches, updates,
+         max_update * 1000);
+}
+
+// What the index adds to appending a line, with a budget that keeps every
+// line indexed
+void RunIndexBuild(const std::string& log, size_t lines) {
+  for (size_t budget : {size_t(0), kIndexBudget}) {
+    Measurement m = Measure([&]() {
+      ColoredTextBuffer buffer(0);
+      buffer.SetSearchIndexBudget(budget);
+      FillBuffer(buffer, log);
+    });
+    Report(budget ? "index_build/on" : "index_build/off", m, lines,
+           log.size());
+  }
+}
+
+// The index alone: candidate lines for a needle over the whole scrollback
+void RunIndexQuery(const ColoredTextBuffer& buffer,
+                   const std::string& name,
+                   const std::u32string& needle) {
+  const TrigramIndex* index = buffer.GetSearchIndex();
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  Measurement m = Measure([&]() {
+    ranges.clear();
+    index->FindCandidates(needle.data(), needle.size(),
+                          buffer.GetTrimmedLineCount(),
+                          buffer.GetTrimmedLineCount() + buffer.GetLineCount(),
+                          ranges);
+  });
+  uint64_t candidates = 0;
+  for (const auto& range : ranges) {
+    candidates += range.second - range.first;
+  }
+  Report("index_query/" + name, m, 1);
+  printf("  %llu candidate lines\n",
+         static_cast<unsigned long long>(candidates));
+}
+
+}  // namespace
+
+void RunSearchBench() {
+  RunLiteralScan();
+
+  std::string log = MakeServiceLog(kLines);
+  std::string request_id = GetServiceLogRequestId(kLines / 3);
+  for (bool indexed : {false, true}) {
+    ColoredTextBuffer buffer(0);
+    if (indexed) {
+      buffer.SetSearchIndexBudget(kIndexBudget);
+    }
+    FillBuffer(buffer, log);
+    std::string suffix = indexed ? "/indexed" : "";
+    RunScrollbackSearch(buffer, "literal_rare" + suffix, "req=" + request_id,
+                        SearchMode::Literal, false);
+    RunScrollbackSearch(buffer, "literal_common" + suffix, "ERROR",
+                        SearchMode::Literal, false);
+    RunScrollbackSearch(buffer, "ignore_case" + suffix, "Console-42.PROD",
+                        SearchMode::Literal, true);
+    if (!indexed) {
+      RunScrollbackSearch(buffer, "regex",
+                          "req=[0-9a-f]{4}" + request_id.substr(4) + "\\b",
+                          SearchMode::Regex, false);
+      continue;
+    }
+
+    SearchIndexStats stats = buffer.GetSearchIndex()->GetStats();
+    printf("%-40s %llu lines, %zu segments, %zu trigrams, %.1f MB\n",
+           "index", static_cast<unsigned long long>(stats.indexed_lines),
+           stats.segments, stats.trigrams, stats.memory_bytes / 1048576.0);
+    std::u32string id32(request_id.begin(), request_id.end());
+    RunIndexQuery(buffer, "request_id", U"req=" + id32);
+    RunIndexQuery(buffer, "host", U"console-42.prod");
+    RunIndexQuery(buffer, "common", U"ERROR");
+  }
+
+  // Build cost on a smaller log, Measure() fills it several times
+  std::string small_log = MakeServiceLog(kLines / 10);
+  RunIndexBuild(small_log, kLines / 10);
+}
+
+}  // namespace MTerm::Bench
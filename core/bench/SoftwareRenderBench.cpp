@@ -0,0 +1,41 @@
+#include <cstdio>
+
+#include "Bench.h"
+#include "ColoredTextBuffer.h"
+#include "Corpus.h"
+#include "SoftwareRenderBackend.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+constexpr int kWidth = 1000;
+constexpr int kHeight = 600;
+constexpr float kFontSize = 10.0f;
+
+void DrawFrame(SoftwareRenderBackend& backend, ColoredTextBuffer& buffer) {
+  backend.BeginFrame();
+  backend.Clear(0x1e1e1e);
+  float line_height = backend.GetLineHeight(kFontSize);
+  int rows = static_cast<int>(kHeight / line_height);
+  int first = static_cast<int>(buffer.GetLineCount()) - rows;
+  backend.TextBuffer(&buffer, 0, 0, kWidth, kHeight, 0, first > 0 ? first : 0,
+                     kFontSize);
+  backend.EndFrame();
+}
+
+}  // namespace
+
+void RunSoftwareRenderBench() {
+  SoftwareRenderBackend backend(kWidth, kHeight);
+  for (const Corpus& corpus : MakeCorpora(1024 * 1024)) {
+    ColoredTextBuffer buffer(0);
+    FillBuffer(buffer, corpus.data);
+
+    double seconds = MeasureBest([&]() { DrawFrame(backend, buffer); });
+    printf("%-40s %10.2f us/frame\n", (corpus.name + "/screen").c_str(),
+           seconds * 1e6);
+  }
+}
+
+}  // namespace MTerm::Bench
@@ -0,0 +1,64 @@
+#include "Bench.h"
+#include "Corpus.h"
+#include "Utils.h"
+
+namespace MTerm::Bench {
+
+namespace {
+
+// Mixed Cyrillic, CJK and emoji text as produced by localized tools
+std::string MakeUnicodeText(size_t target_size) {
+  const char* const kFragments[] = {
+      "Сборка завершена успешно. ", "警告: 未使用的变量 ", "ビルド成功 ",
+      "\xF0\x9F\x9A\x80 deploy ok ", "plain ascii status line ",
+      "ошибка: файл не найден\r\n"};
+  std::string out;
+  size_t i = 0;
+  while (out.size() < target_size) {
+    out += kFragments[i++ % (sizeof(kFragments) / sizeof(kFragments[0]))];
+  }
+  return out;
+}
+
+void RunCorpus(const std::string& name, const std::string& text) {
+  std::vector<char32_t> utf32;
+  Utils::Utf8ToUtf32(text.data(), text.size(), utf32, true);
+  ForEachSimdLevel([&](SimdLevel level) {
+    std::vector<char32_t> decoded;
+    double decode_seconds = MeasureBest([&]() {
+      decoded.clear();
+      Utils::Utf8ToUtf32(text.data(), text.size(), decoded);
+    });
+    ReportThroughput(name + "/utf8_to_utf32/" + SimdLevelName(level),
+                     text.size(), decode_seconds);
+
+    std::string encoded;
+    double encode_seconds = MeasureBest([&]() {
+      encoded.clear();
+      Utils::Utf32ToUtf8(utf32.data(), utf32.size(), encoded);
+    });
+    ReportThroughput(name + "/utf32_to_utf8/" + SimdLevelName(level),
+                     text.size(), encode_seconds);
+  });
+
+  // Used for command lines, window titles and the clipboard, per character
+  std::wstring wide;
+  Measurement to_wide = Measure([&]() { wide = Utils::Utf8ToWChar(text); });
+  Report(name + "/utf8_to_wchar", to_wide, utf32.size(), text.size());
+  std::string narrow;
+  Measurement from_wide =
+      Measure([&]() { narrow = Utils::WCharToUtf8(wide); });
+  Report(name + "/wchar_to_utf8", from_wide, utf32.size(), text.size());
+}
+
+}  // namespace
+
+void RunTranscodeBench() {
+  const size_t size = 8 * 1024 * 1024;
+  for (const Corpus& corpus : MakeCorpora(size)) {
+    RunCorpus(corpus.name, corpus.data);
+  }
+  RunCorpus("unicode_text", MakeUnicodeText(size));
+}
+
+}  // namespace MTerm::Bench
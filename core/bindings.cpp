@@ -2,8 +2,16 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include "AnsiParser.h"
+#include "BufferSearch.h"
 #include "ColoredTextBuffer.h"
+#include "HighlightEngine.h"
+#include "InputLatency.h"
+#include "Instrumentation.h"
 #include "PseudoConsole.h"
+#include "PtyReactor.h"
+#include "PtyRecording.h"
+#include "SoftwareRenderBackend.h"
 #include "Utils.h"
 #include "Window.h"
 
@@ -11,6 +19,187 @@
 
 namespace py = pybind11;
 
+// gil_scoped_acquire that counts the wait in the gil_wait probe
+struct ProbedGilAcquire {
+  uint64_t start = MTerm::Instrumentation::IsActive()
+                       ? MTerm::Instrumentation::Now()
+                       : 0;
+  py::gil_scoped_acquire acquire;
+
+  ProbedGilAcquire() {
+    if (start) {
+      MTerm::Instrumentation::Record(MTerm::Probe::GilWait, start,
+                                     MTerm::Instrumentation::Now());
+    }
+  }
+};
+
+static py::str DecodeUtf8(const char* data, size_t size) {
+  return py::reinterpret_steal<py::str>(
+      PyUnicode_DecodeUTF8(data, static_cast<Py_ssize_t>(size), "replace"));
+}
+
+// Converts parsed actions into tuples:
+//   (ACTION_PRINT, text)
+//   (ACTION_EXECUTE, code)
+//   (ACTION_CSI, final, private_marker, intermediates, params)
+//   (ACTION_ESC, final, intermediates)
+//   (ACTION_OSC, text)
+//   (ACTION_DCS, final, private_marker, intermediates, params, text)
+static py::list ConvertParserActions(const MTerm::AnsiParser& parser) {
+  const std::string& data = parser.GetData();
+  const std::vector<int>& params = parser.GetParams();
+  py::list result;
+  for (const MTerm::ParserAction& action : parser.GetActions()) {
+    int type = static_cast<int>(action.type);
+    const char* text = data.data() + action.data_offset;
+    switch (action.type) {
+      case MTerm::ParserActionType::Print:
+      case MTerm::ParserActionType::OscDispatch:
+        result.append(
+            py::make_tuple(type, DecodeUtf8(text, action.data_length)));
+        break;
+      case MTerm::ParserActionType::Execute:
+        result.append(
+            py::make_tuple(type, static_cast<int>(action.final_byte)));
+        break;
+      case MTerm::ParserActionType::EscDispatch:
+        result.append(py::make_tuple(
+            type, std::string(1, action.final_byte),
+            std::string(action.intermediates, action.num_intermediates)));
+        break;
+      case MTerm::ParserActionType::CsiDispatch:
+      case MTerm::ParserActionType::DcsDispatch: {
+        py::list action_params;
+        for (uint32_t i = 0; i < action.num_params; i++) {
+          action_params.append(params[action.params_offset + i]);
+        }
+        std::string marker;
+        if (action.private_marker) {
+          marker.push_back(action.private_marker);
+        }
+        std::string intermediates(action.intermediates,
+                                  action.num_intermediates);
+        if (action.type == MTerm::ParserActionType::CsiDispatch) {
+          result.append(py::make_tuple(type, std::string(1, action.final_byte),
+                                       marker, intermediates, action_params));
+        } else {
+          result.append(py::make_tuple(
+              type, std::string(1, action.final_byte), marker, intermediates,
+              action_params, DecodeUtf8(text, action.data_length)));
+        }
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+static py::list ConvertSearchMatches(
+    const std::vector<MTerm::SearchMatch>& matches) {
+  py::list result;
+  for (const MTerm::SearchMatch& match : matches) {
+    result.append(py::make_tuple(match.line, match.start, match.end));
+  }
+  return result;
+}
+
+// Drawing methods shared by Window and SoftwareRenderer
+template <typename T>
+static void BindDrawing(py::class_<T>& cls) {
+  cls
+      .def(
+          "clear",
+          [](T& self, int color) {
+            py::gil_scoped_release release;
+            self.Clear(color);
+          },
+          "Clear target", py::arg("color"))
+      .def(
+          "text",
+          [](T& self, const std::string& utf8_text, float font_size, float x,
+             float y, int color, int underline_color, int background_color,
+             float opacity) {
+            std::vector<char32_t> utf32;
+            MTerm::Utils::Utf8ToUtf32(utf8_text.c_str(), utf8_text.size(),
+                                      utf32);
+            py::gil_scoped_release release;
+            self.Text(utf32.data(), static_cast<int>(utf32.size()), font_size,
+                      x, y, color, underline_color, background_color, opacity);
+          },
+          "Draw text", py::arg("text"), py::arg("font_size"), py::arg("x"),
+          py::arg("y"), py::arg("color"), py::arg("underline_color") = -1,
+          py::arg("background_color") = -1, py::arg("opacity") = 1.0f)
+      .def(
+          "line",
+          [](T& self, float start_x, float start_y, float end_x, float end_y,
+             float thickness, int color, float opacity) {
+            py::gil_scoped_release release;
+            self.Line(start_x, start_y, end_x, end_y, thickness, color,
+                      opacity);
+          },
+          "Draw line", py::arg("start_x"), py::arg("start_y"), py::arg("end_x"),
+          py::arg("end_y"), py::arg("thickness"), py::arg("color"),
+          py::arg("opacity") = 1.0f)
+      .def(
+          "rect",
+          [](T& self, float left, float top, float right, float bottom,
+             int color, float opacity) {
+            py::gil_scoped_release release;
+            self.Rect(left, top, right, bottom, color, opacity);
+          },
+          "Draw rectangle", py::arg("left"), py::arg("top"), py::arg("right"),
+          py::arg("bottom"), py::arg("color"), py::arg("opacity") = 1.0f)
+      .def(
+          "outline",
+          [](T& self, float left, float top, float right, float bottom,
+             float thickness, int color, float opacity) {
+            py::gil_scoped_release release;
+            self.Outline(left, top, right, bottom, thickness, color, opacity);
+          },
+          "Draw outline", py::arg("left"), py::arg("top"), py::arg("right"),
+          py::arg("bottom"), py::arg("thickness"), py::arg("color"),
+          py::arg("opacity") = 1.0f)
+      .def(
+          "text_buffer",
+          [](T& self, MTerm::ColoredTextBuffer* buffer, float left, float top,
+             float width, float height, int x_offset_chars, int y_offset_lines,
+             float font_size) {
+            // GIL не отпускается: буфер и его таблицу атрибутов меняют под
+            // GIL (колбэк PTY), а холодные строки читаются через общий LRU
+            self.TextBuffer(buffer, left, top, width, height, x_offset_chars,
+                            y_offset_lines, font_size);
+          },
+          "Draw text buffer", py::arg("buffer"), py::arg("left"),
+          py::arg("top"), py::arg("width"), py::arg("height"),
+          py::arg("x_offset_chars"), py::arg("y_offset_lines"),
+          py::arg("font_size"))
+      .def(
+          "set_palette",
+          [](T& self, const std::vector<int>& colors) {
+            self.SetPalette(colors);
+          },
+          "Set colors for palette indices", py::arg("colors"))
+      .def(
+          "set_highlight_rules",
+          [](T& self, const std::vector<MTerm::HighlightRule>& rules) {
+            std::shared_ptr<const MTerm::HighlightEngine> highlighter;
+            if (!rules.empty()) {
+              highlighter =
+                  std::make_shared<const MTerm::HighlightEngine>(rules);
+            }
+            self.SetHighlighter(std::move(highlighter));
+          },
+          "Highlight matches of rules in the visible lines of text buffers",
+          py::arg("rules"))
+      .def("get_advance", &T::GetAdvance, "Get character advance",
+           py::arg("font_size"))
+      .def("get_line_width", &T::GetLineWidth, "Get line width",
+           py::arg("font_size"), py::arg("num_chars"))
+      .def("get_line_height", &T::GetLineHeight, "Get line height",
+           py::arg("font_size"));
+}
+
 PYBIND11_MODULE(mterm, m) {
   m.doc() = "MTerm - Terminal emulator module";
 
@@ -18,9 +207,7 @@ PYBIND11_MODULE(mterm, m) {
   py::class_<LineFragment>(m, "LineFragment")
       .def(py::init<>())
       .def_readwrite("pos", &LineFragment::pos)
-      .def_readwrite("color", &LineFragment::color)
-      .def_readwrite("underline_color", &LineFragment::underline_color)
-      .def_readwrite("background_color", &LineFragment::background_color);
+      .def_readwrite("attr", &LineFragment::attr);
 
   py::class_<ColoredLine>(m, "ColoredLine")
       .def(py::init<>())
@@ -28,9 +215,9 @@ PYBIND11_MODULE(mterm, m) {
           "text",
           [](const ColoredLine& self) {
             // UTF-32 -> UTF-8 для чтения
-            std::vector<char> utf8;
+            std::string utf8;
             MTerm::Utils::Utf32ToUtf8(self.text.data(), self.text.size(), utf8);
-            return std::string(utf8.begin(), utf8.end());
+            return utf8;
           },
           [](ColoredLine& self, const std::string& utf8_str) {
             // UTF-8 -> UTF-32 для записи
@@ -38,7 +225,8 @@ PYBIND11_MODULE(mterm, m) {
             MTerm::Utils::Utf8ToUtf32(utf8_str.c_str(), utf8_str.size(),
                                       self.text);
           })
-      .def_readwrite("fragments", &ColoredLine::fragments);
+      .def_readwrite("fragments", &ColoredLine::fragments)
+      .def_readonly("version", &ColoredLine::version);
 
   // Экспорт Config структуры с UTF-8 callback
   py::class_<MTerm::Config>(m, "Config")
@@ -65,6 +253,8 @@ PYBIND11_MODULE(mterm, m) {
       .def_readwrite("window_min_height", &MTerm::Config::window_min_height)
       .def_readwrite("border_size", &MTerm::Config::border_size)
       .def_readwrite("cursor_id", &MTerm::Config::cursor_id)
+      .def_readwrite("frame_rate", &MTerm::Config::frame_rate)
+      .def_readwrite("frame_latency_ms", &MTerm::Config::frame_latency_ms)
       .def_readwrite("render_callback", &MTerm::Config::render_callback)
       .def_readwrite("resize_callback", &MTerm::Config::resize_callback)
       .def_readwrite("keydown_callback", &MTerm::Config::keydown_callback)
@@ -97,20 +287,82 @@ PYBIND11_MODULE(mterm, m) {
       .def_readwrite("mouseleave_callback",
                      &MTerm::Config::mouseleave_callback);
 
+  // Общий поток ввода-вывода для многих PseudoConsole
+  py::class_<MTerm::PtyReactor, std::shared_ptr<MTerm::PtyReactor>>(
+      m, "PtyReactor")
+      .def(py::init<>())
+      .def("set_byte_budget", &MTerm::PtyReactor::SetByteBudget,
+           "Set the bytes a session may read and deliver per turn",
+           py::arg("bytes"))
+      .def("get_byte_budget", &MTerm::PtyReactor::GetByteBudget)
+      .def(
+          "session_stats",
+          [](MTerm::PtyReactor& self) {
+            py::list result;
+            for (const MTerm::PtySessionStats& stats :
+                 self.GetSessionStats()) {
+              py::dict session;
+              session["id"] = stats.id;
+              session["bytes_read"] = stats.bytes_read;
+              session["bytes_written"] = stats.bytes_written;
+              session["deliveries"] = stats.deliveries;
+              session["budget_yields"] = stats.budget_yields;
+              session["stalls"] = stats.stalls;
+              session["pending_size"] = stats.pending_size;
+              session["read_rate"] = stats.read_rate;
+              result.append(session);
+            }
+            return result;
+          },
+          "Get per-session counters, read_rate is bytes per second since "
+          "the previous call");
+
   // Экспорт PseudoConsole с UTF-8 callback
   py::class_<MTerm::PseudoConsole>(m, "PseudoConsole")
-      .def(py::init<>())
+      .def(py::init<std::shared_ptr<MTerm::PtyReactor>>(),
+           py::arg("reactor") = nullptr)
+      .def("session_id", &MTerm::PseudoConsole::GetSessionId,
+           "Get the id in the reactor's session stats, 0 without a reactor")
+      .def("set_command", &MTerm::PseudoConsole::SetCommand,
+           "Set the program and arguments for the next start, empty runs "
+           "the default shell",
+           py::arg("argv"))
+      .def("set_environment", &MTerm::PseudoConsole::SetEnvironment,
+           "Replace the inherited environment with NAME=value entries, "
+           "empty inherits",
+           py::arg("environment"))
       .def(
           "start",
           [](MTerm::PseudoConsole& self, short num_rows, short num_columns,
-             std::function<void(const std::string&)> py_callback) {
-            // Конвертируем Python UTF-8 callback в C++ callback
-            auto wrapped_callback = [py_callback](const char* data,
-                                                  unsigned int length) {
-              py::gil_scoped_acquire acquire;
-              std::string utf8_str(data, length);
-              py_callback(utf8_str);
-            };
+             py::function py_callback, bool raw) {
+            // raw: callback получает memoryview на буфер чтения (без копии,
+            // валиден только внутри вызова). Иначе — str, при этом
+            // UTF-8 последовательности, разрезанные между чтениями,
+            // склеиваются декодером.
+            std::function<void(const char*, unsigned int)> wrapped_callback;
+            if (raw) {
+              wrapped_callback = [py_callback](const char* data,
+                                               unsigned int length) {
+                ProbedGilAcquire acquire;
+                py::memoryview view =
+                    py::memoryview::from_memory(data, length);
+                py_callback(view);
+                view.attr("release")();
+              };
+            } else {
+              auto decoder = std::make_shared<MTerm::Utf8StreamDecoder>();
+              auto buffer = std::make_shared<std::string>();
+              wrapped_callback = [py_callback, decoder, buffer](
+                                     const char* data, unsigned int length) {
+                buffer->clear();
+                decoder->Decode(data, length, *buffer);
+                if (buffer->empty()) {
+                  return;
+                }
+                ProbedGilAcquire acquire;
+                py_callback(DecodeUtf8(buffer->data(), buffer->size()));
+              };
+            }
 
             bool result;
             {
@@ -120,7 +372,7 @@ PYBIND11_MODULE(mterm, m) {
             return result;
           },
           "Start pseudo console", py::arg("num_rows"), py::arg("num_columns"),
-          py::arg("callback"))
+          py::arg("callback"), py::arg("raw") = false)
       .def(
           "send",
           [](MTerm::PseudoConsole& self, const std::string& utf8_data) {
@@ -129,6 +381,15 @@ PYBIND11_MODULE(mterm, m) {
                              static_cast<unsigned int>(utf8_data.size()));
           },
           "Send data to console", py::arg("data"))
+      .def(
+          "paste",
+          [](MTerm::PseudoConsole& self, const std::string& utf8_data,
+             bool bracketed) {
+            py::gil_scoped_release release;
+            return self.Paste(utf8_data.data(), utf8_data.size(), bracketed);
+          },
+          "Stream pasted text to console", py::arg("data"),
+          py::arg("bracketed") = false)
       .def(
           "resize",
           [](MTerm::PseudoConsole& self, short num_rows, short num_columns) {
@@ -142,16 +403,161 @@ PYBIND11_MODULE(mterm, m) {
             py::gil_scoped_release release;
             self.Close();
           },
-          "Close console");
+          "Close console")
+      .def(
+          "ring_stats",
+          [](const MTerm::PseudoConsole& self) {
+            MTerm::PtyRingStats stats = self.GetRingStats();
+            py::dict result;
+            result["capacity"] = stats.capacity;
+            result["size"] = stats.size;
+            result["peak_size"] = stats.peak_size;
+            result["bytes_read"] = stats.bytes_read;
+            result["batches"] = stats.batches;
+            result["stalls"] = stats.stalls;
+            result["dropped_bytes"] = stats.dropped_bytes;
+            return result;
+          },
+          "Get output ring occupancy and backpressure counters")
+      .def(
+          "write_stats",
+          [](const MTerm::PseudoConsole& self) {
+            MTerm::PtyWriteStats stats = self.GetWriteStats();
+            py::dict result;
+            result["queue_depth"] = stats.queue_depth;
+            result["bytes_in_flight"] = stats.bytes_in_flight;
+            result["bytes_written"] = stats.bytes_written;
+            result["writes"] = stats.writes;
+            result["coalesced_sends"] = stats.coalesced_sends;
+            return result;
+          },
+          "Get input queue depth and write counters")
+      .def("start_recording", &MTerm::PseudoConsole::StartRecording,
+           "Save received output with timestamps to a file for replay",
+           py::arg("path"))
+      .def("stop_recording", &MTerm::PseudoConsole::StopRecording,
+           "Stop saving output");
+
+  // Чтение записи вывода PseudoConsole:
+  //   (time_us, RECORD_OUTPUT, bytes)
+  //   (time_us, RECORD_RESIZE, (num_rows, num_columns))
+  py::class_<MTerm::PtyRecordingReader>(m, "PtyRecording")
+      .def(py::init([](const std::string& path) {
+             auto reader = std::make_unique<MTerm::PtyRecordingReader>();
+             if (!reader->Open(path)) {
+               throw std::runtime_error("Not a PTY recording: " + path);
+             }
+             return reader;
+           }),
+           py::arg("path"))
+      .def("__iter__",
+           [](MTerm::PtyRecordingReader& self) -> MTerm::PtyRecordingReader& {
+             return self;
+           })
+      .def("__next__", [](MTerm::PtyRecordingReader& self) {
+        MTerm::PtyRecord record;
+        if (!self.Next(record)) {
+          throw py::stop_iteration();
+        }
+        int type = static_cast<int>(record.type);
+        if (record.type == MTerm::PtyRecordType::Resize) {
+          return py::make_tuple(
+              record.time_us, type,
+              py::make_tuple(record.num_rows, record.num_columns));
+        }
+        return py::make_tuple(record.time_us, type, py::bytes(record.data));
+      });
 
   // Экспорт ColoredTextBuffer с UTF-8 интерфейсом
   py::class_<MTerm::ColoredTextBuffer>(m, "ColoredTextBuffer")
-      .def(py::init<>())
+      .def(py::init<size_t>(),
+           py::arg("max_lines") = MTerm::DEFAULT_MAX_LINES)
       .def("add_line", &MTerm::ColoredTextBuffer::AddLine, "Add new line")
-      .def("get_lines", &MTerm::ColoredTextBuffer::GetLines,
-           py::return_value_policy::reference_internal, "Get all lines")
+      .def(
+          "get_line",
+          [](const MTerm::ColoredTextBuffer& self, size_t line_index) {
+            if (line_index >= self.GetLineCount()) {
+              throw py::index_error("line index out of range");
+            }
+            // Копия: строки из сжатых блоков живут только в кэше
+            return ColoredLine(self.GetLine(line_index));
+          },
+          "Get copy of line", py::arg("line_index"))
       .def("get_line_count", &MTerm::ColoredTextBuffer::GetLineCount,
            "Get number of lines")
+      .def("get_line_version", &MTerm::ColoredTextBuffer::GetLineVersion,
+           "Get modification version of line (0 for invalid index)",
+           py::arg("line_index"))
+      .def(
+          "take_damage",
+          [](MTerm::ColoredTextBuffer& self) {
+            MTerm::LineDamage damage = self.TakeDamage();
+            return py::make_tuple(damage.begin, damage.end);
+          },
+          "Get and reset range of lines changed since the previous call")
+      .def("get_max_lines", &MTerm::ColoredTextBuffer::GetMaxLines,
+           "Get scrollback limit (0 - unlimited)")
+      .def("set_max_lines", &MTerm::ColoredTextBuffer::SetMaxLines,
+           "Set scrollback limit (0 - unlimited)", py::arg("max_lines"))
+      .def("get_trimmed_line_count",
+           &MTerm::ColoredTextBuffer::GetTrimmedLineCount,
+           "Get number of lines evicted from the top")
+      .def("get_hot_line_count", &MTerm::ColoredTextBuffer::GetHotLineCount,
+           "Get number of newest lines kept uncompressed")
+      .def("set_hot_line_count", &MTerm::ColoredTextBuffer::SetHotLineCount,
+           "Set number of newest lines kept uncompressed (0 - never "
+           "compress)",
+           py::arg("hot_lines"))
+      .def("get_spill_budget", &MTerm::ColoredTextBuffer::GetSpillBudget,
+           "Get bytes of compressed scrollback kept in memory")
+      .def("set_spill_budget", &MTerm::ColoredTextBuffer::SetSpillBudget,
+           "Set bytes of compressed scrollback kept in memory before it is "
+           "moved to a temp file (0 - never spill)",
+           py::arg("budget"))
+      .def(
+          "get_scrollback_stats",
+          [](const MTerm::ColoredTextBuffer& self) {
+            MTerm::ScrollbackStats stats = self.GetScrollbackStats();
+            py::dict result;
+            result["hot_lines"] = stats.hot_lines;
+            result["cold_lines"] = stats.cold_lines;
+            result["cold_blocks"] = stats.cold_blocks;
+            result["uncompressed_bytes"] = stats.uncompressed_bytes;
+            result["compressed_bytes"] = stats.compressed_bytes;
+            result["spilled_blocks"] = stats.spilled_blocks;
+            result["spilled_bytes"] = stats.spilled_bytes;
+            result["spill_file_bytes"] = stats.spill_file_bytes;
+            result["cache_hits"] = stats.cache_hits;
+            result["cache_misses"] = stats.cache_misses;
+            return result;
+          },
+          "Get sizes of compressed scrollback")
+      .def("get_search_index_budget",
+           &MTerm::ColoredTextBuffer::GetSearchIndexBudget,
+           "Get bytes the search index may use (0 - no index)")
+      .def("set_search_index_budget",
+           &MTerm::ColoredTextBuffer::SetSearchIndexBudget,
+           "Index lines added from now on for BufferSearch, dropping the "
+           "oldest beyond budget bytes (0 - no index)",
+           py::arg("budget"))
+      .def(
+          "get_search_index_stats",
+          [](const MTerm::ColoredTextBuffer& self) {
+            py::dict result;
+            const MTerm::TrigramIndex* index = self.GetSearchIndex();
+            if (!index) {
+              return result;
+            }
+            MTerm::SearchIndexStats stats = index->GetStats();
+            result["indexed_lines"] = stats.indexed_lines;
+            result["dropped_lines"] = stats.dropped_lines;
+            result["segments"] = stats.segments;
+            result["trigrams"] = stats.trigrams;
+            result["memory_bytes"] = stats.memory_bytes;
+            result["dirty_lines"] = stats.dirty_lines;
+            return result;
+          },
+          "Get size of the search index, empty without index")
       .def("insert_lines", &MTerm::ColoredTextBuffer::InsertLines,
            "Insert lines at index", py::arg("index"), py::arg("count"))
       .def("remove_lines", &MTerm::ColoredTextBuffer::RemoveLines,
@@ -202,10 +608,145 @@ PYBIND11_MODULE(mterm, m) {
       .def("set_color", &MTerm::ColoredTextBuffer::SetColor,
            "Set color for text range", py::arg("line_index"),
            py::arg("start_pos"), py::arg("end_pos"), py::arg("color"),
-           py::arg("underline_color"), py::arg("background_color"));
+           py::arg("underline_color"), py::arg("background_color"),
+           py::arg("flags") = 0)
+      .def(
+          "get_attributes",
+          [](const MTerm::ColoredTextBuffer& self, uint32_t attr) {
+            if (attr >= self.GetAttributeCount()) {
+              throw py::index_error("attribute id out of range");
+            }
+            const MTerm::TextAttributes& attributes = self.GetAttributes(attr);
+            return py::make_tuple(attributes.color, attributes.underline_color,
+                                  attributes.background_color,
+                                  attributes.flags);
+          },
+          "Get (color, underline_color, background_color, flags) of a "
+          "fragment attribute id",
+          py::arg("attr"))
+      .def("get_attribute_count",
+           &MTerm::ColoredTextBuffer::GetAttributeCount,
+           "Get number of distinct attributes in use");
+
+  // Поиск по ColoredTextBuffer в фоновом потоке. Совпадения - кортежи
+  // (line, start, end), line - абсолютный номер строки (индекс +
+  // get_trimmed_line_count()).
+  py::class_<MTerm::BufferSearch>(m, "BufferSearch")
+      .def(py::init([](const MTerm::ColoredTextBuffer& buffer,
+                       const std::string& pattern, bool regex,
+                       bool ignore_case) {
+             return std::make_unique<MTerm::BufferSearch>(
+                 buffer, pattern,
+                 regex ? MTerm::SearchMode::Regex : MTerm::SearchMode::Literal,
+                 ignore_case);
+           }),
+           py::arg("buffer"), py::arg("pattern"), py::arg("regex") = false,
+           py::arg("ignore_case") = false, py::keep_alive<1, 2>())
+      .def("update", &MTerm::BufferSearch::Update,
+           "Copy changed lines and a slice of scrollback for the search "
+           "thread, call from the thread editing the buffer",
+           py::arg("max_lines") = MTerm::DEFAULT_SEARCH_SLICE)
+      .def(
+          "take_new_matches",
+          [](MTerm::BufferSearch& self) {
+            return ConvertSearchMatches(self.TakeNewMatches());
+          },
+          "Get matches found since the previous call")
+      .def(
+          "get_matches",
+          [](const MTerm::BufferSearch& self, uint64_t begin, uint64_t end) {
+            return ConvertSearchMatches(self.GetMatches(begin, end));
+          },
+          "Get matches on absolute lines [begin, end)", py::arg("begin"),
+          py::arg("end"))
+      .def(
+          "find_next",
+          [](const MTerm::BufferSearch& self, uint64_t line, int column,
+             bool backward) -> py::object {
+            MTerm::SearchMatch match;
+            if (!self.FindNext(line, column, backward, match)) {
+              return py::none();
+            }
+            return py::make_tuple(match.line, match.start, match.end);
+          },
+          "Get the next match after a position, or None",
+          py::arg("line"), py::arg("column"), py::arg("backward") = false)
+      .def("get_match_count", &MTerm::BufferSearch::GetMatchCount,
+           "Get number of current matches")
+      .def(
+          "stats",
+          [](const MTerm::BufferSearch& self) {
+            MTerm::SearchStats stats = self.GetStats();
+            py::dict result;
+            result["lines_searched"] = stats.lines_searched;
+            result["lines_queued"] = stats.lines_queued;
+            result["lines_remaining"] = stats.lines_remaining;
+            result["matches"] = stats.matches;
+            result["done"] = stats.done;
+            return result;
+          },
+          "Get search progress");
+
+  // Правило подсветки: литерал или регулярное выражение и атрибуты,
+  // заменяющие атрибуты совпавшего текста (HIGHLIGHT_KEEP - оставить свой)
+  py::class_<MTerm::HighlightRule>(m, "HighlightRule")
+      .def(py::init([](const std::string& pattern, bool regex,
+                       bool ignore_case, int color, int underline_color,
+                       int background_color, uint32_t flags) {
+             return MTerm::HighlightRule{pattern,         regex,
+                                         ignore_case,     color,
+                                         underline_color, background_color,
+                                         flags};
+           }),
+           py::arg("pattern"), py::arg("regex") = false,
+           py::arg("ignore_case") = false,
+           py::arg("color") = MTerm::HIGHLIGHT_KEEP,
+           py::arg("underline_color") = MTerm::HIGHLIGHT_KEEP,
+           py::arg("background_color") = MTerm::HIGHLIGHT_KEEP,
+           py::arg("flags") = 0)
+      .def_readwrite("pattern", &MTerm::HighlightRule::pattern)
+      .def_readwrite("regex", &MTerm::HighlightRule::regex)
+      .def_readwrite("ignore_case", &MTerm::HighlightRule::ignore_case)
+      .def_readwrite("color", &MTerm::HighlightRule::color)
+      .def_readwrite("underline_color",
+                     &MTerm::HighlightRule::underline_color)
+      .def_readwrite("background_color",
+                     &MTerm::HighlightRule::background_color)
+      .def_readwrite("flags", &MTerm::HighlightRule::flags);
+
+  // Экспорт AnsiParser
+  py::class_<MTerm::AnsiParser>(m, "AnsiParser")
+      .def(py::init<>())
+      .def(
+          "feed",
+          [](MTerm::AnsiParser& self, const std::string& data) {
+            MTerm::ScopedProbe probe(MTerm::Probe::Parse, data.size());
+            self.Feed(data.data(), data.size());
+            py::list actions = ConvertParserActions(self);
+            self.ClearActions();
+            return actions;
+          },
+          "Parse output and return a list of actions", py::arg("data"))
+      .def(
+          "feed",
+          [](MTerm::AnsiParser& self, py::buffer data) {
+            py::buffer_info info = data.request();
+            MTerm::ScopedProbe probe(
+                MTerm::Probe::Parse,
+                static_cast<uint64_t>(info.size * info.itemsize));
+            self.Feed(static_cast<const char*>(info.ptr),
+                      static_cast<size_t>(info.size * info.itemsize));
+            py::list actions = ConvertParserActions(self);
+            self.ClearActions();
+            return actions;
+          },
+          "Parse raw output bytes and return a list of actions",
+          py::arg("data"))
+      .def("reset", &MTerm::AnsiParser::Reset, "Reset parser state");
 
   // Экспорт Window с UTF-8 интерфейсом
-  py::class_<MTerm::Window>(m, "Window")
+  py::class_<MTerm::Window> window(m, "Window");
+  window
       .def(py::init<>())
       .def(
           "create",
@@ -214,7 +755,7 @@ PYBIND11_MODULE(mterm, m) {
             if (config.render_callback) {
               auto original_render = config.render_callback;
               config.render_callback = [original_render]() {
-                py::gil_scoped_acquire acquire;
+                ProbedGilAcquire acquire;
                 original_render();
               };
             }
@@ -360,76 +901,62 @@ PYBIND11_MODULE(mterm, m) {
       .def("get_width", &MTerm::Window::GetWidth, "Get window width")
       .def("get_height", &MTerm::Window::GetHeight, "Get window height")
       .def(
-          "clear",
-          [](MTerm::Window& self, int color) {
-            py::gil_scoped_release release;
-            self.Clear(color);
-          },
-          "Clear window", py::arg("color"))
-      .def(
-          "text",
-          [](MTerm::Window& self, const std::string& utf8_text, float font_size,
-             float x, float y, int color, int underline_color,
-             int background_color, float opacity) {
-            std::vector<char32_t> utf32;
-            MTerm::Utils::Utf8ToUtf32(utf8_text.c_str(), utf8_text.size(),
-                                      utf32);
-            py::gil_scoped_release release;
-            self.Text(utf32.data(), static_cast<int>(utf32.size()), font_size,
-                      x, y, color, underline_color, background_color, opacity);
+          "get_frame_stats",
+          [](const MTerm::Window& self) {
+            MTerm::FrameSchedulerStats stats = self.GetFrameStats();
+            py::dict result;
+            result["requests"] = stats.requests;
+            result["frames"] = stats.frames;
+            result["frame_interval_us"] = stats.frame_interval_us;
+            result["frame_cost_us"] = stats.frame_cost_us;
+            return result;
           },
-          "Draw text", py::arg("text"), py::arg("font_size"), py::arg("x"),
-          py::arg("y"), py::arg("color"), py::arg("underline_color") = -1,
-          py::arg("background_color") = -1, py::arg("opacity") = 1.0f)
+          "Get redraw requests, frames drawn and the current frame interval")
       .def(
-          "line",
-          [](MTerm::Window& self, float start_x, float start_y, float end_x,
-             float end_y, float thickness, int color, float opacity) {
-            py::gil_scoped_release release;
-            self.Line(start_x, start_y, end_x, end_y, thickness, color,
-                      opacity);
+          "get_batch_stats",
+          [](const MTerm::Window& self) {
+            MTerm::BatchStats stats = self.GetBatchStats();
+            py::dict result;
+            result["draw_calls"] = stats.draw_calls;
+            result["batched_draw_calls"] = stats.batched_draw_calls;
+            result["skipped_backgrounds"] = stats.skipped_backgrounds;
+            return result;
           },
-          "Draw line", py::arg("start_x"), py::arg("start_y"), py::arg("end_x"),
-          py::arg("end_y"), py::arg("thickness"), py::arg("color"),
-          py::arg("opacity") = 1.0f)
+          "Get draw calls of the last frame before and after batching");
+  BindDrawing(window);
+
+  // Отрисовка в памяти, без окна и GPU
+  py::class_<MTerm::SoftwareRenderBackend> software(m, "SoftwareRenderer");
+  software
+      .def(py::init<int, int>(), py::arg("width"), py::arg("height"))
+      .def("resize", &MTerm::SoftwareRenderBackend::Resize,
+           "Resize framebuffer", py::arg("width"), py::arg("height"))
+      .def("get_width", &MTerm::SoftwareRenderBackend::GetWidth,
+           "Get framebuffer width")
+      .def("get_height", &MTerm::SoftwareRenderBackend::GetHeight,
+           "Get framebuffer height")
       .def(
-          "rect",
-          [](MTerm::Window& self, float left, float top, float right,
-             float bottom, int color, float opacity) {
+          "begin_frame",
+          [](MTerm::SoftwareRenderBackend& self) {
             py::gil_scoped_release release;
-            self.Rect(left, top, right, bottom, color, opacity);
+            self.BeginFrame();
           },
-          "Draw rectangle", py::arg("left"), py::arg("top"), py::arg("right"),
-          py::arg("bottom"), py::arg("color"), py::arg("opacity") = 1.0f)
+          "Start a frame")
       .def(
-          "outline",
-          [](MTerm::Window& self, float left, float top, float right,
-             float bottom, float thickness, int color, float opacity) {
+          "end_frame",
+          [](MTerm::SoftwareRenderBackend& self) {
             py::gil_scoped_release release;
-            self.Outline(left, top, right, bottom, thickness, color, opacity);
+            self.EndFrame();
           },
-          "Draw outline", py::arg("left"), py::arg("top"), py::arg("right"),
-          py::arg("bottom"), py::arg("thickness"), py::arg("color"),
-          py::arg("opacity") = 1.0f)
+          "Finish a frame")
       .def(
-          "text_buffer",
-          [](MTerm::Window& self, MTerm::ColoredTextBuffer* buffer, float left,
-             float top, float width, float height, int x_offset_chars,
-             int y_offset_lines, float font_size) {
-            py::gil_scoped_release release;
-            self.TextBuffer(buffer, left, top, width, height, x_offset_chars,
-                            y_offset_lines, font_size);
+          "get_pixels",
+          [](const MTerm::SoftwareRenderBackend& self) {
+            return py::bytes(reinterpret_cast<const char*>(self.GetPixels()),
+                             self.GetPixelsSize());
           },
-          "Draw text buffer", py::arg("buffer"), py::arg("left"),
-          py::arg("top"), py::arg("width"), py::arg("height"),
-          py::arg("x_offset_chars"), py::arg("y_offset_lines"),
-          py::arg("font_size"))
-      .def("get_advance", &MTerm::Window::GetAdvance, "Get character advance",
-           py::arg("font_size"))
-      .def("get_line_width", &MTerm::Window::GetLineWidth, "Get line width",
-           py::arg("font_size"), py::arg("num_chars"))
-      .def("get_line_height", &MTerm::Window::GetLineHeight, "Get line height",
-           py::arg("font_size"));
+          "Get framebuffer as RGBA bytes, rows top to bottom");
+  BindDrawing(software);
 
   m.def(
       "is_key_down",
@@ -482,7 +1009,106 @@ PYBIND11_MODULE(mterm, m) {
       },
       "Paste text from clipboard");
 
+  m.def("set_stats_enabled", &MTerm::Instrumentation::SetEnabled,
+        py::arg("enabled"),
+        "Count calls and latencies of the hot paths for stats()");
+
+  m.def("is_stats_enabled", &MTerm::Instrumentation::IsEnabled,
+        "Whether the hot paths are counted");
+
+  m.def(
+      "stats",
+      []() {
+        py::dict result;
+        for (const MTerm::ProbeStats& stats :
+             MTerm::Instrumentation::GetSnapshot()) {
+          py::dict probe;
+          probe["calls"] = stats.calls;
+          probe["total_ns"] = stats.total_ns;
+          probe["max_ns"] = stats.max_ns;
+          probe["amount"] = stats.amount;
+          probe["p50_ns"] = MTerm::Instrumentation::GetPercentile(stats, 0.5);
+          probe["p99_ns"] = MTerm::Instrumentation::GetPercentile(stats, 0.99);
+          // Upper bound of the bucket in ns (0 for the last one) -> calls
+          py::dict histogram;
+          for (int i = 0; i < MTerm::INSTRUMENTATION_BUCKETS; i++) {
+            if (stats.histogram[i]) {
+              histogram[py::int_(MTerm::Instrumentation::GetBucketBound(i))] =
+                  stats.histogram[i];
+            }
+          }
+          probe["histogram"] = histogram;
+          result[stats.name] = probe;
+        }
+        return result;
+      },
+      "Get counters and latency histograms of the hot paths by probe name");
+
+  m.def("reset_stats", &MTerm::Instrumentation::Reset,
+        "Clear the counters of stats()");
+
+  m.def("start_trace", &MTerm::Instrumentation::StartTrace,
+        py::arg("max_events") = 1000000,
+        "Record every probed call until stop_trace()");
+
+  m.def(
+      "stop_trace",
+      [](const std::string& path) {
+        py::gil_scoped_release release;
+        if (!MTerm::Instrumentation::StopTrace(path)) {
+          throw std::runtime_error("Failed to write the trace to " + path);
+        }
+      },
+      py::arg("path"),
+      "Stop recording and write the calls as Chrome trace_event JSON "
+      "(chrome://tracing, Perfetto)");
+
+  m.def("set_latency_probe_enabled", &MTerm::InputLatency::SetEnabled,
+        py::arg("enabled"),
+        "Follow key presses to the frame that shows their echo");
+
+  m.def(
+      "latency_stats",
+      []() {
+        MTerm::InputLatencyStats stats = MTerm::InputLatency::GetStats();
+        py::dict result;
+        result["samples"] = stats.samples;
+        result["unanswered"] = stats.unanswered;
+        result["p50_us"] = stats.p50_us;
+        result["p99_us"] = stats.p99_us;
+        result["max_us"] = stats.max_us;
+        result["send_us"] = stats.send_us;
+        result["echo_us"] = stats.echo_us;
+        result["apply_us"] = stats.apply_us;
+        result["frame_us"] = stats.frame_us;
+        return result;
+      },
+      "Get key press to frame latency and the medians of its stages");
+
+  m.def("reset_latency_stats", &MTerm::InputLatency::Reset,
+        "Clear the latency samples");
+
   // Константы
   m.attr("PTY_BUFFER_SIZE") = MTerm::PTY_BUFFER_SIZE;
   m.attr("TEXT_BUFFER_SIZE") = MTerm::TEXT_BUFFER_SIZE;
+  m.attr("COLOR_DEFAULT") = MTerm::COLOR_DEFAULT;
+  m.attr("COLOR_PALETTE_FLAG") = MTerm::COLOR_PALETTE_FLAG;
+  m.attr("HIGHLIGHT_KEEP") = MTerm::HIGHLIGHT_KEEP;
+  m.attr("ATTR_BOLD") = static_cast<int>(MTerm::ATTR_BOLD);
+  m.attr("ATTR_ITALIC") = static_cast<int>(MTerm::ATTR_ITALIC);
+  m.attr("ATTR_INVERSE") = static_cast<int>(MTerm::ATTR_INVERSE);
+  m.attr("ACTION_PRINT") =
+      static_cast<int>(MTerm::ParserActionType::Print);
+  m.attr("ACTION_EXECUTE") =
+      static_cast<int>(MTerm::ParserActionType::Execute);
+  m.attr("ACTION_CSI") =
+      static_cast<int>(MTerm::ParserActionType::CsiDispatch);
+  m.attr("ACTION_ESC") =
+      static_cast<int>(MTerm::ParserActionType::EscDispatch);
+  m.attr("ACTION_OSC") =
+      static_cast<int>(MTerm::ParserActionType::OscDispatch);
+  m.attr("ACTION_DCS") =
+      static_cast<int>(MTerm::ParserActionType::DcsDispatch);
+  m.attr("RECORD_OUTPUT") = static_cast<int>(MTerm::PtyRecordType::Output);
+  m.attr("RECORD_RESIZE") = static_cast<int>(MTerm::PtyRecordType::Resize);
 }
\ No newline at end of file
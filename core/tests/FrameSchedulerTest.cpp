@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "FrameScheduler.h"
+
+namespace MTerm {
+
+namespace {
+
+using TimePoint = FrameScheduler::TimePoint;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      g_failures++;                                                   \
+    }                                                                 \
+  } while (false)
+
+struct SimulationResult {
+  uint64_t frames;
+  microseconds max_wait;  // From the oldest request to its frame time
+};
+
+// Drives a scheduler like the window's record thread does: requests come
+// every request_interval for duration, every frame takes cost
+SimulationResult Simulate(microseconds request_interval,
+                          microseconds cost,
+                          microseconds duration) {
+  TimePoint now;
+  FrameScheduler scheduler([&now]() { return now; });
+  const TimePoint end = now + duration;
+
+  TimePoint next_request = now;
+  TimePoint oldest_request = now;
+  SimulationResult result{0, microseconds(0)};
+  auto request = [&]() {
+    now = next_request;
+    if (!scheduler.IsPending()) {
+      oldest_request = now;
+    }
+    scheduler.RequestFrame();
+    next_request += request_interval;
+  };
+
+  while (now < end) {
+    if (!scheduler.IsPending() ||
+        next_request <= std::max(now, scheduler.GetFrameTime())) {
+      request();
+      continue;
+    }
+    TimePoint frame_time = scheduler.GetFrameTime();
+    result.max_wait = std::max(
+        result.max_wait,
+        std::chrono::duration_cast<microseconds>(frame_time - oldest_request));
+    now = std::max(now, frame_time);
+    result.frames++;
+
+    scheduler.BeginFrame();
+    TimePoint frame_end = now + cost;
+    // Output keeps coming while the frame is drawn
+    while (next_request < frame_end) {
+      request();
+    }
+    now = frame_end;
+    scheduler.EndFrame();
+  }
+  return result;
+}
+
+void TestFirstRequestDrawsAtOnce() {
+  TimePoint now = TimePoint() + std::chrono::seconds(1);
+  FrameScheduler scheduler([&now]() { return now; });
+  CHECK(!scheduler.IsPending());
+
+  scheduler.RequestFrame();
+  CHECK(scheduler.IsPending());
+  CHECK(scheduler.GetFrameTime() == now);
+  scheduler.BeginFrame();
+  now += milliseconds(2);
+  scheduler.EndFrame();
+
+  // After an idle period the pacing does not delay the next one either
+  now += std::chrono::seconds(1);
+  scheduler.RequestFrame();
+  CHECK(scheduler.GetFrameTime() == now);
+}
+
+void TestRequestsCoalesce() {
+  TimePoint now;
+  FrameScheduler scheduler([&now]() { return now; });
+  scheduler.RequestFrame();
+  scheduler.BeginFrame();
+  now += milliseconds(1);
+  scheduler.EndFrame();
+
+  TimePoint frame_time;
+  for (int i = 0; i < 100; i++) {
+    scheduler.RequestFrame();
+    if (i == 0) {
+      frame_time = scheduler.GetFrameTime();
+    }
+    // Every request until the frame starts is drawn by it
+    CHECK(scheduler.GetFrameTime() == frame_time);
+    now += microseconds(100);
+  }
+  CHECK(frame_time - (TimePoint() + milliseconds(1)) <
+        scheduler.GetFrameInterval());
+  now = std::max(now, frame_time);
+  scheduler.BeginFrame();
+  CHECK(!scheduler.IsPending());
+
+  FrameSchedulerStats stats = scheduler.GetStats();
+  CHECK(stats.requests == 101);
+  CHECK(stats.frames == 2);
+}
+
+void TestImmediateFrame() {
+  TimePoint now;
+  FrameScheduler scheduler([&now]() { return now; });
+  scheduler.RequestFrame();
+  scheduler.BeginFrame();
+  scheduler.EndFrame();
+
+  scheduler.RequestFrame();
+  CHECK(scheduler.GetFrameTime() > now);
+  scheduler.RequestImmediateFrame();
+  CHECK(scheduler.GetFrameTime() == now);
+}
+
+void TestFloodIsCapped() {
+  const microseconds second = std::chrono::seconds(1);
+
+  // Cheap frames: the target rate, 60 per second
+  SimulationResult cheap =
+      Simulate(microseconds(50), milliseconds(2), second);
+  CHECK(cheap.frames >= 55);
+  CHECK(cheap.frames <= 61);
+
+  // Expensive frames take at most half of the time
+  SimulationResult expensive =
+      Simulate(microseconds(50), milliseconds(20), second);
+  CHECK(expensive.frames <=
+        static_cast<uint64_t>(second / milliseconds(40)) + 1);
+  CHECK(expensive.frames >= 20);
+}
+
+void TestWaitsStayInBudget() {
+  const microseconds budget = milliseconds(50);
+  const microseconds duration = std::chrono::seconds(2);
+  for (microseconds cost : {microseconds(500), microseconds(2000),
+                            microseconds(20000), microseconds(80000)}) {
+    for (microseconds interval :
+         {microseconds(50), microseconds(5000), microseconds(150000)}) {
+      SimulationResult result = Simulate(interval, cost, duration);
+      CHECK(result.max_wait <= budget);
+    }
+  }
+}
+
+}  // namespace
+
+}  // namespace MTerm
+
+int main() {
+  MTerm::TestFirstRequestDrawsAtOnce();
+  MTerm::TestRequestsCoalesce();
+  MTerm::TestImmediateFrame();
+  MTerm::TestFloodIsCapped();
+  MTerm::TestWaitsStayInBudget();
+  if (MTerm::g_failures > 0) {
+    fprintf(stderr, "%d checks failed\n", MTerm::g_failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -1,6 +1,20 @@
 import core
 import user.theme as theme
+import user.highlight as highlight
 from . import selector_color_helper
+from .terminal import build_palette
+
+
+def print_latency_stats(stats):
+    print(
+        f"key press to frame: {stats['samples']} samples, "
+        f"p50 {stats['p50_us'] / 1000:.1f} ms, p99 {stats['p99_us'] / 1000:.1f} ms, "
+        f"max {stats['max_us'] / 1000:.1f} ms, {stats['unanswered']} unanswered"
+    )
+    print(
+        f"  send {stats['send_us'] / 1000:.2f} ms, echo {stats['echo_us'] / 1000:.2f} ms, "
+        f"apply {stats['apply_us'] / 1000:.2f} ms, frame {stats['frame_us'] / 1000:.2f} ms"
+    )
 
 
 class BaseApp(core.Window):
@@ -13,11 +27,15 @@ class BaseApp(core.Window):
         super().__init__()
         self.terminals = []
         self.active_terminal = None
+        self.pty_reactor = core.PtyReactor() if theme.Terminal.SHARED_IO else None
 
         self.selected_ctl_button = -1
         self.selector_hovered_button = -1
         self.current_cursor = core.cursors.ARROW
 
+        self.set_palette(build_palette())
+        self.set_highlight_rules(highlight.RULES)
+
     def get_client_width(self):
         return self.get_width()
 
@@ -293,17 +311,29 @@ class BaseApp(core.Window):
         )
 
     def main(self, icon_path="icon.ico"):
+        if theme.Window.LATENCY_PROBE:
+            core.set_latency_probe_enabled(True)
+        if theme.Window.TRACE_PATH:
+            core.start_trace()
         self.create_terminal()
-        self.run(
-            font_name=theme.Window.FONT,
-            icon_path=icon_path,
-            width=theme.Window.WIDTH,
-            height=theme.Window.HEIGHT,
-            min_width=theme.Window.MIN_WIDTH,
-            min_height=theme.Window.MIN_HEIGHT,
-            border_size=theme.Window.BORDER_SIZE,
-            cursor_id=core.cursors.ARROW,
-        )
+        try:
+            self.run(
+                font_name=theme.Window.FONT,
+                icon_path=icon_path,
+                width=theme.Window.WIDTH,
+                height=theme.Window.HEIGHT,
+                min_width=theme.Window.MIN_WIDTH,
+                min_height=theme.Window.MIN_HEIGHT,
+                border_size=theme.Window.BORDER_SIZE,
+                cursor_id=core.cursors.ARROW,
+                frame_rate=theme.Window.FRAME_RATE,
+                frame_latency_ms=theme.Window.FRAME_LATENCY_MS,
+            )
+        finally:
+            if theme.Window.TRACE_PATH:
+                core.stop_trace(theme.Window.TRACE_PATH)
+            if theme.Window.LATENCY_PROBE:
+                print_latency_stats(core.latency_stats())
 
 
 if __name__ == "__main__":
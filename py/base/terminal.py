@@ -1,25 +1,70 @@
-from core import PseudoConsole, ColoredTextBuffer
+from core import PseudoConsole, ColoredTextBuffer, AnsiParser
+import core
 import user.theme as theme
 import weakref
 import math
-from user.highlight import highlight
+import os
+
+
+def palette_color(index):
+    """Color that the renderer resolves through the palette"""
+    return core.COLOR_PALETTE_FLAG | index
+
+
+def build_palette():
+    """256-color palette: theme colors, 6x6x6 color cube, grayscale"""
+    palette = list(theme.Terminal.ANSI_COLORS) + list(
+        theme.Terminal.ANSI_BRIGHT_COLORS
+    )
+    for index in range(216):
+        r = (index // 36) % 6
+        g = (index // 6) % 6
+        b = index % 6
+
+        r = r * 40 + 55 if r > 0 else 0
+        g = g * 40 + 55 if g > 0 else 0
+        b = b * 40 + 55 if b > 0 else 0
+
+        palette.append((r << 16) | (g << 8) | b)
+    for index in range(24):
+        level = (index * 255) // 23
+        palette.append((level << 16) | (level << 8) | level)
+    return palette
 
 
 class Screen:
-    def __init__(self):
-        self.buffer = ColoredTextBuffer()
+    def __init__(self, max_lines=theme.Terminal.SCROLLBACK_LINES,
+                 spill_budget=theme.Terminal.SCROLLBACK_MEMORY,
+                 search_index_budget=theme.Terminal.SEARCH_INDEX_MEMORY):
+        self.buffer = ColoredTextBuffer(max_lines)
+        self.buffer.set_spill_budget(spill_budget)
+        self.search_index_budget = search_index_budget
+        self.trimmed_lines = 0
         self.start_pos = 0
         self.cursor_x = 0
         self.cursor_y = 0
         self.saved_cursor_x = 0
         self.saved_cursor_y = 0
 
+    def add_line(self):
+        """Append a line, keeping start_pos on the same line if the buffer
+        evicted old lines to make room"""
+        self.buffer.add_line()
+        self.sync_trimmed_lines()
+
+    def sync_trimmed_lines(self):
+        """Shift start_pos by the lines the buffer evicted since the last
+        call, after any edit that can grow a full buffer"""
+        trimmed = self.buffer.get_trimmed_line_count()
+        if trimmed != self.trimmed_lines:
+            self.start_pos = max(0, self.start_pos - (trimmed - self.trimmed_lines))
+            self.trimmed_lines = trimmed
 
-class EscapeState:
-    NONE = 0
-    ESC = 1
-    CSI = 2
-    OSC = 3
+    def enable_search_index(self):
+        """Index new lines for later searches; lines added before are
+        searched without the index"""
+        if self.buffer.get_search_index_budget() == 0:
+            self.buffer.set_search_index_budget(self.search_index_budget)
 
 
 class BaseTerminal:
@@ -27,7 +72,7 @@ class BaseTerminal:
         self.app = app
         self.id = id
         self.title = f"T-{self.id}"
-        self.console = PseudoConsole()
+        self.console = PseudoConsole(app.pty_reactor)
 
         # Screen management
         self.main_screen = Screen()
@@ -36,6 +81,7 @@ class BaseTerminal:
         self.is_alt_screen = False
 
         self.is_cursor_visible = True
+        self.is_bracketed_paste = False
 
         # Terminal dimensions
         self.font_size = theme.Terminal.BASE_FONT_SIZE
@@ -50,11 +96,10 @@ class BaseTerminal:
         self.background_color = -1
         self.underline_color = -1
         self.underline_enabled = False
+        self.text_flags = 0
 
         # ANSI parser state
-        self.in_escape = False
-        self.escape_state = EscapeState.NONE
-        self.escape_buffer = ""
+        self.parser = AnsiParser()
 
         # Initialize terminal size
         line_height = app.get_line_height(self.font_size)
@@ -63,11 +108,24 @@ class BaseTerminal:
             self.num_rows = int(app.get_client_height() // line_height)
             self.num_columns = int(app.get_terminal_width() // advance)
 
-        # Start the console
+        self.start_console()
+
+    def start_console(self):
+        self.console.set_command(theme.Terminal.COMMAND)
+        self.console.set_environment(theme.Terminal.ENVIRONMENT)
+        if theme.Terminal.RECORD_DIR:
+            path = os.path.join(
+                theme.Terminal.RECORD_DIR, f"mterm-{os.getpid()}-{self.id}.mtrec"
+            )
+            self.console.start_recording(path)
+
+        # Start the console; output arrives as raw bytes and the parser
+        # reassembles UTF-8 sequences split between reads
         self.console.start(
             self.num_rows,
             self.num_columns,
             self._make_callback(BaseTerminal.on_console_output),
+            raw=True,
         )
 
     def _make_callback(self, method):
@@ -156,92 +214,35 @@ class BaseTerminal:
             1,
         )
 
-    def reset_escape_state(self):
-        """Reset escape sequence parsing state"""
-        self.in_escape = False
-        self.escape_state = EscapeState.NONE
-        self.escape_buffer = ""
-
     def process_ansi(self, text):
         """Process text with ANSI escape sequences"""
-        # print(text.replace("\x1b", "ESC").replace(" ", "_"))
-        text_buffer = ""
-
-        for c in text:
-            if self.in_escape:
-                if ord(c) < 128:  # Only ASCII characters in escape sequences
-                    self.escape_buffer += c
-
-                    if self.escape_state == EscapeState.ESC:
-                        if c == "[":
-                            self.escape_state = EscapeState.CSI
-                        elif c == "]":
-                            self.escape_state = EscapeState.OSC
-                        elif c in "78cDEHM":
-                            self.handle_escape_sequence(self.escape_buffer)
-                            self.reset_escape_state()
-                        else:
-                            self.reset_escape_state()
-                    elif self.escape_state == EscapeState.CSI:
-                        if 0x40 <= ord(c) <= 0x7E:  # Final byte of CSI sequence
-                            self.handle_escape_sequence(self.escape_buffer)
-                            self.reset_escape_state()
-                    elif self.escape_state == EscapeState.OSC:
-                        if c == "\x07" or (
-                            c == "\\"
-                            and len(self.escape_buffer) > 2
-                            and self.escape_buffer[-2] == "\033"
-                        ):
-                            self.handle_escape_sequence(self.escape_buffer)
-                            self.reset_escape_state()
-                else:
-                    # Non-ASCII character interrupts escape sequence
-                    self.reset_escape_state()
-                    text_buffer += c
-            else:
-                if c == "\033":  # ESC character
-                    # Flush any pending text
-                    if text_buffer:
-                        self.insert_text(text_buffer)
-                        text_buffer = ""
-
-                    # Start collecting escape sequence
-                    self.in_escape = True
-                    self.escape_state = EscapeState.ESC
-                    self.escape_buffer = c
-                elif c == "\r":
-                    # Flush any pending text
-                    if text_buffer:
-                        self.insert_text(text_buffer)
-                        text_buffer = ""
-                    self.handle_carriage_return()
-                elif c == "\n":
-                    # Flush any pending text
-                    if text_buffer:
-                        self.insert_text(text_buffer)
-                        text_buffer = ""
-                    self.handle_new_line()
-                elif c == "\b":
-                    # Flush any pending text
-                    if text_buffer:
-                        self.insert_text(text_buffer)
-                        text_buffer = ""
-                    self.handle_backspace()
-                elif c == "\t":
-                    # Flush any pending text
-                    if text_buffer:
-                        self.insert_text(text_buffer)
-                        text_buffer = ""
-                    self.handle_tab()
-                elif ord(c) >= 32 or (
-                    1 <= ord(c) <= 31 and c not in "\x07\x08\x09\x0a\x0d"
-                ):
-                    # Collect regular text (printable + some control chars, excluding handled ones)
-                    text_buffer += c
-
-        # Flush any remaining text
-        if text_buffer:
-            self.insert_text(text_buffer)
+        self.apply_actions(self.parser.feed(text))
+
+    def apply_actions(self, actions):
+        """Apply parsed actions to the screen"""
+        for action in actions:
+            kind = action[0]
+            if kind == core.ACTION_PRINT:
+                self.insert_text(action[1])
+            elif kind == core.ACTION_EXECUTE:
+                self.handle_control(action[1])
+            elif kind == core.ACTION_CSI:
+                self.handle_csi_sequence(action[1], action[2], action[3], action[4])
+            elif kind == core.ACTION_ESC:
+                self.handle_escape_sequence(action[1], action[2])
+            elif kind == core.ACTION_OSC:
+                self.handle_osc(action[1])
+
+    def handle_control(self, code):
+        """Process a C0 control character"""
+        if code == 0x0D:  # \r
+            self.handle_carriage_return()
+        elif code == 0x0A:  # \n
+            self.handle_new_line()
+        elif code == 0x08:  # \b
+            self.handle_backspace()
+        elif code == 0x09:  # \t
+            self.handle_tab()
 
     def ensure_line_exists(self, line_index):
         """Make sure the specified line exists in the current buffer"""
@@ -249,7 +250,7 @@ class BaseTerminal:
         if self.is_alt_screen:
             current_lines = screen.buffer.get_line_count()
             while current_lines <= line_index:
-                screen.buffer.add_line()
+                screen.add_line()
                 screen.buffer.resize_lines(
                     current_lines, current_lines, self.num_columns
                 )
@@ -258,7 +259,7 @@ class BaseTerminal:
         else:
             current_lines = screen.buffer.get_line_count() - screen.start_pos
             while current_lines <= line_index:
-                screen.buffer.add_line()
+                screen.add_line()
                 screen.buffer.resize_lines(
                     current_lines, current_lines, self.num_columns
                 )
@@ -348,7 +349,7 @@ class BaseTerminal:
 
             # Ensure we have enough lines
             for i in range(self.num_rows):
-                self.alt_screen.buffer.add_line()
+                self.alt_screen.add_line()
 
     def switch_to_main_screen(self):
         """Switch back to main screen buffer"""
@@ -370,21 +371,15 @@ class BaseTerminal:
             screen.cursor_y + screen.start_pos, screen.cursor_x, text
         )
 
-        color = self.foreground_color
-        underline_color = self.underline_color if self.underline_enabled else -1
-        background_color = self.background_color
-        color, underline_color, background_color = highlight(
-            text, color, underline_color, background_color
-        )
-
         # Apply current attributes to the inserted text
         screen.buffer.set_color(
             screen.cursor_y + screen.start_pos,
             screen.cursor_x,
             screen.cursor_x + len(text) - 1,
-            color,
-            underline_color,
-            background_color,
+            self.foreground_color,
+            self.underline_color if self.underline_enabled else -1,
+            self.background_color,
+            self.text_flags,
         )
 
         # Advance cursor
@@ -488,6 +483,7 @@ class BaseTerminal:
     def insert_lines(self, count=1):
         screen = self.current_screen
         screen.buffer.insert_lines(screen.cursor_y + screen.start_pos, count)
+        screen.sync_trimmed_lines()
 
     def delete_lines(self, count=1):
         screen = self.current_screen
@@ -515,71 +511,45 @@ class BaseTerminal:
             self.background_color,
         )
 
-    def handle_escape_sequence(self, sequence):
+    def handle_escape_sequence(self, command, intermediates):
         """Process an escape sequence"""
-        if not sequence or len(sequence) < 2:
+        if intermediates:
             return
+        screen = self.current_screen
 
-        if sequence[1] == "[":  # CSI sequence
-            self.handle_csi_sequence(sequence[2:])
-        elif sequence[1] == "]":
-            self.handle_osc(sequence[2:])
-        elif len(sequence) == 2:
-            command = sequence[1]
-            screen = self.current_screen
-
-            if command == "7":  # Save cursor
-                screen.saved_cursor_x = screen.cursor_x
-                screen.saved_cursor_y = screen.cursor_y
-            elif command == "8":  # Restore cursor
-                screen.cursor_x = screen.saved_cursor_x
-                screen.cursor_y = screen.saved_cursor_y
-                self.ensure_line_exists(screen.cursor_y)
-            elif command == "c":  # Reset terminal
-                self.clear_screen(2)
-                self.foreground_color = theme.Terminal.TEXT
-                self.background_color = -1
-                self.underline_color = -1
-                self.underline_enabled = False
-            elif command == "D":  # Index (Line feed)
-                self.handle_new_line()
-            elif command == "E":  # Next line
-                self.handle_new_line()
-                self.handle_carriage_return()
-            elif command == "M":  # Reverse index
-                screen.cursor_y = max(0, screen.cursor_y - 1)
+        if command == "7":  # Save cursor
+            screen.saved_cursor_x = screen.cursor_x
+            screen.saved_cursor_y = screen.cursor_y
+        elif command == "8":  # Restore cursor
+            screen.cursor_x = screen.saved_cursor_x
+            screen.cursor_y = screen.saved_cursor_y
+            self.ensure_line_exists(screen.cursor_y)
+        elif command == "c":  # Reset terminal
+            self.clear_screen(2)
+            self.foreground_color = theme.Terminal.TEXT
+            self.background_color = -1
+            self.underline_color = -1
+            self.underline_enabled = False
+        elif command == "D":  # Index (Line feed)
+            self.handle_new_line()
+        elif command == "E":  # Next line
+            self.handle_new_line()
+            self.handle_carriage_return()
+        elif command == "M":  # Reverse index
+            screen.cursor_y = max(0, screen.cursor_y - 1)
 
-    def handle_csi_sequence(self, sequence):
+    def handle_csi_sequence(self, command, private_marker, intermediates, params):
         """Handle Control Sequence Introducer (CSI) sequences"""
-        if not sequence:
+        if intermediates:
             return
 
-        # Extract command character (last character)
-        command = sequence[-1]
-        param_part = sequence[:-1]
-
-        # Check for private mode
-        is_private_mode = False
-        if param_part.startswith("?"):
-            is_private_mode = True
-            param_part = param_part[1:]
-
-        # Parse parameters
-        params = []
-        if param_part:
-            for part in param_part.split(";"):
-                try:
-                    params.append(int(part) if part else 0)
-                except ValueError:
-                    params.append(0)
-
         if not params:
             params = [0]
 
         # Handle the command
-        if is_private_mode:
+        if private_marker == "?":
             self.handle_private_mode(params, command)
-        else:
+        elif not private_marker:
             self.handle_csi(params, command)
 
     def handle_private_mode(self, params, command):
@@ -590,19 +560,23 @@ class BaseTerminal:
                     self.switch_to_alt_screen()
                 if param == 25:  # Show cursor
                     self.is_cursor_visible = True
+                if param == 2004:  # Bracketed paste
+                    self.is_bracketed_paste = True
         elif command == "l":  # Reset mode
             for param in params:
                 if param in (47, 1047, 1049):  # Switch to main screen
                     self.switch_to_main_screen()
                 if param == 25:  # Hide cursor
                     self.is_cursor_visible = False
+                if param == 2004:
+                    self.is_bracketed_paste = False
 
     def handle_osc(self, seq):
         """Handle Operating System Command (OSC) sequences"""
         parts = seq.split(";")
         if parts and parts[0] in ("0", "2"):  # Title sequence
             # Title is everything after the first ';'
-            title = ";".join(parts[1:]).rstrip("\x07")
+            title = ";".join(parts[1:])
             self.title = title
 
     def handle_csi(self, params, command):
@@ -672,6 +646,19 @@ class BaseTerminal:
                 self.background_color = -1
                 self.underline_color = -1
                 self.underline_enabled = False
+                self.text_flags = 0
+            elif param == 1:  # Bold
+                self.text_flags |= core.ATTR_BOLD
+            elif param == 3:  # Italic
+                self.text_flags |= core.ATTR_ITALIC
+            elif param == 7:  # Inverse
+                self.text_flags |= core.ATTR_INVERSE
+            elif param == 22:  # Normal intensity
+                self.text_flags &= ~core.ATTR_BOLD
+            elif param == 23:  # Not italic
+                self.text_flags &= ~core.ATTR_ITALIC
+            elif param == 27:  # Not inverse
+                self.text_flags &= ~core.ATTR_INVERSE
             elif param == 4:  # Underline
                 self.underline_enabled = True
                 self.underline_color = self.foreground_color
@@ -679,11 +666,11 @@ class BaseTerminal:
                 self.underline_enabled = False
                 self.underline_color = -1
             elif 30 <= param <= 37:  # Foreground color (standard)
-                self.foreground_color = theme.Terminal.ANSI_COLORS[param - 30]
+                self.foreground_color = palette_color(param - 30)
             elif param == 38:  # Extended foreground color
                 if i + 2 < len(params) and params[i + 1] == 5:
                     # 8-bit color
-                    self.foreground_color = self.get_256_color(params[i + 2])
+                    self.foreground_color = palette_color(params[i + 2] & 0xFF)
                     i += 2
                 elif i + 4 < len(params) and params[i + 1] == 2:
                     # 24-bit RGB
@@ -693,11 +680,11 @@ class BaseTerminal:
             elif param == 39:  # Default foreground color
                 self.foreground_color = theme.Terminal.TEXT
             elif 40 <= param <= 47:  # Background color (standard)
-                self.background_color = theme.Terminal.ANSI_COLORS[param - 40]
+                self.background_color = palette_color(param - 40)
             elif param == 48:  # Extended background color
                 if i + 2 < len(params) and params[i + 1] == 5:
                     # 8-bit color
-                    self.background_color = self.get_256_color(params[i + 2])
+                    self.background_color = palette_color(params[i + 2] & 0xFF)
                     i += 2
                 elif i + 4 < len(params) and params[i + 1] == 2:
                     # 24-bit RGB
@@ -707,29 +694,8 @@ class BaseTerminal:
             elif param == 49:  # Default background color
                 self.background_color = -1
             elif 90 <= param <= 97:  # Foreground color (bright)
-                self.foreground_color = theme.Terminal.ANSI_BRIGHT_COLORS[param - 90]
+                self.foreground_color = palette_color(param - 90 + 8)
             elif 100 <= param <= 107:  # Background color (bright)
-                self.background_color = theme.Terminal.ANSI_BRIGHT_COLORS[param - 100]
+                self.background_color = palette_color(param - 100 + 8)
 
             i += 1
-
-    def get_256_color(self, index):
-        """Convert 8-bit color index to RGB color"""
-        if index < 8:  # Standard colors
-            return theme.Terminal.ANSI_COLORS[index]
-        elif index < 16:  # Bright colors
-            return theme.Terminal.ANSI_BRIGHT_COLORS[index - 8]
-        elif index >= 232 and index < 256:  # Grayscale
-            level = ((index - 232) * 255) // 23
-            return (level << 16) | (level << 8) | level
-        else:  # 6x6x6 color cube
-            index -= 16
-            r = (index // 36) % 6
-            g = (index // 6) % 6
-            b = index % 6
-
-            r = r * 40 + 55 if r > 0 else 0
-            g = g * 40 + 55 if g > 0 else 0
-            b = b * 40 + 55 if b > 0 else 0
-
-            return (r << 16) | (g << 8) | b
@@ -1,5 +1,6 @@
 import base
 import math
+from core import BufferSearch
 from user import theme
 
 
@@ -15,6 +16,8 @@ class TerminalWithSelection(base.BaseTerminal):
         self.selection_type = SelectionType.NONE
         self.selection_start = None
         self.selection_end = None
+        self.search = None
+        self.search_pattern = ""
 
     def get_buffer_position(self, x, y):
         x = max(0, x - self.app.get_selector_width())
@@ -67,10 +70,78 @@ class TerminalWithSelection(base.BaseTerminal):
                 lines.append(line.strip())
         return "\n".join(lines)
 
+    def process_ansi(self, text):
+        """Keep the selection on its text when the output makes the
+        buffer drop its oldest lines"""
+        screen = self.current_screen
+        trimmed = screen.trimmed_lines
+        super().process_ansi(text)
+        if screen is self.current_screen and screen.trimmed_lines != trimmed:
+            self.shift_selection(trimmed - screen.trimmed_lines)
+
+    def shift_selection(self, delta):
+        """Move the selection by delta buffer rows, clearing it if it
+        leaves the buffer at the top"""
+        if not self.selection_start or not self.selection_end:
+            return
+        start_row, start_col = self.selection_start
+        end_row, end_col = self.selection_end
+        start_row += delta
+        end_row += delta
+        if min(start_row, end_row) < 0:
+            self.selection_type = SelectionType.NONE
+            self.selection_start = None
+            self.selection_end = None
+            return
+        self.selection_start = (start_row, start_col)
+        self.selection_end = (end_row, end_col)
+
+    def start_search(self, pattern, regex=False, ignore_case=False):
+        """Search the main screen and its scrollback in the background,
+        matches are highlighted as they are found"""
+        self.main_screen.enable_search_index()
+        self.search = BufferSearch(
+            self.main_screen.buffer, pattern, regex, ignore_case
+        )
+        self.search_pattern = pattern
+        self.app.redraw()
+
+    def stop_search(self):
+        self.search = None
+        self.search_pattern = ""
+        self.app.redraw()
+
     def render(self, x, y, width, height):
         super().render(x, y, width, height)
+        self.render_search(x, y, width, height)
         self.render_selection(x, y, width, height)
 
+    def render_search(self, x, y, width, height):
+        if self.search is None or self.is_alt_screen:
+            return
+
+        # Rendering holds the GIL, so the buffer is not being edited
+        self.search.update()
+        if not self.search.stats()["done"]:
+            self.app.redraw()
+
+        line_height = math.ceil(self.app.get_line_height(self.font_size))
+        advance = self.app.get_advance(self.font_size)
+        buffer_y = max(0, self.main_screen.start_pos - self.scroll_offset)
+        first_line = buffer_y + self.main_screen.buffer.get_trimmed_line_count()
+        for line, start, end in self.search.get_matches(
+            first_line, first_line + self.num_rows
+        ):
+            top = y + (line - first_line) * line_height
+            self.app.rect(
+                x + start * advance,
+                top,
+                x + end * advance,
+                top + line_height,
+                theme.Terminal.SEARCH_MATCH,
+                theme.Terminal.SEARCH_MATCH_OPACITY,
+            )
+
     def render_selection(self, x, y, width, height):
         if (
             self.selection_type == SelectionType.NONE
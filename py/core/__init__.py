@@ -1,17 +1,53 @@
 from .window import Window
-from .mterm import PseudoConsole, LineFragment, ColoredLine, ColoredTextBuffer, is_key_down, clipboard_copy, clipboard_paste
+from .headless import HeadlessWindow
+from .mterm import SoftwareRenderer, PtyReactor, PseudoConsole, PtyRecording, LineFragment, ColoredLine, ColoredTextBuffer, BufferSearch, HighlightRule, AnsiParser, is_key_down, clipboard_copy, clipboard_paste
+from .mterm import set_stats_enabled, is_stats_enabled, stats, reset_stats, start_trace, stop_trace
+from .mterm import set_latency_probe_enabled, latency_stats, reset_latency_stats
+from .mterm import ACTION_PRINT, ACTION_EXECUTE, ACTION_CSI, ACTION_ESC, ACTION_OSC, ACTION_DCS
+from .mterm import RECORD_OUTPUT, RECORD_RESIZE
+from .mterm import COLOR_DEFAULT, COLOR_PALETTE_FLAG, HIGHLIGHT_KEEP, ATTR_BOLD, ATTR_ITALIC, ATTR_INVERSE
 from . import keys, buttons, cursors
 
 __all__ = [
     "Window",
+    "HeadlessWindow",
+    "SoftwareRenderer",
+    "PtyReactor",
     "PseudoConsole",
+    "PtyRecording",
     "LineFragment",
     "ColoredLine",
     "ColoredTextBuffer",
+    "BufferSearch",
+    "HighlightRule",
+    "AnsiParser",
+    "ACTION_PRINT",
+    "ACTION_EXECUTE",
+    "ACTION_CSI",
+    "ACTION_ESC",
+    "ACTION_OSC",
+    "ACTION_DCS",
+    "RECORD_OUTPUT",
+    "RECORD_RESIZE",
+    "COLOR_DEFAULT",
+    "COLOR_PALETTE_FLAG",
+    "HIGHLIGHT_KEEP",
+    "ATTR_BOLD",
+    "ATTR_ITALIC",
+    "ATTR_INVERSE",
     "keys",
     "buttons",
     "cursors",
     "is_key_down",
     "clipboard_copy",
-    "clipboard_paste"
+    "clipboard_paste",
+    "set_stats_enabled",
+    "is_stats_enabled",
+    "stats",
+    "reset_stats",
+    "start_trace",
+    "stop_trace",
+    "set_latency_probe_enabled",
+    "latency_stats",
+    "reset_latency_stats"
 ]
@@ -0,0 +1,89 @@
+from . import mterm, cursors
+
+
+class HeadlessWindow(mterm.SoftwareRenderer):
+    """Window без окна: тот же интерфейс, кадры рисуются в память."""
+
+    def __init__(self, width=1000, height=600):
+        super().__init__(width, height)
+
+    def on_render(self):
+        pass
+
+    def on_resize(self, width, height):
+        pass
+
+    def on_keydown(self, key):
+        pass
+
+    def on_keyup(self, key):
+        pass
+
+    def on_input(self, char):
+        pass
+
+    def on_mousemove(self, x, y):
+        pass
+
+    def on_mousedown(self, button, x, y):
+        pass
+
+    def on_mouseup(self, button, x, y):
+        pass
+
+    def on_doubleclick(self, button, x, y):
+        pass
+
+    def on_scroll(self, delta, x, y):
+        pass
+
+    def on_mouseleave(self):
+        pass
+
+    def set_cursor(self, cursor_id):
+        pass
+
+    def drag(self):
+        pass
+
+    def maximize(self):
+        pass
+
+    def minimize(self):
+        pass
+
+    def restore(self):
+        pass
+
+    def is_maximized(self):
+        return False
+
+    def destroy(self):
+        pass
+
+    def redraw(self):
+        # Рисуем синхронно, кадр готов сразу после возврата
+        self.begin_frame()
+        try:
+            self.on_render()
+        finally:
+            self.end_frame()
+
+    def run(
+        self,
+        font_name="Cascadia Mono",
+        icon_path="icon.ico",
+        width=1000,
+        height=600,
+        min_width=375,
+        min_height=225,
+        border_size=5,
+        cursor_id=cursors.ARROW,
+        frame_rate=60,
+        frame_latency_ms=50,
+    ):
+        # Параметры окна и шрифта игнорируются, размер кадра берется как есть
+        self.resize(width, height)
+        self.on_resize(width, height)
+        self.redraw()
+        return 0
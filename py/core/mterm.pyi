@@ -1,4 +1,4 @@
-from typing import Callable, Optional, List
+from typing import Callable, Optional, List, Tuple, Any, Dict, Union
 
 # Type aliases для удобства
 RenderCallback = Callable[[], None]
@@ -9,13 +9,11 @@ MouseMoveCallback = Callable[[int, int], None]
 MouseButtonCallback = Callable[[int, int, int], None]
 ScrollCallback = Callable[[int, int, int], None]
 MouseLeaveCallback = Callable[[], None]
-ConsoleDataCallback = Callable[[str], None]
+ConsoleDataCallback = Callable[[str | memoryview], None]
 
 class LineFragment:
     pos: int
-    color: int
-    underline_color: int
-    background_color: int
+    attr: int
 
     def __init__(self) -> None: ...
 
@@ -23,6 +21,7 @@ class LineFragment:
 class ColoredLine:
     text: str
     fragments: List[LineFragment]
+    version: int
 
     def __init__(self) -> None: ...
 
@@ -36,6 +35,8 @@ class Config:
     window_min_height: int
     border_size: int
     cursor_id: int
+    frame_rate: int
+    frame_latency_ms: int
 
     render_callback: Optional[RenderCallback]
     resize_callback: Optional[ResizeCallback]
@@ -52,27 +53,93 @@ class Config:
     def __init__(self) -> None: ...
 
 
-class PseudoConsole:
+class PtyReactor:
     def __init__(self) -> None: ...
 
-    def start(self, num_rows: int, num_columns: int, callback: ConsoleDataCallback) -> bool: ...
+    def set_byte_budget(self, bytes: int) -> None: ...
+
+    def get_byte_budget(self) -> int: ...
+
+    def session_stats(self) -> List[Dict[str, float]]: ...
+
+
+class PseudoConsole:
+    def __init__(self, reactor: Optional[PtyReactor] = None) -> None: ...
+
+    def session_id(self) -> int: ...
+
+    def set_command(self, argv: List[str]) -> None: ...
+
+    def set_environment(self, environment: List[str]) -> None: ...
+
+    def start(
+            self,
+            num_rows: int,
+            num_columns: int,
+            callback: ConsoleDataCallback,
+            raw: bool = False
+    ) -> bool: ...
 
     def send(self, data: str) -> bool: ...
 
+    def paste(self, data: str, bracketed: bool = False) -> bool: ...
+
     def resize(self, num_rows: int, num_columns: int) -> None: ...
 
     def close(self) -> None: ...
 
+    def ring_stats(self) -> Dict[str, int]: ...
+
+    def write_stats(self) -> Dict[str, int]: ...
+
+    def start_recording(self, path: str) -> bool: ...
+
+    def stop_recording(self) -> None: ...
+
+
+class PtyRecording:
+    def __init__(self, path: str) -> None: ...
+
+    def __iter__(self) -> "PtyRecording": ...
+
+    def __next__(self) -> Tuple[int, int, Union[bytes, Tuple[int, int]]]: ...
+
 
 class ColoredTextBuffer:
-    def __init__(self) -> None: ...
+    def __init__(self, max_lines: int = 10000) -> None: ...
 
     def add_line(self) -> None: ...
 
-    def get_lines(self) -> List[ColoredLine]: ...
+    def get_line(self, line_index: int) -> ColoredLine: ...
 
     def get_line_count(self) -> int: ...
 
+    def get_line_version(self, line_index: int) -> int: ...
+
+    def take_damage(self) -> Tuple[int, int]: ...
+
+    def get_max_lines(self) -> int: ...
+
+    def set_max_lines(self, max_lines: int) -> None: ...
+
+    def get_trimmed_line_count(self) -> int: ...
+
+    def get_hot_line_count(self) -> int: ...
+
+    def set_hot_line_count(self, hot_lines: int) -> None: ...
+
+    def get_spill_budget(self) -> int: ...
+
+    def set_spill_budget(self, budget: int) -> None: ...
+
+    def get_scrollback_stats(self) -> Dict[str, int]: ...
+
+    def get_search_index_budget(self) -> int: ...
+
+    def set_search_index_budget(self, budget: int) -> None: ...
+
+    def get_search_index_stats(self) -> Dict[str, int]: ...
+
     def insert_lines(self, index: int, count: int) -> None: ...
 
     def remove_lines(self, start_index: int, end_index: int) -> None: ...
@@ -98,9 +165,71 @@ class ColoredTextBuffer:
             end_pos: int,
             color: int,
             underline_color: int,
-            background_color: int
+            background_color: int,
+            flags: int = 0
     ) -> None: ...
 
+    def get_attributes(self, attr: int) -> Tuple[int, int, int, int]: ...
+
+    def get_attribute_count(self) -> int: ...
+
+
+# (line, start, end), line - абсолютный номер строки
+SearchMatch = Tuple[int, int, int]
+
+
+class BufferSearch:
+    def __init__(
+            self,
+            buffer: ColoredTextBuffer,
+            pattern: str,
+            regex: bool = False,
+            ignore_case: bool = False
+    ) -> None: ...
+
+    def update(self, max_lines: int = 2048) -> int: ...
+
+    def take_new_matches(self) -> List[SearchMatch]: ...
+
+    def get_matches(self, begin: int, end: int) -> List[SearchMatch]: ...
+
+    def find_next(
+            self, line: int, column: int, backward: bool = False
+    ) -> Optional[SearchMatch]: ...
+
+    def get_match_count(self) -> int: ...
+
+    def stats(self) -> Dict[str, Any]: ...
+
+
+class HighlightRule:
+    pattern: str
+    regex: bool
+    ignore_case: bool
+    color: int
+    underline_color: int
+    background_color: int
+    flags: int
+
+    def __init__(
+            self,
+            pattern: str,
+            regex: bool = False,
+            ignore_case: bool = False,
+            color: int = -2,
+            underline_color: int = -2,
+            background_color: int = -2,
+            flags: int = 0
+    ) -> None: ...
+
+
+class AnsiParser:
+    def __init__(self) -> None: ...
+
+    def feed(self, data: str | bytes | memoryview) -> List[Tuple[Any, ...]]: ...
+
+    def reset(self) -> None: ...
+
 
 class Window:
     def __init__(self) -> None: ...
@@ -127,6 +256,94 @@ class Window:
 
     def get_height(self) -> int: ...
 
+    def get_frame_stats(self) -> Dict[str, int]: ...
+
+    def get_batch_stats(self) -> Dict[str, int]: ...
+
+    def clear(self, color: int) -> None: ...
+
+    def text(
+            self,
+            text: str,
+            font_size: float,
+            x: float,
+            y: float,
+            color: int,
+            underline_color: int = -1,
+            background_color: int = -1,
+            opacity: float = 1.0
+    ) -> None: ...
+
+    def line(
+            self,
+            start_x: float,
+            start_y: float,
+            end_x: float,
+            end_y: float,
+            thickness: float,
+            color: int,
+            opacity: float = 1.0
+    ) -> None: ...
+
+    def rect(
+            self,
+            left: float,
+            top: float,
+            right: float,
+            bottom: float,
+            color: int,
+            opacity: float = 1.0
+    ) -> None: ...
+
+    def outline(
+            self,
+            left: float,
+            top: float,
+            right: float,
+            bottom: float,
+            thickness: float,
+            color: int,
+            opacity: float = 1.0
+    ) -> None: ...
+
+    def text_buffer(
+            self,
+            buffer: ColoredTextBuffer,
+            left: float,
+            top: float,
+            width: float,
+            height: float,
+            x_offset_chars: int,
+            y_offset_lines: int,
+            font_size: float
+    ) -> None: ...
+
+    def set_palette(self, colors: List[int]) -> None: ...
+
+    def set_highlight_rules(self, rules: List[HighlightRule]) -> None: ...
+
+    def get_advance(self, font_size: float) -> float: ...
+
+    def get_line_width(self, font_size: float, num_chars: int) -> float: ...
+
+    def get_line_height(self, font_size: float) -> float: ...
+
+
+class SoftwareRenderer:
+    def __init__(self, width: int, height: int) -> None: ...
+
+    def resize(self, width: int, height: int) -> None: ...
+
+    def get_width(self) -> int: ...
+
+    def get_height(self) -> int: ...
+
+    def begin_frame(self) -> None: ...
+
+    def end_frame(self) -> None: ...
+
+    def get_pixels(self) -> bytes: ...
+
     def clear(self, color: int) -> None: ...
 
     def text(
@@ -185,6 +402,10 @@ class Window:
             font_size: float
     ) -> None: ...
 
+    def set_palette(self, colors: List[int]) -> None: ...
+
+    def set_highlight_rules(self, rules: List[HighlightRule]) -> None: ...
+
     def get_advance(self, font_size: float) -> float: ...
 
     def get_line_width(self, font_size: float, num_chars: int) -> float: ...
@@ -198,6 +419,39 @@ def clipboard_copy(text: str) -> None: ...
 
 def clipboard_paste() -> str: ...
 
+def set_stats_enabled(enabled: bool) -> None: ...
+
+def is_stats_enabled() -> bool: ...
+
+def stats() -> Dict[str, Dict[str, Any]]: ...
+
+def reset_stats() -> None: ...
+
+def start_trace(max_events: int = 1000000) -> None: ...
+
+def stop_trace(path: str) -> None: ...
+
+def set_latency_probe_enabled(enabled: bool) -> None: ...
+
+def latency_stats() -> Dict[str, int]: ...
+
+def reset_latency_stats() -> None: ...
+
 # Константы
 PTY_BUFFER_SIZE: int
 TEXT_BUFFER_SIZE: int
+ACTION_PRINT: int
+ACTION_EXECUTE: int
+ACTION_CSI: int
+ACTION_ESC: int
+ACTION_OSC: int
+ACTION_DCS: int
+RECORD_OUTPUT: int
+RECORD_RESIZE: int
+
+COLOR_DEFAULT: int
+COLOR_PALETTE_FLAG: int
+HIGHLIGHT_KEEP: int
+ATTR_BOLD: int
+ATTR_ITALIC: int
+ATTR_INVERSE: int
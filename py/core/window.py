@@ -45,6 +45,8 @@ class Window(mterm.Window):
         min_height=225,
         border_size=5,
         cursor_id=cursors.ARROW,
+        frame_rate=60,
+        frame_latency_ms=50,
     ):
         config = mterm.Config()
         config.font_name = font_name
@@ -55,6 +57,8 @@ class Window(mterm.Window):
         config.window_min_height = min_height
         config.border_size = border_size
         config.cursor_id = cursor_id
+        config.frame_rate = frame_rate
+        config.frame_latency_ms = frame_latency_ms
 
         config.render_callback = self.on_render
         config.resize_callback = self.on_resize
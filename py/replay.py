@@ -0,0 +1,174 @@
+"""Replays PTY output saved with Terminal.RECORD_DIR (or
+PseudoConsole.start_recording) through the parser and the terminal screen,
+optionally rendering frames with the software renderer, and reports where
+the time went.
+
+    python replay.py recording.mtrec [--paced] [--render] [--repeat N]
+"""
+
+import argparse
+import math
+import time
+
+import core
+from base.terminal import build_palette
+import user.highlight as highlight
+from user.terminal import Terminal
+
+
+class NullConsole:
+    """Stands in for PseudoConsole, the output comes from the recording"""
+
+    def resize(self, num_rows, num_columns):
+        pass
+
+    def send(self, data):
+        return True
+
+    def paste(self, data, bracketed=False):
+        return True
+
+    def close(self):
+        pass
+
+
+class ReplayTerminal(Terminal):
+    def __init__(self, app, id):
+        self.parse_time = 0.0
+        self.apply_time = 0.0
+        super().__init__(app, id)
+
+    def start_console(self):
+        self.console = NullConsole()
+
+    def process_ansi(self, text):
+        start = time.perf_counter()
+        actions = self.parser.feed(text)
+        parsed = time.perf_counter()
+        self.apply_actions(actions)
+        self.parse_time += parsed - start
+        self.apply_time += time.perf_counter() - parsed
+
+
+class ReplayApp(core.HeadlessWindow):
+    def __init__(self, render):
+        super().__init__()
+        self.pty_reactor = None
+        self.render_enabled = render
+        self.render_time = 0.0
+        self.frames = 0
+        self.set_palette(build_palette())
+        self.set_highlight_rules(highlight.RULES)
+        self.terminal = ReplayTerminal(self, 0)
+
+    def get_client_height(self):
+        return self.get_height()
+
+    def get_terminal_width(self):
+        return self.get_width()
+
+    def get_caption_height(self):
+        return 0
+
+    def get_selector_width(self):
+        return 0
+
+    def resize_terminal(self, num_rows, num_columns):
+        """Sizes the frame so that the terminal gets the recorded size"""
+        font_size = self.terminal.font_size
+        width = math.ceil(num_columns * self.get_advance(font_size))
+        height = num_rows * math.ceil(self.get_line_height(font_size))
+        self.resize(width, height)
+        self.terminal.resize(width, height)
+
+    def on_render(self):
+        self.terminal.render(0, 0, self.get_width(), self.get_height())
+
+    def redraw(self):
+        # A frame per chunk, an upper bound for the paced UI
+        if self.render_enabled:
+            start = time.perf_counter()
+            super().redraw()
+            self.render_time += time.perf_counter() - start
+            self.frames += 1
+
+
+def load(path):
+    start = time.perf_counter()
+    records = list(core.PtyRecording(path))
+    return records, time.perf_counter() - start
+
+
+def replay(records, paced, render):
+    app = ReplayApp(render)
+    terminal = app.terminal
+    total_bytes = 0
+    chunks = 0
+    max_lag = 0.0
+    start = time.perf_counter()
+    for time_us, kind, payload in records:
+        if paced:
+            due = start + time_us / 1e6
+            now = time.perf_counter()
+            if due > now:
+                time.sleep(due - now)
+            else:
+                max_lag = max(max_lag, now - due)
+        if kind == core.RECORD_RESIZE:
+            app.resize_terminal(*payload)
+        else:
+            terminal.on_console_output(payload)
+            total_bytes += len(payload)
+            chunks += 1
+    elapsed = time.perf_counter() - start
+    return {
+        "bytes": total_bytes,
+        "chunks": chunks,
+        "seconds": elapsed,
+        "parse": terminal.parse_time,
+        "apply": terminal.apply_time,
+        "render": app.render_time,
+        "frames": app.frames,
+        "max_lag": max_lag,
+    }
+
+
+def report(path, load_seconds, result, paced):
+    seconds = result["seconds"]
+    print(f"{path}: {result['bytes'] / 1e6:.1f} MB in {result['chunks']} chunks")
+    print(
+        f"  {seconds:.3f} s, {result['bytes'] / seconds / 1e6:.1f} MB/s, "
+        f"{result['chunks'] / seconds:.0f} chunks/s"
+    )
+    print(f"  {'load':<8}{load_seconds:9.3f} s")
+    for name in ("parse", "apply", "render"):
+        print(
+            f"  {name:<8}{result[name]:9.3f} s"
+            f"{result[name] / seconds * 100:7.1f}%"
+        )
+    if result["frames"]:
+        print(f"  {result['frames']} frames, "
+              f"{result['render'] / result['frames'] * 1000:.2f} ms per frame")
+    if paced:
+        print(f"  fell behind the recording by up to {result['max_lag'] * 1000:.1f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay a PTY recording")
+    parser.add_argument("recordings", nargs="+")
+    parser.add_argument("--paced", action="store_true",
+                        help="keep the original timing instead of replaying as fast as possible")
+    parser.add_argument("--render", action="store_true",
+                        help="render a frame after every chunk")
+    parser.add_argument("--repeat", type=int, default=1)
+    args = parser.parse_args()
+
+    for path in args.recordings:
+        records, load_seconds = load(path)
+        for _ in range(args.repeat):
+            report(path, load_seconds, replay(records, args.paced, args.render),
+                   args.paced)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,9 +1,8 @@
-import re
+from core import HighlightRule
 
-
-def highlight(text, color, underline_color, background_color):
-    # Post-process text
-    match = re.match(r'^(PS\s+[A-Z]:\\.*?)', text)
-    if match:
-        color = 0x5AF78E
-    return color, underline_color, background_color
+# Applied by the renderer to visible lines: pattern and the attributes it
+# overrides, see HighlightRule
+RULES = [
+    # PowerShell prompt
+    HighlightRule(r'^PS\s+[A-Z]:\\[^>]*>', regex=True, color=0x5AF78E),
+]
@@ -32,6 +32,9 @@ class Terminal(TerminalWithSelection):
             if core.is_key_down(ord('C')):
                 self.copy_selection(append=core.is_key_down(core.keys.LSHIFT))
                 return
+            if core.is_key_down(ord('F')):
+                self.toggle_search(self.get_selection_text())
+                return
         self.console.send(input_text)
 
     def on_keyup(self, key):
@@ -67,7 +70,7 @@ class Terminal(TerminalWithSelection):
         if x <= self.app.get_selector_width() or y <= self.app.get_caption_height():
             return
         if button == core.buttons.RIGHT and self.selection_type == SelectionType.NONE:
-            self.console.send(core.clipboard_paste())
+            self.console.paste(core.clipboard_paste(), self.is_bracketed_paste)
             return
         
         current_selection_type = (
@@ -104,7 +107,7 @@ class Terminal(TerminalWithSelection):
         if x <= self.app.get_selector_width() or y <= self.app.get_caption_height():
             return
         if button == core.buttons.RIGHT and self.selection_type == SelectionType.NONE:
-            self.console.send(core.clipboard_paste())
+            self.console.paste(core.clipboard_paste(), self.is_bracketed_paste)
             return
         if button == core.buttons.LEFT:
             row, col = self.get_buffer_position(x, y)
@@ -136,6 +139,15 @@ class Terminal(TerminalWithSelection):
         super().switch_to_main_screen()
         self.selection_type = SelectionType.NONE
 
+    def toggle_search(self, pattern):
+        """Ctrl+F on a selection highlights the selected text everywhere,
+        again on the same text stops the search"""
+        self.selection_type = SelectionType.NONE
+        if not pattern or pattern == self.search_pattern:
+            self.stop_search()
+        else:
+            self.start_search(pattern, ignore_case=True)
+
     def copy_selection(self, append=False):
         if self.selection_type != SelectionType.NONE:
             text = self.get_selection_text()
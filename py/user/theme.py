@@ -9,6 +9,10 @@ class Window:
     MIN_HEIGHT=250
     CAPTION_SIZE=30
     BORDER_SIZE=5
+    FRAME_RATE=60
+    FRAME_LATENCY_MS=50  # при потоке вывода кадр не позже этого после redraw
+    LATENCY_PROBE = False  # замерять задержку нажатие→кадр, итог печатается при выходе
+    TRACE_PATH = ""  # файл для трассы Chrome (chrome://tracing) за время работы; пусто - не писать
 
     BG = 0x1e1e1e
     CLOSE_BUTTON = 0xFF1060
@@ -36,6 +40,13 @@ class Terminal:
     BASE_FONT_SIZE=14
     NUM_ROWS=35
     NUM_COLUMNS=90
+    SCROLLBACK_LINES = 100000
+    SCROLLBACK_MEMORY = 64 * 1024 * 1024  # сжатая история сверх этого - во временный файл
+    SEARCH_INDEX_MEMORY = 32 * 1024 * 1024  # индекс триграмм для поиска по истории, с первого поиска во вкладке; 0 - без индекса
+    COMMAND = []  # программа и аргументы; пусто - оболочка по умолчанию
+    ENVIRONMENT = []  # "ИМЯ=значение" вместо унаследованного окружения; пусто - наследовать
+    SHARED_IO = False  # один поток ввода-вывода и вызова колбэков на все вкладки
+    RECORD_DIR = ""  # папка для записи вывода вкладок (см. replay.py); пусто - не записывать
     CURSOR_WIDTH = 1
     SCROLL_SPEED = 0.06
 
@@ -45,6 +56,8 @@ class Terminal:
     LINE_NUMBER = 0xbbbbbb
     SELECTION = 0x00FFFF
     SELECTION_OPACITY = 0.2
+    SEARCH_MATCH = 0xF3F99D
+    SEARCH_MATCH_OPACITY = 0.35
 
     ANSI_COLORS = [
         0x1E1E1E,  # чёрный